@@ -105,6 +105,23 @@ enum {
    * probe (ending in STATUS_PROBE_FAIL or STATUS_DONE).
    */
   ZIP_EVENT_NODE_PROBED,
+  /** The state cache wants stale values refreshed, see
+   * sl_state_cache_refresh(). */
+  ZIP_EVENT_STATE_CACHE_REFRESH,
+  /** The SUC ID sent by send_suc_id() got no callback in time, go on with
+   * the next node. */
+  ZIP_EVENT_RD_SEND_SUC_ID_TIMEOUT,
+  /** The timer of an interview expired: a step that waited for airtime
+   * goes on, or the interview stalled. ev_data is the interview slot, see
+   * rd_probe_timeout(). */
+  ZIP_EVENT_RD_PROBE_TIMEOUT,
+  /** The node info an interview asked for did not arrive. */
+  ZIP_EVENT_RD_NIF_REQUEST_TIMEOUT,
+  /** A node checked by the network discovery did not send its node info. */
+  ZIP_EVENT_RD_NIF_CHECK_TIMEOUT,
+  /** A node info or a failed node info request, see
+   * rd_nif_request_post(). */
+  ZIP_EVENT_RD_NIF_RECEIVED,
 };
 
 /**
@@ -22,13 +22,32 @@
 #include "Net/ZW_zip_classcmd.h"
 #include "Net/ZW_udp_server.h"
 
+/** Largest Z/IP frame an inbound packet buffer holds. */
+#define SL_TCPIP_BUF_DATA_SIZE UIP_MAX_FRAME_BYTES
+
+/** Number of inbound packet buffers in the fixed pool. */
+#ifndef SL_TCPIP_BUF_POOL_SIZE
+#define SL_TCPIP_BUF_POOL_SIZE 12
+#endif
+
+/**
+ * Inbound Z/IP packet. Buffers come from a fixed pool (see sl_udp_utils.h)
+ * and are reference counted, so the same buffer is handed from the socket
+ * to the tcpip queue and the Z/IP node input without copying. Packets to a
+ * node address keep their lwIP pbuf, zip_data then points into it.
+ */
+struct pbuf;
+
 typedef struct {
   zwave_connection_t zw_con;
   uint32_t tcpip_proto;
   uint32_t icmp_type;
   ZW_COMMAND_ZIP_PACKET *zip_packet;
-  char *zip_data;
+  char *zip_data;             /**< Points into data, or into pbuf */
   uint32_t zip_data_len;
+  uint8_t ref;                /**< Owners of the buffer, 0 when free */
+  struct pbuf *pbuf;          /**< Received pbuf freed with the buffer */
+  char data[SL_TCPIP_BUF_DATA_SIZE];
 } sl_tcpip_buf_t;
 
 #endif /* APPS_COMMON_SL_TCPIP_DEF_H_ */
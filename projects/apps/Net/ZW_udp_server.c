@@ -42,6 +42,8 @@
 #include "utls/ipv6_utils.h"
 
 #include "sl_sleeptimer.h"
+#include "FreeRTOS.h"
+#include "cmsis_os2.h"
 
 bool sl_application_cmd_ip_handler(zwave_connection_t *c,
                                    void *pData,
@@ -124,6 +126,31 @@ LIST(udp_tx_sessions_list);
  */
 static BYTE seqNo = 0;
 
+enum {
+  SLI_ZIP_REPLAY_FREE = 0,
+  SLI_ZIP_REPLAY_PENDING, ///< Request being handled, no final ACK/NACK yet
+  SLI_ZIP_REPLAY_DONE,    ///< Final ACK/NACK sent, flags0/flags1 hold it
+};
+
+/**
+ * Z/IP request that asked for an ACK, keyed by the client address and port,
+ * our address, the sequence number and the destination endpoint.
+ */
+struct zip_replay_entry {
+  struct uip_udp_conn conn;
+  u8_t seq;
+  u8_t dst_ep;            ///< Our endpoint, dEndpoint of the request
+  u8_t src_ep;
+  u8_t state;
+  u8_t flags0;
+  u8_t flags1;
+  uint32_t tick;          ///< Kernel tick of the last state change
+};
+
+static struct zip_replay_entry zip_replay[SL_ZIP_REPLAY_SIZE];
+static sl_zip_replay_stats_t zip_replay_stats;
+static osMutexId_t zip_replay_mutex;
+
 int zwave_connection_compare(zwave_connection_t *a, zwave_connection_t *b)
 {
   return uip_ipaddr_cmp(&a->conn.ripaddr, &b->conn.ripaddr)
@@ -157,6 +184,187 @@ security_scheme_t efi_to_shceme(uint8_t ext1, uint8_t ext2)
   return NO_SCHEME;
 }
 
+/*---------------------------------------------------------------------------*/
+static bool sli_zip_replay_match(const struct zip_replay_entry *e,
+                                 const struct uip_udp_conn *c,
+                                 u8_t seq,
+                                 u8_t dst_ep)
+{
+  return e->state != SLI_ZIP_REPLAY_FREE && e->seq == seq
+         && e->dst_ep == dst_ep && e->conn.rport == c->rport
+         && uip_ipaddr_cmp(&e->conn.ripaddr, &c->ripaddr)
+         && uip_ipaddr_cmp(&e->conn.sipaddr, &c->sipaddr);
+}
+
+static struct zip_replay_entry *sli_zip_replay_find(const struct uip_udp_conn *c,
+                                                    u8_t seq,
+                                                    u8_t dst_ep)
+{
+  for (int i = 0; i < SL_ZIP_REPLAY_SIZE; i++) {
+    if (sli_zip_replay_match(&zip_replay[i], c, seq, dst_ep)) {
+      return &zip_replay[i];
+    }
+  }
+  return NULL;
+}
+
+/* Free slot, else the oldest answered one; pending entries are kept. */
+static struct zip_replay_entry *sli_zip_replay_slot(uint32_t now)
+{
+  struct zip_replay_entry *oldest = NULL;
+
+  for (int i = 0; i < SL_ZIP_REPLAY_SIZE; i++) {
+    struct zip_replay_entry *e = &zip_replay[i];
+    if (e->state == SLI_ZIP_REPLAY_FREE
+        || (e->state == SLI_ZIP_REPLAY_DONE
+            && now - e->tick >= pdMS_TO_TICKS(SL_ZIP_REPLAY_TTL_MS))) {
+      return e;
+    }
+    if (e->state == SLI_ZIP_REPLAY_DONE
+        && (oldest == NULL || (int32_t) (e->tick - oldest->tick) < 0)) {
+      oldest = e;
+    }
+  }
+  return oldest;
+}
+
+static void sli_zip_replay_send(const struct zip_replay_entry *e,
+                                u8_t flags0,
+                                u8_t flags1)
+{
+  ZW_COMMAND_ZIP_PACKET ack;
+
+  memset(&ack, 0, sizeof(ack));
+  ack.cmdClass  = COMMAND_CLASS_ZIP;
+  ack.cmd       = COMMAND_ZIP_PACKET;
+  ack.flags0    = flags0;
+  ack.flags1    = flags1 & ZIP_PACKET_FLAGS1_SECURE_ORIGIN;
+  ack.seqNo     = e->seq;
+  ack.sEndpoint = e->dst_ep;
+  ack.dEndpoint = e->src_ep;
+  udp_send_wrap((struct uip_udp_conn *) &e->conn, (const uint8_t *) &ack,
+                ZIP_HEADER_SIZE, 0, 0);
+}
+
+bool sl_zip_replay_check(const struct uip_udp_conn *c,
+                         const ZW_COMMAND_ZIP_PACKET *zip)
+{
+  struct zip_replay_entry *e;
+  struct zip_replay_entry reply;
+  uint32_t now = osKernelGetTickCount();
+
+  if (zip->cmdClass != COMMAND_CLASS_ZIP || zip->cmd != COMMAND_ZIP_PACKET
+      || !(zip->flags0 & ZIP_PACKET_FLAGS0_ACK_REQ)
+      || (zip->flags0 & (ZIP_PACKET_FLAGS0_ACK_RES | ZIP_PACKET_FLAGS0_NACK_RES))
+      || zip_replay_mutex == NULL) {
+    return false;
+  }
+
+  osMutexAcquire(zip_replay_mutex, osWaitForever);
+  e = sli_zip_replay_find(c, zip->seqNo, zip->dEndpoint);
+  if (e && e->state == SLI_ZIP_REPLAY_DONE
+      && now - e->tick >= pdMS_TO_TICKS(SL_ZIP_REPLAY_TTL_MS)) {
+    // Too old to be a retransmission, the client wrapped its sequence.
+    e->state = SLI_ZIP_REPLAY_FREE;
+    e        = NULL;
+  }
+  if (e == NULL) {
+    e = sli_zip_replay_slot(now);
+    if (e) {
+      e->conn   = *c;
+      e->seq    = zip->seqNo;
+      e->dst_ep = zip->dEndpoint;
+      e->src_ep = zip->sEndpoint;
+      e->state  = SLI_ZIP_REPLAY_PENDING;
+      e->tick   = now;
+    } else {
+      zip_replay_stats.full++;
+    }
+    osMutexRelease(zip_replay_mutex);
+    return false;
+  }
+  // Answer outside the lock, sending may block.
+  reply = *e;
+  if (e->state == SLI_ZIP_REPLAY_DONE) {
+    zip_replay_stats.replayed++;
+  } else {
+    zip_replay_stats.waiting++;
+  }
+  osMutexRelease(zip_replay_mutex);
+
+  DBG_PRINTF("Duplicate Z/IP seq %d from port %d, %s\n",
+             reply.seq,
+             UIP_HTONS(reply.conn.rport),
+             reply.state == SLI_ZIP_REPLAY_DONE ? "replaying answer" : "in flight");
+  if (reply.state == SLI_ZIP_REPLAY_DONE) {
+    sli_zip_replay_send(&reply, reply.flags0, reply.flags1);
+  } else {
+    sli_zip_replay_send(&reply,
+                        ZIP_PACKET_FLAGS0_NACK_RES | ZIP_PACKET_FLAGS0_NACK_WAIT,
+                        zip->flags1);
+  }
+  return true;
+}
+
+void sl_zip_replay_record(const zwave_connection_t *c, u8_t flags0, u8_t flags1)
+{
+  struct zip_replay_entry *e;
+
+  /* Only final answers are cached; NACK+Waiting is repeated on its own. */
+  if (!(flags0 & (ZIP_PACKET_FLAGS0_ACK_RES | ZIP_PACKET_FLAGS0_NACK_RES))
+      || (flags0 & ZIP_PACKET_FLAGS0_NACK_WAIT) || zip_replay_mutex == NULL) {
+    return;
+  }
+  osMutexAcquire(zip_replay_mutex, osWaitForever);
+  e = sli_zip_replay_find(&c->conn, c->seq, c->lendpoint);
+  if (e && e->state == SLI_ZIP_REPLAY_PENDING) {
+    e->state  = SLI_ZIP_REPLAY_DONE;
+    e->flags0 = flags0;
+    e->flags1 = flags1;
+    e->tick   = osKernelGetTickCount();
+  }
+  osMutexRelease(zip_replay_mutex);
+}
+
+void sl_zip_replay_forget(const struct uip_udp_conn *c,
+                          const ZW_COMMAND_ZIP_PACKET *zip)
+{
+  struct zip_replay_entry *e;
+
+  if (zip_replay_mutex == NULL) {
+    return;
+  }
+  osMutexAcquire(zip_replay_mutex, osWaitForever);
+  e = sli_zip_replay_find(c, zip->seqNo, zip->dEndpoint);
+  if (e && e->state == SLI_ZIP_REPLAY_PENDING) {
+    e->state = SLI_ZIP_REPLAY_FREE;
+  }
+  osMutexRelease(zip_replay_mutex);
+}
+
+void sl_zip_replay_get_stats(sl_zip_replay_stats_t *stats)
+{
+  *stats = zip_replay_stats;
+}
+
+void sl_zip_replay_print_stats(void)
+{
+  int pending = 0;
+  int done    = 0;
+
+  for (int i = 0; i < SL_ZIP_REPLAY_SIZE; i++) {
+    pending += zip_replay[i].state == SLI_ZIP_REPLAY_PENDING;
+    done    += zip_replay[i].state == SLI_ZIP_REPLAY_DONE;
+  }
+  LOG_PRINTF("Z/IP replay cache: %d pending %d done of %d, waiting %ld replayed %ld full %ld\n",
+             pending,
+             done,
+             SL_ZIP_REPLAY_SIZE,
+             zip_replay_stats.waiting,
+             zip_replay_stats.replayed,
+             zip_replay_stats.full);
+}
+
 /*---------------------------------------------------------------------------*/
 /* Max size of ZIP Header incl longest hdr extension we might add*/
 /* Extensions currently accounted for: EFI and MULTICAST */
@@ -169,6 +377,19 @@ void sl_zw_send_data_udp(zwave_connection_t *c,
                          void (*cbFunc)(BYTE, void *),
                          void *user,
                          BOOL ackreq)
+{
+  sl_zw_send_data_udp_ext(c, dataptr, datalen, cbFunc, user, ackreq, NULL, 0);
+}
+
+/* send data over udp connection, with extra header extension options. */
+void sl_zw_send_data_udp_ext(zwave_connection_t *c,
+                             const BYTE *dataptr,
+                             u16_t datalen,
+                             void (*cbFunc)(BYTE, void *),
+                             void *user,
+                             BOOL ackreq,
+                             const uint8_t *ext,
+                             uint8_t ext_len)
 {
   static struct uip_udp_conn client_conn;
   security_scheme_t scheme = NO_SCHEME;
@@ -179,7 +400,7 @@ void sl_zw_send_data_udp(zwave_connection_t *c,
   LOG_PRINTF("sl_zw_send_data_udp: %d\n", client_conn.rport);
   sl_print_hex_buf(dataptr, datalen);
 
-  if (datalen + MAX_ZIP_HEADER_SIZE > sizeof(udp_buffer)) {
+  if (datalen + ext_len + MAX_ZIP_HEADER_SIZE > sizeof(udp_buffer)) {
     ERR_PRINTF("sl_zw_send_data_udp: Package is too large.\n");
     return;
   }
@@ -241,6 +462,11 @@ void sl_zw_send_data_udp(zwave_connection_t *c,
       break;
   }
 
+  if (ext_len) {
+    memcpy(&pZipPacket->payload[i], ext, ext_len);
+    i += ext_len;
+  }
+
   if (((c->rx_flags & RECEIVE_STATUS_TYPE_MASK) == RECEIVE_STATUS_TYPE_MULTI)
       || ((c->rx_flags & RECEIVE_STATUS_TYPE_MASK) == RECEIVE_STATUS_TYPE_BROAD)) {
     pZipPacket->payload[i++] = ZWAVE_MULTICAST_ADDRESSING;
@@ -287,13 +513,18 @@ void udp_send_wrap(struct uip_udp_conn *c,
 #endif
 }
 
+/* Callback and user of a sl_zw_send_zip_data_user() call sent over UDP. */
+typedef struct {
+  ZW_SendDataAppl_Callback_t cbFunc;
+  void *user;
+} zw_senddatazip_udp_t;
+
 // Wrapper callback to adapt cbFunc to the expected UDP callback signature
 static void zw_senddatazip_udp_cb(BYTE status, void *user)
 {
-  // user
-  void (*cbFunc)(BYTE, void *, TX_STATUS_TYPE *) = (void (*)(BYTE, void *, TX_STATUS_TYPE *))user;
-  if (cbFunc) {
-    cbFunc(status, NULL, NULL);
+  zw_senddatazip_udp_t *d = (zw_senddatazip_udp_t *) user;
+  if (d->cbFunc) {
+    d->cbFunc(status, d->user, NULL);
   }
 }
 
@@ -304,6 +535,15 @@ void sl_zw_send_zip_data(zwave_connection_t *c,
                          const void *dataptr,
                          u16_t datalen,
                          void (*cbFunc)(BYTE, void *user, TX_STATUS_TYPE *))
+{
+  sl_zw_send_zip_data_user(c, dataptr, datalen, cbFunc, NULL);
+}
+
+void sl_zw_send_zip_data_user(zwave_connection_t *c,
+                              const void *dataptr,
+                              u16_t datalen,
+                              ZW_SendDataAppl_Callback_t cbFunc,
+                              void *user)
 {
   ts_param_t p;
   nodeid_t rnode;
@@ -325,15 +565,18 @@ void sl_zw_send_zip_data(zwave_connection_t *c,
     p.dendpoint = c->rendpoint;
     p.sendpoint = c->lendpoint;
 
-    if (!sl_zw_send_data_appl(&p, dataptr, datalen, cbFunc, 0) && cbFunc != NULL) {
-      cbFunc(TRANSMIT_COMPLETE_FAIL, 0, NULL);
+    if (!sl_zw_send_data_appl(&p, dataptr, datalen, cbFunc, user)
+        && cbFunc != NULL) {
+      cbFunc(TRANSMIT_COMPLETE_FAIL, user, NULL);
     }
   } else {
+    // udp_send_wrap() calls back before returning, d may live on the stack.
+    zw_senddatazip_udp_t d = { cbFunc, user };
     sl_zw_send_data_udp(c,
                         dataptr,
                         datalen,
                         zw_senddatazip_udp_cb,
-                        (void *)cbFunc,
+                        &d,
                         FALSE);
   }
 }
@@ -468,6 +711,7 @@ void send_udp_ack(zwave_udp_session_t *s, zwave_udp_response_t res)
       break;
   }
 
+  sl_zip_replay_record(s, ack.flags0, ack.flags1);
   udp_send_wrap(&s->conn, (const uint8_t*)&ack, ZIP_HEADER_SIZE, 0, 0);
 }
 
@@ -500,9 +744,11 @@ static int sli_udp_zwave_cmd_process(struct uip_udp_conn *c,
                                      security_scheme_t scheme)
 {
   BOOL isMulticast = false;
-  struct async_state *s;
+  /* sl_udp_store_zw_msg_put() copies what it needs, nothing outlives the
+   * call so the state stays on the stack */
+  struct async_state state = { 0 };
+  struct async_state *s    = &state;
   /* payload here is ZWave command without ZIP header */
-  s = (struct async_state *) malloc(sizeof(struct async_state));
   uint16_t pcmd_data_len = udp_payload_len;
   uint8_t pcmd_data[udp_payload_len];
   memcpy(pcmd_data, payload, udp_payload_len);
@@ -660,7 +906,16 @@ static int sli_udp_handle_zip_packet(struct uip_udp_conn *c,
 
     case COMMAND_ZIP_PACKET:
     {
-      return sli_upd_zip_process(c, pZipPacket, data, len, received_secure);
+      int ret;
+
+      /* A retransmission is answered from the cache, never handled twice. */
+      if (sl_zip_replay_check(c, pZipPacket)) {
+        return 0;
+      }
+      ret = sli_upd_zip_process(c, pZipPacket, data, len, received_secure);
+      // Handled without a final ACK/NACK: let a retry through again.
+      sl_zip_replay_forget(c, pZipPacket);
+      return ret;
     }
     default:
       LOG_PRINTF("Invalid Z-Wave package\n");
@@ -723,4 +978,9 @@ void sl_zw_udp_init(void)
   memb_init(&udp_tx_sessions_memb);
   list_init(udp_tx_sessions_list);
   sl_udp_store_zw_msg_init();
+  sl_udp_socket_pool_init();
+  if (zip_replay_mutex == NULL) {
+    zip_replay_mutex = osMutexNew(NULL);
+  }
+  memset(zip_replay, 0, sizeof(zip_replay));
 }
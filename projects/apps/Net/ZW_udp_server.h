@@ -18,9 +18,11 @@
 #define ZW_UDP_SERVER_H_
 
 #include <stdint.h>
+#include <stdbool.h>
 #include <Common/sl_common_type.h>
 #include <Common/sl_uip_def.h>
 #include <transport/sl_ts_param.h>
+#include <Net/ZW_zip_classcmd.h>
 /** \ingroup processes
  * \defgroup ZIP_Udp Z/IP UDP process
  * Handles the all Z/IP inbound and outbout UDP communication
@@ -130,6 +132,27 @@ extern void
 sl_zw_send_zip_data(zwave_connection_t *c, const  void *dataptr, uint16_t datalen,
                     ZW_SendDataAppl_Callback_t cbFunc);
 
+/**
+ * Same as \ref sl_zw_send_zip_data, but \p user is passed to \p cbFunc.
+ */
+extern void
+sl_zw_send_zip_data_user(zwave_connection_t *c, const void *dataptr,
+                         uint16_t datalen, ZW_SendDataAppl_Callback_t cbFunc,
+                         void *user);
+
+/**
+ * Send a Z/IP packet over UDP like sl_zw_send_data_udp(), with extra header
+ * extension options appended after the EFI option.
+ *
+ * \param ext the encoded options, type, length and value of each
+ * \param ext_len length of ext
+ */
+extern void
+sl_zw_send_data_udp_ext(zwave_connection_t *c, const uint8_t *dataptr,
+                        uint16_t datalen, void (*cbFunc)(uint8_t, void *),
+                        void *user, BOOL ackreq, const uint8_t *ext,
+                        uint8_t ext_len);
+
 /**
  * Send a Z-Wave udp frame, but with the ACK flag set. No retransmission will be attempted
  * See \ref sl_zw_send_zip_data
@@ -190,6 +213,55 @@ security_scheme_t efi_to_shceme(uint8_t ext1, uint8_t ext2);
 
 void sl_zw_udp_init(void);
 
+/** Requests remembered by the Z/IP replay cache. */
+#ifndef SL_ZIP_REPLAY_SIZE
+#define SL_ZIP_REPLAY_SIZE 16
+#endif
+
+/** How long a final ACK/NACK is replayed to retransmissions. */
+#ifndef SL_ZIP_REPLAY_TTL_MS
+#define SL_ZIP_REPLAY_TTL_MS 10000
+#endif
+
+/** Z/IP replay cache counters. */
+typedef struct {
+  uint32_t waiting;  /**< Duplicates of a request in flight, NACK+Waiting sent */
+  uint32_t replayed; /**< Duplicates answered with the cached ACK/NACK */
+  uint32_t full;     /**< Requests not remembered, all entries pending */
+} sl_zip_replay_stats_t;
+
+/**
+ * Check a Z/IP packet against the replay cache before handling it.
+ *
+ * Clients resend a request with the same sequence number when the ZIP ACK
+ * is late. Requests asking for an ACK are remembered by client address and
+ * port, our address, sequence number and destination endpoint. A duplicate
+ * gets NACK+Waiting while the original is in flight, or the cached final
+ * ACK/NACK once it completed.
+ *
+ * \param c connection the packet was received on
+ * \param zip the Z/IP packet
+ * \return true if the packet is a retransmission and has been answered; the
+ *         caller must drop it. false if it is new and must be handled.
+ */
+bool sl_zip_replay_check(const struct uip_udp_conn *c, const ZW_COMMAND_ZIP_PACKET *zip);
+
+/**
+ * Remember the final ACK/NACK sent for a request. Called for every ZIP
+ * status sent; NACK+Waiting and unknown requests are ignored.
+ */
+void sl_zip_replay_record(const zwave_connection_t *c, uint8_t flags0, uint8_t flags1);
+
+/**
+ * Drop a request that finished without a final ACK/NACK, so a retry is
+ * handled again. Answered requests are kept.
+ */
+void sl_zip_replay_forget(const struct uip_udp_conn *c, const ZW_COMMAND_ZIP_PACKET *zip);
+
+void sl_zip_replay_get_stats(sl_zip_replay_stats_t *stats);
+
+void sl_zip_replay_print_stats(void);
+
 void sl_zw_udp_handler(struct uip_udp_conn *c, uint8_t *uip_appdata, uint16_t uip_datalen);
 
 int sl_udp_packet_send_v6(struct uip_udp_conn *c, const uint8_t *data, uint16_t len);
@@ -29,6 +29,8 @@
 
 #if SL_USE_LWIP_STACK
 #include "lwip/udp.h"
+#include "lwip/pbuf.h"
+#include "lwip/tcpip.h"
 #include "lwip/ip_addr.h"
 #include "lwip/mem.h"
 #include "lwip/inet.h"
@@ -51,12 +53,45 @@
 #include "utls/ipv6_utils.h"
 #include "ip_translate/ipv46_if_handler.h"
 #include "threads/sl_infra_if.h"
+#include "threads/sl_zw_netif.h"
 
 #include "sl_udp_utils.h"
 
 // this queue store z-wave message.
 static osMessageQueueId_t sli_zw_msg_queue;
 
+/* Long-lived send sockets, keyed by family, source address and port. */
+typedef struct {
+  int sock;
+  int family;
+  uip_ip6addr_t src;
+  uint16_t port;
+  uint32_t last_used;
+} sli_udp_pool_entry_t;
+
+static sli_udp_pool_entry_t sli_udp_pool[SL_UDP_SOCKET_POOL_SIZE];
+static sl_udp_socket_pool_stats_t sli_udp_pool_stats;
+static uint32_t sli_udp_pool_tick;
+static osMutexId_t sli_udp_pool_mutex;
+static const uip_ip6addr_t sli_udp_any_addr;
+
+/* Inbound packet buffers, see sl_tcpip_def.h. */
+static sl_tcpip_buf_t sli_tcpip_bufs[SL_TCPIP_BUF_POOL_SIZE];
+static sl_tcpip_buf_stats_t sli_tcpip_buf_stats;
+static osMutexId_t sli_tcpip_buf_mutex;
+/* Buffers currently holding a received pbuf, at most SL_TCPIP_BUF_PBUF_MAX. */
+static uint32_t sli_tcpip_buf_pbufs;
+
+#define SLI_TCPIP_BUF_OWNED(b) \
+  ((b) >= &sli_tcpip_bufs[0] && (b) < &sli_tcpip_bufs[SL_TCPIP_BUF_POOL_SIZE])
+
+static void sli_tcpip_buf_count_copy(uint32_t len)
+{
+  osMutexAcquire(sli_tcpip_buf_mutex, osWaitForever);
+  sli_tcpip_buf_stats.bytes_copied += len;
+  osMutexRelease(sli_tcpip_buf_mutex);
+}
+
 void uint32_to_ip(uint32_t ip, char *bytes)
 {
   bytes[0] = (ip >> 24) & 0xFF;
@@ -96,31 +131,317 @@ void sl_udp_ip46_to_sockaddr(uint32_t *s, uip_ip6addr_t *ipv64)
   *s = (ipv64->u16[6]) | (ipv64->u16[7] << 16);
 }
 
+/* Least recently used entry to recycle when the pool is full. */
+static sli_udp_pool_entry_t *sli_udp_pool_victim(void)
+{
+  sli_udp_pool_entry_t *victim = &sli_udp_pool[0];
+
+  for (int i = 0; i < SL_UDP_SOCKET_POOL_SIZE; i++) {
+    if (sli_udp_pool[i].sock < 0) {
+      return &sli_udp_pool[i];
+    }
+    if ((int32_t) (sli_udp_pool[i].last_used - victim->last_used) < 0) {
+      victim = &sli_udp_pool[i];
+    }
+  }
+  sli_udp_pool_stats.evictions++;
+  close(victim->sock);
+  victim->sock = -1;
+  return victim;
+}
+
+static int sli_udp_pool_open(sli_udp_pool_entry_t *e)
+{
+  int sock = socket(e->family, SOCK_DGRAM, IPPROTO_UDP);
+  if (sock < 0) {
+    LOG_PRINTF("\r\nSocket creation failed with bsd error: %d\r\n", errno);
+    return -1;
+  }
+
+  if (e->family == AF_INET6
+      && (!uip_ipaddr_cmp(&e->src, &sli_udp_any_addr) || e->port)) {
+    struct sockaddr_in6 local = { 0 };
+    local.sin6_family = AF_INET6;
+    local.sin6_port   = htons(e->port);
+    memcpy(&local.sin6_addr, e->src.u8, sizeof(local.sin6_addr));
+    if (bind(sock, (struct sockaddr *) &local, sizeof(local)) < 0) {
+      LOG_PRINTF("\r\nSocket bind failed with bsd error: %d\r\n", errno);
+      close(sock);
+      return -1;
+    }
+  }
+  LOG_PRINTF("\r\nSocket ID : %d\r\n", sock);
+  return sock;
+}
+
+/* Must be called with sli_udp_pool_mutex held. */
+static sli_udp_pool_entry_t *sli_udp_pool_get(int family,
+                                              const uip_ip6addr_t *src,
+                                              uint16_t port)
+{
+  sli_udp_pool_entry_t *e;
+
+  sli_udp_pool_tick++;
+  for (int i = 0; i < SL_UDP_SOCKET_POOL_SIZE; i++) {
+    e = &sli_udp_pool[i];
+    if (e->sock >= 0 && e->family == family && e->port == port
+        && uip_ipaddr_cmp(&e->src, src)) {
+      e->last_used = sli_udp_pool_tick;
+      sli_udp_pool_stats.hits++;
+      return e;
+    }
+  }
+
+  sli_udp_pool_stats.misses++;
+  e         = sli_udp_pool_victim();
+  e->family = family;
+  e->port   = port;
+  uip_ipaddr_copy(&e->src, src);
+  e->sock = sli_udp_pool_open(e);
+  if (e->sock < 0) {
+    return NULL;
+  }
+  e->last_used = sli_udp_pool_tick;
+  return e;
+}
+
+static int sli_udp_pool_sendto(int family,
+                               const uip_ip6addr_t *src,
+                               uint16_t port,
+                               const uint8_t *data,
+                               uint16_t len,
+                               const struct sockaddr *to,
+                               socklen_t to_len)
+{
+  sli_udp_pool_entry_t *e;
+  int sent_bytes = -1;
+
+  if (sli_udp_pool_mutex == NULL) {
+    return -1;
+  }
+  // A node address is not an lwIP address, a socket bound to it cannot send.
+  if (family == AF_INET6 && sl_zw_netif_has_addr(src)) {
+    const struct sockaddr_in6 *dst = (const struct sockaddr_in6 *) to;
+    (void) to_len;
+    return sl_zw_netif_send_udp(src,
+                                port,
+                                (const uip_ip6addr_t *) &dst->sin6_addr,
+                                lwip_ntohs(dst->sin6_port),
+                                data,
+                                len);
+  }
+  osMutexAcquire(sli_udp_pool_mutex, osWaitForever);
+  e = sli_udp_pool_get(family, src, port);
+  if (e) {
+    sent_bytes = sendto(e->sock, data, len, 0, to, to_len);
+    if (sent_bytes < 0) {
+      LOG_PRINTF("\r\nSocket send failed with bsd error: %d\r\n", errno);
+      // Drop the socket, the next send opens a fresh one.
+      sli_udp_pool_stats.errors++;
+      close(e->sock);
+      e->sock = -1;
+    }
+  }
+  osMutexRelease(sli_udp_pool_mutex);
+  return sent_bytes;
+}
+
+void sl_udp_socket_pool_init(void)
+{
+  if (sli_udp_pool_mutex == NULL) {
+    sli_udp_pool_mutex = osMutexNew(NULL);
+  }
+  for (int i = 0; i < SL_UDP_SOCKET_POOL_SIZE; i++) {
+    sli_udp_pool[i].sock = -1;
+  }
+}
+
+int sl_udp_socket_pool_send_v6(const uip_ip6addr_t *src,
+                               uint16_t sport,
+                               const uip_ip6addr_t *dst,
+                               uint16_t dport,
+                               const uint8_t *data,
+                               uint16_t len)
+{
+  struct sockaddr_in6 server_address = { 0 };
+
+  server_address.sin6_family = AF_INET6;
+  server_address.sin6_port   = htons(dport);
+  memcpy(&server_address.sin6_addr, dst->u8, 16);
+  return sli_udp_pool_sendto(AF_INET6,
+                             src ? src : &sli_udp_any_addr,
+                             sport,
+                             data,
+                             len,
+                             (struct sockaddr *) &server_address,
+                             sizeof(server_address));
+}
+
+void sl_udp_socket_pool_get_stats(sl_udp_socket_pool_stats_t *stats)
+{
+  *stats = sli_udp_pool_stats;
+}
+
+void sl_udp_socket_pool_print_stats(void)
+{
+  int open = 0;
+
+  for (int i = 0; i < SL_UDP_SOCKET_POOL_SIZE; i++) {
+    open += sli_udp_pool[i].sock >= 0;
+  }
+  LOG_PRINTF("UDP socket pool: %d/%d open, hit %ld miss %ld evict %ld err %ld\n",
+             open,
+             SL_UDP_SOCKET_POOL_SIZE,
+             sli_udp_pool_stats.hits,
+             sli_udp_pool_stats.misses,
+             sli_udp_pool_stats.evictions,
+             sli_udp_pool_stats.errors);
+}
+
+void sl_tcpip_buf_pool_init(void)
+{
+  if (sli_tcpip_buf_mutex == NULL) {
+    sli_tcpip_buf_mutex = osMutexNew(NULL);
+  }
+}
+
+sl_tcpip_buf_t *sl_tcpip_buf_alloc(void)
+{
+  sl_tcpip_buf_t *buf = NULL;
+
+  if (sli_tcpip_buf_mutex == NULL) {
+    return NULL;
+  }
+  osMutexAcquire(sli_tcpip_buf_mutex, osWaitForever);
+  for (int i = 0; i < SL_TCPIP_BUF_POOL_SIZE; i++) {
+    if (sli_tcpip_bufs[i].ref == 0) {
+      buf      = &sli_tcpip_bufs[i];
+      buf->ref = 1;
+      break;
+    }
+  }
+  if (buf) {
+    sli_tcpip_buf_stats.packets++;
+    if (++sli_tcpip_buf_stats.in_use > sli_tcpip_buf_stats.peak) {
+      sli_tcpip_buf_stats.peak = sli_tcpip_buf_stats.in_use;
+    }
+  } else {
+    sli_tcpip_buf_stats.exhausted++;
+  }
+  osMutexRelease(sli_tcpip_buf_mutex);
+  return buf;
+}
+
+void sl_tcpip_buf_hold(sl_tcpip_buf_t *buf)
+{
+  if (!SLI_TCPIP_BUF_OWNED(buf)) {
+    return;
+  }
+  osMutexAcquire(sli_tcpip_buf_mutex, osWaitForever);
+  buf->ref++;
+  osMutexRelease(sli_tcpip_buf_mutex);
+}
+
+void sl_tcpip_buf_release(sl_tcpip_buf_t *buf)
+{
+  struct pbuf *p = NULL;
+
+  if (!SLI_TCPIP_BUF_OWNED(buf)) {
+    return;
+  }
+  osMutexAcquire(sli_tcpip_buf_mutex, osWaitForever);
+  if (buf->ref && --buf->ref == 0) {
+    sli_tcpip_buf_stats.in_use--;
+    p         = buf->pbuf;
+    buf->pbuf = NULL;
+    if (p) {
+      sli_tcpip_buf_pbufs--;
+    }
+  }
+  osMutexRelease(sli_tcpip_buf_mutex);
+  // The last owner is usually the tcpip thread, not the lwIP thread.
+  if (p && pbuf_free_callback(p) != ERR_OK) {
+    pbuf_free(p);
+  }
+}
+
+sl_tcpip_buf_t *sl_tcpip_buf_from_pbuf(struct pbuf *p,
+                                       uint16_t offset,
+                                       uint16_t len)
+{
+  sl_tcpip_buf_t *buf = sl_tcpip_buf_alloc();
+  bool keep           = false;
+
+  if (buf == NULL) {
+    pbuf_free(p);
+    return NULL;
+  }
+  osMutexAcquire(sli_tcpip_buf_mutex, osWaitForever);
+  if (p->len >= offset + len && sli_tcpip_buf_pbufs < SL_TCPIP_BUF_PBUF_MAX) {
+    sli_tcpip_buf_pbufs++;
+    keep = true;
+  }
+  osMutexRelease(sli_tcpip_buf_mutex);
+
+  if (keep) {
+    pbuf_remove_header(p, offset);
+    buf->pbuf = p;
+    return buf;
+  }
+  // Chained, or too many pbufs held already: copy and give the pbuf back.
+  pbuf_copy_partial(p, buf->data, len, offset);
+  sli_tcpip_buf_count_copy(len);
+  pbuf_free(p);
+  return buf;
+}
+
+void sl_tcpip_buf_get_stats(sl_tcpip_buf_stats_t *stats)
+{
+  osMutexAcquire(sli_tcpip_buf_mutex, osWaitForever);
+  *stats = sli_tcpip_buf_stats;
+  osMutexRelease(sli_tcpip_buf_mutex);
+}
+
+void sl_tcpip_buf_print_stats(void)
+{
+  sl_tcpip_buf_stats_t st;
+
+  sl_tcpip_buf_get_stats(&st);
+  LOG_PRINTF("Packet buffers: %ld/%d in use, peak %ld, exhausted %ld\n",
+             st.in_use,
+             SL_TCPIP_BUF_POOL_SIZE,
+             st.peak,
+             st.exhausted);
+  LOG_PRINTF("Packets %ld dropped %ld, bytes copied %ld (%ld per packet)\n",
+             st.packets,
+             st.dropped,
+             st.bytes_copied,
+             st.packets ? st.bytes_copied / st.packets : 0);
+}
+
+void sl_tcpip_buf_count_drop(void)
+{
+  osMutexAcquire(sli_tcpip_buf_mutex, osWaitForever);
+  sli_tcpip_buf_stats.dropped++;
+  osMutexRelease(sli_tcpip_buf_mutex);
+}
+
 int sl_udp_packet_send(struct uip_udp_conn *c, uint8_t *data, uint16_t len)
 {
-  // Create socket
-  int client_socket                 = -1;
   struct sockaddr_in server_address = { 0 };
   socklen_t socket_length           = sizeof(struct sockaddr_in);
   int sent_bytes                    = 1;
   server_address.sin_family         = AF_INET;
   server_address.sin_port           = ZWAVE_PORT;
 
-  client_socket = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
-  if (client_socket < 0) {
-    LOG_PRINTF("\r\nSocket creation failed with bsd error: %d\r\n", errno);
-    return SL_STATUS_FAIL;
-  }
-  LOG_PRINTF("\r\nSocket ID : %d\r\n", client_socket);
-  sent_bytes = sendto(client_socket,
-                      data,
-                      len,
-                      0,
-                      (struct sockaddr *) &server_address,
-                      socket_length);
+  sent_bytes = sli_udp_pool_sendto(AF_INET,
+                                   &sli_udp_any_addr,
+                                   0,
+                                   data,
+                                   len,
+                                   (struct sockaddr *) &server_address,
+                                   socket_length);
   if (sent_bytes < 0) {
-    LOG_PRINTF("\r\nSocket send failed with bsd error: %d\r\n", errno);
-    close(client_socket);
     return SL_STATUS_FAIL;
   }
 
@@ -128,91 +449,79 @@ int sl_udp_packet_send(struct uip_udp_conn *c, uint8_t *data, uint16_t len)
   LOG_PRINTF(" to: ");
   uip_debug_ipaddr_print(&c->ripaddr);
   LOG_PRINTF(":%d\n", server_address.sin_port)
-  close(client_socket);
   return len;
 }
 
 int sl_udp_packet_send_v6(struct uip_udp_conn *c, const uint8_t *data, uint16_t len)
 {
-  int client_socket = -1;
-  struct sockaddr_in6 server_address = { 0 };
-  socklen_t socket_length = sizeof(struct sockaddr_in6);
-  int sent_bytes = 1;
-
-  server_address.sin6_family = AF_INET6;
-  server_address.sin6_port = (((uint16_t)ZWAVE_PORT & 0xFF) << 8) | (((uint16_t)ZWAVE_PORT >> 8) & 0xFF); //(ZWAVE_PORT);
-  // Copy IPv6 address
-  memcpy(&server_address.sin6_addr, c->ripaddr.u8, 16);
+  int sent_bytes;
+  bool node = sl_zw_netif_has_addr(&c->sipaddr);
 
-  client_socket = socket(AF_INET6, SOCK_DGRAM, IPPROTO_UDP);
-  if (client_socket < 0) {
-    LOG_PRINTF("\r\nSocket creation failed with bsd error: %d\r\n", errno);
-    return SL_STATUS_FAIL;
-  }
-  LOG_PRINTF("\r\nSocket ID : %d\r\n", client_socket);
-  sent_bytes = sendto(client_socket,
-                      data,
-                      len,
-                      0,
-                      (struct sockaddr *) &server_address,
-                      socket_length);
+  // Answer from the node address the client used, otherwise leave the
+  // source unbound so lwIP picks the address of the outgoing interface.
+  sent_bytes = sl_udp_socket_pool_send_v6(node ? &c->sipaddr : NULL,
+                                          node ? c->lport : 0,
+                                          &c->ripaddr,
+                                          ZWAVE_PORT,
+                                          data,
+                                          len);
   if (sent_bytes < 0) {
-    LOG_PRINTF("\r\nSocket send failed with bsd error: %d\r\n", errno);
-    close(client_socket);
     return SL_STATUS_FAIL;
   }
 
   LOG_PRINTF("\r\nBytes sent : %d ", sent_bytes);
   LOG_PRINTF(" to: ");
   uip_debug_ipaddr_print(&c->ripaddr);
-  LOG_PRINTF(" port %d\n", server_address.sin6_port);
-  close(client_socket);
+  LOG_PRINTF(" port %d\n", ZWAVE_PORT);
   return len;
 }
 
-sl_tcpip_buf_t* sl_zip_packet_v6(struct in6_addr *in,
-                                 uint16_t in_port,
-                                 char *lip,
-                                 uint8_t *buf,
-                                 uint16_t len)
+void sl_zip_packet_v6_fill(sl_tcpip_buf_t *tcpip_buf,
+                           const struct in6_addr *in,
+                           uint16_t in_port,
+                           const uip_ip6addr_t *lip,
+                           uint16_t len)
 {
-  struct uip_udp_conn conn;
-  conn.lport = ZWAVE_PORT;
-  memcpy(conn.ripaddr.u8, in->un.u8_addr, 16);
+  memcpy(tcpip_buf->zw_con.ripaddr.u8, in->un.u8_addr, 16);
 
   LOG_PRINTF("\nRecv UDPv6 data: %d bytes from ", len);
-  uip_debug_ipaddr_print((const uip_ipaddr_t *) &conn.ripaddr);
+  uip_debug_ipaddr_print((const uip_ipaddr_t *) &tcpip_buf->zw_con.ripaddr);
   LOG_PRINTF(" port %d, TIME: %ld\n", in_port, osKernelGetTickCount());
 
-  conn.rport = in_port;
-
-  // forward to tcpip.
-  sl_tcpip_buf_t *tcpip_buf = (sl_tcpip_buf_t *) malloc(sizeof(sl_tcpip_buf_t));
-  if (tcpip_buf == NULL) {
-    ERR_PRINTF("malloc tcpip_buf failed\n");
-    return NULL;
-  }
-
-  uint8_t *zip_data = (uint8_t *) malloc(len);
-  if (zip_data == NULL) {
-    ERR_PRINTF("malloc zip_data failed\n");
-    free(tcpip_buf);
-    return NULL;
-  }
-  memcpy(zip_data, buf, len);
-  tcpip_buf->zw_con.ripaddr = conn.ripaddr;
-  sl_uiplib_ipaddrconv((const char *) lip, &(tcpip_buf->zw_con.lipaddr));
-  tcpip_buf->zw_con.rport     = conn.rport;
+  uip_ipaddr_copy(&tcpip_buf->zw_con.lipaddr, lip);
+  tcpip_buf->zw_con.rport     = in_port;
   tcpip_buf->zw_con.lport     = ZWAVE_PORT;
   tcpip_buf->tcpip_proto      = UIP_PROTO_UDP;
-  tcpip_buf->zip_data         = (char *) zip_data;
+  tcpip_buf->zip_data         = tcpip_buf->pbuf ? (char *) tcpip_buf->pbuf->payload
+                                                : tcpip_buf->data;
   tcpip_buf->zip_data_len     = len;
   tcpip_buf->zip_packet       = (ZW_COMMAND_ZIP_PACKET *) tcpip_buf->zip_data;
   tcpip_buf->zw_con.lendpoint = tcpip_buf->zip_packet->sEndpoint;
   tcpip_buf->zw_con.rendpoint = tcpip_buf->zip_packet->dEndpoint;
   tcpip_buf->zw_con.rx_flags  = tcpip_buf->zip_packet->flags0;
   tcpip_buf->zw_con.tx_flags  = tcpip_buf->zip_packet->flags1;
+}
+
+sl_tcpip_buf_t* sl_zip_packet_v6(struct in6_addr *in,
+                                 uint16_t in_port,
+                                 const uip_ip6addr_t *lip,
+                                 uint8_t *buf,
+                                 uint16_t len)
+{
+  sl_tcpip_buf_t *tcpip_buf;
 
+  if (len > SL_TCPIP_BUF_DATA_SIZE) {
+    ERR_PRINTF("zip packet too long: %d\n", len);
+    return NULL;
+  }
+  tcpip_buf = sl_tcpip_buf_alloc();
+  if (tcpip_buf == NULL) {
+    ERR_PRINTF("no free tcpip_buf\n");
+    return NULL;
+  }
+  memcpy(tcpip_buf->data, buf, len);
+  sli_tcpip_buf_count_copy(len);
+  sl_zip_packet_v6_fill(tcpip_buf, in, in_port, lip, len);
   return tcpip_buf;
 }
 
@@ -222,7 +531,6 @@ sl_tcpip_buf_t* sl_zip_packet_v4(struct sockaddr_in *in, uint8_t *buf, uint16_t
   struct sockaddr_in *ip = in;
 
   uint8_t aip[4];
-  char ip_str[64] = { 0 };
   nodeid_t nodeid = 0;
   uint32_to_ip(ip->sin_addr.s_addr, (char *) aip);
 
@@ -242,27 +550,24 @@ sl_tcpip_buf_t* sl_zip_packet_v4(struct sockaddr_in *in, uint8_t *buf, uint16_t
   conn.rport = ip->sin_port;
 
   // forward to tcpip. In this version, we are including dest nodeid in UDP message.
-  sl_tcpip_buf_t *tcpip_buf = (sl_tcpip_buf_t *) malloc(sizeof(sl_tcpip_buf_t));
-  if (tcpip_buf == NULL) {
-    ERR_PRINTF("malloc tcpip_buf failed\n");
+  if (len < 2 || len - 2 > SL_TCPIP_BUF_DATA_SIZE) {
+    ERR_PRINTF("zip packet length invalid: %d\n", len);
     return NULL;
   }
-
-  uint8_t *zip_data = (uint8_t *) malloc(len);
-  if (zip_data == NULL) {
-    ERR_PRINTF("malloc zip_data failed\n");
-    free(tcpip_buf);
+  sl_tcpip_buf_t *tcpip_buf = sl_tcpip_buf_alloc();
+  if (tcpip_buf == NULL) {
+    ERR_PRINTF("no free tcpip_buf\n");
     return NULL;
   }
-  memcpy(zip_data, buf + 2, len - 2);
+  memcpy(tcpip_buf->data, buf + 2, len - 2);
+  sli_tcpip_buf_count_copy(len - 2);
   tcpip_buf->zw_con.ripaddr = conn.ripaddr;
   nodeid                    = (nodeid_t)((buf[0]) | (buf[1] << 8));
-  snprintf(ip_str, sizeof(ip_str), "%s%x", SL_INFRA_IF_RIO_PREFIX, nodeid);
-  sl_uiplib_ipaddrconv((const char *) ip_str, &(tcpip_buf->zw_con.lipaddr));
+  sl_zw_netif_node_addr(nodeid, &tcpip_buf->zw_con.lipaddr);
   tcpip_buf->zw_con.rport = conn.rport;
   tcpip_buf->zw_con.lport = ZWAVE_PORT;
   tcpip_buf->tcpip_proto  = UIP_PROTO_UDP;
-  tcpip_buf->zip_data     = (char *) zip_data;
+  tcpip_buf->zip_data     = tcpip_buf->data;
   tcpip_buf->zip_data_len = len - 2;
   tcpip_buf->zip_packet   = (ZW_COMMAND_ZIP_PACKET *) tcpip_buf->zip_data;
   tcpip_buf->zw_con.lendpoint = tcpip_buf->zip_packet->sEndpoint;
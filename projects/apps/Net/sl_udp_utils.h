@@ -24,6 +24,45 @@
 #include "lwip/inet.h"
 #include "lwip/sockets.h"
 
+/**
+ * Number of long-lived send sockets. Each holds one of the MEMP_NUM_UDP_PCB
+ * lwIP PCBs; the least recently used one is closed when a new key is needed.
+ */
+#ifndef SL_UDP_SOCKET_POOL_SIZE
+#define SL_UDP_SOCKET_POOL_SIZE 3
+#endif
+
+/**
+ * Number of inbound buffers that may keep their lwIP pbuf instead of a copy.
+ * Packets parked for a sleeping node must not drain the pbuf pool the Wi-Fi
+ * receive path allocates from.
+ */
+#ifndef SL_TCPIP_BUF_PBUF_MAX
+#define SL_TCPIP_BUF_PBUF_MAX (PBUF_POOL_SIZE / 2)
+#endif
+
+/**
+ * @brief Send socket pool counters
+ */
+typedef struct {
+  uint32_t hits;       /**< Sends on an already open socket */
+  uint32_t misses;     /**< Sends that had to open a socket */
+  uint32_t evictions;  /**< Sockets closed to make room for another key */
+  uint32_t errors;     /**< Failed sends, the socket is dropped */
+} sl_udp_socket_pool_stats_t;
+
+/**
+ * @brief Inbound packet buffer pool counters
+ */
+typedef struct {
+  uint32_t packets;      /**< Buffers handed out */
+  uint32_t dropped;      /**< Packets dropped because the pool was empty */
+  uint32_t exhausted;    /**< Allocations that found the pool empty */
+  uint32_t in_use;       /**< Buffers currently held */
+  uint32_t peak;         /**< Highest in_use seen */
+  uint32_t bytes_copied; /**< Payload bytes copied into buffers */
+} sl_tcpip_buf_stats_t;
+
 /**
  * @brief Metadata structure for asynchronous UDP packets
  *
@@ -84,15 +123,112 @@ sl_status_t sl_udp_store_zw_msg_get(void *msg, uint32_t timeout);
 void sl_udp_store_zw_msg_init(void);
 
 /**
- * @brief Send a UDP packet
+ * @brief Initialize the send socket pool
  *
- * Sends a UDP packet over the specified connection.
+ * No socket is opened until the first send.
+ */
+void sl_udp_socket_pool_init(void);
+
+/**
+ * @brief Send a UDP packet over IPv6 on a pooled socket
  *
- * @param[in] c Pointer to the UDP connection structure
+ * The socket is reused for every send with the same source address and
+ * port, so no PCB is created per packet. A node address as source is not an
+ * lwIP address and is sent through zw_netif instead, see
+ * sl_zw_netif_send_udp().
+ *
+ * @param[in] src Source address to bind, NULL to let lwIP choose
+ * @param[in] sport Source port to bind (host order), 0 for ephemeral
+ * @param[in] dst Destination address
+ * @param[in] dport Destination port (host order)
  * @param[in] data Pointer to the data to be sent
  * @param[in] len Length of the data in bytes
  * @return Number of bytes sent, or negative value on error
  */
+int sl_udp_socket_pool_send_v6(const uip_ip6addr_t *src,
+                               uint16_t sport,
+                               const uip_ip6addr_t *dst,
+                               uint16_t dport,
+                               const uint8_t *data,
+                               uint16_t len);
+
+/**
+ * @brief Copy the send socket pool counters
+ *
+ * @param[out] stats Counters since boot
+ */
+void sl_udp_socket_pool_get_stats(sl_udp_socket_pool_stats_t *stats);
+
+/**
+ * @brief Print the send socket pool counters
+ */
+void sl_udp_socket_pool_print_stats(void);
+
+/**
+ * @brief Initialize the inbound packet buffer pool
+ *
+ * Must run before the first receiver starts.
+ */
+void sl_tcpip_buf_pool_init(void);
+
+/**
+ * @brief Take a buffer from the inbound packet pool
+ *
+ * The buffer is returned with one reference held by the caller.
+ *
+ * @return Buffer, or NULL if all buffers are in use
+ */
+sl_tcpip_buf_t *sl_tcpip_buf_alloc(void);
+
+/**
+ * @brief Add a reference to a pool buffer
+ *
+ * Buffers that do not belong to the pool are ignored.
+ */
+void sl_tcpip_buf_hold(sl_tcpip_buf_t *buf);
+
+/**
+ * @brief Drop a reference; the buffer returns to the pool on the last one
+ *
+ * A pbuf held by the buffer is freed with it. Buffers that do not belong to
+ * the pool are ignored.
+ */
+void sl_tcpip_buf_release(sl_tcpip_buf_t *buf);
+
+/**
+ * @brief Take a pool buffer for a Z/IP payload received in an lwIP pbuf
+ *
+ * The buffer keeps the pbuf, with the payload at offset, so the packet is
+ * not copied. When the payload is not in the first pbuf of the chain or
+ * SL_TCPIP_BUF_PBUF_MAX pbufs are already held, the payload is copied into
+ * the buffer instead. Call sl_zip_packet_v6_fill() next.
+ *
+ * @param[in] p Received packet, freed in every case
+ * @param[in] offset Offset of the Z/IP payload in p
+ * @param[in] len Length of the Z/IP payload
+ * @return Buffer, or NULL if all buffers are in use
+ */
+sl_tcpip_buf_t *sl_tcpip_buf_from_pbuf(struct pbuf *p,
+                                       uint16_t offset,
+                                       uint16_t len);
+
+/**
+ * @brief Count a packet that was dropped for lack of a buffer
+ */
+void sl_tcpip_buf_count_drop(void);
+
+/**
+ * @brief Copy the inbound packet pool counters
+ *
+ * @param[out] stats Counters since boot
+ */
+void sl_tcpip_buf_get_stats(sl_tcpip_buf_stats_t *stats);
+
+/**
+ * @brief Print the inbound packet pool counters
+ */
+void sl_tcpip_buf_print_stats(void);
+
 /**
  * @brief Send a UDP packet
  *
@@ -127,21 +263,42 @@ int sl_udp_packet_send_v6(struct uip_udp_conn *c, const uint8_t *data, uint16_t
  */
 void uint32_to_ip(uint32_t ip, char *bytes);
 
+/**
+ * @brief Set up a pool buffer whose data was received in place
+ *
+ * Fills the connection fields of a buffer whose payload was written straight
+ * into tcpip_buf->data, or is held in its pbuf (see sl_tcpip_buf_from_pbuf()),
+ * so the packet reaches the tcpip thread without a copy.
+ *
+ * @param[in,out] tcpip_buf Buffer from sl_tcpip_buf_alloc()
+ * @param[in] in Source IPv6 address
+ * @param[in] in_port Source port number
+ * @param[in] lip Local (destination node) IPv6 address
+ * @param[in] len Length of the packet data
+ */
+void sl_zip_packet_v6_fill(sl_tcpip_buf_t *tcpip_buf,
+                           const struct in6_addr *in,
+                           uint16_t in_port,
+                           const uip_ip6addr_t *lip,
+                           uint16_t len);
+
 /**
  * @brief Process an IPv6 ZIP packet
  *
- * Creates a TCP/IP buffer from an IPv6 ZIP packet for processing by the Z-Wave stack.
+ * Copies an IPv6 ZIP packet into a pool buffer for processing by the Z-Wave
+ * stack. Receivers that can write into the buffer directly should use
+ * sl_zip_packet_v6_fill() instead.
  *
  * @param[in] in Pointer to the IPv6 address structure
  * @param[in] in_port Source port number
- * @param[in] lip Local IP address string
+ * @param[in] lip Local (destination node) IPv6 address
  * @param[in] buf Pointer to the packet data
  * @param[in] len Length of the packet data
- * @return Pointer to allocated TCP/IP buffer or NULL on failure
+ * @return Pool buffer (release with sl_tcpip_buf_release()) or NULL on failure
  */
 sl_tcpip_buf_t* sl_zip_packet_v6(struct in6_addr *in,
                                  uint16_t in_port,
-                                 char *lip,
+                                 const uip_ip6addr_t *lip,
                                  uint8_t *buf,
                                  uint16_t len);
 
@@ -154,7 +311,7 @@ sl_tcpip_buf_t* sl_zip_packet_v6(struct in6_addr *in,
  * @param[in] in Pointer to the IPv4 socket address structure
  * @param[in] buf Pointer to the packet data
  * @param[in] len Length of the packet data
- * @return Pointer to allocated TCP/IP buffer or NULL on failure
+ * @return Pool buffer (release with sl_tcpip_buf_release()) or NULL on failure
  */
 sl_tcpip_buf_t* sl_zip_packet_v4(struct sockaddr_in *in, uint8_t *buf, uint16_t len);
 
@@ -40,6 +40,7 @@
 
 #include "sl_uart_drv.h"
 #include "sl_serial.h"
+#include "modules/sl_block_pool.h"
 #include "FreeRTOS.h"
 
 osMutexId_t sl_cmd_mutex;
@@ -467,13 +468,7 @@ void SerialFlushQueue(void)
   while (rxQueue) {
     l       = rxQueue;
     rxQueue = rxQueue->next;
-    if (l->data) {
-      free(l->data);
-    }
-
-    if (l) {
-      free(l);
-    }
+    sl_block_pool_free(l);
   }
 }
 
@@ -487,17 +482,13 @@ static void QueueFrame()
     return;
   }
 
-  l       = (struct list *) malloc(sizeof(struct list));
+  // One block holds the list entry and the frame behind it.
+  l = (struct list *) sl_block_pool_alloc(sizeof(struct list) + pdata_len + 1);
   if (l == NULL) {
-    SER_PRINTF("QueueFrame: malloc failed\n");
-    return;
-  }
-  l->data = (uint8_t*)malloc(pdata_len + 1);
-  if (l->data == NULL) {
-    SER_PRINTF("QueueFrame: malloc failed for data\n");
-    free(l);
+    SER_PRINTF("QueueFrame: no free block for %ld bytes\n", pdata_len);
     return;
   }
+  l->data = (uint8_t *) (l + 1);
 
   l->next = 0;
   l->len  = (BYTE)pdata_len;
@@ -701,12 +692,7 @@ uint8_t SerialAPI_Poll(void)
     // we don't use extern these variables.
     sl_serial_set_local_buf(l->data, l->len);
     Dispatch(l->data, l->len);
-    if (l->data) {
-      free(l->data);
-    }
-    if (l) {
-      free(l);
-    }
+    sl_block_pool_free(l);
     LOG_PRINTF("rxQueue: %d\n", rxQueue_Len());
   }
   sl_serial_lock();
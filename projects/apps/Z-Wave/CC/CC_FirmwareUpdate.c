@@ -31,14 +31,13 @@ static sl_command_handler_codes_t sli_md_get_v3_handler(zwave_connection_t *c,
                                                         uint8_t *pData,
                                                         uint16_t bDatalen)
 {
-  (void) c;
   const ZW_FIRMWARE_UPDATE_MD_GET_V3_FRAME *f =
     (ZW_FIRMWARE_UPDATE_MD_GET_V3_FRAME *) pData;
 
   sl_print_hex_buf(pData, bDatalen);
   uint16_t num   = f->numberOfReports;
   uint16_t ch_id = ((f->properties1 & 0x7F) << 8) | f->reportNumber2;
-  sl_node_ota_send_md_chunks(ch_id, num);
+  sl_node_ota_handle_md_get(sl_node_of_ip(&c->ripaddr), ch_id, num);
 
   return COMMAND_HANDLED;
 }
@@ -48,13 +47,13 @@ sli_md_update_md_status_report_handler(zwave_connection_t *c,
                                        uint8_t *pData,
                                        uint16_t bDatalen)
 {
-  (void) c;
   ZW_FIRMWARE_UPDATE_MD_STATUS_REPORT_V4_FRAME *f =
     (ZW_FIRMWARE_UPDATE_MD_STATUS_REPORT_V4_FRAME *) pData;
 
   if (bDatalen < sizeof(ZW_FIRMWARE_UPDATE_MD_STATUS_REPORT_V4_FRAME)) {
     return COMMAND_PARSE_ERROR;
   }
+  sl_node_ota_handle_status(sl_node_of_ip(&c->ripaddr), true, f->status);
 
   if (f->status == 0xFF) {
     LOG_PRINTF("Firmware update successful, status = 0x%02x\r\n", f->status);
@@ -68,10 +67,10 @@ static sl_command_handler_codes_t sli_md_request_report_v3_handler(zwave_connect
                                                                    uint8_t *pData,
                                                                    uint16_t bDatalen)
 {
-  (void) c;
   sl_print_hex_buf(pData, bDatalen);
   ZW_FIRMWARE_UPDATE_MD_REQUEST_REPORT_V3_FRAME *f =
     (ZW_FIRMWARE_UPDATE_MD_REQUEST_REPORT_V3_FRAME *) pData;
+  sl_node_ota_handle_status(sl_node_of_ip(&c->ripaddr), false, f->status);
   if (f->status == 0xFF) {
     LOG_PRINTF("Firmware Valid combination\n");
   } else {
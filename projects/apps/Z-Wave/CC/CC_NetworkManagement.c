@@ -2376,7 +2376,6 @@ uint16_t find_min_bitmask_len(uint8_t *buffer, uint16_t length)
 static uint16_t nm_build_failed_node_list_frame(uint8_t *buffer, uint8_t seq)
 {
   nodeid_t i;
-  rd_node_database_entry_t *n;
   nodemask_t nlist = { 0 };
   uint16_t lr_len  = 0;
 
@@ -2387,8 +2386,7 @@ static uint16_t nm_build_failed_node_list_frame(uint8_t *buffer, uint8_t seq)
   f->seqNo    = seq;
 
   for (i = 1; i <= ZW_MAX_NODES; i++) { // i is node id here
-    n = rd_node_get_raw(i);
-    if (!n) {
+    if (!rd_node_exists(i)) {
       continue;
     }
 
@@ -2566,7 +2564,7 @@ sli_nm_cmdclass_nmp_cache_get_handler(ZW_APPLICATION_TX_BUFFER *pCmd,
 
   ZW_NODE_INFO_CACHED_GET_V4_FRAME *get_frame =
     (ZW_NODE_INFO_CACHED_GET_V4_FRAME *) pCmd;
-  rd_ep_database_entry_t *ep;
+  rd_node_database_entry_t *node;
   uint32_t age_sec;
   uint8_t maxage_log;
   nodeid_t nid = get_frame->nodeId;
@@ -2586,10 +2584,10 @@ sli_nm_cmdclass_nmp_cache_get_handler(ZW_APPLICATION_TX_BUFFER *pCmd,
     return COMMAND_HANDLED;
   }
 
-  ep = rd_ep_first(nid);
-  if (ep) {
+  node = rd_get_node_dbe(nid);
+  if (node && list_head(node->endpoints)) {
     /* Find out if the data we have is too old */
-    age_sec    = clock_seconds() - ep->node->lastUpdate;
+    age_sec    = clock_seconds() - node->lastUpdate;
     maxage_log = (get_frame->properties1 & 0xF);
     if (!(nid == MyNodeID)) {
       LOG_PRINTF("Seconds since last update: %ld Node info cached get max "
@@ -2600,6 +2598,7 @@ sli_nm_cmdclass_nmp_cache_get_handler(ZW_APPLICATION_TX_BUFFER *pCmd,
        * asynchronously. */
       if ((maxage_log != 0xF && (age_sec > ageToTime(maxage_log)))
           || maxage_log == 0) {
+        rd_free_node_dbe(node);
         nms.tmp_node = nid;
         nms.state    = NM_WAIT_FOR_NODE_INFO_PROBE;
         /* Make the probe start asynchronously */
@@ -2615,8 +2614,7 @@ sli_nm_cmdclass_nmp_cache_get_handler(ZW_APPLICATION_TX_BUFFER *pCmd,
   /* We can send a reply immediately. */
   ZW_NODE_INFO_CACHED_REPORT_1BYTE_FRAME *f =
     (ZW_NODE_INFO_CACHED_REPORT_1BYTE_FRAME *) &nms.buf;
-  rd_node_database_entry_t *node = rd_get_node_dbe(nid);
-  int len                        = nm_build_node_cached_report(node, f);
+  int len = nm_build_node_cached_report(node, f);
 
   rd_free_node_dbe(node);
   nm_send_reply(f, 10 + len);
@@ -2682,6 +2680,7 @@ sli_nm_cmdclass_nmp_cap_get_handler(ZW_APPLICATION_TX_BUFFER *pCmd,
                                     BYTE bDatalen)
 {
   rd_ep_database_entry_t *ep_entry;
+  u16_t len;
   ZW_NM_MULTI_CHANNEL_CAPABILITY_GET_V4_FRAME *get_frame =
     (ZW_NM_MULTI_CHANNEL_CAPABILITY_GET_V4_FRAME *) pCmd;
   ZW_NM_MULTI_CHANNEL_CAPABILITY_REPORT_V4_FRAME *report_frame =
@@ -2736,9 +2735,10 @@ sli_nm_cmdclass_nmp_cap_get_handler(ZW_APPLICATION_TX_BUFFER *pCmd,
            1);
   }
 
-  nm_send_reply(report_frame,
-                sizeof(ZW_NM_MULTI_CHANNEL_CAPABILITY_REPORT_V4_FRAME)
-                + ep_entry->endpoint_info_len);
+  len = sizeof(ZW_NM_MULTI_CHANNEL_CAPABILITY_REPORT_V4_FRAME)
+        + ep_entry->endpoint_info_len;
+  rd_free_ep(ep_entry);
+  nm_send_reply(report_frame, len);
 
   return COMMAND_HANDLED;
 }
@@ -2748,6 +2748,7 @@ sli_nm_cmdclass_nmp_members_get_handler(ZW_APPLICATION_TX_BUFFER *pCmd,
                                         BYTE bDatalen)
 {
   rd_ep_database_entry_t *ep_entry;
+  u16_t len;
   ZW_NM_MULTI_CHANNEL_AGGREGATED_MEMBERS_GET_V4_FRAME *get_frame =
     (ZW_NM_MULTI_CHANNEL_AGGREGATED_MEMBERS_GET_V4_FRAME *) pCmd;
   ZW_NM_MULTI_CHANNEL_AGGREGATED_MEMBERS_REPORT_V4_FRAME
@@ -2774,6 +2775,7 @@ sli_nm_cmdclass_nmp_members_get_handler(ZW_APPLICATION_TX_BUFFER *pCmd,
   }
   ep_entry = rd_get_ep(nodeid, get_frame->aggregatedEndpoint & 0x7F);
   if (NULL == ep_entry || 0 == ep_entry->endpoint_aggr_len) {
+    rd_free_ep(ep_entry);
     return COMMAND_PARSE_ERROR;
   }
 
@@ -2799,9 +2801,10 @@ sli_nm_cmdclass_nmp_members_get_handler(ZW_APPLICATION_TX_BUFFER *pCmd,
            0,
            1);
   }
-  nm_send_reply(report_frame,
-                sizeof(ZW_NM_MULTI_CHANNEL_AGGREGATED_MEMBERS_REPORT_V4_FRAME)
-                + ep_entry->endpoint_aggr_len);
+  len = sizeof(ZW_NM_MULTI_CHANNEL_AGGREGATED_MEMBERS_REPORT_V4_FRAME)
+        + ep_entry->endpoint_aggr_len;
+  rd_free_ep(ep_entry);
+  nm_send_reply(report_frame, len);
   return COMMAND_HANDLED;
 }
 
@@ -19,8 +19,10 @@
 #include <rsi_ble_apis.h>
 #include <rsi_bt_common_apis.h>
 #include <rsi_common_apis.h>
+#include "cmsis_os2.h"
 #include "ZW_classcmd_ex.h"
 #include "RD_internal.h"
+#include "RD_name_index.h"
 #include "modules/sl_rd_data_store.h"
 #include "sl_common_type.h"
 #include "sl_common_log.h"
@@ -43,20 +45,51 @@
 #define MODE_FLAGS_LOWBAT  0x04
 
 /* Consider to move this to a GW component, ref: ZGW-1243 */
-const cc_version_pair_t controlled_cc_v[] = { { COMMAND_CLASS_VERSION, 0x0 },
-                                              { COMMAND_CLASS_ZWAVEPLUS_INFO, 0x0 },
-                                              { COMMAND_CLASS_MANUFACTURER_SPECIFIC, 0x0 },
-                                              { COMMAND_CLASS_WAKE_UP, 0x0 },
-                                              { COMMAND_CLASS_MULTI_CHANNEL_V4, 0x0 },
-                                              { COMMAND_CLASS_ASSOCIATION, 0x0 },
-                                              { COMMAND_CLASS_MULTI_CHANNEL_ASSOCIATION_V3, 0x0 },
-                                              { 0xffff, 0xff } };
-/* This eats memory ! */
+/*
+ * Controlled command classes whose version is cached, with the version
+ * assumed until probed. Shared by all nodes, which only keep one version
+ * byte per entry, in this order. Sorted by class for the lookup.
+ */
+static const cc_version_pair_t controlled_cc_v[RD_CC_VERSION_COUNT] = {
+  { COMMAND_CLASS_ZWAVEPLUS_INFO, 0x0 },
+  { COMMAND_CLASS_MULTI_CHANNEL_V4, 0x0 },
+  { COMMAND_CLASS_MANUFACTURER_SPECIFIC, 0x0 },
+  { COMMAND_CLASS_WAKE_UP, 0x0 },
+  { COMMAND_CLASS_ASSOCIATION, 0x0 },
+  { COMMAND_CLASS_VERSION, 0x0 },
+  { COMMAND_CLASS_MULTI_CHANNEL_ASSOCIATION_V3, 0x0 },
+};
 /**
- * The node database.
+ * The node database. Entries are loaded on demand by rd_node_get_raw() and
+ * unloaded by rd_node_cache_trim(); ndb holds the loaded ones.
  */
 static rd_node_database_entry_t* ndb[ZW_MAX_NODES];
 
+/* rd_node_set_ep_states() was not called while the entry was unloaded. */
+#define RD_EP_STATE_KEEP 0xFF
+
+/* What is kept of every node in node_db, loaded or not. */
+typedef struct {
+  rd_node_hot_t hot;  /* Valid while the entry is not loaded. */
+  uint32_t last_use;  /* sli_rd_clock at the last rd_node_get_raw(). */
+  uint16_t dsk_tag;   /* First two DSK bytes, to skip loads in rd_lookup_by_dsk(). */
+  uint8_t dsk_len;
+  uint8_t ep_state;   /* Endpoint state to set on load, or RD_EP_STATE_KEEP. */
+  uint8_t present;
+} sli_rd_node_t;
+
+static sli_rd_node_t sli_rd_nodes[ZW_MAX_NODES];
+static uint32_t sli_rd_clock;
+static rd_node_cache_stats_t sli_rd_cache_stats;
+
+/* Serializes loads, lookups and evictions of ndb between threads. Recursive,
+   the lookups load through rd_node_get_raw(). */
+static const osMutexAttr_t sli_rd_mutex_attr = {
+  .name      = "rd",
+  .attr_bits = osMutexRecursive | osMutexPrioInherit,
+};
+static osMutexId_t sli_rd_mutex = NULL;
+
 const char *ep_state_name(int state)
 {
   static char str[25];
@@ -105,21 +138,43 @@ const char* rd_node_probe_state_name(int state)
   }
 };
 
+/* Position of a class in controlled_cc_v, or -1. */
+static int sli_cc_version_index(uint16_t command_class)
+{
+  int lo = 0;
+  int hi = RD_CC_VERSION_COUNT - 1;
+
+  while (lo <= hi) {
+    int mid = (lo + hi) / 2;
+    if (controlled_cc_v[mid].command_class == command_class) {
+      return mid;
+    }
+    if (controlled_cc_v[mid].command_class < command_class) {
+      lo = mid + 1;
+    } else {
+      hi = mid - 1;
+    }
+  }
+  return -1;
+}
+
 uint8_t controlled_cc_v_size()
 {
-  return sizeof(controlled_cc_v);
+  return RD_CC_VERSION_COUNT;
 }
 
 int rd_mem_cc_versions_set_default(uint8_t node_cc_versions_len,
-                                   cc_version_pair_t *node_cc_versions)
+                                   uint8_t *node_cc_versions)
 {
-  if (node_cc_versions_len < sizeof(controlled_cc_v)) {
+  if (node_cc_versions_len < RD_CC_VERSION_COUNT) {
     return 0;
   }
   if (node_cc_versions) {
-    memcpy(node_cc_versions, controlled_cc_v, sizeof(controlled_cc_v));
+    for (int i = 0; i < RD_CC_VERSION_COUNT; i++) {
+      node_cc_versions[i] = controlled_cc_v[i].version;
+    }
   }
-  return sizeof(controlled_cc_v);
+  return RD_CC_VERSION_COUNT;
 }
 
 void rd_node_cc_versions_set_default(rd_node_database_entry_t *n)
@@ -127,17 +182,46 @@ void rd_node_cc_versions_set_default(rd_node_database_entry_t *n)
   if (!n) {
     return;
   }
-  if (n->node_cc_versions) {
-    memcpy(n->node_cc_versions, controlled_cc_v, n->node_cc_versions_len);
-  } else {
+  if (!n->node_cc_versions
+      || !rd_mem_cc_versions_set_default(n->node_cc_versions_len,
+                                         n->node_cc_versions)) {
     LOG_PRINTF("Node CC version set default failed.\n");
   }
 }
 
+void rd_node_cc_versions_upgrade(rd_node_database_entry_t *n)
+{
+  const cc_version_pair_t *pairs;
+  uint8_t *v;
+  int cnt, idx;
+
+  if (!n || !n->node_cc_versions
+      || n->node_cc_versions_len == RD_CC_VERSION_COUNT) {
+    return;
+  }
+  v = rd_data_mem_alloc(RD_CC_VERSION_COUNT);
+  if (!v) {
+    return;
+  }
+  rd_mem_cc_versions_set_default(RD_CC_VERSION_COUNT, v);
+
+  // Older stores keep class/version pairs, ended by class 0xffff.
+  pairs = (const cc_version_pair_t *) n->node_cc_versions;
+  cnt   = n->node_cc_versions_len / sizeof(cc_version_pair_t);
+  for (int i = 0; i < cnt; i++) {
+    idx = sli_cc_version_index(pairs[i].command_class);
+    if (idx >= 0) {
+      v[idx] = pairs[i].version;
+    }
+  }
+  rd_data_mem_free(n->node_cc_versions);
+  n->node_cc_versions     = v;
+  n->node_cc_versions_len = RD_CC_VERSION_COUNT;
+}
+
 uint8_t rd_node_cc_version_get(rd_node_database_entry_t *n, uint16_t command_class)
 {
-  int i, cnt;
-  uint8_t version;
+  int idx;
 
   if (!n) {
     return 0;
@@ -151,21 +235,16 @@ uint8_t rd_node_cc_version_get(rd_node_database_entry_t *n, uint16_t command_cla
     return 0;
   }
 
-  version = 0;
-  cnt = n->node_cc_versions_len / sizeof(cc_version_pair_t);
-
-  for (i = 0; i < cnt; i++) {
-    if (n->node_cc_versions[i].command_class == command_class) {
-      version = n->node_cc_versions[i].version;
-      break;
-    }
+  idx = sli_cc_version_index(command_class);
+  if (idx < 0 || idx >= n->node_cc_versions_len) {
+    return 0;
   }
-  return version;
+  return n->node_cc_versions[idx];
 }
 
 void rd_node_cc_version_set(rd_node_database_entry_t *n, uint16_t command_class, uint8_t version)
 {
-  int i, cnt;
+  int idx;
 
   if (!n) {
     return;
@@ -178,19 +257,111 @@ void rd_node_cc_version_set(rd_node_database_entry_t *n, uint16_t command_class,
   if (n->mode & MODE_FLAGS_DELETED) {
     return;
   }
-  cnt = n->node_cc_versions_len / sizeof(cc_version_pair_t);
 
-  for (i = 0; i < cnt; i++) {
-    if (n->node_cc_versions[i].command_class == command_class) {
-      n->node_cc_versions[i].version = version;
-      break;
+  idx = sli_cc_version_index(command_class);
+  if (idx >= 0 && idx < n->node_cc_versions_len) {
+    n->node_cc_versions[idx] = version;
+  }
+}
+
+static bool sli_rd_node_valid(nodeid_t nodeid)
+{
+  return (nodeid > 0) && (nodeid <= ZW_MAX_NODES);
+}
+
+static uint16_t sli_rd_dsk_tag(const uint8_t *dsk, uint8_t dsklen)
+{
+  return (dsk && (dsklen >= 2)) ? (uint16_t) ((dsk[0] << 8) | dsk[1]) : 0;
+}
+
+static uint32_t sli_rd_nif_digest(const rd_node_database_entry_t *n)
+{
+  const rd_ep_database_entry_t *ep0 = list_head(n->endpoints);
+
+  return (ep0 && ep0->endpoint_id == 0) ? ep0->cap_digest : 0;
+}
+
+/* Keep the resident fields of an entry that is about to be unloaded. */
+static void sli_rd_node_save(const rd_node_database_entry_t *n)
+{
+  sli_rd_node_t *s = &sli_rd_nodes[n->nodeid - 1];
+
+  s->hot.wakeUp_interval = n->wakeUp_interval;
+  s->hot.lastAwake       = n->lastAwake;
+  s->hot.mode            = n->mode;
+  s->hot.state           = n->state;
+  s->hot.security_flags  = n->security_flags;
+  s->hot.nif_digest      = sli_rd_nif_digest(n);
+  s->dsk_len             = n->dskLen;
+  s->dsk_tag             = sli_rd_dsk_tag(n->dsk, n->dskLen);
+  s->present             = 1;
+}
+
+static void sli_rd_ep_states_set(rd_node_database_entry_t *n,
+                                 rd_ep_state_t state)
+{
+  rd_ep_database_entry_t *ep;
+
+  for (ep = list_head(n->endpoints); ep; ep = list_item_next(ep)) {
+    ep->state = state;
+  }
+}
+
+/* The resident fields are newer than the stored ones, which are only
+   written with the entry. */
+static void sli_rd_node_restore(rd_node_database_entry_t *n)
+{
+  sli_rd_node_t *s = &sli_rd_nodes[n->nodeid - 1];
+
+  n->wakeUp_interval = s->hot.wakeUp_interval;
+  n->lastAwake       = s->hot.lastAwake;
+  n->mode            = s->hot.mode;
+  n->state           = s->hot.state;
+  n->security_flags  = s->hot.security_flags;
+  if (s->ep_state != RD_EP_STATE_KEEP) {
+    sli_rd_ep_states_set(n, (rd_ep_state_t) s->ep_state);
+    s->ep_state = RD_EP_STATE_KEEP;
+  }
+}
+
+void rd_lock_init(void)
+{
+  if (sli_rd_mutex == NULL) {
+    sli_rd_mutex = osMutexNew(&sli_rd_mutex_attr);
+  }
+}
+
+void rd_lock(void)
+{
+  if (sli_rd_mutex) {
+    osMutexAcquire(sli_rd_mutex, osWaitForever);
+  }
+}
+
+void rd_unlock(void)
+{
+  if (sli_rd_mutex) {
+    osMutexRelease(sli_rd_mutex);
+  }
+}
+
+static uint8_t sli_rd_loaded_count(void)
+{
+  uint8_t cnt = 0;
+
+  for (nodeid_t i = 0; i < ZW_MAX_NODES; i++) {
+    if (ndb[i]) {
+      cnt++;
     }
   }
+  return cnt;
 }
 
 rd_node_database_entry_t* rd_node_entry_alloc(nodeid_t nodeid)
 {
   rd_node_database_entry_t* rd_node = rd_data_mem_alloc(sizeof(rd_node_database_entry_t));
+
+  rd_lock();
   ndb[nodeid - 1] = rd_node;
   if (rd_node != NULL) {
     memset(rd_node, 0, sizeof(rd_node_database_entry_t));
@@ -215,27 +386,228 @@ rd_node_database_entry_t* rd_node_entry_alloc(nodeid_t nodeid)
     rd_node->node_properties_flags = 0x0000;
 
     LIST_STRUCT_INIT(rd_node, endpoints);
+
+    sli_rd_node_save(rd_node);
+    sli_rd_nodes[nodeid - 1].ep_state = RD_EP_STATE_KEEP;
+    sli_rd_nodes[nodeid - 1].last_use = ++sli_rd_clock;
   }
+  rd_unlock();
 
   return rd_node;
 }
 
-rd_node_database_entry_t* rd_node_entry_import(nodeid_t nodeid)
+static bool sli_rd_import_node(const rd_node_database_entry_t *n, void *ctx)
 {
-  ndb[nodeid - 1] = rd_data_store_read(nodeid);
-  return ndb[nodeid - 1];
+  nodeid_t nodeid = *(const nodeid_t *) ctx;
+
+  if (n->nodeid != nodeid) {
+    LOG_PRINTF("Record of node %i holds node %i\n", nodeid, n->nodeid);
+    return false;
+  }
+  rd_name_index_add_node(n);
+  sli_rd_node_save(n);
+  sli_rd_nodes[nodeid - 1].ep_state = RD_EP_STATE_KEEP;
+  sli_rd_nodes[nodeid - 1].last_use = 0;
+  return true;
+}
+
+static void sli_rd_import_ep(const rd_ep_database_entry_t *ep, void *ctx)
+{
+  nodeid_t nodeid = *(const nodeid_t *) ctx;
+
+  if (ep->endpoint_id == 0) {
+    sli_rd_nodes[nodeid - 1].hot.nif_digest = ep->cap_digest;
+  }
+  rd_name_index_add_ep(ep);
+}
+
+/* Walks the record instead of decoding it, so booting with a large network
+   does not allocate every entry. */
+uint8_t rd_node_entry_import(nodeid_t nodeid)
+{
+  uint8_t ok = 1;
+
+  if (!sli_rd_node_valid(nodeid)) {
+    return 0;
+  }
+  rd_lock();
+  if (!rd_data_store_peek(nodeid, sli_rd_import_node, sli_rd_import_ep,
+                          &nodeid)) {
+    rd_name_index_remove_node(nodeid);
+    sli_rd_nodes[nodeid - 1].present = 0;
+    ok = 0;
+  }
+  rd_unlock();
+  return ok;
 }
 
 void rd_node_entry_free(nodeid_t nodeid)
 {
-  rd_node_database_entry_t* rd_node = ndb[nodeid - 1];
-  rd_data_store_mem_free(rd_node);
+  rd_node_database_entry_t* rd_node;
+
+  rd_lock();
+  rd_node = ndb[nodeid - 1];
+  rd_name_index_remove_node(nodeid);
+  if (rd_node) {
+    rd_data_store_mem_free(rd_node);
+  }
   ndb[nodeid - 1] = NULL;
+  memset(&sli_rd_nodes[nodeid - 1], 0, sizeof(sli_rd_node_t));
+  rd_unlock();
 }
 
 rd_node_database_entry_t* rd_node_get_raw(nodeid_t nodeid)
 {
-  return ndb[nodeid - 1];
+  rd_node_database_entry_t *n;
+
+  if (!sli_rd_node_valid(nodeid)) {
+    return NULL;
+  }
+  rd_lock();
+  n = ndb[nodeid - 1];
+  if (n) {
+    sli_rd_cache_stats.hits++;
+  } else if (sli_rd_nodes[nodeid - 1].present) {
+    n = rd_data_store_read(nodeid);
+    if (n) {
+      sli_rd_node_restore(n);
+      ndb[nodeid - 1] = n;
+      sli_rd_cache_stats.loads++;
+    } else {
+      sli_rd_cache_stats.errors++;
+    }
+  }
+  if (n) {
+    sli_rd_nodes[nodeid - 1].last_use = ++sli_rd_clock;
+  }
+  rd_unlock();
+  return n;
+}
+
+rd_node_database_entry_t* rd_node_get_loaded(nodeid_t nodeid)
+{
+  return sli_rd_node_valid(nodeid) ? ndb[nodeid - 1] : NULL;
+}
+
+bool rd_node_hot_get(nodeid_t nodeid, rd_node_hot_t *hot)
+{
+  const rd_node_database_entry_t *n;
+
+  if (!sli_rd_node_valid(nodeid) || !sli_rd_nodes[nodeid - 1].present) {
+    return false;
+  }
+  rd_lock();
+  n = ndb[nodeid - 1];
+  if (n) {
+    hot->wakeUp_interval = n->wakeUp_interval;
+    hot->lastAwake       = n->lastAwake;
+    hot->mode            = n->mode;
+    hot->state           = n->state;
+    hot->security_flags  = n->security_flags;
+    hot->nif_digest      = sli_rd_nif_digest(n);
+  } else {
+    *hot = sli_rd_nodes[nodeid - 1].hot;
+  }
+  rd_unlock();
+  return true;
+}
+
+void rd_node_hot_set(nodeid_t nodeid, const rd_node_hot_t *hot)
+{
+  rd_node_database_entry_t *n;
+
+  if (!sli_rd_node_valid(nodeid) || !sli_rd_nodes[nodeid - 1].present) {
+    return;
+  }
+  rd_lock();
+  n = ndb[nodeid - 1];
+  if (n) {
+    n->wakeUp_interval = hot->wakeUp_interval;
+    n->lastAwake       = hot->lastAwake;
+    n->mode            = hot->mode;
+    n->state           = hot->state;
+    n->security_flags  = hot->security_flags;
+  } else {
+    uint32_t digest = sli_rd_nodes[nodeid - 1].hot.nif_digest;
+
+    sli_rd_nodes[nodeid - 1].hot            = *hot;
+    sli_rd_nodes[nodeid - 1].hot.nif_digest = digest;
+  }
+  rd_unlock();
+}
+
+void rd_node_set_ep_states(nodeid_t nodeid, rd_ep_state_t state)
+{
+  if (!sli_rd_node_valid(nodeid) || !sli_rd_nodes[nodeid - 1].present) {
+    return;
+  }
+  rd_lock();
+  if (ndb[nodeid - 1]) {
+    sli_rd_ep_states_set(ndb[nodeid - 1], state);
+  } else {
+    sli_rd_nodes[nodeid - 1].ep_state = state;
+  }
+  rd_unlock();
+}
+
+void rd_node_cache_trim(uint8_t keep)
+{
+  rd_node_database_entry_t *n;
+  uint8_t loaded;
+  nodeid_t victim;
+
+  rd_lock();
+  loaded = sli_rd_loaded_count();
+  while (loaded > keep) {
+    victim = 0;
+    for (nodeid_t i = 1; i <= ZW_MAX_NODES; i++) {
+      n = ndb[i - 1];
+      if (n && (n->refCnt == 0) && !rd_node_is_busy(n)
+          && (!victim
+              || (sli_rd_nodes[i - 1].last_use
+                  < sli_rd_nodes[victim - 1].last_use))) {
+        victim = i;
+      }
+    }
+    if (!victim) {
+      break;
+    }
+    n = ndb[victim - 1];
+    /* Keep the entry if its changes cannot be written, they would be lost. */
+    if (!rd_data_store_flush_node(n)) {
+      break;
+    }
+    sli_rd_node_save(n);
+    ndb[victim - 1] = NULL;
+    rd_data_store_mem_free(n);
+    sli_rd_cache_stats.evictions++;
+    loaded--;
+  }
+  rd_unlock();
+}
+
+void rd_node_cache_get_stats(rd_node_cache_stats_t *stats)
+{
+  rd_lock();
+  *stats        = sli_rd_cache_stats;
+  stats->loaded = sli_rd_loaded_count();
+  stats->nodes  = 0;
+  for (nodeid_t i = 0; i < ZW_MAX_NODES; i++) {
+    if (sli_rd_nodes[i].present) {
+      stats->nodes++;
+    }
+  }
+  rd_unlock();
+}
+
+void rd_node_cache_print_stats(void)
+{
+  rd_node_cache_stats_t st;
+
+  rd_node_cache_get_stats(&st);
+  LOG_PRINTF("RD cache: %d of %d nodes loaded, %lu hits, %lu loads, "
+             "%lu errors, %lu evictions\n",
+             st.loaded, st.nodes, st.hits, st.loads, st.errors, st.evictions);
 }
 
 void
@@ -243,6 +615,8 @@ rd_destroy()
 {
   nodeid_t i;
   rd_node_database_entry_t *n;
+
+  rd_lock();
   for (i = 0; i < ZW_MAX_NODES; i++) {
     n = ndb[i];
     if (n) {
@@ -250,19 +624,36 @@ rd_destroy()
       ndb[i] = 0;
     }
   }
+  memset(sli_rd_nodes, 0, sizeof(sli_rd_nodes));
+  rd_name_index_clear();
+  rd_unlock();
 }
 
 u8_t rd_node_exists(nodeid_t node)
 {
-  if (node > 0 && node <= ZW_MAX_NODES) {
-    return (ndb[node - 1] != 0);
+  if (sli_rd_node_valid(node)) {
+    return sli_rd_nodes[node - 1].present;
   }
   return false;
 }
 
+/* First endpoint of the first node from \p i on that has one. */
+static rd_ep_database_entry_t* sli_rd_ep_from(nodeid_t i)
+{
+  rd_node_database_entry_t *n;
+
+  for (; i <= ZW_MAX_NODES; i++) {
+    n = sli_rd_nodes[i - 1].present ? rd_node_get_raw(i) : NULL;
+    if (n && list_head(n->endpoints)) {
+      return list_head(n->endpoints);
+    }
+  }
+  return 0;
+}
+
 rd_ep_database_entry_t* rd_ep_first(nodeid_t node)
 {
-  nodeid_t i;
+  rd_node_database_entry_t *n;
 
   /* special rule for node 0 to be valid for searching all nodes */
   if ((node > ZW_MAX_NODES)
@@ -271,42 +662,45 @@ rd_ep_database_entry_t* rd_ep_first(nodeid_t node)
   }
 
   if (node == 0) {
-    for (i = 0; i < ZW_MAX_NODES; i++) {
-      if (ndb[i]) {
-        return list_head(ndb[i]->endpoints);
-      }
-    }
-  } else if (ndb[node - 1]) {
-    return list_head(ndb[node - 1]->endpoints);
+    return sli_rd_ep_from(1);
   }
-  return 0;
+  n = rd_node_get_raw(node);
+  return n ? list_head(n->endpoints) : 0;
 }
 
 rd_ep_database_entry_t* rd_ep_next(nodeid_t node, rd_ep_database_entry_t* ep)
 {
-  nodeid_t i;
   rd_ep_database_entry_t* next = list_item_next(ep);
 
   if (next == 0 && node == 0) {
-    for (i = ep->node->nodeid; i < ZW_MAX_NODES; i++) {
-      if (ndb[i]) {
-        return list_head(ndb[i]->endpoints);
-      }
-    }
+    return sli_rd_ep_from(ep->node->nodeid + 1);
   }
   return next;
 }
 
 rd_node_mode_t rd_node_mode_value_get(nodeid_t n)
 {
-  rd_node_database_entry_t *node = rd_node_get_raw(n);
-  if (node) {
-    return RD_NODE_MODE_VALUE_GET(node);
+  rd_node_hot_t hot;
+
+  if (rd_node_hot_get(n, &hot)) {
+    return hot.mode & 0xFF;
   } else {
     return MODE_NODE_UNDEF;
   }
 }
 
+/* 32 bit FNV-1a. 0 is kept for a digest that is not known. */
+uint32_t rd_capability_digest(const uint8_t *data, uint8_t len)
+{
+  uint32_t h = 2166136261UL;
+
+  for (uint8_t i = 0; i < len; i++) {
+    h ^= data[i];
+    h *= 16777619UL;
+  }
+  return h ? h : 1;
+}
+
 u8_t
 rd_get_node_name(rd_node_database_entry_t* n, char* buf, u8_t size)
 {
@@ -321,20 +715,41 @@ rd_get_node_name(rd_node_database_entry_t* n, char* buf, u8_t size)
   }
 }
 
+/* Length of the default node name, "zw" + home ID + node ID in hex. */
+#define RD_DEFAULT_NODE_NAME_LEN (2 + 8 + 4)
+
 rd_node_database_entry_t* rd_lookup_by_node_name(const char* name)
 {
-  nodeid_t i;
-  uint8_t j;
-  char buf[64];
-  for (i = 0; i < ZW_MAX_NODES; i++) {
-    if (ndb[i]) {
-      j = rd_get_node_name(ndb[i], buf, sizeof(buf));
-      if (strncasecmp(buf, name, j) == 0) {
-        return ndb[i];
-      }
-    }
+  rd_node_database_entry_t *n;
+  size_t len = strlen(name);
+  char buf[9];
+  char *end;
+  unsigned long id;
+
+  if (len > 0xFF) {
+    return 0;
   }
-  return 0;
+  n = rd_name_index_find_node(name, (u8_t)len);
+  if (n) {
+    return n;
+  }
+
+  /* Nodes without a name answer to the name generated by rd_get_node_name(). */
+  if ((len != RD_DEFAULT_NODE_NAME_LEN) || strncasecmp(name, "zw", 2)) {
+    return 0;
+  }
+  memcpy(buf, name + 2, 8);
+  buf[8] = 0;
+  id = strtoul(buf, &end, 16);
+  if ((*end != 0) || (id != UIP_HTONL(homeID))) {
+    return 0;
+  }
+  id = strtoul(name + 10, &end, 16);
+  if ((*end != 0) || (id == 0) || (id > ZW_MAX_NODES)) {
+    return 0;
+  }
+  n = rd_node_get_raw((nodeid_t) id);
+  return (n && n->nodeNameLen == 0) ? n : 0;
 }
 
 u8_t rd_get_ep_name(rd_ep_database_entry_t* ep, char* buf, u8_t size)
@@ -421,19 +836,32 @@ void rd_node_add_dsk(nodeid_t node, uint8_t dsklen, const uint8_t *dsk)
 
 rd_node_database_entry_t* rd_lookup_by_dsk(uint8_t dsklen, const uint8_t* dsk)
 {
+  rd_node_database_entry_t *n;
+  const sli_rd_node_t *s;
   nodeid_t ii;
 
   if (dsklen == 0) {
     return NULL;
   }
 
+  rd_lock();
   for (ii = 0; ii < ZW_MAX_NODES; ii++) {
-    if (ndb[ii] && (ndb[ii]->dskLen >= dsklen)) {
-      if (memcmp(ndb[ii]->dsk, dsk, dsklen) == 0) {
-        return ndb[ii];
+    s = &sli_rd_nodes[ii];
+    n = ndb[ii];
+    /* Only load a node whose DSK can match. */
+    if (!n && (!s->present || (s->dsk_len < dsklen)
+               || (s->dsk_tag != sli_rd_dsk_tag(dsk, dsklen)))) {
+      continue;
+    }
+    n = n ? n : rd_node_get_raw(ii + 1);
+    if (n && (n->dskLen >= dsklen)) {
+      if (memcmp(n->dsk, dsk, dsklen) == 0) {
+        rd_unlock();
+        return n;
       }
     }
   }
+  rd_unlock();
   return NULL;
 }
 
@@ -445,8 +873,12 @@ rd_node_database_entry_t* rd_get_node_dbe(nodeid_t nodeid)
     return 0;
   }
 
-  if (ndb[nodeid - 1]) {
-    ndb[nodeid - 1]->refCnt++;
+  rd_lock();
+  rd_node_database_entry_t *n = rd_node_get_raw(nodeid);
+
+  if (n) {
+    n->refCnt++;
   }
-  return ndb[nodeid - 1];
+  rd_unlock();
+  return n;
 }
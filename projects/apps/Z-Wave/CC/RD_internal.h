@@ -18,6 +18,8 @@
 #ifndef RD_BASIC_H
 #define RD_BASIC_H
 
+#include <stddef.h>
+#include <stdbool.h>
 #include "lib/list.h" /* Contiki lists */
 // #include "net/uip.h" /* Contiki uip_ip6addr_t */
 #include "sl_rd_types.h"
@@ -28,6 +30,9 @@
  */
 #define DEFAULT_WAKE_UP_INTERVAL (70 * 60)
 
+/** Number of controlled command classes whose version is cached per node. */
+#define RD_CC_VERSION_COUNT 7
+
 /** Get the mDNS mode of a node.
  *
  * \ingroup node_db
@@ -72,8 +77,10 @@ typedef enum {
   STATUS_CREATED,
   /** Waiting for NIF   */
   STATUS_PROBE_NODE_INFO,
-  /** If node supports Manufacturer Specific, ask for it.  On reply,
-   * go to #STATUS_ENUMERATE_ENDPOINTS */
+  /** If node supports Manufacturer Specific, ask for it, then ask
+   * Version for the firmware version.  If a device profile of the
+   * model fills in the endpoints (rd_profile_apply()), go to
+   * #STATUS_CHECK_WU_CC_VERSION, else to #STATUS_ENUMERATE_ENDPOINTS */
   STATUS_PROBE_PRODUCT_ID,
   /** If node supports multichannel, ask how many endpoints.  On
    * reply, go to #STATUS_FIND_ENDPOINTS */
@@ -241,8 +248,9 @@ typedef struct rd_node_database_entry {
    * has been received yet. The version stored is the version reported by
    * the node, even if the gateway only controls a lower version.
    */
-  /* CC versions cache for this node */
-  cc_version_pair_t *node_cc_versions;
+  /* CC versions cache for this node, one byte per controlled command
+   * class, see rd_node_cc_version_get(). */
+  uint8_t *node_cc_versions;
 
   /* This is not persisted in eeprom */
   sl_probe_cc_version_state_t *pcvs;
@@ -456,8 +464,38 @@ typedef struct rd_ep_database_entry {
   /** Z-Wave plus icon ID. */
   uint16_t user_iconID;
   nodeid_t nodeID;
+
+  /* Fields below are not in the endpoint objects of the legacy store, see
+     #RD_EP_STORE_SIZE. */
+
+  /** Digest of the capability data the endpoint reported at its last
+      probe, the node info for endpoint 0, see rd_capability_digest().
+      0 if not known. */
+  uint32_t cap_digest;
+
+  /* Fields below are rebuilt from the ones above and not persisted. */
+
+  /** Support flags (#SUPPORTED_NON_SEC, ..., #CONTROLLED_SEC) of the one
+      byte command classes in #endpoint_info, one nibble per class, built by
+      rd_ep_class_index(). NULL if not built. */
+  uint8_t *cc_flags;
+  /** Number of classes covered by #cc_flags; higher classes are absent. */
+  uint8_t cc_flags_classes;
 } rd_ep_database_entry_t;
 
+/** Classes from this value up are not in rd_ep_database_entry::cc_flags. */
+#define RD_EP_CC_FLAGS_MAX 0xF0
+
+/**
+ * Digest of the capability data of an endpoint: the generic and specific
+ * device class followed by the command classes, as in a node info frame or
+ * a Multi Channel capability report. Never 0.
+ */
+uint32_t rd_capability_digest(const uint8_t *data, uint8_t len);
+
+/** Bytes of an endpoint entry written to NVM3. */
+#define RD_EP_STORE_SIZE offsetof(rd_ep_database_entry_t, cap_digest)
+
 /** Allocate a node entry in the \ref node_db.
  *
  * \ingroup node_db
@@ -471,22 +509,131 @@ typedef struct rd_ep_database_entry {
  */
 rd_node_database_entry_t* rd_node_entry_alloc(nodeid_t nodeid);
 
-/** Import stored data for node \p nodeid from \ref rd_data_store into \ref node_db.
+/** Register node \p nodeid from \ref rd_data_store in \ref node_db.
  *
  * \ingroup node_db
  *
- * \return Pointer to the newly allocated node entry, or NULL if it
- * was not found in \ref rd_data_store.
+ * Only the resident fields (\ref rd_node_hot_t) and the names are read;
+ * the entry itself is loaded by the first rd_node_get_raw().
+ *
+ * \return 1 if the node was found in \ref rd_data_store.
  */
-rd_node_database_entry_t* rd_node_entry_import(nodeid_t nodeid);
+uint8_t rd_node_entry_import(nodeid_t nodeid);
 
 /**
  * Free the dynamic data of node \p nodeid in both \ref node_db and \ref rd_data_store.
  */
 void rd_node_entry_free(nodeid_t nodeid);
 
+/**
+ * Node fields kept resident for every node, also while its entry is not
+ * loaded, so the frequent questions about a node do not load it.
+ *
+ * \ingroup node_db
+ *
+ * While the entry is loaded, its own fields are the ones in use.
+ */
+typedef struct rd_node_hot {
+  uint32_t wakeUp_interval;
+  uint32_t lastAwake;
+  rd_node_mode_t mode;
+  rd_node_state_t state;
+  uint8_t security_flags;
+  /** rd_ep_database_entry::cap_digest of endpoint 0, ignored by
+      rd_node_hot_set(). */
+  uint32_t nif_digest;
+} rd_node_hot_t;
+
+/** Node entries kept loaded by rd_node_cache_trim() from the router loop. */
+#ifndef RD_NODE_CACHE_SIZE
+#define RD_NODE_CACHE_SIZE 16
+#endif
+
+typedef struct {
+  uint32_t hits;      /**< rd_node_get_raw() calls finding the entry loaded. */
+  uint32_t loads;     /**< Entries loaded from \ref rd_data_store. */
+  uint32_t errors;    /**< Entries that could not be loaded. */
+  uint32_t evictions; /**< Entries unloaded by rd_node_cache_trim(). */
+  uint8_t loaded;     /**< Entries loaded now. */
+  uint8_t nodes;      /**< Nodes in \ref node_db. */
+} rd_node_cache_stats_t;
+
+/**
+ * Create the lock of \ref node_db; called from rd_init().
+ *
+ * \ingroup node_db
+ */
+void rd_lock_init(void);
+
+/**
+ * Lock \ref node_db against loads and evictions from other threads.
+ *
+ * \ingroup node_db
+ *
+ * The lock is recursive. Loads, lookups and rd_node_cache_trim() take it
+ * themselves; hold it to keep an entry of rd_node_get_raw() valid across
+ * several calls outside the router thread. Never call it from a timer
+ * callback, post an event to the router thread instead.
+ */
+void rd_lock(void);
+
+/** Release the lock taken with rd_lock(). */
+void rd_unlock(void);
+
+/**
+ * Get the entry of a node, loading it from \ref rd_data_store if needed.
+ *
+ * \ingroup node_db
+ *
+ * The pointer stays valid until the router loop calls rd_node_cache_trim(),
+ * unless it is held with rd_get_node_dbe(). Other threads must hold it or
+ * rd_lock() while they use it.
+ */
 rd_node_database_entry_t* rd_node_get_raw(nodeid_t nodeid);
 
+/** Get the entry of a node only if it is loaded. */
+rd_node_database_entry_t* rd_node_get_loaded(nodeid_t nodeid);
+
+/**
+ * Get the resident fields of a node without loading its entry.
+ * \return false if the node is not in \ref node_db.
+ */
+bool rd_node_hot_get(nodeid_t nodeid, rd_node_hot_t *hot);
+
+/**
+ * Set the resident fields of a node, in its entry if it is loaded. Nothing
+ * is marked for writing.
+ */
+void rd_node_hot_set(nodeid_t nodeid, const rd_node_hot_t *hot);
+
+/**
+ * Set the state of all endpoints of a node, when its entry is loaded if it
+ * is not now.
+ */
+void rd_node_set_ep_states(nodeid_t nodeid, rd_ep_state_t state);
+
+/**
+ * Unload least recently used entries until at most \p keep are loaded.
+ *
+ * Entries held with rd_get_node_dbe() and entries in use by the probe
+ * machine (rd_node_is_busy()) stay. Changes are written before an entry is
+ * unloaded. Call only from the router loop, where it holds no other entry
+ * pointer; other threads are kept out with rd_lock().
+ */
+void rd_node_cache_trim(uint8_t keep);
+
+/** Copy the cache counters. */
+void rd_node_cache_get_stats(rd_node_cache_stats_t *stats);
+
+/** Print the cache counters. */
+void rd_node_cache_print_stats(void);
+
+/**
+ * True if the probe machine keeps a pointer to the node or one of its
+ * endpoints across callbacks. Implemented in sl_zw_resource.c.
+ */
+bool rd_node_is_busy(const rd_node_database_entry_t *n);
+
 /** Set the DSK of a node.
  *
  * \ingroup node_db
@@ -606,7 +753,7 @@ void rd_node_cc_version_set(rd_node_database_entry_t *n, uint16_t command_class,
  * \return The actual size of the default values.
  */
 int rd_mem_cc_versions_set_default(uint8_t node_cc_versions_len,
-                                   cc_version_pair_t *node_cc_versions);
+                                   uint8_t *node_cc_versions);
 
 /** Node CC version helper function - Set Default
  *
@@ -616,12 +763,23 @@ int rd_mem_cc_versions_set_default(uint8_t node_cc_versions_len,
  */
 void rd_node_cc_versions_set_default(rd_node_database_entry_t *n);
 
+/** Node CC version helper function - Upgrade
+ *
+ * Convert the class/version pairs of an older data store to one version
+ * byte per controlled command class. Does nothing for the current layout.
+ *
+ * \ingroup node_db
+ *
+ * \param n The node just read from the data store
+ */
+void rd_node_cc_versions_upgrade(rd_node_database_entry_t *n);
+
 /**
- * @brief Return the size of controlled command class that gateway is caching.
+ * @brief Return the size of the per-node version cache, in bytes.
  *
  * \ingroup node_db
  *
- * \return size size of controlled_cc_v array
+ * \return size one byte per entry of controlled_cc_v
  */
 uint8_t controlled_cc_v_size();
 
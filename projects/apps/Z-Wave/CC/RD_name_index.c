@@ -0,0 +1,254 @@
+/***************************************************************************/ /**
+ * @file RD_name_index.c
+ * @brief Hash index of node and endpoint names
+ *******************************************************************************
+ * # License
+ * <b>Copyright 2025 Silicon Laboratories Inc. www.silabs.com</b>
+ *******************************************************************************
+ *
+ * The licensor of this software is Silicon Laboratories Inc. Your use of this
+ * software is governed by the terms of Silicon Labs Master Software License
+ * Agreement (MSLA) available at
+ * www.silabs.com/about-us/legal/master-software-license-agreement. This
+ * software is distributed to you in Source Code format and is governed by the
+ * sections of the MSLA applicable to Source Code.
+ *
+ ******************************************************************************/
+
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include "lib/memb.h"
+#include "sl_common_log.h"
+#include "ZW_transport_api.h"
+#include "RD_name_index.h"
+#include "apps/ip_translate/sl_zw_resource.h"
+
+#define FNV_OFFSET 2166136261UL
+#define FNV_PRIME  16777619UL
+
+/* Entries refer to nodes by ID, an entry may be unloaded, see
+   rd_node_get_raw(). */
+typedef struct rd_name_entry {
+  struct rd_name_entry *next;
+  uint32_t hash;
+  nodeid_t nodeid;
+  uint8_t epid;
+  uint8_t is_ep;
+} rd_name_entry_t;
+
+MEMB(name_entries, rd_name_entry_t, RD_NAME_INDEX_SIZE);
+static rd_name_entry_t *buckets[RD_NAME_INDEX_BUCKETS];
+/* Set when an entry could not be allocated, the index is then partial. */
+static uint8_t overflow;
+
+static uint32_t hash_add(uint32_t h, const char *s, u8_t len)
+{
+  for (u8_t i = 0; i < len; i++) {
+    h ^= (uint8_t) tolower((unsigned char) s[i]);
+    h *= FNV_PRIME;
+  }
+  return h;
+}
+
+/* Hash of "name.location", the same as hash_add() over the service name. */
+static uint32_t ep_hash(const char *name, u8_t name_len,
+                        const char *location, u8_t loc_len)
+{
+  uint32_t h = hash_add(FNV_OFFSET, name, name_len);
+
+  if (loc_len) {
+    h = hash_add(h, ".", 1);
+    h = hash_add(h, location, loc_len);
+  }
+  return h;
+}
+
+static int str_match(const char *a, u8_t a_len, const char *b, u8_t b_len)
+{
+  return a_len == b_len && (a_len == 0 || strncasecmp(a, b, a_len) == 0);
+}
+
+static int ep_match(const rd_ep_database_entry_t *ep,
+                    const char *name, u8_t name_len,
+                    const char *location, u8_t loc_len)
+{
+  return ep->endpoint_name
+         && str_match(ep->endpoint_name, ep->endpoint_name_len, name, name_len)
+         && str_match(ep->endpoint_location, ep->endpoint_loc_len,
+                      location, loc_len);
+}
+
+static void insert(nodeid_t nodeid, uint8_t epid, uint32_t hash, uint8_t is_ep)
+{
+  rd_name_entry_t *e = memb_alloc(&name_entries);
+
+  if (!e) {
+    if (!overflow) {
+      WRN_PRINTF("Name index full, falling back to scans\n");
+    }
+    overflow = 1;
+    return;
+  }
+  e->nodeid = nodeid;
+  e->epid   = epid;
+  e->hash   = hash;
+  e->is_ep  = is_ep;
+  e->next   = buckets[hash & (RD_NAME_INDEX_BUCKETS - 1)];
+  buckets[hash & (RD_NAME_INDEX_BUCKETS - 1)] = e;
+}
+
+/* Removal is rare, so entries are found by ID rather than by hash. With
+   all_eps set, remove the node name and every endpoint of the node. */
+static void remove_ids(nodeid_t nodeid, uint8_t epid, uint8_t is_ep,
+                       uint8_t all_eps)
+{
+  for (int b = 0; b < RD_NAME_INDEX_BUCKETS; b++) {
+    rd_name_entry_t **pp = &buckets[b];
+    while (*pp) {
+      rd_name_entry_t *e = *pp;
+      if (e->nodeid == nodeid
+          && (all_eps || (e->is_ep == is_ep && e->epid == epid))) {
+        *pp = e->next;
+        memb_free(&name_entries, e);
+      } else {
+        pp = &e->next;
+      }
+    }
+  }
+}
+
+static void add_ep(const rd_ep_database_entry_t *ep)
+{
+  if (ep->endpoint_name && ep->endpoint_name_len) {
+    insert(ep->node->nodeid, ep->endpoint_id,
+           ep_hash(ep->endpoint_name, ep->endpoint_name_len,
+                   ep->endpoint_location, ep->endpoint_loc_len),
+           1);
+  }
+}
+
+void rd_name_index_clear(void)
+{
+  memb_init(&name_entries);
+  memset(buckets, 0, sizeof(buckets));
+  overflow = 0;
+}
+
+void rd_name_index_add_node(const rd_node_database_entry_t *n)
+{
+  if (!n) {
+    return;
+  }
+  if (n->nodename && n->nodeNameLen) {
+    insert(n->nodeid, 0, hash_add(FNV_OFFSET, n->nodename, n->nodeNameLen), 0);
+  }
+  for (rd_ep_database_entry_t *ep = list_head(n->endpoints); ep;
+       ep = list_item_next(ep)) {
+    add_ep(ep);
+  }
+}
+
+void rd_name_index_add_ep(const rd_ep_database_entry_t *ep)
+{
+  add_ep(ep);
+}
+
+void rd_name_index_remove_node(nodeid_t nodeid)
+{
+  remove_ids(nodeid, 0, 0, 1);
+}
+
+void rd_name_index_set_ep(const rd_ep_database_entry_t *ep)
+{
+  remove_ids(ep->node->nodeid, ep->endpoint_id, 1, 0);
+  add_ep(ep);
+}
+
+void rd_name_index_remove_ep(const rd_ep_database_entry_t *ep)
+{
+  remove_ids(ep->node->nodeid, ep->endpoint_id, 1, 0);
+}
+
+/* Load the endpoint an entry refers to. */
+static rd_ep_database_entry_t *entry_ep(const rd_name_entry_t *e)
+{
+  rd_node_database_entry_t *n = rd_node_get_raw(e->nodeid);
+  rd_ep_database_entry_t *ep;
+
+  for (ep = n ? list_head(n->endpoints) : NULL; ep; ep = list_item_next(ep)) {
+    if (ep->endpoint_id == e->epid) {
+      return ep;
+    }
+  }
+  return NULL;
+}
+
+rd_node_database_entry_t *rd_name_index_find_node(const char *name, u8_t len)
+{
+  uint32_t h = hash_add(FNV_OFFSET, name, len);
+  rd_node_database_entry_t *n;
+
+  for (rd_name_entry_t *e = buckets[h & (RD_NAME_INDEX_BUCKETS - 1)]; e;
+       e = e->next) {
+    if (e->is_ep || e->hash != h) {
+      continue;
+    }
+    n = rd_node_get_raw(e->nodeid);
+    if (n && str_match(n->nodename, n->nodeNameLen, name, len)) {
+      return n;
+    }
+  }
+  if (overflow) {
+    for (nodeid_t i = 1; i <= ZW_MAX_NODES; i++) {
+      n = rd_node_get_raw(i);
+      if (n && n->nodename && n->nodeNameLen
+          && str_match(n->nodename, n->nodeNameLen, name, len)) {
+        return n;
+      }
+    }
+  }
+  return NULL;
+}
+
+rd_ep_database_entry_t *rd_name_index_find_ep(const char *name, u8_t name_len,
+                                              const char *location,
+                                              u8_t loc_len)
+{
+  uint32_t h = ep_hash(name, name_len, location, loc_len);
+  rd_ep_database_entry_t *ep;
+
+  if (name_len == 0) {
+    return NULL;
+  }
+  for (rd_name_entry_t *e = buckets[h & (RD_NAME_INDEX_BUCKETS - 1)]; e;
+       e = e->next) {
+    if (!e->is_ep || e->hash != h) {
+      continue;
+    }
+    ep = entry_ep(e);
+    if (ep && ep_match(ep, name, name_len, location, loc_len)) {
+      return ep;
+    }
+  }
+  if (overflow) {
+    for (ep = rd_ep_first(RD_ALL_NODES); ep; ep = rd_ep_next(RD_ALL_NODES, ep)) {
+      if (ep_match(ep, name, name_len, location, loc_len)) {
+        return ep;
+      }
+    }
+  }
+  return NULL;
+}
+
+rd_ep_database_entry_t *rd_name_index_find_service(const char *service,
+                                                   u8_t len)
+{
+  const char *dot = memchr(service, '.', len);
+
+  if (!dot) {
+    return rd_name_index_find_ep(service, len, NULL, 0);
+  }
+  return rd_name_index_find_ep(service, (u8_t) (dot - service),
+                               dot + 1, (u8_t) (len - (dot - service) - 1));
+}
@@ -0,0 +1,88 @@
+/***************************************************************************/ /**
+ * @file RD_name_index.h
+ * @brief Hash index of node and endpoint names
+ *******************************************************************************
+ * # License
+ * <b>Copyright 2025 Silicon Laboratories Inc. www.silabs.com</b>
+ *******************************************************************************
+ *
+ * The licensor of this software is Silicon Laboratories Inc. Your use of this
+ * software is governed by the terms of Silicon Labs Master Software License
+ * Agreement (MSLA) available at
+ * www.silabs.com/about-us/legal/master-software-license-agreement. This
+ * software is distributed to you in Source Code format and is governed by the
+ * sections of the MSLA applicable to Source Code.
+ *
+ ******************************************************************************/
+
+#ifndef RD_NAME_INDEX_H
+#define RD_NAME_INDEX_H
+
+#include "RD_internal.h"
+#include "sl_common_type.h"
+
+/**
+ * \ingroup node_db
+ *
+ * Case-insensitive hash index over the names that were set on nodes and the
+ * name/location pairs that were set on endpoints. Generated default names
+ * are not indexed, they are decoded by the lookups in RD_internal.c.
+ *
+ * An endpoint is keyed by its service name, "name.location", or just
+ * "name" when it has no location; a Z/IP name never contains a dot.
+ *
+ * Entries hold node and endpoint IDs, not pointers, so they stay valid
+ * while a node entry is unloaded. A lookup loads the entry it matches.
+ *
+ * If the entry pool runs out, lookups fall back to scanning the node
+ * database until rd_name_index_clear() is called.
+ */
+
+/** Indexed names, nodes and endpoints together. */
+#ifndef RD_NAME_INDEX_SIZE
+#define RD_NAME_INDEX_SIZE 128
+#endif
+
+/** Hash buckets, a power of two. */
+#define RD_NAME_INDEX_BUCKETS 64
+
+/** Drop all entries. */
+void rd_name_index_clear(void);
+
+/** Index the name of a node and the names of all its endpoints. */
+void rd_name_index_add_node(const rd_node_database_entry_t *n);
+
+/** Index the name of an endpoint that is not indexed yet. */
+void rd_name_index_add_ep(const rd_ep_database_entry_t *ep);
+
+/** Remove the name of a node and the names of all its endpoints. */
+void rd_name_index_remove_node(nodeid_t nodeid);
+
+/** Re-index an endpoint after its name or location changed. */
+void rd_name_index_set_ep(const rd_ep_database_entry_t *ep);
+
+/** Remove an endpoint. */
+void rd_name_index_remove_ep(const rd_ep_database_entry_t *ep);
+
+/**
+ * Find a node by the name set on it.
+ * \param name Name, not zero terminated.
+ * \param len Length of \p name.
+ */
+rd_node_database_entry_t *rd_name_index_find_node(const char *name, u8_t len);
+
+/**
+ * Find an endpoint by name and location.
+ * \param location Location, NULL or empty for none.
+ */
+rd_ep_database_entry_t *rd_name_index_find_ep(const char *name, u8_t name_len,
+                                              const char *location,
+                                              u8_t loc_len);
+
+/**
+ * Find an endpoint by service name, "name.location" or "name".
+ */
+rd_ep_database_entry_t *rd_name_index_find_service(const char *service,
+                                                   u8_t len);
+
+#endif
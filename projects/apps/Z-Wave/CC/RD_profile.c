@@ -0,0 +1,293 @@
+/***************************************************************************/ /**
+ * @file RD_profile.c
+ * @brief Interview templates of device models
+ *******************************************************************************
+ * # License
+ * <b>Copyright 2025 Silicon Laboratories Inc. www.silabs.com</b>
+ *******************************************************************************
+ *
+ * The licensor of this software is Silicon Laboratories Inc. Your use of this
+ * software is governed by the terms of Silicon Labs Master Software License
+ * Agreement (MSLA) available at
+ * www.silabs.com/about-us/legal/master-software-license-agreement. This
+ * software is distributed to you in Source Code format and is governed by the
+ * sections of the MSLA applicable to Source Code.
+ *
+ ******************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include "sl_common_log.h"
+#include "RD_profile.h"
+#include "RD_name_index.h"
+#include "modules/sl_rd_data_store.h"
+#include "modules/sl_rd_record.h"
+#include "apps/ip_translate/sl_zw_resource.h"
+
+/*
+ * A profile object is a header followed by a template record of the node,
+ * see rd_record_template_encode():
+ *
+ *   format, manufacturer, product type, product ID, firmware version,
+ *   security flags
+ *
+ * 16 bit fields are little endian.
+ */
+#define RD_PROFILE_FORMAT  1
+#define RD_PROFILE_HDR_LEN 10
+
+/* Slot index, loaded by rd_profile_init(). */
+typedef struct {
+  rd_profile_id_t id;
+  uint8_t security_flags;
+  uint8_t used;
+  uint32_t last_use; /* Sequence number, for replacing the oldest */
+} rd_profile_slot_t;
+
+static rd_profile_slot_t slots[RD_PROFILE_MAX];
+static rd_profile_stats_t stats;
+static uint32_t use_seq;
+
+static void put_u16(uint8_t *p, uint16_t v)
+{
+  p[0] = v & 0xFF;
+  p[1] = v >> 8;
+}
+
+static uint16_t get_u16(const uint8_t *p)
+{
+  return p[0] | (p[1] << 8);
+}
+
+static bool same_model(const rd_profile_id_t *a, const rd_profile_id_t *b)
+{
+  return a->manufacturer == b->manufacturer
+         && a->product_type == b->product_type
+         && a->product_id == b->product_id;
+}
+
+static int find_slot(const rd_profile_id_t *id)
+{
+  for (int i = 0; i < RD_PROFILE_MAX; i++) {
+    if (slots[i].used && same_model(&slots[i].id, id)) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+static void drop_slot(int i)
+{
+  rd_data_store_profile_delete(i);
+  memset(&slots[i], 0, sizeof(slots[i]));
+}
+
+/* Endpoint 0 of the template must match the root node info found by the
+   probe of this node, all of it. A node info that is only a prefix of the
+   one of the template, or is missing, belongs to another model. */
+static bool root_matches(const rd_node_database_entry_t *n,
+                         const rd_node_database_entry_t *tpl)
+{
+  const rd_ep_database_entry_t *a = list_head(n->endpoints);
+  const rd_ep_database_entry_t *b = list_head(tpl->endpoints);
+
+  if (!a || !b || a->endpoint_id != 0 || b->endpoint_id != 0) {
+    return false;
+  }
+  if (!a->endpoint_info || !b->endpoint_info || a->endpoint_info_len == 0
+      || a->endpoint_info_len != b->endpoint_info_len) {
+    return false;
+  }
+  return memcmp(a->endpoint_info, b->endpoint_info, a->endpoint_info_len) == 0;
+}
+
+void rd_profile_init(void)
+{
+  uint8_t *buf;
+  size_t len;
+
+  memset(slots, 0, sizeof(slots));
+  for (int i = 0; i < RD_PROFILE_MAX; i++) {
+    buf = rd_data_store_profile_read(i, &len);
+    if (!buf) {
+      continue;
+    }
+    if (len > RD_PROFILE_HDR_LEN && buf[0] == RD_PROFILE_FORMAT) {
+      slots[i].id.manufacturer = get_u16(buf + 1);
+      slots[i].id.product_type = get_u16(buf + 3);
+      slots[i].id.product_id   = get_u16(buf + 5);
+      slots[i].id.fw_version   = get_u16(buf + 7);
+      slots[i].security_flags  = buf[9];
+      slots[i].used            = 1;
+    } else {
+      WRN_PRINTF("Dropping device profile %d of unknown format\n", i);
+      rd_data_store_profile_delete(i);
+    }
+    free(buf);
+  }
+}
+
+bool rd_profile_apply(rd_node_database_entry_t *n, const rd_profile_id_t *id)
+{
+  rd_node_database_entry_t *tpl;
+  rd_ep_database_entry_t *ep, *ep0;
+  uint8_t *buf;
+  size_t len;
+  int i = find_slot(id);
+
+  if (i < 0) {
+    stats.misses++;
+    return false;
+  }
+  if (slots[i].id.fw_version != id->fw_version) {
+    LOG_PRINTF("Device profile %04x:%04x:%04x is for firmware %d.%d, "
+               "node %d runs %d.%d\n",
+               id->manufacturer, id->product_type, id->product_id,
+               slots[i].id.fw_version >> 8, slots[i].id.fw_version & 0xFF,
+               n->nodeid, id->fw_version >> 8, id->fw_version & 0xFF);
+    drop_slot(i);
+    stats.invalidated++;
+    stats.misses++;
+    return false;
+  }
+  if (slots[i].security_flags != n->security_flags) {
+    stats.misses++;
+    return false;
+  }
+
+  buf = rd_data_store_profile_read(i, &len);
+  tpl = buf ? rd_record_decode(buf + RD_PROFILE_HDR_LEN,
+                               len - RD_PROFILE_HDR_LEN) : NULL;
+  free(buf);
+  if (!tpl) {
+    drop_slot(i);
+    stats.errors++;
+    stats.misses++;
+    return false;
+  }
+  ep0 = list_head(n->endpoints);
+  if (!root_matches(n, tpl)) {
+    rd_data_store_mem_release(tpl);
+    stats.misses++;
+    return false;
+  }
+
+  /* Drop the endpoints of an earlier interview, then move the ones of the
+     template over. Both come from the same pools. */
+  while (ep0->list) {
+    ep        = ep0->list;
+    ep0->list = ep->list;
+    rd_name_index_remove_ep(ep);
+    rd_store_mem_free_ep(ep);
+  }
+  n->nEndpoints = 1;
+  rd_store_mem_free_ep(list_pop(tpl->endpoints));
+  while ((ep = list_pop(tpl->endpoints)) != NULL) {
+    ep->node   = n;
+    ep->nodeID = n->nodeid;
+    /* Nothing left to ask, STATUS_PROBE_ENDPOINTS marks it done. */
+    ep->state = EP_STATE_MDNS_PROBE;
+    list_add(n->endpoints, ep);
+    n->nEndpoints++;
+  }
+  n->nAggEndpoints                 = tpl->nAggEndpoints;
+  n->node_version_cap_and_zwave_sw = tpl->node_version_cap_and_zwave_sw;
+  n->node_is_zws_probed            = tpl->node_is_zws_probed;
+  if (n->node_cc_versions && tpl->node_cc_versions
+      && n->node_cc_versions_len == tpl->node_cc_versions_len) {
+    memcpy(n->node_cc_versions, tpl->node_cc_versions,
+           n->node_cc_versions_len);
+  }
+  rd_data_store_mem_release(tpl);
+
+  slots[i].last_use = ++use_seq;
+  stats.hits++;
+  LOG_PRINTF("Node %d takes %d endpoints from device profile %04x:%04x:%04x\n",
+             n->nodeid, n->nEndpoints - 1,
+             id->manufacturer, id->product_type, id->product_id);
+  return true;
+}
+
+void rd_profile_store(const rd_node_database_entry_t *n,
+                      const rd_profile_id_t *id)
+{
+  uint32_t size, len;
+  uint8_t *buf;
+  int i = find_slot(id);
+
+  if (i < 0) {
+    /* A free slot, else the least recently used one */
+    i = 0;
+    for (int k = 0; k < RD_PROFILE_MAX; k++) {
+      if (!slots[k].used) {
+        i = k;
+        break;
+      }
+      if (slots[k].last_use < slots[i].last_use) {
+        i = k;
+      }
+    }
+  }
+
+  size = RD_PROFILE_HDR_LEN + rd_record_template_size(n);
+  if (size > RD_RECORD_MAX_SIZE) {
+    return;
+  }
+  buf = malloc(size);
+  if (!buf) {
+    LOG_PRINTF("Out of memory\n");
+    stats.errors++;
+    return;
+  }
+  buf[0] = RD_PROFILE_FORMAT;
+  put_u16(buf + 1, id->manufacturer);
+  put_u16(buf + 3, id->product_type);
+  put_u16(buf + 5, id->product_id);
+  put_u16(buf + 7, id->fw_version);
+  buf[9] = n->security_flags;
+  len    = rd_record_template_encode(n, buf + RD_PROFILE_HDR_LEN,
+                                     size - RD_PROFILE_HDR_LEN);
+  if (!len || !rd_data_store_profile_write(i, buf, RD_PROFILE_HDR_LEN + len)) {
+    free(buf);
+    stats.errors++;
+    return;
+  }
+  free(buf);
+
+  slots[i].id             = *id;
+  slots[i].security_flags = n->security_flags;
+  slots[i].used           = 1;
+  slots[i].last_use       = ++use_seq;
+  stats.stored++;
+  DBG_PRINTF("Stored device profile %04x:%04x:%04x in slot %d\n",
+             id->manufacturer, id->product_type, id->product_id, i);
+}
+
+void rd_profile_clear(void)
+{
+  for (int i = 0; i < RD_PROFILE_MAX; i++) {
+    if (slots[i].used) {
+      drop_slot(i);
+    }
+  }
+}
+
+void rd_profile_get_stats(rd_profile_stats_t *st)
+{
+  *st      = stats;
+  st->used = 0;
+  for (int i = 0; i < RD_PROFILE_MAX; i++) {
+    st->used += slots[i].used;
+  }
+}
+
+void rd_profile_print_stats(void)
+{
+  rd_profile_stats_t st;
+
+  rd_profile_get_stats(&st);
+  LOG_PRINTF("RD profiles: %d of %d used, %ld hits, %ld misses, %ld stored, "
+             "%ld invalidated, %ld errors\n",
+             st.used, RD_PROFILE_MAX, st.hits, st.misses, st.stored,
+             st.invalidated, st.errors);
+}
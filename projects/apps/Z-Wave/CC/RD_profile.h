@@ -0,0 +1,95 @@
+/***************************************************************************/ /**
+ * @file RD_profile.h
+ * @brief Interview templates of device models
+ *******************************************************************************
+ * # License
+ * <b>Copyright 2025 Silicon Laboratories Inc. www.silabs.com</b>
+ *******************************************************************************
+ *
+ * The licensor of this software is Silicon Laboratories Inc. Your use of this
+ * software is governed by the terms of Silicon Labs Master Software License
+ * Agreement (MSLA) available at
+ * www.silabs.com/about-us/legal/master-software-license-agreement. This
+ * software is distributed to you in Source Code format and is governed by the
+ * sections of the MSLA applicable to Source Code.
+ *
+ ******************************************************************************/
+
+#ifndef RD_PROFILE_H
+#define RD_PROFILE_H
+
+#include <stdbool.h>
+#include "RD_internal.h"
+
+/**
+ * \ingroup node_db
+ *
+ * Device profiles let a node skip the parts of its interview that are the
+ * same for every device of its model: the multi channel endpoints with
+ * their command classes, aggregations and icons, and the command class
+ * versions.
+ *
+ * A profile is keyed by manufacturer ID, product type and product ID, and
+ * holds the firmware version it was learned from. It is stored when an
+ * interview ends in #STATUS_DONE and used once the manufacturer specific
+ * and version reports of a new node are in. A profile learned from other
+ * firmware is deleted and learned again.
+ *
+ * A profile is only used for a node with the same security keys and the
+ * same root node info, so it never hides a difference the root probe
+ * found.
+ *
+ * Profiles are kept in NVM3, one object each, see
+ * rd_data_store_profile_read().
+ */
+
+/** Device models remembered. */
+#ifndef RD_PROFILE_MAX
+#define RD_PROFILE_MAX 16
+#endif
+
+/** Identity of a device model. */
+typedef struct {
+  uint16_t manufacturer;
+  uint16_t product_type;
+  uint16_t product_id;
+  uint16_t fw_version; /**< Application version, major in the high byte. */
+} rd_profile_id_t;
+
+typedef struct {
+  uint32_t hits;        /**< Interviews completed from a profile. */
+  uint32_t misses;      /**< Identified nodes without a usable profile. */
+  uint32_t stored;      /**< Profiles written. */
+  uint32_t invalidated; /**< Profiles deleted for a firmware change. */
+  uint32_t errors;      /**< Profiles that could not be read or written. */
+  uint8_t used;         /**< Slots holding a profile. */
+} rd_profile_stats_t;
+
+/** Learn which slots hold which models. Call after data_store_init(). */
+void rd_profile_init(void);
+
+/**
+ * Fill in the endpoints and command class versions of \p n from the
+ * profile of its model. Endpoints above 0 of \p n are replaced; the
+ * ones from the profile wait for #EP_STATE_MDNS_PROBE. Nothing is
+ * written, the interview stores \p n when it ends.
+ *
+ * \return true if \p n was filled in, false if the interview has to run.
+ */
+bool rd_profile_apply(rd_node_database_entry_t *n, const rd_profile_id_t *id);
+
+/**
+ * Store what the interview of \p n found as the profile of its model,
+ * replacing an older profile of that model or the least recently used one.
+ */
+void rd_profile_store(const rd_node_database_entry_t *n,
+                      const rd_profile_id_t *id);
+
+/** Delete all profiles. */
+void rd_profile_clear(void);
+
+void rd_profile_get_stats(rd_profile_stats_t *stats);
+
+void rd_profile_print_stats(void);
+
+#endif
@@ -16,6 +16,7 @@
  ******************************************************************************/
 
 #include "stddef.h"
+#include <stdlib.h>
 #include "sl_common_log.h"
 #include "lib/list.h"
 #include "lib/memb.h"
@@ -122,7 +123,13 @@ static const char *ip_assoc_type2str(ip_assoc_type_t type);
  */
 
 LIST(ip_association_table);
-MEMB(ip_association_pool, ip_association_t, MAX_IP_ASSOCIATIONS);
+/* Same as MEMB(), but the blocks are allocated in the PSRAM arena by
+ * ip_assoc_init(). */
+static char ip_association_pool_memb_count[MAX_IP_ASSOCIATIONS];
+static struct memb ip_association_pool = { sizeof(ip_association_t),
+                                           MAX_IP_ASSOCIATIONS,
+                                           ip_association_pool_memb_count,
+                                           NULL };
 
 /* ZW_AssignReturnRoute() does not support passing a user parameter to the
  * provided callback function. The following global variable is used instead. */
@@ -153,6 +160,19 @@ static struct {
  */
 void ip_assoc_init(void)
 {
+  const uint32_t pool_size = sizeof(ip_association_t) * MAX_IP_ASSOCIATIONS;
+
+  if (ip_association_pool.mem == NULL) {
+    ip_association_pool.mem = sl_psram_arena_alloc(SL_PSRAM_POOL_IP_ASSOC,
+                                                   pool_size);
+  }
+  if (ip_association_pool.mem == NULL) {
+    ip_association_pool.mem = malloc(pool_size);
+  }
+  if (ip_association_pool.mem == NULL) {
+    ERR_PRINTF("No memory for the IP association table\n");
+    ip_association_pool.num = 0;
+  }
   list_init(ip_association_table);
   memb_init(&ip_association_pool);
 
@@ -459,6 +479,7 @@ static void sli_handle_ip_association_set(zwave_connection_t *c,
   u8_t assoc_dest_ep;
   nodeid_t dest_nodeid;
   rd_ep_database_entry_t *ep;
+  int ok;
 
   uint8_t pData[len];
   memcpy(pData, payload, len);
@@ -479,7 +500,9 @@ static void sli_handle_ip_association_set(zwave_connection_t *c,
   }
 
   if (is_local_address(assoc_dest_ip)) {
-    if (sli_hndle_ip_asso_multi(assoc_dest_ep, c, ep, dest_nodeid) == 0) {
+    ok = sli_hndle_ip_asso_multi(assoc_dest_ep, c, ep, dest_nodeid);
+    rd_free_ep(ep);
+    if (ok == 0) {
       goto abort;
     }
 
@@ -490,7 +513,9 @@ static void sli_handle_ip_association_set(zwave_connection_t *c,
                                      assoc_dest_ip,
                                      dest_nodeid);
   } else { /* if (is_local_address(assoc_dest_ip)) */
-    if (sli_handle_ip_asso_rd_class(c, payload, len, was_dtls, ep) == 0) {
+    ok = sli_handle_ip_asso_rd_class(c, payload, len, was_dtls, ep);
+    rd_free_ep(ep);
+    if (ok == 0) {
       goto abort;
     }
   }
@@ -1290,7 +1315,7 @@ static void send_ip_association_cmd(ip_association_t *a,
                                     nodeid_t dest_nodeid,
                                     uint16_t len)
 {
-  /* Send the association frame in classic_txBuf on the radio.
+  /* Send the association frame in ClassicZIPNode_getTXBuf() on the radio.
    * When callback comes back, setup return routes.
    * When that callback comes, send off ZIP_ACK. */
 
@@ -36,48 +36,170 @@
 
 #include "sl_bridge_ip_assoc.h"
 #include "sl_bridge_temp_assoc.h"
+#include "sl_state_cache.h"
+#include "sl_shared_get.h"
+#include "sl_mailbox.h"
+#include "Z-Wave/CC/CC_NetworkManagement.h"
+#include "Net/sl_udp_utils.h"
+#include "modules/sl_block_pool.h"
+#include "cmsis_os2.h"
 
 #define MANGLE_MAGIC 0x55AA
 
 #define MAX_CLASSIC_SESSIONS ZW_MAX_NODES /* Only used for non-bridge libraries */
+#ifndef CLASSIC_ZIP_SESSIONS
+#define CLASSIC_ZIP_SESSIONS 4 /* Z/IP requests handled at the same time */
+#endif
 #define FAIL_TIMEOUT_TEMP_ASSOC 2000 /* Time to wait for ZW_SendData() callback on unsolicited,
                                       * incoming frames before we give up. */
 /* 10 sec delay, from SDS11402 */
 #define CLASSIC_SESSION_TIMEOUT 65000UL
+/* Largest Z-Wave command of a Z/IP request */
+#define CLASSIC_TX_BUF_SIZE (UIP_MAX_FRAME_BYTES - UIP_IPUDPH_LEN)
 
 /* 10 sec delay, from SDS11402 */
 const BYTE ZW_NOP[] =
 { 0 };
 
-uint8_t backup_buf[UIP_MAX_FRAME_BYTES];
-uint16_t backup_len;
-uint8_t is_device_reset_locally = 0;
-uint16_t zip_payload_len;
+/*
+ * One Z/IP request to a classic node, from ClassicZIPNode_input() until its
+ * completion callback. Holds everything needed to send the ZIP ACK/NACK in
+ * the ZW_SendData callback, so requests to different nodes can overlap.
+ */
+typedef struct {
+  bool in_use;
+  bool exclusive;               /* IP association, no other session may start */
+  uint8_t gen;                  /* Tells stale callbacks from a reused slot */
+  sl_tcpip_buf_t *pkt;          /* The request, one reference held */
+  zwave_connection_t zwc;       /* Reply connection, seq and header extensions */
+  BYTE flags0;
+  BYTE flags1;
+  uint16_t payload_len;
+  uint8_t is_device_reset_locally;
+  bool from_mailbox;            /* Taken back from the mailbox, send it now */
+  uint8_t send_handle;          /* ClassicZIPNode_SendDataAppl() handle */
+  nodeid_t dest_nodeid;
+  ip_association_t *proxy_assoc;
+  uint32_t deadline;            /* Kernel tick of CLASSIC_SESSION_TIMEOUT */
+  sl_sleeptimer_timer_handle_t nak_wait_timer;
+  VOID_CALLBACKFUNC(completed)(BYTE, BYTE * data, uint16_t len, void *user);
+  void *user;
+  uint8_t tx_options;           /* ClassicZIPNode_setTXOptions() */
+  BOOL send_nack;               /* ClassicZIPNode_sendNACK() */
+  uint8_t *txBuf;               /* Block pool, only while the frame is sent */
+} sli_czn_session_t;
+
+static sli_czn_session_t sli_czn_sessions[CLASSIC_ZIP_SESSIONS];
+/* Session of the code running now, set around session callbacks. */
+static sli_czn_session_t *sli_czn_cur;
+/* Session owning the IP association state, its callbacks carry no session. */
+static sli_czn_session_t *sli_czn_exclusive;
+
+/* Transmit options new sessions start with. */
+static uint8_t sli_czn_tx_options;
 
-static uint8_t classic_txBuf[UIP_MAX_FRAME_BYTES - UIP_IPUDPH_LEN];/*NOTE: the local txBuf is ok here, because the frame is sent via the SerialAPI*/
+/*
+ * Frames built by the IP association code with ClassicZIPNode_getTXBuf().
+ * That code runs for one request at a time, the exclusive session, and
+ * from its own callbacks, so one buffer serves it.
+ */
+static uint8_t sli_czn_assoc_buf[CLASSIC_TX_BUF_SIZE];
 
-static uint8_t txOpts;
+static BOOL
+proxy_command_handler(zwave_connection_t* c, const uint8_t* payload, uint8_t len, BOOL was_dtls, BOOL ack_req, uint8_t bSupervisionUnwrapped);
 
-static BOOL bSendNAck;
+static int
+LogicalRewriteAndSend();
 
-sl_sleeptimer_timer_handle_t nak_wait_timer;
+static void
+send_using_temp_assoc_callback(BYTE bStatus, void* user, TX_STATUS_TYPE *t);
 
-/* Place holders for parameters needed to send ACK, in the ZW_SendData callback */
+/* Session the current-session API acts on, NULL outside any request. */
+static sli_czn_session_t *sli_czn_current(void)
+{
+  if (sli_czn_cur) {
+    return sli_czn_cur;
+  }
+  return sli_czn_exclusive;
+}
 
-zwave_connection_t sl_zwc;
+/* Session reference for callback user pointers: slot and generation. */
+static void *sli_czn_to_user(sli_czn_session_t *s)
+{
+  if (s < sli_czn_sessions || s >= &sli_czn_sessions[CLASSIC_ZIP_SESSIONS]) {
+    return NULL;
+  }
+  return (void *) (intptr_t) (((s - sli_czn_sessions) << 8) | s->gen);
+}
 
-static BYTE cur_flags0;
-static BYTE cur_flags1;
+static sli_czn_session_t *sli_czn_from_user(void *user)
+{
+  uintptr_t v = (uintptr_t) user;
+  uintptr_t idx = v >> 8;
 
-static uint8_t cur_SendDataAppl_handle;
+  if (idx >= CLASSIC_ZIP_SESSIONS || !sli_czn_sessions[idx].in_use
+      || sli_czn_sessions[idx].gen != (uint8_t) v) {
+    return NULL;
+  }
+  return &sli_czn_sessions[idx];
+}
 
-static VOID_CALLBACKFUNC(cbCompletedFunc)(BYTE, BYTE * data, uint16_t len);
+/* What sli_czn_enter() replaced. */
+typedef struct {
+  sl_tcpip_buf_t *pkt;
+  sli_czn_session_t *cur;
+} sli_czn_ctx_t;
 
-static BOOL
-proxy_command_handler(zwave_connection_t* c, const uint8_t* payload, uint8_t len, BOOL was_dtls, BOOL ack_req, uint8_t bSupervisionUnwrapped);
+/*
+ * Run code on behalf of s from an asynchronous callback. The current packet
+ * macros (sl_uip_buf_*) are pointed at the request of s meanwhile.
+ */
+static sli_czn_ctx_t sli_czn_enter(sli_czn_session_t *s)
+{
+  sli_czn_ctx_t prev = { .pkt = bkp_pkt, .cur = sli_czn_cur };
 
-static int
-LogicalRewriteAndSend();
+  sl_tcpip_buf_hold(prev.pkt);
+  sl_backup_pkt_set(s->pkt);
+  sli_czn_cur = s;
+  return prev;
+}
+
+static void sli_czn_leave(sli_czn_ctx_t prev)
+{
+  sli_czn_cur = prev.cur;
+  sl_backup_pkt_set(prev.pkt);
+  sl_tcpip_buf_release(prev.pkt);
+}
+
+static void sli_czn_txbuf_release(sli_czn_session_t *s)
+{
+  sl_block_pool_free(s->txBuf);
+  s->txBuf = NULL;
+}
+
+static void sli_czn_free(sli_czn_session_t *s)
+{
+  void *followers[SL_SHARED_GET_FOLLOWERS];
+  int n;
+
+  /* A shared Get ending without its transmit result fails its followers. */
+  n = sl_shared_get_sent(sli_czn_to_user(s), false, followers,
+                         SL_SHARED_GET_FOLLOWERS);
+  sl_sleeptimer_stop_timer(&s->nak_wait_timer);
+  sli_czn_txbuf_release(s);
+  sl_tcpip_buf_release(s->pkt);
+  s->pkt = NULL;
+  s->in_use = false;
+  if (sli_czn_exclusive == s) {
+    sli_czn_exclusive = NULL;
+  }
+  if (sli_czn_cur == s) {
+    sli_czn_cur = NULL;
+  }
+  for (int i = 0; i < n; i++) {
+    send_using_temp_assoc_callback(TRANSMIT_COMPLETE_FAIL, followers[i], NULL);
+  }
+}
 
 /**
  * Wrapper for sl_zw_send_data_appl() that saves result to private handle in ClassicZipNode module.
@@ -90,33 +212,48 @@ uint8_t ClassicZIPNode_SendDataAppl(ts_param_t* p,
                                     ZW_SendDataAppl_Callback_t callback,
                                     void* user)
 {
-  cur_SendDataAppl_handle = sl_zw_send_data_appl(p, pData, dataLength, callback, user);
-  return cur_SendDataAppl_handle;
+  sli_czn_session_t *s = sli_czn_current();
+  uint8_t h;
+
+  h = sl_zw_send_data_appl(p, pData, dataLength, callback, user);
+  if (s) {
+    s->send_handle = h;
+  }
+  return h;
 }
 
 void
 ClassicZIPNode_CallSendCompleted_cb(BYTE bStatus, void* usr, TX_STATUS_TYPE *t)
 {
-  (void) usr;
   (void) t;
-  uint16_t l;
-  VOID_CALLBACKFUNC(tmp_cbCompletedFunc)(BYTE, BYTE * data, uint16_t len);
+  sli_czn_session_t *s = sli_czn_from_user(usr);
+  VOID_CALLBACKFUNC(completed)(BYTE, BYTE * data, uint16_t len, void *user);
+  sl_tcpip_buf_t *pkt;
+  void *user;
 
-  l = bkp_zip_len;
-  backup_len = 0;
-  cur_SendDataAppl_handle = 0;
-  tmp_cbCompletedFunc = cbCompletedFunc;
-  cbCompletedFunc = NULL;
-  if (tmp_cbCompletedFunc) {
-    tmp_cbCompletedFunc(bStatus, (BYTE*)bkp_zip, l);
+  if (s == NULL || !s->in_use) {
+    return;
   }
+  completed = s->completed;
+  user = s->user;
+  pkt = s->pkt;
+  // Keep the request readable by the callback, the session is freed first.
+  sl_tcpip_buf_hold(pkt);
+  sli_czn_free(s);
+  if (completed) {
+    completed(bStatus, (BYTE*)pkt->zip_data, pkt->zip_data_len, user);
+  }
+  sl_tcpip_buf_release(pkt);
 }
 
 void
 report_send_completed(uint8_t bStatus)
 {
-  ClassicZIPNode_CallSendCompleted_cb(bStatus, NULL, NULL);
-  sl_sleeptimer_stop_timer(&nak_wait_timer);
+  sli_czn_session_t *s = sli_czn_current();
+
+  if (s && s->in_use) {
+    ClassicZIPNode_CallSendCompleted_cb(bStatus, sli_czn_to_user(s), NULL);
+  }
 }
 
 /**
@@ -151,6 +288,7 @@ void SendUDPStatus_rssi(int flags0, int flags1, zwave_connection_t *c, TX_STATUS
 
   len += 2; /* 2 bytes for EFI */
 
+  sl_zip_replay_record(c, flags0, flags1);
   udp_send_wrap(&c->conn, (const uint8_t*)zip, len, 0, 0);
 }
 
@@ -169,8 +307,11 @@ void SendUDPStatus(int flags0, int flags1, zwave_connection_t *c)
 static void
 nak_wait_timeout(void* user)
 {
-  (void) user;
-  SendUDPStatus(ZIP_PACKET_FLAGS0_NACK_WAIT | ZIP_PACKET_FLAGS0_NACK_RES, cur_flags1, &sl_zwc);
+  sli_czn_session_t *s = sli_czn_from_user(user);
+
+  if (s && s->in_use) {
+    SendUDPStatus(ZIP_PACKET_FLAGS0_NACK_WAIT | ZIP_PACKET_FLAGS0_NACK_RES, s->flags1, &s->zwc);
+  }
 }
 
 void sl_nak_timer_timeout(sl_sleeptimer_timer_handle_t *t, void *u)
@@ -185,7 +326,7 @@ void sl_nak_timer_timeout(sl_sleeptimer_timer_handle_t *t, void *u)
  * Send a ZIP Ack/Nack
  *
  * @param bStatus Transmission status
- * @param user HAN node id of destination node
+ * @param user Session reference, see sli_czn_to_user()
  * @param t pointer to TX status
  * @param is_mcast TRUE if ClassicZIPNode_SendDataAppl() was sending a multicast
  *                 frame, FALSE otherwise
@@ -193,11 +334,21 @@ void sl_nak_timer_timeout(sl_sleeptimer_timer_handle_t *t, void *u)
 static void
 send_using_temp_assoc_callback_ex(BYTE bStatus, void *user, TX_STATUS_TYPE *t, BOOL is_mcast)
 {
-  /* NB: The "user" pointer is NOT pointing to a memory location with the node
-   * id. The actual pointer value IS the node id (saves us from creating a
-   * static/global variable to hold the node id).
-   */
-  nodeid_t dest_nodeid = (nodeid_t) (intptr_t) user;
+  sli_czn_session_t *s = sli_czn_from_user(user);
+  void *followers[SL_SHARED_GET_FOLLOWERS];
+  sli_czn_ctx_t prev;
+  int n;
+
+  if (s == NULL) {
+    /* Session expired, the request was already answered. */
+    return;
+  }
+  s->send_handle = 0;
+  /* Requests sharing this Get take its result. */
+  n = sl_shared_get_sent(user, bStatus == TRANSMIT_COMPLETE_OK,
+                         followers, SL_SHARED_GET_FOLLOWERS);
+  nodeid_t dest_nodeid = s->dest_nodeid;
+  prev = sli_czn_enter(s);
 
   DBG_PRINTF("send_using_temp_assoc_callback_ex for node %d status %u\n", dest_nodeid, bStatus);
 
@@ -205,10 +356,10 @@ send_using_temp_assoc_callback_ex(BYTE bStatus, void *user, TX_STATUS_TYPE *t, B
     /* Do not send an ACK/NACK because the frame will be re-queued in the long queue*/
   } else {
     /* Only send ACK if it has been requested */
-    if ( (cur_flags0 & ZIP_PACKET_FLAGS0_ACK_REQ) ) {
+    if ( (s->flags0 & ZIP_PACKET_FLAGS0_ACK_REQ) ) {
       int flags0 = (bStatus == TRANSMIT_COMPLETE_OK) ? ZIP_PACKET_FLAGS0_ACK_RES
                    : ZIP_PACKET_FLAGS0_NACK_RES;
-      SendUDPStatus_rssi(flags0, cur_flags1, &sl_zwc, t, is_mcast);
+      SendUDPStatus_rssi(flags0, s->flags1, &s->zwc, t, is_mcast);
     }
 
     if (bStatus == TRANSMIT_COMPLETE_OK) {
@@ -219,6 +370,11 @@ send_using_temp_assoc_callback_ex(BYTE bStatus, void *user, TX_STATUS_TYPE *t, B
   }
 
   report_send_completed(bStatus);
+  sli_czn_leave(prev);
+
+  for (int i = 0; i < n; i++) {
+    send_using_temp_assoc_callback_ex(bStatus, followers[i], t, is_mcast);
+  }
 }
 
 /* Callback from send_using_temp_assoc on single-cast frame */
@@ -235,14 +391,23 @@ static void
 forward_to_ip_assoc_proxy_callback(BYTE bStatus, void* user, TX_STATUS_TYPE *t)
 {
   (void) t;
-  ip_association_t *a = (ip_association_t*)user;
+  sli_czn_session_t *s = sli_czn_from_user(user);
+  sli_czn_ctx_t prev;
+
+  if (s == NULL) {
+    return;
+  }
+  s->send_handle = 0;
+  ip_association_t *a = s->proxy_assoc;
   DBG_PRINTF("forward_to_ip_assoc_proxy_callback status %u, node %u\n", bStatus, a->han_nodeid);
 
   if (bStatus == TRANSMIT_COMPLETE_OK) {
     rd_node_is_alive(a->han_nodeid);
   }
 
+  prev = sli_czn_enter(s);
   report_send_completed(bStatus);
+  sli_czn_leave(prev);
 }
 
 /**
@@ -255,20 +420,26 @@ forward_to_ip_assoc_proxy_callback(BYTE bStatus, void* user, TX_STATUS_TYPE *t)
 void
 send_zip_ack(uint8_t bStatus)
 {
+  sli_czn_session_t *s = sli_czn_current();
+
+  if (s == NULL || !s->in_use) {
+    return;
+  }
   if (bStatus == TRANSMIT_COMPLETE_OK) {
-    SendUDPStatus(ZIP_PACKET_FLAGS0_ACK_RES, cur_flags1, &sl_zwc);
-  } else if (bSendNAck) {
-    SendUDPStatus(ZIP_PACKET_FLAGS0_NACK_RES, cur_flags1, &sl_zwc);
+    SendUDPStatus(ZIP_PACKET_FLAGS0_ACK_RES, s->flags1, &s->zwc);
+  } else if (s->send_nack) {
+    SendUDPStatus(ZIP_PACKET_FLAGS0_NACK_RES, s->flags1, &s->zwc);
   }
 }
 
 /**
- * Send frame in classic_txBuf using temporary association virtual node
+ * Send frame in the session txBuf using temporary association virtual node
  *
+ * @param s session of the request
  * @param a temporary association to use
  */
 static void
-send_using_temp_assoc(temp_association_t *a)
+send_using_temp_assoc(sli_czn_session_t *s, temp_association_t *a)
 {
   /* Extract the Z-Wave destination nodeid and endpoint */
   nodeid_t han_nodeid = sl_node_of_ip(&(sl_uip_buf_dst_addr()));
@@ -278,32 +449,55 @@ send_using_temp_assoc(temp_association_t *a)
   uint8_t h = 0;
 
   ts_set_std(&p, han_nodeid);
-  p.tx_flags = ClassicZIPNode_getTXOptions();
-  p.is_mcast_with_folloup = cur_flags0 & ZIP_PACKET_FLAGS0_ACK_REQ ? TRUE : FALSE;
+  p.tx_flags = s->tx_options;
+  p.is_mcast_with_folloup = s->flags0 & ZIP_PACKET_FLAGS0_ACK_REQ ? TRUE : FALSE;
   p.dendpoint = han_endpoint;
-  p.sendpoint = sl_zwc.rendpoint;
-  if (is_device_reset_locally) {
+  p.sendpoint = s->zwc.rendpoint;
+  if (s->is_device_reset_locally) {
     p.snode = MyNodeID;
   } else {
     p.snode = a->virtual_id;
   }
-  p.scheme = sl_zwc.scheme;
+  p.scheme = s->zwc.scheme;
+  s->dest_nodeid = han_nodeid;
   LOG_PRINTF("send_using_temp_assoc info: d_ed=%d, s_ed=%d, sch=%d\n", p.dendpoint, p.sendpoint, p.scheme);
 
+  /* Another client is polling the node with the same Get, take its report. */
+  temp_association_t client = *a;
+  client.resource_endpoint = s->zwc.rendpoint;
+  switch (sl_shared_get_begin(han_nodeid, han_endpoint, p.scheme, p.snode,
+                              &client, s->txBuf, s->payload_len,
+                              sli_czn_to_user(s))) {
+    case SL_SHARED_GET_FOLLOW:
+      sli_czn_txbuf_release(s);
+      nak_wait_timeout(sli_czn_to_user(s));
+      return;
+    case SL_SHARED_GET_SENT:
+      sli_czn_txbuf_release(s);
+      send_using_temp_assoc_callback(TRANSMIT_COMPLETE_OK,
+                                     sli_czn_to_user(s),
+                                     NULL);
+      return;
+    default:
+      break;
+  }
+
   h = ClassicZIPNode_SendDataAppl(&p,
-                                  classic_txBuf,
-                                  zip_payload_len,
+                                  s->txBuf,
+                                  s->payload_len,
                                   send_using_temp_assoc_callback,
-                                  (void *) (intptr_t) han_nodeid);
+                                  sli_czn_to_user(s));
+  /* The frame was copied to its frame buffer. */
+  sli_czn_txbuf_release(s);
 
   if (h) {
     // just call immediately
     LOG_PRINTF("Send ack/nack immediately\n");
-    sl_nak_timer_timeout(NULL, NULL);
+    nak_wait_timeout(sli_czn_to_user(s));
   } else {
     ERR_PRINTF("sl_zw_send_data_appl() failed\n");
     send_using_temp_assoc_callback(TRANSMIT_COMPLETE_FAIL,
-                                   (void *) (intptr_t) han_nodeid,
+                                   sli_czn_to_user(s),
                                    NULL);
   }
 }
@@ -314,6 +508,7 @@ send_using_temp_assoc(temp_association_t *a)
 static uint8_t
 handle_version(const uint8_t* payload, uint8_t len, BOOL ack_req)
 {
+  sli_czn_session_t *s = sli_czn_current();
   int the_version;
   ZW_VERSION_COMMAND_CLASS_REPORT_FRAME f;
 
@@ -343,7 +538,7 @@ handle_version(const uint8_t* payload, uint8_t len, BOOL ack_req)
     if (the_version) {
       /*Send ACK first*/
       if (ack_req) {
-        SendUDPStatus(ZIP_PACKET_FLAGS0_ACK_RES, cur_flags1, &sl_zwc);
+        SendUDPStatus(ZIP_PACKET_FLAGS0_ACK_RES, s->flags1, &s->zwc);
       }
 
       f.cmdClass = COMMAND_CLASS_VERSION;
@@ -351,7 +546,9 @@ handle_version(const uint8_t* payload, uint8_t len, BOOL ack_req)
       f.requestedCommandClass = payload[2];
       f.commandClassVersion = the_version;
 
-      sl_zw_send_zip_data(&sl_zwc, &f, sizeof(f), ClassicZIPNode_CallSendCompleted_cb);
+      sl_zw_send_zip_data_user(&s->zwc, &f, sizeof(f),
+                               ClassicZIPNode_CallSendCompleted_cb,
+                               sli_czn_to_user(s));
       return TRUE;
     }
   }
@@ -374,7 +571,9 @@ proxy_supervision_command_handler(zwave_connection_t* c, const uint8_t* payload,
       rep.status = SUPERVISION_REPORT_SUCCESS;
       rep.duration = 0;
 
-      sl_zw_send_zip_data(c, &rep, sizeof(rep), ClassicZIPNode_CallSendCompleted_cb);
+      sl_zw_send_zip_data_user(c, &rep, sizeof(rep),
+                               ClassicZIPNode_CallSendCompleted_cb,
+                               sli_czn_to_user(sli_czn_current()));
       return TRUE;
     }
   }
@@ -390,17 +589,21 @@ static BOOL
 proxy_command_handler(zwave_connection_t* c, const uint8_t* payload, uint8_t len, BOOL was_dtls, BOOL ack_req, uint8_t bSupervisionUnwrapped)
 {
   (void) bSupervisionUnwrapped;
+  sli_czn_session_t *s = sli_czn_current();
   zwave_connection_t tc = *c;
   tc.scheme = SECURITY_SCHEME_UDP;
   switch (payload[0]) {
     case COMMAND_CLASS_IP_ASSOCIATION:
+      /* The IP association code keeps its state in globals. */
+      s->exclusive = true;
+      sli_czn_exclusive = s;
       if (ack_req) {
-        sl_sleeptimer_start_timer_ms(&nak_wait_timer, 150, sl_nak_timer_timeout, NULL, 1, 0);
+        sl_sleeptimer_start_timer_ms(&s->nak_wait_timer, 150, sl_nak_timer_timeout, sli_czn_to_user(s), 1, 0);
       }
-      return handle_ip_association(&tc, payload, zip_payload_len, was_dtls);
+      return handle_ip_association(&tc, payload, s->payload_len, was_dtls);
 
     case COMMAND_CLASS_VERSION:
-      return handle_version(payload, zip_payload_len, ack_req);
+      return handle_version(payload, s->payload_len, ack_req);
     case COMMAND_CLASS_SUPERVISION:
       return proxy_supervision_command_handler(&tc, payload, len, was_dtls, ack_req);
     default:
@@ -410,7 +613,7 @@ proxy_command_handler(zwave_connection_t* c, const uint8_t* payload, uint8_t len
 
 static int sli_zipudp_drop_frame(zwave_connection_t* c, uint8_t flags1)
 {
-  if (ZIP_PKT_BUF->flags0 & ZIP_PACKET_FLAGS0_ACK_REQ) {
+  if (sli_czn_current()->flags0 & ZIP_PACKET_FLAGS0_ACK_REQ) {
     SendUDPStatus(ZIP_PACKET_FLAGS0_NACK_RES, flags1, c);
   }
   report_send_completed(TRANSMIT_COMPLETE_ERROR);
@@ -419,10 +622,9 @@ static int sli_zipudp_drop_frame(zwave_connection_t* c, uint8_t flags1)
 
 static int sli_zipudp_error_frame(zwave_connection_t* c, uint8_t flags1)
 {
-  (void) c;
   ERR_PRINTF("Option error\n");
-  if (ZIP_PKT_BUF->flags0 & ZIP_PACKET_FLAGS0_ACK_REQ) {
-    SendUDPStatus(ZIP_PACKET_FLAGS0_NACK_RES | ZIP_PACKET_FLAGS0_NACK_OERR, flags1, &sl_zwc);
+  if (sli_czn_current()->flags0 & ZIP_PACKET_FLAGS0_ACK_REQ) {
+    SendUDPStatus(ZIP_PACKET_FLAGS0_NACK_RES | ZIP_PACKET_FLAGS0_NACK_OERR, flags1, c);
   }
   report_send_completed(TRANSMIT_COMPLETE_ERROR);
   return TRUE;
@@ -431,11 +633,12 @@ static int sli_zipudp_error_frame(zwave_connection_t* c, uint8_t flags1)
 static int sli_zipudp_association_process(zwave_connection_t lzw, ZW_COMMAND_ZIP_PACKET *zip_ptk, uint8_t flags1)
 {
   (void) flags1; // Unused parameter, but needed for function signature
+  sli_czn_session_t *s = sli_czn_current();
   /* Do not set source node as virtual node if its COMMAND_CLASS_DEVICE_RESET_LOCALLY */
   if (zip_ptk->payload[0] == COMMAND_CLASS_DEVICE_RESET_LOCALLY) {
-    is_device_reset_locally = 1;
+    s->is_device_reset_locally = 1;
   } else {
-    is_device_reset_locally = 0;
+    s->is_device_reset_locally = 0;
   }
   ip_association_t *ia = NULL;
 
@@ -453,19 +656,20 @@ static int sli_zipudp_association_process(zwave_connection_t lzw, ZW_COMMAND_ZIP
     ASSERT(ia->type == PROXY_IP_ASSOC);
     ts_param_t p;
     ts_set_std(&p, node_id);
-    p.tx_flags = ClassicZIPNode_getTXOptions();
+    p.tx_flags = s->tx_options;
     p.dendpoint = ia->resource_endpoint;
     ASSERT(uip_ipaddr_prefixcmp(&lzw.lipaddr, &ia->resource_ip, 128));
     ASSERT(p.dnode);
-    if (is_device_reset_locally) {
+    if (s->is_device_reset_locally) {
       p.snode = MyNodeID;
     } else {
       p.snode = ia->virtual_id;
     }
     p.scheme = lzw.scheme;
+    s->proxy_assoc = ia;
 
-    if (!ClassicZIPNode_SendDataAppl(&p, (BYTE*) &zip_ptk->payload, zip_payload_len,
-                                     forward_to_ip_assoc_proxy_callback, ia)) {
+    if (!ClassicZIPNode_SendDataAppl(&p, (BYTE*) &zip_ptk->payload, s->payload_len,
+                                     forward_to_ip_assoc_proxy_callback, sli_czn_to_user(s))) {
       WRN_PRINTF("ClassicZIPNode_SendDataAppl failed on case2 IP Assoc proxying\n");
     }
     return TRUE;
@@ -473,15 +677,23 @@ static int sli_zipudp_association_process(zwave_connection_t lzw, ZW_COMMAND_ZIP
   return FALSE;
 }
 
-static int sli_zipudp_temp_association_process(uint8_t *payload, BOOL secure)
+static int sli_zipudp_temp_association_process(sli_czn_session_t *s,
+                                               uint8_t *payload,
+                                               BOOL secure)
 {
-  memcpy(classic_txBuf, payload, zip_payload_len);
+  /* Held until the frame is handed to sl_zw_send_data_appl(). */
+  s->txBuf = sl_block_pool_alloc(s->payload_len);
+  if (s->txBuf == NULL) {
+    ERR_PRINTF("No buffer for a frame to node %d\n", s->dest_nodeid);
+    return sli_zipudp_drop_frame(&s->zwc, s->flags1);
+  }
+  memcpy(s->txBuf, payload, s->payload_len);
 
   /* If we get this far it's time to create a temporary association */
 
   temp_association_t *ta = temp_assoc_create(secure);
   if (ta) {
-    send_using_temp_assoc(ta);
+    send_using_temp_assoc(s, ta);
 
     /* Check if it's firmware update md get or report */
     if ((payload[0] == COMMAND_CLASS_FIRMWARE_UPDATE_MD)
@@ -492,6 +704,7 @@ static int sli_zipudp_temp_association_process(uint8_t *payload, BOOL secure)
     /* Malloc or create virtual failed, abort */
     ASSERT(0);
     ERR_PRINTF("Temporary association creation failed");
+    sli_czn_txbuf_release(s);
     send_zip_ack(TRANSMIT_COMPLETE_ERROR);
     report_send_completed(TRANSMIT_COMPLETE_ERROR);
   }
@@ -501,19 +714,21 @@ static int sli_zipudp_temp_association_process(uint8_t *payload, BOOL secure)
 static int sli_zipudp_class_process(struct uip_udp_conn* c, uint8_t* pktdata, uint16_t len, BOOL secure)
 {
   ZW_COMMAND_ZIP_PACKET* zip_ptk = (ZW_COMMAND_ZIP_PACKET*)pktdata;
+  sli_czn_session_t *s = sli_czn_current();
+  zwave_connection_t *zwc = &s->zwc;
   BYTE* payload;
 
-  zip_payload_len = len - ZIP_HEADER_SIZE;
+  s->payload_len = len - ZIP_HEADER_SIZE;
   payload = &zip_ptk->payload[0];
 
-  cur_flags0 = zip_ptk->flags0;
-  cur_flags1 = zip_ptk->flags1;// secure ? ZIP_PACKET_FLAGS1_SECURE_ORIGIN : 0;
-  sl_zwc.conn = *c;
-  sl_zwc.seq = zip_ptk->seqNo;
-  sl_zwc.lendpoint = zip_ptk->dEndpoint;
-  sl_zwc.rendpoint = zip_ptk->sEndpoint;
-  sl_zwc.scheme = (zip_ptk->flags1 & ZIP_PACKET_FLAGS1_SECURE_ORIGIN) ? AUTO_SCHEME  : NO_SCHEME;
-  LOG_PRINTF("info: d_ed=%d, s_ed=%d, sch=%d\n", sl_zwc.lendpoint, sl_zwc.rendpoint, sl_zwc.scheme);
+  s->flags0 = zip_ptk->flags0;
+  s->flags1 = zip_ptk->flags1;// secure ? ZIP_PACKET_FLAGS1_SECURE_ORIGIN : 0;
+  zwc->conn = *c;
+  zwc->seq = zip_ptk->seqNo;
+  zwc->lendpoint = zip_ptk->dEndpoint;
+  zwc->rendpoint = zip_ptk->sEndpoint;
+  zwc->scheme = (zip_ptk->flags1 & ZIP_PACKET_FLAGS1_SECURE_ORIGIN) ? AUTO_SCHEME  : NO_SCHEME;
+  LOG_PRINTF("info: d_ed=%d, s_ed=%d, sch=%d\n", zwc->lendpoint, zwc->rendpoint, zwc->scheme);
 
   /*
    * This is an ACK for a previously sent command
@@ -527,62 +742,78 @@ static int sli_zipudp_class_process(struct uip_udp_conn* c, uint8_t* pktdata, ui
   if (zip_ptk->flags1 & ZIP_PACKET_FLAGS1_HDR_EXT_INCL) {
     uint16_t ext_hdr_size = 0;
 
-    if ( *payload - 1 == 0 || *payload - 1 > zip_payload_len) {
+    if ( *payload - 1 == 0 || *payload - 1 > s->payload_len) {
       ERR_PRINTF("BAD extended header\n");
-      return sli_zipudp_drop_frame(&sl_zwc, cur_flags1);
+      return sli_zipudp_drop_frame(zwc, s->flags1);
     }
 
     /*
      * ext_hdr_size reports the actual length in case of EXT_HDR_LENGTH and
      * excluding one byte field
      */
-    return_codes_zip_ext_hdr_t rc = parse_CC_ZIP_EXT_HDR(&zip_ptk->payload[1], *payload - 1, &sl_zwc, &ext_hdr_size);
+    return_codes_zip_ext_hdr_t rc = parse_CC_ZIP_EXT_HDR(&zip_ptk->payload[1], *payload - 1, zwc, &ext_hdr_size);
     if (rc == DROP_FRAME) {
-      return sli_zipudp_drop_frame(&sl_zwc, cur_flags1);
+      return sli_zipudp_drop_frame(zwc, s->flags1);
     } else if (rc == OPT_ERROR) {
-      return sli_zipudp_error_frame(&sl_zwc, cur_flags1);
+      return sli_zipudp_error_frame(zwc, s->flags1);
     }
-    zip_payload_len -= (ext_hdr_size + 1);
+    s->payload_len -= (ext_hdr_size + 1);
     payload += (ext_hdr_size + 1);
   }
 
   /*
    * If no ZW Command included just drop
    */
-  if ( ((zip_ptk->flags1 & ZIP_PACKET_FLAGS1_ZW_CMD_INCL) == 0) || zip_payload_len == 0 ) {
+  if ( ((zip_ptk->flags1 & ZIP_PACKET_FLAGS1_ZW_CMD_INCL) == 0) || s->payload_len == 0 ) {
     DBG_PRINTF("No Zwave command included, Dropping\n");
-    return sli_zipudp_drop_frame(&sl_zwc, cur_flags1);
+    return sli_zipudp_drop_frame(zwc, s->flags1);
   }
   /* If frame is too large, drop */
-  if (zip_payload_len > sizeof(classic_txBuf)) {
+  if (s->payload_len > CLASSIC_TX_BUF_SIZE) {
     ERR_PRINTF("Frame too large\n");
-    return sli_zipudp_drop_frame(&sl_zwc, cur_flags1);
+    return sli_zipudp_drop_frame(zwc, s->flags1);
   }
   /* Remember for later if it is a reset command. */
 
-  if (sli_zipudp_association_process(sl_zwc, zip_ptk, cur_flags1)) {
+  if (sli_zipudp_association_process(*zwc, zip_ptk, s->flags1)) {
     return TRUE;
   }
 
   // FALSE since we are not doing supervision unwrapping
-  if (proxy_command_handler(&sl_zwc, payload, zip_payload_len, secure, zip_ptk->flags0 & ZIP_PACKET_FLAGS0_ACK_REQ, FALSE)) {
+  if (proxy_command_handler(zwc, payload, s->payload_len, secure, zip_ptk->flags0 & ZIP_PACKET_FLAGS0_ACK_REQ, FALSE)) {
+    return TRUE;
+  }
+
+  if (s->payload_len > CLASSIC_TX_BUF_SIZE) {
+    return sli_zipudp_drop_frame(zwc, s->flags1);
+  }
+
+  if (sl_state_cache_answer(zwc,
+                            sl_node_of_ip(&sl_uip_buf_dst_addr()),
+                            zip_ptk->flags0 & ZIP_PACKET_FLAGS0_ACK_REQ,
+                            s->flags1,
+                            payload,
+                            s->payload_len)) {
+    report_send_completed(TRANSMIT_COMPLETE_OK);
     return TRUE;
   }
 
-  if (zip_payload_len > sizeof(classic_txBuf)) {
-    return sli_zipudp_drop_frame(&sl_zwc, cur_flags1);
+  /* A wake-up node cannot hear us now, hold the request until it wakes up. */
+  if (!s->from_mailbox && sl_mailbox_post(s->dest_nodeid, s->pkt, zwc)) {
+    report_send_completed(TRANSMIT_COMPLETE_OK);
+    return TRUE;
   }
 
-  return sli_zipudp_temp_association_process(payload, secure);
+  return sli_zipudp_temp_association_process(s, payload, secure);
 }
 
 /**
  * Parse an incoming UDP packet addressed for a classic ZWave node. The packet must be already
- * decrypted and located in the backup_buf buffer. uip_buf is unsafe because it will be
+ * decrypted and located in the current packet buffer (bkp_pkt). uip_buf is unsafe because it will be
  * overwritten if we use async requests as a part of the parsing.
  *
  * Input argument data must point to ZIP hdr and length must count only zip hdr + zip payload
- * Furthermore, callers must ensure that data points to somewhere in the backup_buf buffer.
+ * Furthermore, callers must ensure that data points to somewhere in the bkp_pkt buffer.
  */
 /* Overview:
  * if bridge not ready: return FALSE
@@ -644,10 +875,10 @@ int ClassicZIPNode_dec_input(void * pktdata, int len)
    And used from PAN to LAN after LogicalRewriteAndSend()
  */
 int
-ClassicZIPNode_input(nodeid_t node, VOID_CALLBACKFUNC(completedFunc) (BYTE, BYTE*, uint16_t),
-                     int bFromMailbox, int bRequeued)
+ClassicZIPNode_input(nodeid_t node,
+                     VOID_CALLBACKFUNC(completedFunc) (BYTE, BYTE*, uint16_t, void *user),
+                     void *user, int bFromMailbox, int bRequeued)
 {
-  (void) bFromMailbox;
   (void) bRequeued;
   /* Overview:
    *   if unknown destination: drop
@@ -674,49 +905,133 @@ ClassicZIPNode_input(nodeid_t node, VOID_CALLBACKFUNC(completedFunc) (BYTE, BYTE
   nodeid_t nid = node;
   uint16_t dst_port = sl_uip_buf_dst_port();
   uint32_t proto = UIP_PROTO_UDP;
+  sli_czn_session_t *s = NULL;
+  int ret = TRUE;
+
+  if (!ClassicZIPNode_can_accept()) {
+    completedFunc(TRANSMIT_COMPLETE_REQUEUE, NULL, 0, user);
+    return TRUE;
+  }
+  if (!sl_nm_is_idle()) {
+    /* Inclusion or exclusion in progress, try again later. */
+    completedFunc(TRANSMIT_COMPLETE_REQUEUE_QUEUED, NULL, 0, user);
+    return TRUE;
+  }
   if (nodemask_nodeid_is_invalid(nid)) {
     ERR_PRINTF("Dropping as the node id: %d is out of range\n", nid);
-    completedFunc(TRANSMIT_COMPLETE_ERROR, NULL, 0);
+    completedFunc(TRANSMIT_COMPLETE_ERROR, NULL, 0, user);
     return TRUE;
   }
-  cbCompletedFunc = completedFunc;
-  /*Create a backup of package, in order to make async requests. */
-  backup_len = sl_backup_zip_len();
   ASSERT(nid);
+  for (int i = 0; i < CLASSIC_ZIP_SESSIONS; i++) {
+    if (!sli_czn_sessions[i].in_use) {
+      s = &sli_czn_sessions[i];
+      break;
+    }
+  }
+  /* Keep the package for the asynchronous part of the request. */
+  memset(&s->zwc, 0, sizeof(s->zwc));
+  s->in_use = true;
+  s->exclusive = false;
+  // Generation 0 is skipped so a session reference is never NULL.
+  if (++s->gen == 0) {
+    s->gen = 1;
+  }
+  s->pkt = bkp_pkt;
+  sl_tcpip_buf_hold(s->pkt);
+  s->send_handle = 0;
+  s->dest_nodeid = nid;
+  s->proxy_assoc = NULL;
+  s->from_mailbox = bFromMailbox;
+  s->deadline = osKernelGetTickCount() + (CLASSIC_SESSION_TIMEOUT * osKernelGetTickFreq()) / 1000;
+  s->completed = completedFunc;
+  s->user = user;
+  s->tx_options = sli_czn_tx_options;
+  s->send_nack = FALSE;
+  s->txBuf = NULL;
+  sli_czn_cur = s;
 
-  /* Destination address of frame has MANGLE_MAGIC, ie, this was a Z-wave frame. */
   if (LogicalRewriteAndSend()) {
-    ClassicZIPNode_CallSendCompleted_cb(TRANSMIT_COMPLETE_OK, NULL, NULL);
-    return TRUE;
+    /* Destination address of frame has MANGLE_MAGIC, ie, this was a Z-wave frame. */
+    ClassicZIPNode_CallSendCompleted_cb(TRANSMIT_COMPLETE_OK,
+                                        sli_czn_to_user(s),
+                                        NULL);
+  } else if (proto == UIP_PROTO_UDP && dst_port == UIP_HTONS(ZWAVE_PORT)) {
+    struct uip_udp_conn* c = &sl_uip_buf_get_conn();
+    ret = ClassicZIPUDP_input(c, (uint8_t*)ZIP_PKT_BUF,
+                              sl_backup_zip_len(), 0);
+  } else {
+    /* Unknown port or protocol */
+    DBG_PRINTF("Unknown protocol %ld or port %d\n", proto, UIP_HTONS(dst_port));
+    ClassicZIPNode_CallSendCompleted_cb(TRANSMIT_COMPLETE_OK,
+                                        sli_czn_to_user(s),
+                                        NULL);
+  }
+  sli_czn_cur = NULL;
+  if (!ret && s->in_use) {
+    /* The caller completes a package that was not processed. */
+    sli_czn_free(s);
   }
+  return ret;
+}
+
+bool ClassicZIPNode_can_accept(void)
+{
+  if (sli_czn_exclusive) {
+    return false;
+  }
+  for (int i = 0; i < CLASSIC_ZIP_SESSIONS; i++) {
+    if (!sli_czn_sessions[i].in_use) {
+      return true;
+    }
+  }
+  return false;
+}
 
-  switch (proto) {
-    case UIP_PROTO_UDP:
-    {
-      if (dst_port == UIP_HTONS(ZWAVE_PORT)) {
-        struct uip_udp_conn* c = &sl_uip_buf_get_conn();
-        return ClassicZIPUDP_input(c, (uint8_t*)ZIP_PKT_BUF,
-                                   sl_backup_zip_len(), 0);
-      } else { /* Unknown port */
-        ClassicZIPNode_CallSendCompleted_cb(TRANSMIT_COMPLETE_OK, NULL, NULL);
-        return TRUE;
+uint32_t ClassicZIPNode_process(void)
+{
+  uint32_t now = osKernelGetTickCount();
+  uint32_t next = osWaitForever;
+
+  for (int i = 0; i < CLASSIC_ZIP_SESSIONS; i++) {
+    sli_czn_session_t *s = &sli_czn_sessions[i];
+    sli_czn_ctx_t prev;
+    int32_t left;
+
+    if (!s->in_use) {
+      continue;
+    }
+    left = (int32_t) (s->deadline - now);
+    if (left > 0) {
+      if ((uint32_t) left < next) {
+        next = (uint32_t) left;
       }
+      continue;
     }
-    break;
-    default:
-      DBG_PRINTF("Unknown protocol %ld\n", proto);
-      ClassicZIPNode_CallSendCompleted_cb(TRANSMIT_COMPLETE_OK, NULL, NULL);
-      return TRUE;
+    /* No callback came back for this request, give up on it. */
+    WRN_PRINTF("Classic Z/IP session %d to node %d timed out\n", i, s->dest_nodeid);
+    prev = sli_czn_enter(s);
+    if (s->send_handle) {
+      ZW_SendDataApplAbort(s->send_handle);
+    }
+    if (s->flags0 & ZIP_PACKET_FLAGS0_ACK_REQ) {
+      SendUDPStatus(ZIP_PACKET_FLAGS0_NACK_RES, s->flags1, &s->zwc);
+    }
+    report_send_completed(TRANSMIT_COMPLETE_FAIL);
+    sli_czn_leave(prev);
   }
-  /* We have processed this packet but it is not delivered. */
-  ClassicZIPNode_CallSendCompleted_cb(TRANSMIT_COMPLETE_ERROR, NULL, NULL);
-  return TRUE;
+  return next;
 }
 
 void
 sl_class_zip_node_init()
 {
-  backup_len = 0;
+  memset(sli_czn_sessions, 0, sizeof(sli_czn_sessions));
+  sli_czn_cur = NULL;
+  sli_czn_exclusive = NULL;
+  sl_state_cache_init();
+  sl_shared_get_init();
+  sl_mailbox_init();
 
   ClassicZIPNode_setTXOptions(TRANSMIT_OPTION_ACK
                               | TRANSMIT_OPTION_AUTO_ROUTE
@@ -725,6 +1040,36 @@ sl_class_zip_node_init()
 
 void sl_temp_assoc_fw_lock_release_on_timeout(sl_sleeptimer_timer_handle_t *t, void *u);
 
+/* Send a frame from a node to the client of temporary association a. */
+static void
+sli_czn_send_to_client(const temp_association_t *a, uint8_t rendpoint,
+                       ts_param_t* p, unsigned char *pCmd, uint8_t cmdLength)
+{
+  zwave_connection_t c;
+
+  memset(&c, 0, sizeof(c));
+
+  c.tx_flags = p->tx_flags;
+  c.rx_flags = p->rx_flags;
+  c.scheme = p->scheme;
+  c.rendpoint = rendpoint;
+  c.lendpoint = p->sendpoint;
+  c.rport = a->resource_port;
+  c.lport = a->was_dtls ? UIP_HTONS(DTLS_PORT) : UIP_HTONS(ZWAVE_PORT);
+
+  /* Association to LAN - use DTLS and association source as source ip */
+  sl_ip_of_node(&c.lipaddr, p->snode);
+  uip_ipaddr_copy(&c.ripaddr, &a->resource_ip);
+
+  DBG_PRINTF("Packet from nodeid: %d to port: %d IP addr: ", p->snode, UIP_HTONS(c.rport));
+  uip_debug_ipaddr_print(&c.ripaddr);
+  DBG_PRINTF("data: ")
+  sl_print_hex_buf(pCmd, cmdLength);
+  DBG_PRINTF("\n");
+
+  sl_zw_send_data_udp(&c, pCmd, cmdLength, NULL, FALSE);
+}
+
 /**
  * Form a UDP package from the the Z-Wave package. Destination address will
  * be a logical HAN address which contains the source and destination node
@@ -736,15 +1081,8 @@ void sl_temp_assoc_fw_lock_release_on_timeout(sl_sleeptimer_timer_handle_t *t, v
 void
 CreateLogicalUDP(ts_param_t* p, unsigned char *pCmd, uint8_t cmdLength)
 {
-  zwave_connection_t c;
-
-  memset(&c, 0, sizeof(c));
-
-  c.tx_flags = p->tx_flags;
-  c.rx_flags = p->rx_flags;
-  c.scheme = p->scheme;
-  c.rendpoint = p->dendpoint;
-  c.lendpoint = p->sendpoint;
+  temp_association_t clients[SL_SHARED_GET_FOLLOWERS];
+  int n;
 
   /* Lookup destination node in assoc table*/
   if (p->dendpoint & 0x80) {
@@ -775,20 +1113,14 @@ CreateLogicalUDP(ts_param_t* p, unsigned char *pCmd, uint8_t cmdLength)
       sl_sleeptimer_start_timer_ms(&temp_assoc_fw_lock.reset_fw_timer, 60000, sl_temp_assoc_fw_lock_release_on_timeout, a, 1, 0);
     }
 
-    c.rport = a->resource_port;
-    c.lport = a->was_dtls ? UIP_HTONS(DTLS_PORT) : UIP_HTONS(ZWAVE_PORT);
-
-    /* Association to LAN - use DTLS and association source as source ip */
-    sl_ip_of_node(&c.lipaddr, p->snode);
-    uip_ipaddr_copy(&c.ripaddr, &a->resource_ip);
+    sli_czn_send_to_client(a, p->dendpoint, p, pCmd, cmdLength);
 
-    DBG_PRINTF("Packet from nodeid: %d to port: %d IP addr: ", p->snode, UIP_HTONS(c.rport));
-    uip_debug_ipaddr_print(&c.ripaddr);
-    DBG_PRINTF("data: ")
-    sl_print_hex_buf(pCmd, cmdLength);
-    DBG_PRINTF("\n");
-
-    sl_zw_send_data_udp(&c, pCmd, cmdLength, NULL, FALSE);
+    /* Clients whose Get shared this one get the report too. */
+    n = sl_shared_get_report(p, pCmd, cmdLength, clients, SL_SHARED_GET_FOLLOWERS);
+    for (int i = 0; i < n; i++) {
+      sli_czn_send_to_client(&clients[i], clients[i].resource_endpoint,
+                             p, pCmd, cmdLength);
+    }
   } else {
     WRN_PRINTF("No temp association found for package\n");
   }
@@ -860,40 +1192,62 @@ LogicalRewriteAndSend()
   return FALSE;
 }
 
+/* Options of the current request, or those new requests start with. */
 void
 ClassicZIPNode_setTXOptions(uint8_t opt)
 {
-  txOpts = opt;
+  sli_czn_session_t *s = sli_czn_current();
+
+  if (s) {
+    s->tx_options = opt;
+  } else {
+    sli_czn_tx_options = opt;
+  }
 }
 
 void
 ClassicZIPNode_addTXOptions(uint8_t opt)
 {
-  txOpts |= opt;
+  sli_czn_session_t *s = sli_czn_current();
+
+  if (s) {
+    s->tx_options |= opt;
+  } else {
+    sli_czn_tx_options |= opt;
+  }
 }
 
 uint8_t
 ClassicZIPNode_getTXOptions(void)
 {
-  return txOpts;
+  sli_czn_session_t *s = sli_czn_current();
+
+  return s ? s->tx_options : sli_czn_tx_options;
 }
 
 uint8_t *
 ClassicZIPNode_getTXBuf(void)
 {
-  return classic_txBuf;
+  return sli_czn_assoc_buf;
 }
 
 void
 ClassicZIPNode_sendNACK(BOOL __sendNAck)
 {
-  bSendNAck = __sendNAck;
+  sli_czn_session_t *s = sli_czn_current();
+
+  if (s) {
+    s->send_nack = __sendNAck;
+  }
 }
 
 void
 ClassicZIPNode_AbortSending()
 {
-  if (cur_SendDataAppl_handle) {
-    ZW_SendDataApplAbort(cur_SendDataAppl_handle);
+  sli_czn_session_t *s = sli_czn_current();
+
+  if (s && s->send_handle) {
+    ZW_SendDataApplAbort(s->send_handle);
+    s->send_handle = 0;
   }
 }
@@ -89,17 +89,44 @@
  * This routine will do asynchronous processing, i.e., it will return before any IP reply
  * is ready.
  *
- * If ClassicZIPNode_input() is already busy, it invokes completedFunc
- * immediately with status \ref TRANSMIT_COMPLETE_REQUEUE.
+ * Every accepted package gets its own session, holding a reference to the
+ * package and the connection needed for the ZIP ACK/NACK, so requests to
+ * different nodes can be in flight at the same time. A session that gets no
+ * completion within CLASSIC_SESSION_TIMEOUT is failed by
+ * ClassicZIPNode_process().
+ *
+ * If no session is free, or an IP Association request is in progress, it
+ * invokes completedFunc immediately with status \ref TRANSMIT_COMPLETE_REQUEUE.
+ * While Network Management is busy it does the same with
+ * TRANSMIT_COMPLETE_REQUEUE_QUEUED.
  *
  * @param node node to send this package to
  * @param completedFunc callback to be called when frame has been sent.
+ * @param user Passed to completedFunc.
  * @param bFromMailbox Boolean should be TRUE if this frame is sent from mailbox.
+ *                     Otherwise requests to a wake-up node are put in the
+ *                     mailbox (see sl_mailbox_post()).
  * @param bRequeued Boolean should be TRUE if this frame has been re-queued to node-queue already.
  * @return true if the package has been processed.
  */
-int ClassicZIPNode_input(nodeid_t node, void (*completedFunc)(BYTE, BYTE *, uint16_t),
-                         int bFromMailbox, int bRequeued);
+int ClassicZIPNode_input(nodeid_t node,
+                         void (*completedFunc)(BYTE, BYTE *, uint16_t, void *user),
+                         void *user, int bFromMailbox, int bRequeued);
+
+/**
+ * Check whether ClassicZIPNode_input() can take a new packet.
+ *
+ * @return true if a session is free and no IP Association request is in
+ *         progress.
+ */
+bool ClassicZIPNode_can_accept(void);
+
+/**
+ * Fail the sessions that timed out.
+ *
+ * @return Kernel ticks until the next session times out, or osWaitForever.
+ */
+uint32_t ClassicZIPNode_process(void);
 
 /**
  * Call the callback function registered with ClassicZIPNode_input().
@@ -109,7 +136,7 @@ int ClassicZIPNode_input(nodeid_t node, void (*completedFunc)(BYTE, BYTE *, uint
  * two unused parameters.
  *
  * @param bStatus Status code to pass to callback function
- * @param usr     Not used
+ * @param usr     Session reference, NULL for the session running now
  * @param t       Not used
  */
 void ClassicZIPNode_CallSendCompleted_cb(BYTE bStatus, void* usr, TX_STATUS_TYPE *t);
@@ -179,7 +206,8 @@ void report_send_completed(uint8_t bStatus);
 uint8_t is_local_address(uip_ipaddr_t *ip);
 
 /**
- * Set the txOptions used in transmissions.
+ * Set the txOptions used in transmissions of the current request, or of
+ * the requests started later when called outside any request.
  */
 void ClassicZIPNode_setTXOptions(uint8_t opt);
 
@@ -187,6 +215,10 @@ void ClassicZIPNode_addTXOptions(uint8_t opt);
 
 uint8_t ClassicZIPNode_getTXOptions(void);
 
+/**
+ * Buffer the IP association code builds its frames in. There is one, the
+ * IP association requests run one at a time.
+ */
 uint8_t *ClassicZIPNode_getTXBuf(void);
 
 void ClassicZIPNode_sendNACK(BOOL __sendAck);
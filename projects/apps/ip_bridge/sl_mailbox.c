@@ -0,0 +1,390 @@
+/*******************************************************************************
+ * @file  sl_mailbox.c
+ * @brief Mailbox holding Z/IP requests for wake-up nodes
+ *******************************************************************************
+ * # License
+ * <b>Copyright 2025 Silicon Laboratories Inc. www.silabs.com</b>
+ *******************************************************************************
+ *
+ * The licensor of this software is Silicon Laboratories Inc. Your use of this
+ * software is governed by the terms of Silicon Labs Master Software License
+ * Agreement (MSLA) available at
+ * www.silabs.com/about-us/legal/master-software-license-agreement. This
+ * software is distributed to you in Source Code format and is governed by the
+ * sections of the MSLA applicable to Source Code.
+ *
+ ******************************************************************************/
+
+#include <string.h>
+#include "cmsis_os2.h"
+#include "sl_common_log.h"
+#include "ZW_classcmd.h"
+#include "ZW_transport_api.h"
+#include "Z-Wave/CC/RD_internal.h"
+#include "ip_translate/sl_zw_resource.h"
+#include "modules/sl_psram_arena.h"
+#include "Net/sl_udp_utils.h"
+#include "transport/sl_ts_common.h"
+#include "transport/sl_zw_send_data.h"
+#include "threads/sl_tcpip_handler.h"
+#include "sl_classic_zip_node.h"
+#include "sl_mailbox.h"
+
+/* One queued request, kept in the PSRAM arena. */
+typedef struct sli_mb_frame {
+  struct sli_mb_frame *next;
+  zwave_connection_t zw_con;
+  uint32_t tcpip_proto;
+  uint16_t len;
+  uint8_t data[];           // Z/IP packet, zip_data of the request
+} sli_mb_frame_t;
+
+typedef struct {
+  nodeid_t node;            // 0 when the slot is free
+  uint8_t count;
+  bool awake;               // Wake Up Notification seen, burst running
+  bool inflight;            // a request is with the tcpip thread
+  bool burst;               // something was delivered since the wake up
+  sli_mb_frame_t *head;
+  sli_mb_frame_t *tail;
+} sli_mb_node_t;
+
+/****************************************************************************/
+/*                            LOCAL VARIABLES                               */
+/****************************************************************************/
+
+static sli_mb_node_t sli_mb_nodes[SL_MAILBOX_NODES];
+static uint32_t sli_mb_total;
+static sl_mailbox_stats_t sli_mb_stats;
+static osMutexId_t sli_mb_mutex = NULL;
+
+static const uint8_t sli_mb_no_more_info[] = {
+  COMMAND_CLASS_WAKE_UP,
+  WAKE_UP_NO_MORE_INFORMATION
+};
+
+/****************************************************************************/
+/*                            PRIVATE FUNCTIONS                             */
+/****************************************************************************/
+
+static void sli_mb_lock(void)
+{
+  if (sli_mb_mutex) {
+    osMutexAcquire(sli_mb_mutex, osWaitForever);
+  }
+}
+
+static void sli_mb_unlock(void)
+{
+  if (sli_mb_mutex) {
+    osMutexRelease(sli_mb_mutex);
+  }
+}
+
+static sli_mb_node_t *sli_mb_find(nodeid_t node)
+{
+  for (int i = 0; i < SL_MAILBOX_NODES; i++) {
+    if (sli_mb_nodes[i].node == node) {
+      return &sli_mb_nodes[i];
+    }
+  }
+  return NULL;
+}
+
+static sli_mb_node_t *sli_mb_get(nodeid_t node)
+{
+  sli_mb_node_t *n = sli_mb_find(node);
+
+  if (n == NULL && (n = sli_mb_find(0)) != NULL) {
+    memset(n, 0, sizeof(*n));
+    n->node = node;
+  }
+  return n;
+}
+
+/* Release the slot once nothing is queued or running for the node. */
+static void sli_mb_node_check_free(sli_mb_node_t *n)
+{
+  if (n->head == NULL && !n->inflight && !n->awake) {
+    memset(n, 0, sizeof(*n));
+  }
+}
+
+/* Same client, sequence number and endpoint as a queued request. */
+static bool sli_mb_is_duplicate(const sli_mb_node_t *n,
+                                const sl_tcpip_buf_t *pkt)
+{
+  const ZW_COMMAND_ZIP_PACKET *zip = pkt->zip_packet;
+
+  for (sli_mb_frame_t *f = n->head; f; f = f->next) {
+    const ZW_COMMAND_ZIP_PACKET *q = (const ZW_COMMAND_ZIP_PACKET *) f->data;
+    if (q->seqNo == zip->seqNo && q->dEndpoint == zip->dEndpoint
+        && f->zw_con.conn.rport == pkt->zw_con.conn.rport
+        && uip_ipaddr_cmp(&f->zw_con.conn.ripaddr, &pkt->zw_con.conn.ripaddr)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+static void sli_mb_no_more_info_cb(BYTE txStatus, void *user, TX_STATUS_TYPE *t)
+{
+  (void) t;
+  DBG_PRINTF("Mailbox: no more information to node %d, status %d\n",
+             (int) (uintptr_t) user,
+             txStatus);
+}
+
+static void sli_mb_send_no_more_info(nodeid_t node)
+{
+  ts_param_t p;
+
+  ts_set_std(&p, node);
+  sl_zw_send_data_appl(&p,
+                       sli_mb_no_more_info,
+                       sizeof(sli_mb_no_more_info),
+                       sli_mb_no_more_info_cb,
+                       (void *) (uintptr_t) node);
+}
+
+/****************************************************************************/
+/*                            PUBLIC FUNCTIONS                              */
+/****************************************************************************/
+
+void sl_mailbox_init(void)
+{
+  if (sli_mb_mutex == NULL) {
+    sli_mb_mutex = osMutexNew(NULL);
+  }
+  for (int i = 0; i < SL_MAILBOX_NODES; i++) {
+    if (sli_mb_nodes[i].node) {
+      sl_mailbox_purge(sli_mb_nodes[i].node);
+    }
+  }
+  sli_mb_lock();
+  memset(sli_mb_nodes, 0, sizeof(sli_mb_nodes));
+  memset(&sli_mb_stats, 0, sizeof(sli_mb_stats));
+  sli_mb_total = 0;
+  sli_mb_unlock();
+}
+
+bool sl_mailbox_post(nodeid_t node,
+                     const sl_tcpip_buf_t *pkt,
+                     zwave_connection_t *c)
+{
+  bool ack_req = pkt->zip_packet->flags0 & ZIP_PACKET_FLAGS0_ACK_REQ;
+  uint8_t flags1 = pkt->zip_packet->flags1;
+  sli_mb_frame_t *f = NULL;
+  sli_mb_node_t *n;
+  bool wake;
+
+  if ((rd_get_node_mode(node) & 0xff) != MODE_MAILBOX) {
+    return false;
+  }
+
+  sli_mb_lock();
+  n = sli_mb_get(node);
+  if (n && sli_mb_is_duplicate(n, pkt)) {
+    sli_mb_stats.duplicates++;
+    sli_mb_unlock();
+    if (ack_req) {
+      SendUDPStatus(ZIP_PACKET_FLAGS0_NACK_RES | ZIP_PACKET_FLAGS0_NACK_WAIT,
+                    flags1,
+                    c);
+    }
+    return true;
+  }
+  if (n && n->count < SL_MAILBOX_NODE_FRAMES
+      && sli_mb_total < SL_MAILBOX_FRAMES) {
+    f = sl_psram_arena_alloc(SL_PSRAM_POOL_MAILBOX,
+                             sizeof(*f) + pkt->zip_data_len);
+  }
+  if (f == NULL) {
+    sli_mb_stats.dropped++;
+    if (n) {
+      sli_mb_node_check_free(n);
+    }
+    sli_mb_unlock();
+    WRN_PRINTF("Mailbox: full, dropping request to node %d\n", node);
+    if (ack_req) {
+      SendUDPStatus(ZIP_PACKET_FLAGS0_NACK_RES | ZIP_PACKET_FLAGS0_NACK_QF,
+                    flags1,
+                    c);
+    }
+    return true;
+  }
+
+  f->next        = NULL;
+  f->zw_con      = pkt->zw_con;
+  f->tcpip_proto = pkt->tcpip_proto;
+  f->len         = (uint16_t) pkt->zip_data_len;
+  memcpy(f->data, pkt->zip_data, pkt->zip_data_len);
+  if (n->tail) {
+    n->tail->next = f;
+  } else {
+    n->head = f;
+  }
+  n->tail = f;
+  n->count++;
+  sli_mb_total++;
+  sli_mb_stats.queued++;
+  // Still awake from an earlier notification, join the running burst.
+  wake = n->awake && !n->inflight;
+  sli_mb_unlock();
+
+  LOG_PRINTF("Mailbox: queued request for node %d\n", node);
+  if (ack_req) {
+    SendUDPStatus(ZIP_PACKET_FLAGS0_NACK_RES | ZIP_PACKET_FLAGS0_NACK_WAIT,
+                  flags1,
+                  c);
+  }
+  if (wake) {
+    sl_tcpip_wakeup();
+  }
+  return true;
+}
+
+bool sl_mailbox_wakeup(nodeid_t node)
+{
+  sli_mb_node_t *n;
+  bool wake = false;
+
+  sli_mb_lock();
+  n = sli_mb_find(node);
+  if (n && n->head) {
+    n->awake = true;
+    n->burst = false;
+    sli_mb_stats.wakeups++;
+    wake = true;
+  }
+  sli_mb_unlock();
+
+  if (wake) {
+    LOG_PRINTF("Mailbox: node %d is awake\n", node);
+    sl_tcpip_wakeup();
+  }
+  return wake;
+}
+
+sl_tcpip_buf_t *sl_mailbox_next(nodeid_t *node)
+{
+  sl_tcpip_buf_t *buf = NULL;
+  sli_mb_frame_t *f;
+
+  sli_mb_lock();
+  for (int i = 0; i < SL_MAILBOX_NODES; i++) {
+    sli_mb_node_t *n = &sli_mb_nodes[i];
+
+    if (!n->node || !n->awake || n->inflight || n->head == NULL) {
+      continue;
+    }
+    buf = sl_tcpip_buf_alloc();
+    if (buf == NULL) {
+      break;
+    }
+    f       = n->head;
+    n->head = f->next;
+    if (n->head == NULL) {
+      n->tail = NULL;
+    }
+    n->count--;
+    n->inflight = true;
+    n->burst    = true;
+    sli_mb_total--;
+    sli_mb_stats.delivered++;
+
+    buf->zw_con       = f->zw_con;
+    buf->tcpip_proto  = f->tcpip_proto;
+    buf->zip_data     = buf->data;
+    buf->zip_data_len = f->len;
+    buf->zip_packet   = (ZW_COMMAND_ZIP_PACKET *) buf->zip_data;
+    memcpy(buf->data, f->data, f->len);
+    sl_psram_arena_free(f);
+    *node = n->node;
+    break;
+  }
+  sli_mb_unlock();
+  return buf;
+}
+
+void sl_mailbox_done(nodeid_t node, uint8_t status)
+{
+  sli_mb_node_t *n;
+  bool no_more_info = false;
+
+  sli_mb_lock();
+  n = sli_mb_find(node);
+  if (n == NULL || !n->inflight) {
+    sli_mb_unlock();
+    return;
+  }
+  n->inflight = false;
+  if (status == TRANSMIT_COMPLETE_NO_ACK) {
+    // Back to sleep already, the rest waits for the next notification.
+    n->awake = false;
+  } else if (n->head == NULL) {
+    n->awake     = false;
+    no_more_info = n->burst;
+  }
+  sli_mb_node_check_free(n);
+  sli_mb_unlock();
+
+  if (no_more_info) {
+    sli_mb_send_no_more_info(node);
+  } else {
+    sl_tcpip_wakeup();
+  }
+}
+
+void sl_mailbox_purge(nodeid_t node)
+{
+  sli_mb_node_t *n;
+
+  sli_mb_lock();
+  n = sli_mb_find(node);
+  if (n) {
+    while (n->head) {
+      sli_mb_frame_t *f = n->head;
+      n->head = f->next;
+      sl_psram_arena_free(f);
+      sli_mb_total--;
+    }
+    n->tail  = NULL;
+    n->count = 0;
+    n->awake = false;
+    sli_mb_node_check_free(n);
+  }
+  sli_mb_unlock();
+}
+
+void sl_mailbox_get_stats(sl_mailbox_stats_t *stats)
+{
+  sli_mb_lock();
+  *stats = sli_mb_stats;
+  sli_mb_unlock();
+}
+
+void sl_mailbox_print_stats(void)
+{
+  sli_mb_lock();
+  LOG_PRINTF("Mailbox: %ld/%d requests, queued %ld delivered %ld dropped %ld "
+             "duplicates %ld wakeups %ld\n",
+             sli_mb_total,
+             SL_MAILBOX_FRAMES,
+             sli_mb_stats.queued,
+             sli_mb_stats.delivered,
+             sli_mb_stats.dropped,
+             sli_mb_stats.duplicates,
+             sli_mb_stats.wakeups);
+  for (int i = 0; i < SL_MAILBOX_NODES; i++) {
+    sli_mb_node_t *n = &sli_mb_nodes[i];
+    if (n->node) {
+      LOG_PRINTF("  node %3d: %d queued%s%s\n",
+                 n->node,
+                 n->count,
+                 n->awake ? ", awake" : "",
+                 n->inflight ? ", sending" : "");
+    }
+  }
+  sli_mb_unlock();
+}
@@ -0,0 +1,130 @@
+/*******************************************************************************
+ * @file  sl_mailbox.h
+ * @brief Mailbox holding Z/IP requests for wake-up nodes
+ *******************************************************************************
+ * # License
+ * <b>Copyright 2025 Silicon Laboratories Inc. www.silabs.com</b>
+ *******************************************************************************
+ *
+ * The licensor of this software is Silicon Laboratories Inc. Your use of this
+ * software is governed by the terms of Silicon Labs Master Software License
+ * Agreement (MSLA) available at
+ * www.silabs.com/about-us/legal/master-software-license-agreement. This
+ * software is distributed to you in Source Code format and is governed by the
+ * sections of the MSLA applicable to Source Code.
+ *
+ ******************************************************************************/
+#ifndef SL_MAILBOX_H_
+#define SL_MAILBOX_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "Common/sl_tcpip_def.h"
+
+/**
+ * \defgroup mailbox Mailbox
+ *
+ * A wake-up node (#MODE_MAILBOX) only listens for a few seconds after it
+ * sends a Wake Up Notification. Z/IP requests for such a node are copied
+ * to a per-node FIFO in the PSRAM arena and the client is told with a ZIP
+ * NACK+Waiting that the request is queued.
+ *
+ * When the Wake Up Notification arrives, the tcpip thread takes the queued
+ * requests back with sl_mailbox_next(), one at a time per node and in
+ * order, and the node is sent Wake Up No More Information after the last
+ * one so it can go back to sleep.
+ * @{
+ */
+
+/** Nodes that can have requests queued at the same time. */
+#ifndef SL_MAILBOX_NODES
+#define SL_MAILBOX_NODES 8
+#endif
+
+/** Requests queued for one node. */
+#ifndef SL_MAILBOX_NODE_FRAMES
+#define SL_MAILBOX_NODE_FRAMES 8
+#endif
+
+/** Requests queued for all nodes. */
+#ifndef SL_MAILBOX_FRAMES
+#define SL_MAILBOX_FRAMES 32
+#endif
+
+typedef struct {
+  uint32_t queued;     /**< Requests put in the mailbox */
+  uint32_t delivered;  /**< Requests handed back for transmission */
+  uint32_t dropped;    /**< Requests refused because the mailbox was full */
+  uint32_t duplicates; /**< Retransmissions of a queued request */
+  uint32_t wakeups;    /**< Wake Up Notifications with requests pending */
+} sl_mailbox_stats_t;
+
+/**
+ * @brief Clear the mailbox; called from sl_class_zip_node_init().
+ */
+void sl_mailbox_init(void);
+
+/**
+ * @brief Queue a request for a wake-up node.
+ *
+ * Does nothing for nodes that are not wake-up nodes. The client is sent a
+ * NACK+Waiting if it asked for an ACK; a full mailbox is answered with a
+ * NACK.
+ *
+ * @param node Destination node.
+ * @param pkt The request; it is copied, the caller keeps its reference.
+ * @param c Reply connection of the request.
+ * @return true if the request was taken by the mailbox (queued or refused).
+ */
+bool sl_mailbox_post(nodeid_t node,
+                     const sl_tcpip_buf_t *pkt,
+                     zwave_connection_t *c);
+
+/**
+ * @brief Mark a node awake after its Wake Up Notification.
+ *
+ * Runs in the Z/IP router thread; wakes the tcpip thread if requests are
+ * queued for the node.
+ *
+ * @return true if requests are queued for the node and the mailbox takes
+ * it over; otherwise the notification is forwarded as usual.
+ */
+bool sl_mailbox_wakeup(nodeid_t node);
+
+/**
+ * @brief Next queued request of an awake node, for the tcpip thread.
+ *
+ * A node gets its next request only after sl_mailbox_done() was called for
+ * the previous one.
+ *
+ * @param[out] node Destination node of the request.
+ * @return A packet buffer holding one reference, or NULL.
+ */
+sl_tcpip_buf_t *sl_mailbox_next(nodeid_t *node);
+
+/**
+ * @brief Report the end of a request returned by sl_mailbox_next().
+ *
+ * Sends Wake Up No More Information once the node has nothing left, or
+ * stops the burst if the node did not answer.
+ *
+ * @param node Destination node of the request.
+ * @param status Transmit status of the request.
+ */
+void sl_mailbox_done(nodeid_t node, uint8_t status);
+
+/**
+ * @brief Drop all requests queued for a node.
+ */
+void sl_mailbox_purge(nodeid_t node);
+
+void sl_mailbox_get_stats(sl_mailbox_stats_t *stats);
+
+/**
+ * @brief Print the mailbox counters and the nodes with requests queued.
+ */
+void sl_mailbox_print_stats(void);
+
+/** @} */
+
+#endif /* SL_MAILBOX_H_ */
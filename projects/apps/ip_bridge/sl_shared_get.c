@@ -0,0 +1,301 @@
+/*******************************************************************************
+ * @file  sl_shared_get.c
+ * @brief Identical client Gets to a node share one radio transaction
+ *******************************************************************************
+ * # License
+ * <b>Copyright 2025 Silicon Laboratories Inc. www.silabs.com</b>
+ *******************************************************************************
+ *
+ * The licensor of this software is Silicon Laboratories Inc. Your use of this
+ * software is governed by the terms of Silicon Labs Master Software License
+ * Agreement (MSLA) available at
+ * www.silabs.com/about-us/legal/master-software-license-agreement. This
+ * software is distributed to you in Source Code format and is governed by the
+ * sections of the MSLA applicable to Source Code.
+ *
+ ******************************************************************************/
+
+#include <string.h>
+#include "FreeRTOS.h"
+#include "cmsis_os2.h"
+#include "sl_common_log.h"
+#include "ZW_classcmd.h"
+#include "sl_shared_get.h"
+
+/* A Get without parameters and the report answering it. */
+typedef struct {
+  uint8_t cc;
+  uint8_t get;
+  uint8_t report;
+} sli_shared_get_cmd_t;
+
+typedef struct {
+  uint32_t tick;          // kernel tick the Get was sent
+  void *leader;           // request on air, NULL once its result is known
+  nodeid_t node;
+  nodeid_t virtual_id;    // the node answers this virtual node
+  uint8_t endpoint;
+  uint8_t scheme;
+  uint8_t cc;
+  uint8_t report;
+  uint8_t in_use : 1;
+  uint8_t closed : 1;     // no more followers, the report may be ambiguous
+  uint8_t answered : 1;   // report delivered, waiting for the leader result
+  uint8_t followers;
+  temp_association_t clients[SL_SHARED_GET_FOLLOWERS];
+  void *sending[SL_SHARED_GET_FOLLOWERS]; // requests waiting for the result
+} sli_shared_get_t;
+
+/****************************************************************************/
+/*                            LOCAL VARIABLES                               */
+/****************************************************************************/
+
+static const sli_shared_get_cmd_t sli_shared_get_cmds[] = {
+  { COMMAND_CLASS_BASIC, BASIC_GET, BASIC_REPORT },
+  { COMMAND_CLASS_SWITCH_BINARY, SWITCH_BINARY_GET, SWITCH_BINARY_REPORT },
+  { COMMAND_CLASS_SWITCH_MULTILEVEL, SWITCH_MULTILEVEL_GET,
+    SWITCH_MULTILEVEL_REPORT },
+  { COMMAND_CLASS_SENSOR_BINARY, SENSOR_BINARY_GET, SENSOR_BINARY_REPORT },
+  { COMMAND_CLASS_SENSOR_MULTILEVEL, SENSOR_MULTILEVEL_GET,
+    SENSOR_MULTILEVEL_REPORT },
+  { COMMAND_CLASS_METER, METER_GET, METER_REPORT },
+  { COMMAND_CLASS_BATTERY, BATTERY_GET, BATTERY_REPORT },
+  { COMMAND_CLASS_DOOR_LOCK, DOOR_LOCK_OPERATION_GET,
+    DOOR_LOCK_OPERATION_REPORT },
+  { COMMAND_CLASS_THERMOSTAT_MODE, THERMOSTAT_MODE_GET,
+    THERMOSTAT_MODE_REPORT },
+};
+
+static sli_shared_get_t sli_shared_gets[SL_SHARED_GET_SIZE];
+static sl_shared_get_stats_t sli_shared_get_stats;
+static osMutexId_t sli_shared_get_mutex = NULL;
+
+/****************************************************************************/
+/*                            PRIVATE FUNCTIONS                             */
+/****************************************************************************/
+
+static void sli_shared_get_lock(void)
+{
+  if (sli_shared_get_mutex) {
+    osMutexAcquire(sli_shared_get_mutex, osWaitForever);
+  }
+}
+
+static void sli_shared_get_unlock(void)
+{
+  if (sli_shared_get_mutex) {
+    osMutexRelease(sli_shared_get_mutex);
+  }
+}
+
+static const sli_shared_get_cmd_t *sli_shared_get_cmd(uint8_t cc)
+{
+  for (uint32_t i = 0;
+       i < sizeof(sli_shared_get_cmds) / sizeof(sli_shared_get_cmds[0]);
+       i++) {
+    if (sli_shared_get_cmds[i].cc == cc) {
+      return &sli_shared_get_cmds[i];
+    }
+  }
+  return NULL;
+}
+
+/*
+ * A sent Get whose report is overdue no longer holds its slot, nor does one
+ * whose transmit result is. The latter only happens if its request was
+ * dropped without sl_shared_get_sent(); followers still waiting for the
+ * result keep it, closed, as they complete with it.
+ */
+static bool sli_shared_get_expired(sli_shared_get_t *g, uint32_t now)
+{
+  if (g->leader == NULL) {
+    return now - g->tick >= pdMS_TO_TICKS(SL_SHARED_GET_TIMEOUT_MS);
+  }
+  if (now - g->tick < pdMS_TO_TICKS(SL_SHARED_GET_SEND_TIMEOUT_MS)) {
+    return false;
+  }
+  for (int f = 0; f < g->followers; f++) {
+    if (g->sending[f]) {
+      g->closed = 1;
+      return false;
+    }
+  }
+  return true;
+}
+
+static sli_shared_get_t *sli_shared_get_find(nodeid_t node,
+                                             uint8_t endpoint,
+                                             uint8_t cc,
+                                             uint32_t now)
+{
+  for (int i = 0; i < SL_SHARED_GET_SIZE; i++) {
+    sli_shared_get_t *g = &sli_shared_gets[i];
+    if (g->in_use && sli_shared_get_expired(g, now)) {
+      g->in_use = 0;
+    }
+    if (g->in_use && !g->closed && !g->answered && g->node == node
+        && g->endpoint == endpoint && g->cc == cc) {
+      return g;
+    }
+  }
+  return NULL;
+}
+
+static sli_shared_get_t *sli_shared_get_alloc(void)
+{
+  for (int i = 0; i < SL_SHARED_GET_SIZE; i++) {
+    if (!sli_shared_gets[i].in_use) {
+      return &sli_shared_gets[i];
+    }
+  }
+  return NULL;
+}
+
+/****************************************************************************/
+/*                            PUBLIC FUNCTIONS                              */
+/****************************************************************************/
+
+void sl_shared_get_init(void)
+{
+  if (sli_shared_get_mutex == NULL) {
+    sli_shared_get_mutex = osMutexNew(NULL);
+  }
+  sli_shared_get_lock();
+  memset(sli_shared_gets, 0, sizeof(sli_shared_gets));
+  memset(&sli_shared_get_stats, 0, sizeof(sli_shared_get_stats));
+  sli_shared_get_unlock();
+}
+
+sl_shared_get_result_t sl_shared_get_begin(nodeid_t node,
+                                           uint8_t endpoint,
+                                           uint8_t scheme,
+                                           nodeid_t virtual_id,
+                                           const temp_association_t *client,
+                                           const uint8_t *data,
+                                           uint16_t len,
+                                           void *session)
+{
+  const sli_shared_get_cmd_t *cmd;
+  sl_shared_get_result_t res = SL_SHARED_GET_SEND;
+  uint32_t now = osKernelGetTickCount();
+  sli_shared_get_t *g;
+
+  if (len < 2 || (cmd = sli_shared_get_cmd(data[0])) == NULL
+      || data[1] != cmd->get) {
+    return SL_SHARED_GET_SEND;
+  }
+
+  sli_shared_get_lock();
+  g = sli_shared_get_find(node, endpoint, cmd->cc, now);
+  if (len != 2) {
+    // Its report could be taken for the one of the pending Get.
+    if (g) {
+      g->closed = 1;
+    }
+    sli_shared_get_unlock();
+    return SL_SHARED_GET_SEND;
+  }
+
+  if (g && g->scheme == scheme && g->followers < SL_SHARED_GET_FOLLOWERS) {
+    g->clients[g->followers] = *client;
+    g->sending[g->followers] = g->leader ? session : NULL;
+    g->followers++;
+    res = g->leader ? SL_SHARED_GET_FOLLOW : SL_SHARED_GET_SENT;
+    sli_shared_get_stats.shared++;
+    DBG_PRINTF("Get 0x%02x to node %d shares a pending Get\n", cmd->cc, node);
+  } else if (g == NULL && (g = sli_shared_get_alloc()) != NULL) {
+    memset(g, 0, sizeof(*g));
+    g->in_use     = 1;
+    g->tick       = now;
+    g->leader     = session;
+    g->node       = node;
+    g->virtual_id = virtual_id;
+    g->endpoint   = endpoint;
+    g->scheme     = scheme;
+    g->cc         = cmd->cc;
+    g->report     = cmd->report;
+    sli_shared_get_stats.sent++;
+  }
+  sli_shared_get_unlock();
+  return res;
+}
+
+int sl_shared_get_sent(void *session, bool ok, void **followers, int max)
+{
+  int n = 0;
+
+  sli_shared_get_lock();
+  for (int i = 0; i < SL_SHARED_GET_SIZE; i++) {
+    sli_shared_get_t *g = &sli_shared_gets[i];
+    if (!g->in_use || g->leader != session) {
+      continue;
+    }
+    for (int f = 0; f < g->followers; f++) {
+      if (g->sending[f] && n < max) {
+        followers[n++] = g->sending[f];
+      }
+      g->sending[f] = NULL;
+    }
+    g->leader = NULL;
+    g->tick   = osKernelGetTickCount();
+    if (!ok || g->answered) {
+      g->in_use = 0;
+    }
+    break;
+  }
+  sli_shared_get_unlock();
+  return n;
+}
+
+int sl_shared_get_report(const ts_param_t *p,
+                         const uint8_t *data,
+                         uint16_t len,
+                         temp_association_t *clients,
+                         int max)
+{
+  int n = 0;
+
+  if (len < 2) {
+    return 0;
+  }
+  sli_shared_get_lock();
+  for (int i = 0; i < SL_SHARED_GET_SIZE; i++) {
+    sli_shared_get_t *g = &sli_shared_gets[i];
+    if (!g->in_use || g->answered || g->node != p->snode
+        || g->endpoint != p->sendpoint || g->virtual_id != p->dnode
+        || g->cc != data[0] || g->report != data[1]) {
+      continue;
+    }
+    for (int f = 0; f < g->followers && n < max; f++) {
+      clients[n++] = g->clients[f];
+    }
+    sli_shared_get_stats.reports += n;
+    // The followers still on air complete in sl_shared_get_sent().
+    if (g->leader) {
+      g->answered = 1;
+    } else {
+      g->in_use = 0;
+    }
+    break;
+  }
+  sli_shared_get_unlock();
+  return n;
+}
+
+void sl_shared_get_get_stats(sl_shared_get_stats_t *stats)
+{
+  sli_shared_get_lock();
+  *stats = sli_shared_get_stats;
+  sli_shared_get_unlock();
+}
+
+void sl_shared_get_print_stats(void)
+{
+  sl_shared_get_stats_t st;
+
+  sl_shared_get_get_stats(&st);
+  LOG_PRINTF("Shared Gets: %ld sent, %ld shared, %ld report copies\n",
+             st.sent,
+             st.shared,
+             st.reports);
+}
@@ -0,0 +1,140 @@
+/*******************************************************************************
+ * @file  sl_shared_get.h
+ * @brief Identical client Gets to a node share one radio transaction
+ *******************************************************************************
+ * # License
+ * <b>Copyright 2025 Silicon Laboratories Inc. www.silabs.com</b>
+ *******************************************************************************
+ *
+ * The licensor of this software is Silicon Laboratories Inc. Your use of this
+ * software is governed by the terms of Silicon Labs Master Software License
+ * Agreement (MSLA) available at
+ * www.silabs.com/about-us/legal/master-software-license-agreement. This
+ * software is distributed to you in Source Code format and is governed by the
+ * sections of the MSLA applicable to Source Code.
+ *
+ ******************************************************************************/
+#ifndef SL_SHARED_GET_H_
+#define SL_SHARED_GET_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "sl_uip_def.h"
+#include "sl_sleeptimer.h"
+#include "transport/sl_ts_param.h"
+#include "sl_bridge_temp_assoc.h"
+
+/**
+ * When several Z/IP clients poll the same node, each Get is forwarded over
+ * its client's temporary association and the node answers each one. A Get
+ * identical to one still waiting for its report (same bytes, node,
+ * endpoint and scheme) is not sent again: its client is added to the
+ * pending Get and gets a copy of the report the node sends to the first
+ * client.
+ *
+ * Only Gets without parameters of a few polled command classes are shared,
+ * their report is known and cannot depend on the request.
+ */
+
+/** Pending Gets that can be shared at the same time. */
+#ifndef SL_SHARED_GET_SIZE
+#define SL_SHARED_GET_SIZE 8
+#endif
+
+/** Clients that can follow one pending Get. */
+#ifndef SL_SHARED_GET_FOLLOWERS
+#define SL_SHARED_GET_FOLLOWERS 4
+#endif
+
+/** A sent Get stops taking followers when its report is this late. */
+#ifndef SL_SHARED_GET_TIMEOUT_MS
+#define SL_SHARED_GET_TIMEOUT_MS 3000
+#endif
+
+/** A Get whose transmit result is this late no longer holds its slot. */
+#ifndef SL_SHARED_GET_SEND_TIMEOUT_MS
+#define SL_SHARED_GET_SEND_TIMEOUT_MS 10000
+#endif
+
+typedef enum {
+  SL_SHARED_GET_SEND = 0, /**< Send the Get; identical ones may follow it. */
+  SL_SHARED_GET_FOLLOW,   /**< Identical Get on air, wait for sl_shared_get_sent(). */
+  SL_SHARED_GET_SENT,     /**< Identical Get delivered, only the report is due. */
+} sl_shared_get_result_t;
+
+typedef struct {
+  uint32_t sent;     /**< Shareable Gets sent to a node */
+  uint32_t shared;   /**< Gets that followed a pending identical one */
+  uint32_t reports;  /**< Report copies sent to followers */
+} sl_shared_get_stats_t;
+
+/**
+ * @brief Clear the pending Gets; called from sl_class_zip_node_init().
+ */
+void sl_shared_get_init(void);
+
+/**
+ * @brief Register a client Get about to be forwarded to a node.
+ *
+ * @param node Destination node.
+ * @param endpoint Destination endpoint.
+ * @param scheme Security scheme the Get is sent with.
+ * @param virtual_id Virtual node the Get is sent from, the report goes to it.
+ * @param client Temporary association of the client; resource_endpoint is
+ *               the client endpoint the report is sent to.
+ * @param data The Z-Wave command.
+ * @param len Length of data.
+ * @param session Reference of the caller's request, returned by
+ *                sl_shared_get_sent() to followers. Never NULL.
+ * @return What the caller must do with the Get.
+ */
+sl_shared_get_result_t sl_shared_get_begin(nodeid_t node,
+                                           uint8_t endpoint,
+                                           uint8_t scheme,
+                                           nodeid_t virtual_id,
+                                           const temp_association_t *client,
+                                           const uint8_t *data,
+                                           uint16_t len,
+                                           void *session);
+
+/**
+ * @brief Record the transmit result of a Get that returned SEND.
+ *
+ * Also called with ok false when the request of session ends without a
+ * transmit result, so its followers are not left waiting.
+ *
+ * @param session Reference passed to sl_shared_get_begin().
+ * @param ok The node acknowledged the Get.
+ * @param followers Filled with the references of the requests that
+ *                  returned FOLLOW; they complete with the same result.
+ * @param max Size of followers.
+ * @return Number of followers.
+ */
+int sl_shared_get_sent(void *session, bool ok, void **followers, int max);
+
+/**
+ * @brief Look for the clients following the Get a report answers.
+ *
+ * Called for every frame a node sends to a temporary association.
+ *
+ * @param p Receive parameters of the frame.
+ * @param data The Z-Wave command.
+ * @param len Length of data.
+ * @param clients Filled with the temporary associations of the followers.
+ * @param max Size of clients.
+ * @return Number of followers to send a copy of the report to.
+ */
+int sl_shared_get_report(const ts_param_t *p,
+                         const uint8_t *data,
+                         uint16_t len,
+                         temp_association_t *clients,
+                         int max);
+
+void sl_shared_get_get_stats(sl_shared_get_stats_t *stats);
+
+/**
+ * @brief Print the shared Get counters.
+ */
+void sl_shared_get_print_stats(void);
+
+#endif /* SL_SHARED_GET_H_ */
@@ -0,0 +1,404 @@
+/*******************************************************************************
+ * @file  sl_state_cache.c
+ * @brief Last known state of nodes, used to answer Gets without the radio
+ *******************************************************************************
+ * # License
+ * <b>Copyright 2025 Silicon Laboratories Inc. www.silabs.com</b>
+ *******************************************************************************
+ *
+ * The licensor of this software is Silicon Laboratories Inc. Your use of this
+ * software is governed by the terms of Silicon Labs Master Software License
+ * Agreement (MSLA) available at
+ * www.silabs.com/about-us/legal/master-software-license-agreement. This
+ * software is distributed to you in Source Code format and is governed by the
+ * sections of the MSLA applicable to Source Code.
+ *
+ ******************************************************************************/
+
+#include <string.h>
+#include "FreeRTOS.h"
+#include "cmsis_os2.h"
+#include "sl_common_log.h"
+#include "sl_router_events.h"
+#include "sl_status.h"
+#include "ZW_classcmd.h"
+#include "ZW_classcmd_ex.h"
+#include "Z-Wave/CC/RD_internal.h"
+#include "ip_translate/sl_zw_resource.h"
+#include "transport/sl_ts_common.h"
+#include "transport/sl_zw_send_request.h"
+#include "sl_classic_zip_node.h"
+#include "sl_state_cache.h"
+
+#define STATE_CACHE_REQUEST_TIMEOUT_MS 2000
+
+/* Refresh requests name their value, the slot may be reused meanwhile. */
+#define SLI_STATE_CACHE_KEY(node, ep, cc) \
+  (((uintptr_t) (node) << 16) | ((uintptr_t) (ep) << 8) | (cc))
+#define SLI_STATE_CACHE_KEY_NODE(k) ((nodeid_t) ((k) >> 16))
+#define SLI_STATE_CACHE_KEY_EP(k)   ((uint8_t) ((k) >> 8))
+#define SLI_STATE_CACHE_KEY_CC(k)   ((uint8_t) (k))
+
+sl_status_t zw_zip_post_event(uint32_t event, void *data);
+
+/* A Get without parameters and the report answering it. */
+typedef struct {
+  uint8_t cc;
+  uint8_t get;
+  uint8_t report;
+} sli_state_cache_cmd_t;
+
+typedef struct {
+  uint32_t tick;          // kernel tick of the report
+  nodeid_t node;
+  uint8_t endpoint;
+  uint8_t cc;
+  uint8_t report;
+  uint8_t len;
+  uint8_t scheme;         // security_scheme_t the report was received with
+  uint8_t in_use : 1;
+  uint8_t refresh : 1;    // background Get wanted
+  uint8_t refreshing : 1; // background Get outstanding
+  uint8_t data[SL_STATE_CACHE_DATA_LEN];
+} sli_state_cache_entry_t;
+
+/****************************************************************************/
+/*                            LOCAL VARIABLES                               */
+/****************************************************************************/
+
+static const sli_state_cache_cmd_t sli_state_cache_cmds[] = {
+  { COMMAND_CLASS_BASIC, BASIC_GET, BASIC_REPORT },
+  { COMMAND_CLASS_SWITCH_BINARY, SWITCH_BINARY_GET, SWITCH_BINARY_REPORT },
+  { COMMAND_CLASS_SWITCH_MULTILEVEL, SWITCH_MULTILEVEL_GET,
+    SWITCH_MULTILEVEL_REPORT },
+  { COMMAND_CLASS_BATTERY, BATTERY_GET, BATTERY_REPORT },
+  { COMMAND_CLASS_DOOR_LOCK, DOOR_LOCK_OPERATION_GET,
+    DOOR_LOCK_OPERATION_REPORT },
+  { COMMAND_CLASS_THERMOSTAT_MODE, THERMOSTAT_MODE_GET,
+    THERMOSTAT_MODE_REPORT },
+};
+
+static sli_state_cache_entry_t sli_state_cache[SL_STATE_CACHE_SIZE];
+static sl_state_cache_stats_t sli_state_cache_stats;
+static sl_state_cache_mode_t sli_state_cache_mode = SL_STATE_CACHE_MODE;
+static osMutexId_t sli_state_cache_mutex = NULL;
+
+/****************************************************************************/
+/*                            PRIVATE FUNCTIONS                             */
+/****************************************************************************/
+
+static void sli_state_cache_lock(void)
+{
+  if (sli_state_cache_mutex) {
+    osMutexAcquire(sli_state_cache_mutex, osWaitForever);
+  }
+}
+
+static void sli_state_cache_unlock(void)
+{
+  if (sli_state_cache_mutex) {
+    osMutexRelease(sli_state_cache_mutex);
+  }
+}
+
+static const sli_state_cache_cmd_t *sli_state_cache_cmd(uint8_t cc)
+{
+  for (uint32_t i = 0;
+       i < sizeof(sli_state_cache_cmds) / sizeof(sli_state_cache_cmds[0]);
+       i++) {
+    if (sli_state_cache_cmds[i].cc == cc) {
+      return &sli_state_cache_cmds[i];
+    }
+  }
+  return NULL;
+}
+
+static sli_state_cache_entry_t *sli_state_cache_find(nodeid_t node,
+                                                     uint8_t endpoint,
+                                                     uint8_t cc)
+{
+  for (int i = 0; i < SL_STATE_CACHE_SIZE; i++) {
+    sli_state_cache_entry_t *e = &sli_state_cache[i];
+    if (e->in_use && e->node == node && e->endpoint == endpoint
+        && e->cc == cc) {
+      return e;
+    }
+  }
+  return NULL;
+}
+
+/* Free entry, or the oldest one. */
+static sli_state_cache_entry_t *sli_state_cache_victim(uint32_t now)
+{
+  sli_state_cache_entry_t *oldest = &sli_state_cache[0];
+
+  for (int i = 0; i < SL_STATE_CACHE_SIZE; i++) {
+    sli_state_cache_entry_t *e = &sli_state_cache[i];
+    if (!e->in_use) {
+      return e;
+    }
+    if (now - e->tick > now - oldest->tick) {
+      oldest = e;
+    }
+  }
+  return oldest;
+}
+
+static bool sli_state_cache_is_sleeping(nodeid_t node)
+{
+  return (rd_get_node_mode(node) & 0xff) == MODE_MAILBOX;
+}
+
+static bool sli_state_cache_is_secure(uint8_t scheme)
+{
+  return scheme != NO_SCHEME && scheme != USE_CRC16;
+}
+
+/*
+ * Send the cached report e back to the client, age in seconds. Caller holds
+ * the lock.
+ */
+static void sli_state_cache_send(zwave_connection_t *c,
+                                 const sli_state_cache_entry_t *e,
+                                 uint32_t age)
+{
+  zwave_connection_t rc = *c;
+  uint8_t ext[4];
+
+  if (age > 0xFFFF) {
+    age = 0xFFFF;
+  }
+  ext[0] = SL_STATE_CACHE_EXT_AGE;
+  ext[1] = 2;
+  ext[2] = (uint8_t) (age >> 8);
+  ext[3] = (uint8_t) age;
+  // Same header as the report forwarded from the node.
+  rc.scheme = e->scheme;
+  sl_zw_send_data_udp_ext(&rc, e->data, e->len, NULL, NULL, FALSE,
+                          ext, sizeof(ext));
+}
+
+static int sli_state_cache_refresh_cb(BYTE txStatus,
+                                      BYTE rxStatus,
+                                      ZW_APPLICATION_TX_BUFFER *pCmd,
+                                      WORD cmdLength,
+                                      void *user)
+{
+  (void) txStatus;
+  (void) rxStatus;
+  (void) pCmd;
+  (void) cmdLength;
+  uintptr_t key = (uintptr_t) user;
+  sli_state_cache_entry_t *e;
+
+  // The report itself was stored by sl_state_cache_record().
+  sli_state_cache_lock();
+  e = sli_state_cache_find(SLI_STATE_CACHE_KEY_NODE(key),
+                           SLI_STATE_CACHE_KEY_EP(key),
+                           SLI_STATE_CACHE_KEY_CC(key));
+  if (e) {
+    e->refreshing = 0;
+  }
+  sli_state_cache_unlock();
+  return FALSE;
+}
+
+/****************************************************************************/
+/*                            PUBLIC FUNCTIONS                              */
+/****************************************************************************/
+
+void sl_state_cache_init(void)
+{
+  if (sli_state_cache_mutex == NULL) {
+    sli_state_cache_mutex = osMutexNew(NULL);
+  }
+  sli_state_cache_lock();
+  memset(sli_state_cache, 0, sizeof(sli_state_cache));
+  memset(&sli_state_cache_stats, 0, sizeof(sli_state_cache_stats));
+  sli_state_cache_unlock();
+}
+
+void sl_state_cache_set_mode(sl_state_cache_mode_t mode)
+{
+  sli_state_cache_mode = mode;
+}
+
+void sl_state_cache_record(const ts_param_t *p, const uint8_t *data, uint16_t len)
+{
+  const sli_state_cache_cmd_t *cmd;
+  sli_state_cache_entry_t *e;
+  uint32_t now;
+
+  if (sli_state_cache_mode == SL_STATE_CACHE_OFF || len < 2
+      || len > SL_STATE_CACHE_DATA_LEN) {
+    return;
+  }
+  cmd = sli_state_cache_cmd(data[0]);
+  if (cmd == NULL || data[1] != cmd->report) {
+    return;
+  }
+
+  now = osKernelGetTickCount();
+  sli_state_cache_lock();
+  e = sli_state_cache_find(p->snode, p->sendpoint, data[0]);
+  if (e == NULL) {
+    e = sli_state_cache_victim(now);
+    memset(e, 0, sizeof(*e));
+    e->in_use   = 1;
+    e->node     = p->snode;
+    e->endpoint = p->sendpoint;
+    e->cc       = data[0];
+  }
+  e->report  = data[1];
+  e->scheme  = (uint8_t) p->scheme;
+  e->len     = (uint8_t) len;
+  e->tick    = now;
+  e->refresh = 0;
+  memcpy(e->data, data, len);
+  sli_state_cache_stats.records++;
+  sli_state_cache_unlock();
+}
+
+bool sl_state_cache_answer(zwave_connection_t *c,
+                           nodeid_t node,
+                           bool ack_req,
+                           uint8_t flags1,
+                           const uint8_t *data,
+                           uint16_t len)
+{
+  const sli_state_cache_cmd_t *cmd;
+  sli_state_cache_entry_t *e;
+  sli_state_cache_entry_t copy;
+  bool sleeping, post = false;
+  uint32_t age;
+
+  if (sli_state_cache_mode == SL_STATE_CACHE_OFF || len < 2) {
+    return false;
+  }
+  cmd = sli_state_cache_cmd(data[0]);
+  if (cmd == NULL || data[1] == cmd->report) {
+    return false;
+  }
+
+  sli_state_cache_lock();
+  e = sli_state_cache_find(node, c->lendpoint, data[0]);
+  if (data[1] != cmd->get) {
+    // A Set or another command may change the value, ask the node next time.
+    if (e) {
+      e->in_use = 0;
+    }
+    sli_state_cache_unlock();
+    return false;
+  }
+
+  sleeping = sli_state_cache_is_sleeping(node);
+  age      = e ? osKernelGetTickCount() - e->tick : 0;
+  if (len != 2 || e == NULL
+      || (!sleeping && sli_state_cache_mode != SL_STATE_CACHE_ALL)
+      || (!sleeping && age >= pdMS_TO_TICKS(SL_STATE_CACHE_MAX_AGE_MS))
+      || (sli_state_cache_is_secure(e->scheme) && c->scheme == NO_SCHEME)) {
+    sli_state_cache_stats.misses++;
+    sli_state_cache_unlock();
+    return false;
+  }
+
+  copy = *e;
+  sli_state_cache_stats.hits++;
+
+  // A wake-up node is refreshed by its own reports when it wakes up.
+  if (!sleeping && age >= pdMS_TO_TICKS(SL_STATE_CACHE_FRESH_MS)
+      && !e->refreshing && !e->refresh) {
+    e->refresh = 1;
+    post       = true;
+  }
+  sli_state_cache_unlock();
+
+  // Sent from the copy, the router thread records reports meanwhile.
+  if (ack_req) {
+    SendUDPStatus(ZIP_PACKET_FLAGS0_ACK_RES, flags1, c);
+  }
+  sli_state_cache_send(c, &copy, age / configTICK_RATE_HZ);
+
+  if (post) {
+    zw_zip_post_event(ZIP_EVENT_STATE_CACHE_REFRESH, 0);
+  }
+  return true;
+}
+
+void sl_state_cache_refresh(void)
+{
+  for (int i = 0; i < SL_STATE_CACHE_SIZE; i++) {
+    const sli_state_cache_cmd_t *cmd;
+    sli_state_cache_entry_t *e = &sli_state_cache[i];
+    uintptr_t key;
+    uint8_t get[2];
+    ts_param_t p;
+
+    sli_state_cache_lock();
+    if (!e->in_use || !e->refresh || e->refreshing
+        || (cmd = sli_state_cache_cmd(e->cc)) == NULL) {
+      sli_state_cache_unlock();
+      continue;
+    }
+    e->refresh    = 0;
+    e->refreshing = 1;
+    get[0]        = cmd->cc;
+    get[1]        = cmd->get;
+    ts_set_std(&p, e->node);
+    p.dendpoint = e->endpoint;
+    key         = SLI_STATE_CACHE_KEY(e->node, e->endpoint, e->cc);
+    sli_state_cache_stats.refreshes++;
+    sli_state_cache_unlock();
+
+    if (!sl_zw_send_request(&p,
+                            get,
+                            sizeof(get),
+                            cmd->report,
+                            STATE_CACHE_REQUEST_TIMEOUT_MS,
+                            (void *) key,
+                            sli_state_cache_refresh_cb)) {
+      sli_state_cache_refresh_cb(TRANSMIT_COMPLETE_FAIL, 0, NULL, 0,
+                                 (void *) key);
+    }
+  }
+}
+
+void sl_state_cache_forget_node(nodeid_t node)
+{
+  sli_state_cache_lock();
+  for (int i = 0; i < SL_STATE_CACHE_SIZE; i++) {
+    if (sli_state_cache[i].node == node) {
+      sli_state_cache[i].in_use = 0;
+    }
+  }
+  sli_state_cache_unlock();
+}
+
+void sl_state_cache_get_stats(sl_state_cache_stats_t *stats)
+{
+  sli_state_cache_lock();
+  *stats = sli_state_cache_stats;
+  sli_state_cache_unlock();
+}
+
+void sl_state_cache_print_stats(void)
+{
+  sl_state_cache_stats_t st;
+  uint32_t used = 0;
+
+  sli_state_cache_lock();
+  st = sli_state_cache_stats;
+  for (int i = 0; i < SL_STATE_CACHE_SIZE; i++) {
+    used += sli_state_cache[i].in_use;
+  }
+  sli_state_cache_unlock();
+  LOG_PRINTF("State cache: mode %d, %ld/%d values\n",
+             (int) sli_state_cache_mode,
+             used,
+             SL_STATE_CACHE_SIZE);
+  LOG_PRINTF("  hits %ld misses %ld records %ld refreshes %ld\n",
+             st.hits,
+             st.misses,
+             st.records,
+             st.refreshes);
+}
@@ -0,0 +1,139 @@
+/*******************************************************************************
+ * @file  sl_state_cache.h
+ * @brief Last known state of nodes, used to answer Gets without the radio
+ *******************************************************************************
+ * # License
+ * <b>Copyright 2025 Silicon Laboratories Inc. www.silabs.com</b>
+ *******************************************************************************
+ *
+ * The licensor of this software is Silicon Laboratories Inc. Your use of this
+ * software is governed by the terms of Silicon Labs Master Software License
+ * Agreement (MSLA) available at
+ * www.silabs.com/about-us/legal/master-software-license-agreement. This
+ * software is distributed to you in Source Code format and is governed by the
+ * sections of the MSLA applicable to Source Code.
+ *
+ ******************************************************************************/
+#ifndef SL_STATE_CACHE_H_
+#define SL_STATE_CACHE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "ZW_udp_server.h"
+#include "transport/sl_ts_param.h"
+
+/**
+ * The cache keeps the last report of a few state command classes (Basic,
+ * Binary/Multilevel Switch, Battery, Door Lock, Thermostat Mode) per node
+ * and endpoint. A Z/IP client Get for such a value can then be answered by
+ * the gateway: a wake-up node may sleep for hours, so otherwise the Get
+ * waits in the mailbox until the node wakes up.
+ *
+ * Answers carry a non-critical header extension with the age of the value,
+ * see #SL_STATE_CACHE_EXT_AGE. Clients that do not know it ignore it.
+ *
+ * Only Gets without parameters are answered; a Set to a cached command
+ * class drops the value.
+ */
+
+/** Number of cached values. The oldest one is replaced when full. */
+#ifndef SL_STATE_CACHE_SIZE
+#define SL_STATE_CACHE_SIZE 64
+#endif
+
+/** Longest report payload kept, command class and command included. */
+#define SL_STATE_CACHE_DATA_LEN 16
+
+/** Values older than this are refreshed in the background after a hit. */
+#ifndef SL_STATE_CACHE_FRESH_MS
+#define SL_STATE_CACHE_FRESH_MS 30000
+#endif
+
+/** Listening nodes are only answered from values younger than this. */
+#ifndef SL_STATE_CACHE_MAX_AGE_MS
+#define SL_STATE_CACHE_MAX_AGE_MS 300000
+#endif
+
+/**
+ * Z/IP header extension option carrying the age of a cached value in
+ * seconds (2 bytes, saturated at 0xFFFF). Gateway specific, never critical.
+ */
+#define SL_STATE_CACHE_EXT_AGE 0x7E
+
+typedef enum {
+  SL_STATE_CACHE_OFF = 0,   /**< Every Get goes to the node. */
+  SL_STATE_CACHE_SLEEPING,  /**< Answer Gets for wake-up nodes only. */
+  SL_STATE_CACHE_ALL,       /**< Answer Gets for all nodes. */
+} sl_state_cache_mode_t;
+
+#ifndef SL_STATE_CACHE_MODE
+#define SL_STATE_CACHE_MODE SL_STATE_CACHE_SLEEPING
+#endif
+
+typedef struct {
+  uint32_t hits;       /**< Gets answered from the cache */
+  uint32_t misses;     /**< Cacheable Gets forwarded to the node */
+  uint32_t records;    /**< Reports stored */
+  uint32_t refreshes;  /**< Background Gets sent to refresh a value */
+} sl_state_cache_stats_t;
+
+/**
+ * @brief Clear the cache; called from sl_class_zip_node_init().
+ */
+void sl_state_cache_init(void);
+
+/**
+ * @brief Select which nodes are answered from the cache.
+ */
+void sl_state_cache_set_mode(sl_state_cache_mode_t mode);
+
+/**
+ * @brief Store a report received from a node, if it is cacheable.
+ *
+ * @param p Receive parameters of the frame.
+ * @param data The unencapsulated command.
+ * @param len Length of data.
+ */
+void sl_state_cache_record(const ts_param_t *p, const uint8_t *data, uint16_t len);
+
+/**
+ * @brief Answer a Z/IP client command from the cache.
+ *
+ * Called for every command a client sends to a node. Sets to a cached
+ * command class drop the value and return false.
+ *
+ * @param c Connection of the request, the answer goes back on it.
+ * @param node Destination node of the request.
+ * @param ack_req The request asked for a Z/IP ACK.
+ * @param flags1 flags1 of the request, echoed in the ACK.
+ * @param data The Z-Wave command of the request.
+ * @param len Length of data.
+ * @return true if the request was answered and must not go to the node.
+ */
+bool sl_state_cache_answer(zwave_connection_t *c,
+                           nodeid_t node,
+                           bool ack_req,
+                           uint8_t flags1,
+                           const uint8_t *data,
+                           uint16_t len);
+
+/**
+ * @brief Send the background Gets requested by sl_state_cache_answer().
+ *
+ * Runs in the Z/IP router thread on #ZIP_EVENT_STATE_CACHE_REFRESH.
+ */
+void sl_state_cache_refresh(void);
+
+/**
+ * @brief Drop every value of a node, e.g. when it leaves the network.
+ */
+void sl_state_cache_forget_node(nodeid_t node);
+
+void sl_state_cache_get_stats(sl_state_cache_stats_t *stats);
+
+/**
+ * @brief Print the cache counters and the number of values held.
+ */
+void sl_state_cache_print_stats(void);
+
+#endif /* SL_STATE_CACHE_H_ */
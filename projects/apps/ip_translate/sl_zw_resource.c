@@ -15,6 +15,7 @@
  *
  ******************************************************************************/
 #include <stdlib.h>
+#include <stddef.h>
 #include <strings.h>
 #include <stdio.h>
 #include <stdbool.h>
@@ -27,18 +28,25 @@
 #include "Serialapi.h"
 #include "utls/sl_node_sec_flags.h"
 #include "modules/sl_rd_data_store.h"
+#include "modules/sl_airtime_budget.h"
 #include "sl_zw_resource.h"
 #include "ZW_transport_api.h"
 #include "ZW_classcmd.h"
 #include "sl_uip_def.h"
 #include "apps/Z-Wave/CC/CC_NetworkManagement.h"
 #include "apps/Z-Wave/CC/RD_internal.h"
+#include "apps/Z-Wave/CC/RD_name_index.h"
+#include "apps/Z-Wave/CC/RD_profile.h"
 #include "apps/transport/sl_zw_send_request.h"
 #include "apps/transport/sl_ts_common.h"
 #include "sl_rd_types.h"
+#include "sl_router_events.h"
 #include "sl_sleeptimer.h"
 #include "ip_bridge/sl_bridge.h"
+#include "ip_bridge/sl_state_cache.h"
+#include "ip_bridge/sl_mailbox.h"
 #include "threads/sl_zw_netif.h"
+#include "modules/sl_block_pool.h"
 
 //This is 2000ms
 #define SL_REQUEST_TIMEOUT_MS 2000
@@ -66,6 +74,11 @@ uint8_t suc_changed = 0;
 void rd_node_probe_update(rd_node_database_entry_t *data);
 void rd_ep_probe_update(rd_ep_database_entry_t *ep);
 void send_suc_id(uint8_t);
+sl_status_t zw_zip_try_post_event(uint32_t event, void *data);
+
+/* Node info of the gateway, built by sl_application_nif_init(). */
+extern BYTE MyNIF[];
+extern BYTE MyNIFLen;
 
 /** Check if endpoint supports a command class non-securely.
  *
@@ -88,7 +101,7 @@ typedef struct node_probe_done_notifier {
   nodeid_t node_id;
 } node_probe_done_notifier_t;
 
-#define NUM_PROBES 1
+#define NUM_PROBES RD_PROBE_MAX_ACTIVE
 
 /** Storage for callbacks to clients that want notification when a
  * node probe is completed.
@@ -132,7 +145,7 @@ void rd_set_failing(rd_node_database_entry_t *n, uint8_t failing)
     n->mode |= (n->state == STATUS_FAILING) ? MODE_FLAGS_FAILED : 0;
 
     /*Persisting the Failing Node state*/
-    rd_data_store_update(n);
+    rd_data_store_mark_dirty(n, RD_DIRTY_NODE);
 
     sl_nm_node_failed_to_unsolicited();
   }
@@ -158,16 +171,14 @@ void rd_set_failing(rd_node_database_entry_t *n, uint8_t failing)
 clock_time_t rd_calculate_inclusion_timeout(BOOL is_controller)
 {
   clock_time_t timeout = 76000;
-  rd_node_database_entry_t *n;
+  rd_node_hot_t hot;
 
   for (nodeid_t i = 1; i <= ZW_MAX_NODES; i++) {
-    n = rd_node_get_raw(i);
-
-    if (!n) {
+    if (!rd_node_hot_get(i, &hot)) {
       continue;
     }
 
-    if (is_virtual_node(n->nodeid)) {
+    if (is_virtual_node(i)) {
       continue;
     }
 
@@ -175,11 +186,11 @@ clock_time_t rd_calculate_inclusion_timeout(BOOL is_controller)
       timeout += 732;
     }
 
-    if ((n->mode & 0xff) == MODE_FREQUENTLYLISTENING) {
+    if ((hot.mode & 0xff) == MODE_FREQUENTLYLISTENING) {
       timeout += 3517;
     }
 
-    if ((n->mode & 0xff) == MODE_ALWAYSLISTENING) {
+    if ((hot.mode & 0xff) == MODE_ALWAYSLISTENING) {
       timeout += 217;
     }
   }
@@ -189,6 +200,314 @@ clock_time_t rd_calculate_inclusion_timeout(BOOL is_controller)
   return timeout;
 }
 
+/*Used when a get node info is pending */
+static rd_ep_database_entry_t *nif_request_ep = 0;
+
+/* Give up on the node info of an endpoint interview. */
+#define RD_NIF_REQUEST_TIMEOUT_MS 5000
+
+/* Give up on a node info asked for by rd_full_network_discovery(). */
+#define RD_NIF_CHECK_TIMEOUT_MS 3000
+/* Wait before asking again when the request could not be sent. */
+#define RD_NIF_CHECK_RETRY_MS 1000
+
+/* Nodes whose node info rd_full_network_discovery() has yet to ask for,
+ * and the node asked now. */
+static nodemask_t sli_rd_nif_check;
+static nodeid_t sli_rd_nif_check_node;
+static sl_sleeptimer_timer_handle_t sli_rd_nif_check_timer;
+
+/* Failed nodes interviewed again because they sent their node info. Such
+ * a node is only tried once this way until an interview of it completes;
+ * rd_full_network_discovery() tries the others. */
+static nodemask_t sli_rd_nif_retried;
+
+/* Wait before asking again to assign a return route. */
+#define RD_PROBE_ROUTE_RETRY_MS 1000
+
+/* Wait before a timer posts its event again when the router queue is full. */
+#define RD_TIMER_EVENT_RETRY_MS 100
+
+/* Called from timer callback cb of timer: rd_lock() cannot be taken there,
+ * so hand the event to the router thread, or try again shortly. */
+static void sli_rd_timer_post(sl_sleeptimer_timer_handle_t *timer,
+                              sl_sleeptimer_timer_callback_t cb,
+                              uint32_t event,
+                              void *data)
+{
+  if (zw_zip_try_post_event(event, data) != SL_STATUS_OK) {
+    sl_sleeptimer_start_timer_ms(timer,
+                                 RD_TIMER_EVENT_RETRY_MS,
+                                 cb,
+                                 data,
+                                 1,
+                                 0);
+  }
+}
+
+/* The timer is running, an event it posted before is stale. */
+static bool sli_rd_timer_running(sl_sleeptimer_timer_handle_t *timer)
+{
+  bool running = false;
+
+  sl_sleeptimer_is_timer_running(timer, &running);
+  return running;
+}
+
+/** The interview of one node.
+ *
+ * Used to determine if the probe machine is busy.  I.e., it should
+ * not be cleared before all nodes are in one of the terminal states.
+ *
+ * The timer watches for an interview that stopped making progress, or
+ * continues a step that had to wait for airtime.
+ */
+typedef struct {
+  rd_node_database_entry_t *n;   /* NULL when the slot is free */
+  rd_ep_database_entry_t *ep;    /* Endpoint step waiting, NULL for the node */
+  uint32_t started;              /* clock_time() at start */
+  uint8_t waiting;               /* The timer continues a step */
+  uint8_t held;                  /* Stopped by the probe lock */
+  uint8_t id_step;               /* SLI_RD_ID_x, how far the model is known */
+  uint8_t from_profile;          /* Filled in by rd_profile_apply() */
+  rd_profile_id_t id;
+  sl_sleeptimer_timer_handle_t timer;
+} sli_rd_probe_t;
+
+/* Identification of the device model in STATUS_PROBE_PRODUCT_ID. */
+#define SLI_RD_ID_NONE    0
+#define SLI_RD_ID_VENDOR  1 /* Manufacturer specific report is in */
+#define SLI_RD_ID_DONE    2 /* Version report is in, id is complete */
+
+static sli_rd_probe_t sli_rd_probes[RD_PROBE_MAX_ACTIVE];
+static sl_airtime_budget_t sli_rd_probe_budget;
+static rd_probe_stats_t sli_rd_probe_stats;
+/* Set by the scheduler bench, see rd_probe_set_stubs(). */
+static const rd_probe_stubs_t *sli_rd_probe_stubs;
+
+/** The node assigned a return route. ZW_AssignReturnRoute() has no user
+ * argument, so only one interview at a time does this, and a node must
+ * not be removed (rd_remove_node()) while it is in progress.
+ */
+static rd_node_database_entry_t *sli_rd_route_entry = 0;
+
+static sli_rd_probe_t *sli_rd_probe_find(const rd_node_database_entry_t *n)
+{
+  for (int i = 0; n && i < RD_PROBE_MAX_ACTIVE; i++) {
+    if (sli_rd_probes[i].n == n) {
+      return &sli_rd_probes[i];
+    }
+  }
+  return NULL;
+}
+
+static uint8_t sli_rd_probe_active(void)
+{
+  uint8_t cnt = 0;
+
+  for (int i = 0; i < RD_PROBE_MAX_ACTIVE; i++) {
+    if (sli_rd_probes[i].n) {
+      cnt++;
+    }
+  }
+  return cnt;
+}
+
+static void sli_rd_probe_timeout(sl_sleeptimer_timer_handle_t *handle,
+                                 void *user);
+
+static void sli_rd_probe_watch(sli_rd_probe_t *pr)
+{
+  pr->waiting = 0;
+  pr->ep      = NULL;
+  sl_sleeptimer_start_timer_ms(&pr->timer,
+                               RD_PROBE_STALL_MS,
+                               sli_rd_probe_timeout,
+                               pr,
+                               1,
+                               0);
+}
+
+/* Continue the step of ep, or of the node if ep is NULL, after ms. */
+static void sli_rd_probe_wait(sli_rd_probe_t *pr,
+                              rd_ep_database_entry_t *ep,
+                              uint32_t ms)
+{
+  pr->waiting = 1;
+  pr->ep      = ep;
+  sl_sleeptimer_start_timer_ms(&pr->timer,
+                               ms,
+                               sli_rd_probe_timeout,
+                               pr,
+                               1,
+                               0);
+}
+
+/* Interview slots in use, fewer while the bench runs on stubs. */
+static uint8_t sli_rd_probe_slots(void)
+{
+  return sli_rd_probe_stubs ? sli_rd_probe_stubs->slots : RD_PROBE_MAX_ACTIVE;
+}
+
+/* Start an interview of n, leaving reserve slots free. */
+static sli_rd_probe_t *sli_rd_probe_start(rd_node_database_entry_t *n,
+                                          uint8_t reserve)
+{
+  sli_rd_probe_t *pr = NULL;
+  uint8_t active     = 0;
+
+  for (int i = 0; i < RD_PROBE_MAX_ACTIVE; i++) {
+    if (sli_rd_probes[i].n) {
+      active++;
+    } else if (!pr) {
+      pr = &sli_rd_probes[i];
+    }
+  }
+  if (!pr || (active + reserve >= sli_rd_probe_slots())) {
+    return NULL;
+  }
+  pr->n            = n;
+  pr->held         = 0;
+  pr->id_step      = SLI_RD_ID_NONE;
+  pr->from_profile = 0;
+  pr->started      = clock_time();
+  sli_rd_probe_watch(pr);
+
+  sli_rd_probe_stats.started++;
+  if (++active > sli_rd_probe_stats.peak) {
+    sli_rd_probe_stats.peak = active;
+  }
+  DBG_PRINTF("Interview of node %d started, %d running\n", n->nodeid, active);
+  return pr;
+}
+
+static void sli_rd_probe_end(sli_rd_probe_t *pr)
+{
+  sl_sleeptimer_stop_timer(&pr->timer);
+  if (nif_request_ep && (nif_request_ep->node == pr->n)) {
+    nif_request_ep = 0;
+    sl_sleeptimer_stop_timer(&nif_request_timer);
+  }
+  pr->n       = NULL;
+  pr->ep      = NULL;
+  pr->waiting = 0;
+  pr->held    = 0;
+}
+
+static void sli_rd_probe_end_all(void)
+{
+  for (int i = 0; i < RD_PROBE_MAX_ACTIVE; i++) {
+    if (sli_rd_probes[i].n) {
+      sli_rd_probe_end(&sli_rd_probes[i]);
+    }
+  }
+}
+
+/* Take the airtime of the next step, or wait for it on the interview timer.
+ * A step that turns out to send nothing is charged all the same. */
+static bool sli_rd_probe_airtime(sli_rd_probe_t *pr, rd_ep_database_entry_t *ep)
+{
+  uint32_t wait = sl_airtime_budget_take(&sli_rd_probe_budget,
+                                         RD_PROBE_STEP_AIRTIME_MS,
+                                         clock_time());
+
+  if (wait) {
+    sli_rd_probe_stats.deferred++;
+    sli_rd_probe_wait(pr, ep, wait);
+    return false;
+  }
+  sli_rd_probe_watch(pr);
+  return true;
+}
+
+static void sli_rd_probe_timeout(sl_sleeptimer_timer_handle_t *handle,
+                                 void *user)
+{
+  sli_rd_timer_post(handle, sli_rd_probe_timeout, ZIP_EVENT_RD_PROBE_TIMEOUT,
+                    user);
+}
+
+static void sli_rd_probe_timeout_locked(void *slot)
+{
+  sli_rd_probe_t *pr = NULL;
+  rd_node_database_entry_t *n;
+  rd_ep_database_entry_t *ep;
+
+  for (int i = 0; i < RD_PROBE_MAX_ACTIVE; i++) {
+    if (slot == &sli_rd_probes[i]) {
+      pr = &sli_rd_probes[i];
+    }
+  }
+  /* Ended, held or watched again since the timer expired. */
+  if (!pr || !pr->n || pr->held || sli_rd_timer_running(&pr->timer)) {
+    return;
+  }
+  n  = pr->n;
+  ep = pr->ep;
+  if (pr->waiting) {
+    pr->waiting = 0;
+    pr->ep      = NULL;
+    if (ep) {
+      rd_ep_probe_update(ep);
+    } else {
+      rd_node_probe_update(n);
+    }
+    return;
+  }
+  ERR_PRINTF("Interview of node %d stalled in %s\n",
+             n->nodeid,
+             rd_node_probe_state_name(n->state));
+  sli_rd_probe_stats.stalled++;
+  n->state = STATUS_PROBE_FAIL;
+  rd_node_probe_update(n);
+}
+
+void rd_probe_timeout(void *slot)
+{
+  rd_lock();
+  sli_rd_probe_timeout_locked(slot);
+  rd_unlock();
+}
+
+/* Interview steps that send a request. */
+static bool sli_rd_node_step_sends(rd_node_state_t state)
+{
+  switch (state) {
+    case STATUS_PROBE_PRODUCT_ID:
+    case STATUS_ENUMERATE_ENDPOINTS:
+    case STATUS_FIND_ENDPOINTS:
+    case STATUS_GET_WU_CAP:
+    case STATUS_SET_WAKE_UP_INTERVAL:
+    case STATUS_ASSIGN_RETURN_ROUTE:
+    case STATUS_PROBE_WAKE_UP_INTERVAL:
+      return true;
+    default:
+      return false;
+  }
+}
+
+static bool sli_rd_ep_step_sends(int state)
+{
+  switch (state) {
+    case EP_STATE_PROBE_AGGREGATED_ENDPOINTS:
+    case EP_STATE_PROBE_INFO:
+    case EP_STATE_PROBE_SEC2_C2_INFO:
+    case EP_STATE_PROBE_SEC2_C1_INFO:
+    case EP_STATE_PROBE_SEC2_C0_INFO:
+    case EP_STATE_PROBE_SEC0_INFO:
+    case EP_STATE_PROBE_ZWAVE_PLUS:
+      return true;
+    default:
+      return false;
+  }
+}
+
+bool rd_node_is_busy(const rd_node_database_entry_t *n)
+{
+  return sli_rd_probe_find(n) || (n == sli_rd_route_entry)
+         || (nif_request_ep && (nif_request_ep->node == n));
+}
+
 static uint8_t rd_add_endpoint(rd_node_database_entry_t *n, BYTE epid)
 {
   rd_ep_database_entry_t *ep;
@@ -293,6 +612,7 @@ static int rd_probe_vendor_callback(BYTE txStatus,
   (void) cmdLength;
 
   rd_node_database_entry_t *e = (rd_node_database_entry_t *) user;
+  sli_rd_probe_t *pr          = sli_rd_probe_find(e);
 
   if (txStatus == TRANSMIT_COMPLETE_OK) {
     e->manufacturerID =
@@ -303,6 +623,15 @@ static int rd_probe_vendor_callback(BYTE txStatus,
     e->productType = pCmd->ZW_ManufacturerSpecificReportFrame.productTypeId1
                      << 8
                      | pCmd->ZW_ManufacturerSpecificReportFrame.productTypeId2;
+    if (pr && e->state == STATUS_PROBE_PRODUCT_ID) {
+      /* Ask for the firmware version before looking for a profile. */
+      pr->id.manufacturer = e->manufacturerID;
+      pr->id.product_type = e->productType;
+      pr->id.product_id   = e->productID;
+      pr->id_step         = SLI_RD_ID_VENDOR;
+      rd_node_probe_update(e);
+      return 0;
+    }
   } else {
     ERR_PRINTF("rd_probe_vendor_callback: manufacturer report received fail\n");
   }
@@ -313,6 +642,49 @@ static int rd_probe_vendor_callback(BYTE txStatus,
   return 0;
 }
 
+/* The model of e is known. Skip the endpoint interview if a profile of
+ * the model fills it in. */
+static void sli_rd_node_probe_identified(rd_node_database_entry_t *e,
+                                         sli_rd_probe_t *pr)
+{
+  if ((e->security_flags & (NODE_FLAG_INFO_ONLY | NODE_FLAG_KNOWN_BAD)) == 0
+      && rd_profile_apply(e, &pr->id)) {
+    pr->from_profile = 1;
+    e->state         = STATUS_CHECK_WU_CC_VERSION;
+  } else {
+    e->state = STATUS_ENUMERATE_ENDPOINTS;
+  }
+  rd_node_probe_update(e);
+}
+
+static int rd_probe_version_callback(BYTE txStatus,
+                                     BYTE rxStatus,
+                                     ZW_APPLICATION_TX_BUFFER *pCmd,
+                                     WORD cmdLength,
+                                     void *user)
+{
+  (void) rxStatus;
+
+  rd_node_database_entry_t *e = (rd_node_database_entry_t *) user;
+  sli_rd_probe_t *pr          = sli_rd_probe_find(e);
+
+  if (!pr || e->state != STATUS_PROBE_PRODUCT_ID) {
+    return 0;
+  }
+  if (txStatus == TRANSMIT_COMPLETE_OK
+      && cmdLength >= sizeof(ZW_VERSION_REPORT_FRAME)) {
+    pr->id.fw_version = pCmd->ZW_VersionReportFrame.applicationVersion << 8
+                        | pCmd->ZW_VersionReportFrame.applicationSubVersion;
+    pr->id_step       = SLI_RD_ID_DONE;
+    sli_rd_node_probe_identified(e, pr);
+    return 0;
+  }
+  ERR_PRINTF("rd_probe_version_callback: version report received fail\n");
+  e->state = STATUS_ENUMERATE_ENDPOINTS;
+  rd_node_probe_update(e);
+  return 0;
+}
+
 void find_report_timed_out(sl_sleeptimer_timer_handle_t *handle, void *user)
 {
   (void) handle;
@@ -417,6 +789,7 @@ static int rd_ep_get_callback(BYTE txStatus,
       while (ep0->list) {
         ep        = ep0->list;
         ep0->list = ep->list;
+        rd_name_index_remove_ep(ep);
         rd_store_mem_free_ep(ep);
       }
 
@@ -539,7 +912,7 @@ static int rd_ep_aggregated_members_get_callback(BYTE txStatus,
     if (ep->endpoint_agg) {
       rd_data_mem_free(ep->endpoint_agg);
     }
-    ep->endpoint_agg = rd_data_mem_alloc(n);
+    ep->endpoint_agg = rd_data_mem_alloc_cold(SL_PSRAM_POOL_RD_INFO, n);
     if (!ep->endpoint_agg) {
       ERR_PRINTF("Out of memory\n");
       ep->state = EP_STATE_PROBE_FAIL;
@@ -568,17 +941,33 @@ static int rd_ep_capability_get_callback(BYTE txStatus,
   (void) cmdLength;
 
   rd_ep_database_entry_t *ep = (rd_ep_database_entry_t *) user;
+  uint32_t digest;
 
   if (txStatus == TRANSMIT_COMPLETE_OK
       && ep->endpoint_id
       == (pCmd->ZW_MultiChannelCapabilityReport1byteV4Frame.properties1
           & 0x7F)) {
+    digest = rd_capability_digest(
+      &(pCmd->ZW_MultiChannelCapabilityReport1byteV4Frame.genericDeviceClass),
+      cmdLength - 3);
+    /* The secure classes and icons found for the same capabilities still
+     * hold, unless the node was included again. */
+    if (digest == ep->cap_digest && ep->endpoint_info
+        && !(ep->node->node_properties_flags & RD_NODE_FLAG_JUST_ADDED)) {
+      DBG_PRINTF("Endpoint %d of node %d is unchanged\n",
+                 ep->endpoint_id, ep->node->nodeid);
+      sli_rd_probe_stats.ep_reused++;
+      ep->state = EP_STATE_MDNS_PROBE;
+      rd_ep_probe_update(ep);
+      return 0;
+    }
     if (ep->endpoint_info) {
       rd_data_mem_free(ep->endpoint_info);
     }
     ep->endpoint_info_len = 0;
 
-    ep->endpoint_info = rd_data_mem_alloc(cmdLength - 3);
+    ep->endpoint_info = rd_data_mem_alloc_cold(SL_PSRAM_POOL_RD_INFO,
+                                               cmdLength - 3);
     WRN_PRINTF("Storing %i bytes epid = %i\n", cmdLength - 3, ep->endpoint_id);
     if (ep->endpoint_info) {
       memcpy(ep->endpoint_info,
@@ -586,10 +975,12 @@ static int rd_ep_capability_get_callback(BYTE txStatus,
                .genericDeviceClass),
              cmdLength - 3);
       ep->endpoint_info_len = cmdLength - 3;
+      ep->cap_digest        = digest;
       ep->state             = EP_STATE_PROBE_SEC2_C2_INFO;
     } else {
       ep->state = EP_STATE_PROBE_FAIL;
     }
+    rd_ep_class_index(ep);
   } else {
     ep->state = EP_STATE_PROBE_FAIL;
   }
@@ -640,7 +1031,8 @@ static void sli_rd_ep_secure_commands_done(uint8_t cmdLength,
   if (cmdLength > header_len) {
     /*Reallocate the node info to hold the security nif*/
     uint8_t *p =
-      rd_data_mem_alloc(ep->endpoint_info_len + 2 + cmdLength - header_len);
+      rd_data_mem_alloc_cold(SL_PSRAM_POOL_RD_INFO,
+                             ep->endpoint_info_len + 2 + cmdLength - header_len);
     if (!p) {
       return;
     }
@@ -658,6 +1050,7 @@ static void sli_rd_ep_secure_commands_done(uint8_t cmdLength,
 
     memcpy(p, &((BYTE *) pCmd)[header_len], cmdLength - header_len);
     ep->endpoint_info_len += 2 + cmdLength - header_len;
+    rd_ep_class_index(ep);
   }
 
   if (ep->endpoint_id == 0) {
@@ -737,36 +1130,23 @@ static int rd_ep_secure_commands_get_callback(BYTE txStatus,
   return 0;
 }
 
-/*Used when a get node info is pending */
-static rd_ep_database_entry_t *nif_request_ep = 0;
-
-/** The node currently being probed (pan side or mdns).
- *
- * Used to determine if the probe machine is busy.  I.e., it should
- * not be cleared before all nodes are in one of the terminal states.
- *
- * Used by assign return route, node_info_request_timeout(),
- * rd_endpoint_name_probe_done() to determine which node the callback
- * concerns.  I.e., a node must not be removed (rd_remove_node())
- * while these operations are in progress.
- *
- */
-static rd_node_database_entry_t *current_probe_entry = 0;
-
 static void sli_rd_nif_request_notf_done(rd_ep_database_entry_t *ep,
                                          uint8_t *nif,
                                          uint8_t nif_len)
 {
   if (!ep->endpoint_info) {
+    rd_ep_class_index(ep);
     ep->state = EP_STATE_PROBE_FAIL;
     return;
   }
   memcpy(ep->endpoint_info, nif + 1, nif_len - 1);
+  ep->cap_digest = rd_capability_digest(nif + 1, nif_len - 1);
 
   ep->endpoint_info[nif_len - 1] = COMMAND_CLASS_ZIP_NAMING;
   ep->endpoint_info[nif_len]     = COMMAND_CLASS_ZIP;
 
   ep->endpoint_info_len = nif_len + 1;
+  rd_ep_class_index(ep);
 
   /* If node is just added and GW is inclusion controller, we
    * are still trying to determine security classes. */
@@ -796,6 +1176,188 @@ static void sli_rd_nif_request_notf_done(rd_ep_database_entry_t *ep,
   ep->state++;
 }
 
+/*
+ * Digest of a node info of node, or 0 if it cannot be compared. A node
+ * interviewed before the digest was stored gets it here if its node info
+ * is still the one in the RD: the root endpoint must hold exactly the
+ * classes of nif and the Z/IP classes added by
+ * sli_rd_nif_request_notf_done(). Nodes with secure classes are not
+ * matched and are interviewed again.
+ */
+static uint32_t sli_rd_nif_digest_known(nodeid_t node,
+                                        const uint8_t *nif,
+                                        uint8_t nif_len,
+                                        uint32_t digest)
+{
+  rd_node_database_entry_t *n;
+  rd_ep_database_entry_t *ep0;
+  uint32_t known = 0;
+
+  n = rd_get_node_dbe(node);
+  if (!n) {
+    return 0;
+  }
+  ep0 = list_head(n->endpoints);
+  if (ep0 && ep0->endpoint_id == 0 && ep0->endpoint_info
+      && ep0->endpoint_info_len == nif_len + 1
+      && memcmp(ep0->endpoint_info, nif + 1, nif_len - 1) == 0
+      && ep0->endpoint_info[nif_len - 1] == COMMAND_CLASS_ZIP_NAMING
+      && ep0->endpoint_info[nif_len] == COMMAND_CLASS_ZIP) {
+    ep0->cap_digest = digest;
+    rd_data_store_mark_ep_dirty(ep0, RD_DIRTY_EP);
+    known = digest;
+  }
+  rd_free_node_dbe(n);
+  return known;
+}
+
+/* A node info that no interview asked for. */
+static void sli_rd_nif_received(nodeid_t node, uint8_t *nif, uint8_t nif_len)
+{
+  rd_node_hot_t hot;
+  uint32_t digest;
+
+  if (nif_len < 2 || node == MyNodeID || !rd_node_hot_get(node, &hot)) {
+    return;
+  }
+  digest = rd_capability_digest(nif + 1, nif_len - 1);
+  if (hot.state == STATUS_DONE || hot.state == STATUS_FAILING) {
+    rd_node_is_alive(node);
+    if (hot.nif_digest == 0) {
+      hot.nif_digest = sli_rd_nif_digest_known(node, nif, nif_len, digest);
+    }
+    if (hot.nif_digest == digest) {
+      sli_rd_probe_stats.nif_same++;
+      return;
+    }
+    LOG_PRINTF("Node info of node %d changed, interviewing it again\n", node);
+  } else if (hot.state == STATUS_PROBE_FAIL) {
+    if (nodemask_test_node(node, sli_rd_nif_retried)) {
+      return;
+    }
+    nodemask_add_node(node, sli_rd_nif_retried);
+    DBG_PRINTF("Node %d sent its node info, interviewing it again\n", node);
+  } else {
+    /* Being interviewed */
+    return;
+  }
+  sli_rd_probe_stats.nif_new++;
+  rd_register_new_node(node, 0x00);
+}
+
+static void sli_rd_nif_check_timeout(sl_sleeptimer_timer_handle_t *handle,
+                                     void *user);
+
+/* Ask the next node of sli_rd_nif_check for its node info. */
+static void sli_rd_nif_check_next(void)
+{
+  rd_node_hot_t hot;
+  uint32_t wait;
+
+  sl_sleeptimer_stop_timer(&sli_rd_nif_check_timer);
+  sli_rd_nif_check_node = 0;
+  for (nodeid_t i = 1; i <= ZW_LR_MAX_NODE_ID_IN_NVM; i++) {
+    if (!nodemask_test_node(i, sli_rd_nif_check)) {
+      continue;
+    }
+    if (!rd_node_hot_get(i, &hot)
+        || (hot.state != STATUS_DONE && hot.state != STATUS_FAILING)) {
+      /* Removed, or interviewed meanwhile */
+      nodemask_remove_node(i, sli_rd_nif_check);
+      continue;
+    }
+    /* The answer of the node and the one an interview waits for cannot be
+     * told apart, and the request shares the airtime of the interviews. */
+    wait = nif_request_ep ? RD_NIF_CHECK_RETRY_MS
+           : sl_airtime_budget_take(&sli_rd_probe_budget,
+                                    RD_PROBE_STEP_AIRTIME_MS,
+                                    clock_time());
+    if (wait == 0) {
+      if (ZW_RequestNodeInfo(i, 0)) {
+        nodemask_remove_node(i, sli_rd_nif_check);
+        sli_rd_nif_check_node = i;
+        sli_rd_probe_stats.nif_checks++;
+        wait = RD_NIF_CHECK_TIMEOUT_MS;
+      } else {
+        wait = RD_NIF_CHECK_RETRY_MS;
+      }
+    }
+    sl_sleeptimer_start_timer_ms(&sli_rd_nif_check_timer,
+                                 wait,
+                                 sli_rd_nif_check_timeout,
+                                 NULL,
+                                 1,
+                                 0);
+    return;
+  }
+}
+
+static void sli_rd_nif_check_timeout(sl_sleeptimer_timer_handle_t *handle,
+                                     void *user)
+{
+  sli_rd_timer_post(handle, sli_rd_nif_check_timeout,
+                    ZIP_EVENT_RD_NIF_CHECK_TIMEOUT, user);
+}
+
+void rd_nif_check_timeout(void)
+{
+  rd_lock();
+  if (!sli_rd_timer_running(&sli_rd_nif_check_timer)) {
+    if (sli_rd_nif_check_node) {
+      /* Not answering is for the dead node detection to handle. */
+      DBG_PRINTF("No node info from node %d\n", sli_rd_nif_check_node);
+    }
+    sli_rd_nif_check_next();
+  }
+  rd_unlock();
+}
+
+/* Copy of a controller update, see rd_nif_request_post(). */
+typedef struct {
+  nodeid_t node;
+  uint8_t status;
+  uint8_t len;
+  uint8_t nif[];
+} sli_rd_nif_event_t;
+
+void rd_nif_request_post(uint8_t bStatus,
+                         nodeid_t bNodeID,
+                         const uint8_t *nif,
+                         uint8_t nif_len)
+{
+  sli_rd_nif_event_t *e;
+
+  if (!bStatus) {
+    nif_len = 0;
+  }
+  e = sl_block_pool_alloc(sizeof(*e) + nif_len);
+  if (!e) {
+    ERR_PRINTF("Node info of node %d dropped, no buffer\n", bNodeID);
+    return;
+  }
+  e->node   = bNodeID;
+  e->status = bStatus;
+  e->len    = nif_len;
+  if (nif_len) {
+    memcpy(e->nif, nif, nif_len);
+  }
+  /* The serial API thread must not wait on the router thread. A lost node
+   * info ends like an unanswered request, on nif_request_timer or
+   * sli_rd_nif_check_timer. */
+  if (zw_zip_try_post_event(ZIP_EVENT_RD_NIF_RECEIVED, e) != SL_STATUS_OK) {
+    ERR_PRINTF("Node info of node %d dropped, queue full\n", bNodeID);
+    sl_block_pool_free(e);
+  }
+}
+
+void rd_nif_received(void *data)
+{
+  sli_rd_nif_event_t *e = data;
+
+  rd_nif_request_notify(e->status, e->node, e->status ? e->nif : NULL, e->len);
+  sl_block_pool_free(e);
+}
+
 /*IN  Node id of the node that send node info */
 /*IN  Pointer to Application Node information */
 /*IN  Node info length                        */
@@ -804,8 +1366,13 @@ void rd_nif_request_notify(uint8_t bStatus,
                            uint8_t *nif,
                            uint8_t nif_len)
 {
-  rd_ep_database_entry_t *ep = nif_request_ep;
-  if (ep && ep->state == EP_STATE_PROBE_INFO) {
+  rd_ep_database_entry_t *ep;
+  bool checked;
+
+  rd_lock();
+  ep = nif_request_ep;
+  if (ep && ep->state == EP_STATE_PROBE_INFO
+      && (!bStatus || ep->node->nodeid == bNodeID)) {
     nif_request_ep = 0;
     sl_sleeptimer_stop_timer(&nif_request_timer);
 
@@ -815,23 +1382,63 @@ void rd_nif_request_notify(uint8_t bStatus,
       if (ep->endpoint_info) {
         rd_data_mem_free(ep->endpoint_info);
       }
-      ep->endpoint_info = rd_data_mem_alloc(nif_len + 1);
+      ep->endpoint_info = rd_data_mem_alloc_cold(SL_PSRAM_POOL_RD_INFO,
+                                                 nif_len + 1);
       sli_rd_nif_request_notf_done(ep, nif, nif_len);
     } else {
       ep->state = EP_STATE_PROBE_FAIL;
     }
     rd_ep_probe_update(ep);
+    rd_unlock();
+    return;
+  }
+
+  checked = sli_rd_nif_check_node
+            && (!bStatus || bNodeID == sli_rd_nif_check_node);
+  if (bStatus) {
+    sli_rd_nif_received(bNodeID, nif, nif_len);
+  }
+  if (checked) {
+    sli_rd_nif_check_next();
+  }
+  rd_unlock();
+}
+
+static void sli_rd_nif_request_timeout(sl_sleeptimer_timer_handle_t *handle,
+                                       void *user)
+{
+  sli_rd_timer_post(handle, sli_rd_nif_request_timeout,
+                    ZIP_EVENT_RD_NIF_REQUEST_TIMEOUT, user);
+}
+
+void rd_nif_request_timeout(void)
+{
+  rd_ep_database_entry_t *ep;
+
+  rd_lock();
+  ep = nif_request_ep;
+  if (ep && !sli_rd_timer_running(&nif_request_timer)) {
+    nif_request_ep = 0;
+    if (ep->state == EP_STATE_PROBE_INFO) {
+      ERR_PRINTF("No node info from node %d\n", ep->node->nodeid);
+      ep->state = EP_STATE_PROBE_FAIL;
+      rd_ep_probe_update(ep);
+    }
   }
+  rd_unlock();
 }
 
 void sl_assign_route_callback(uint8_t status)
 {
-  if (current_probe_entry) {
+  rd_node_database_entry_t *n = sli_rd_route_entry;
+
+  if (n) {
+    sli_rd_route_entry = NULL;
     if (status != TRANSMIT_COMPLETE_OK) {
       ERR_PRINTF("sl_assign_route_callback: assign return route fail\n");
     }
-    current_probe_entry->state = STATUS_PROBE_WAKE_UP_INTERVAL;
-    rd_node_probe_update(current_probe_entry);
+    n->state = STATUS_PROBE_WAKE_UP_INTERVAL;
+    rd_node_probe_update(n);
   } else {
     ASSERT(0);
   }
@@ -860,6 +1467,11 @@ static int should_probe_level(rd_ep_database_entry_t *ep, uint8_t level)
 
 BOOL is_virtual_node(nodeid_t nid);
 
+/* Result of an endpoint step that sent its request: the callback moves
+ * the endpoint on. TRUE is a step with nothing to ask, FALSE a failed
+ * send. */
+#define SLI_RD_STEP_SENT 2
+
 static int sli_rd_ep_probe_update_aggegate(rd_ep_database_entry_t *ep)
 {
   ZW_MULTI_CHANNEL_AGGREGATED_MEMBERS_GET_V4_FRAME f;
@@ -932,7 +1544,41 @@ static int sli_rd_ep_probe_update_info(rd_ep_database_entry_t *ep)
     }
   }
 
-  ERR_PRINTF("Request node info %d\n", ep->node->nodeid);
+  if (ep->endpoint_id > 0) {
+    return TRUE;
+  }
+
+  if (ep->node->nodeid == MyNodeID) {
+    /* The node info of the gateway is known, skip its basic type. */
+    rd_lock();
+    nif_request_ep = ep;
+    rd_nif_request_notify(TRUE,
+                          MyNodeID,
+                          &MyNIF[offsetof(NODEINFO, nodeType)],
+                          MyNIFLen - offsetof(NODEINFO, nodeType));
+    rd_unlock();
+    return TRUE;
+  }
+  /* One node info is asked for at a time, answers carry no request id. */
+  rd_lock();
+  if (nif_request_ep || sli_rd_nif_check_node) {
+    rd_unlock();
+    sli_rd_probe_wait(sli_rd_probe_find(ep->node), ep, RD_NIF_CHECK_RETRY_MS);
+    return TRUE;
+  }
+  DBG_PRINTF("Request node info %d\n", ep->node->nodeid);
+  if (!ZW_RequestNodeInfo(ep->node->nodeid, 0)) {
+    rd_unlock();
+    return FALSE;
+  }
+  nif_request_ep = ep;
+  sl_sleeptimer_start_timer_ms(&nif_request_timer,
+                               RD_NIF_REQUEST_TIMEOUT_MS,
+                               sli_rd_nif_request_timeout,
+                               NULL,
+                               1,
+                               0);
+  rd_unlock();
   return TRUE;
 }
 
@@ -960,6 +1606,7 @@ static int sli_rd_ep_probe_update_c2_info(rd_ep_database_entry_t *ep)
                               rd_ep_secure_commands_get_callback)) {
         return FALSE;
       }
+      return SLI_RD_STEP_SENT;
     }
     /* Node is not included with S2 or GW is not running S2. */
     /* If the ep or the GW do not support S0, either, we let the
@@ -979,6 +1626,7 @@ static int sli_rd_ep_probe_update_c2_info(rd_ep_database_entry_t *ep)
                             rd_ep_secure_commands_get_callback)) {
       return FALSE;
     }
+    return SLI_RD_STEP_SENT;
   }
   return TRUE;
 }
@@ -1003,6 +1651,7 @@ static int sli_rd_ep_probe_update_info_zwave_plus(rd_ep_database_entry_t *ep)
                             rd_ep_zwave_plus_info_callback)) {
       return FALSE;
     }
+    return SLI_RD_STEP_SENT;
   }
   return TRUE;
 }
@@ -1069,10 +1718,7 @@ static int sli_rd_ep_probe_update_s2_info(rd_ep_database_entry_t *ep)
     return TRUE;
   }
 
-  if (!sli_rd_ep_probe_update_c2_info(ep)) {
-    return FALSE;
-  }
-  return TRUE;
+  return sli_rd_ep_probe_update_c2_info(ep);
 }
 
 static int sli_rd_ep_probe_update_s2_c1_info(rd_ep_database_entry_t *ep)
@@ -1105,6 +1751,7 @@ static int sli_rd_ep_probe_update_s2_c1_info(rd_ep_database_entry_t *ep)
                             rd_ep_secure_commands_get_callback)) {
       return FALSE;
     }
+    return SLI_RD_STEP_SENT;
   }
   return TRUE;
 }
@@ -1139,19 +1786,22 @@ static int sli_rd_ep_probe_update_s2_c0_info(rd_ep_database_entry_t *ep)
                             rd_ep_secure_commands_get_callback)) {
       return FALSE;
     }
+    return SLI_RD_STEP_SENT;
   }
   return TRUE;
 }
 
-static int sli_rd_ep_probe_update_check(rd_ep_database_entry_t *ep)
+static sli_rd_probe_t *sli_rd_ep_probe_update_check(rd_ep_database_entry_t *ep)
 {
-  ASSERT(current_probe_entry);
-  if (!current_probe_entry) {
-    return 0;
-  }
+  sli_rd_probe_t *pr;
 
   if (ep->node == 0) {
-    return 0;
+    return NULL;
+  }
+  /* Endpoints are probed within the interview of their node. */
+  pr = sli_rd_probe_find(ep->node);
+  if (!pr) {
+    return NULL;
   }
   DBG_PRINTF("EP probe rd_node=%i (flags 0x%02x) ep =%d state=%s\n",
              ep->node->nodeid,
@@ -1162,9 +1812,9 @@ static int sli_rd_ep_probe_update_check(rd_ep_database_entry_t *ep)
   if (is_virtual_node(ep->node->nodeid)) {
     rd_remove_node(ep->node->nodeid);
     ASSERT(0);
-    return 0;
+    return NULL;
   }
-  return 1;
+  return pr;
 }
 
 static void rd_ep_probe_handle_aggregated_endpoints(rd_ep_database_entry_t *ep)
@@ -1185,6 +1835,20 @@ static void rd_ep_probe_handle_info(rd_ep_database_entry_t *ep)
   }
 }
 
+/* Move ep on after a step helper returned res. */
+static void sli_rd_ep_probe_step_done(rd_ep_database_entry_t *ep, int res)
+{
+  if (res == SLI_RD_STEP_SENT) {
+    return;
+  }
+  if (res == FALSE) {
+    ep->state = EP_STATE_PROBE_FAIL;
+  } else {
+    ep->state++;
+  }
+  rd_ep_probe_update(ep);
+}
+
 static void rd_ep_probe_handle_sec2_c2_info(rd_ep_database_entry_t *ep)
 {
   if (ep->node->security_flags & NODE_FLAG_KNOWN_BAD) {
@@ -1192,35 +1856,23 @@ static void rd_ep_probe_handle_sec2_c2_info(rd_ep_database_entry_t *ep)
     rd_ep_probe_update(ep);
     return;
   }
-  if (sli_rd_ep_probe_update_s2_info(ep) == FALSE) {
-    ep->state = EP_STATE_PROBE_FAIL;
+  /* The gateway does not ask itself, its node info is all there is. */
+  if (ep->node->nodeid == MyNodeID) {
+    ep->state = EP_STATE_PROBE_DONE;
     rd_ep_probe_update(ep);
     return;
   }
-  ep->state++;
-  rd_ep_probe_update(ep);
+  sli_rd_ep_probe_step_done(ep, sli_rd_ep_probe_update_s2_info(ep));
 }
 
 static void rd_ep_probe_handle_sec2_c1_info(rd_ep_database_entry_t *ep)
 {
-  if (sli_rd_ep_probe_update_s2_c1_info(ep) == FALSE) {
-    ep->state = EP_STATE_PROBE_FAIL;
-    rd_ep_probe_update(ep);
-    return;
-  }
-  ep->state++;
-  rd_ep_probe_update(ep);
+  sli_rd_ep_probe_step_done(ep, sli_rd_ep_probe_update_s2_c1_info(ep));
 }
 
 static void rd_ep_probe_handle_sec2_c0_info(rd_ep_database_entry_t *ep)
 {
-  if (sli_rd_ep_probe_update_s2_c0_info(ep) == FALSE) {
-    ep->state = EP_STATE_PROBE_FAIL;
-    rd_ep_probe_update(ep);
-    return;
-  }
-  ep->state++;
-  rd_ep_probe_update(ep);
+  sli_rd_ep_probe_step_done(ep, sli_rd_ep_probe_update_s2_c0_info(ep));
 }
 
 static void rd_ep_probe_handle_sec0_info(rd_ep_database_entry_t *ep)
@@ -1234,18 +1886,33 @@ static void rd_ep_probe_handle_sec0_info(rd_ep_database_entry_t *ep)
 
 static void rd_ep_probe_handle_zwave_plus(rd_ep_database_entry_t *ep)
 {
-  if (!sli_rd_ep_probe_update_info_zwave_plus(ep)) {
-    ep->state = EP_STATE_PROBE_FAIL;
-    rd_ep_probe_update(ep);
-    return;
-  }
-  ep->state++;
+  sli_rd_ep_probe_step_done(ep, sli_rd_ep_probe_update_info_zwave_plus(ep));
+}
+
+/* The versions of the controlled classes keep their defaults; only the
+ * firmware version is asked, in STATUS_PROBE_PRODUCT_ID. */
+static void rd_ep_probe_handle_version(rd_ep_database_entry_t *ep)
+{
+  ep->state = EP_STATE_PROBE_ZWAVE_PLUS;
   rd_ep_probe_update(ep);
 }
 
-void rd_ep_probe_update(rd_ep_database_entry_t *ep)
+/* The gateway announces no service per endpoint, there is no name to
+ * probe. */
+static void rd_ep_probe_handle_mdns_probe(rd_ep_database_entry_t *ep)
 {
-  if (sli_rd_ep_probe_update_check(ep) == 0) {
+  ep->state = EP_STATE_PROBE_DONE;
+  rd_ep_probe_update(ep);
+}
+
+static void sli_rd_ep_probe_update_locked(rd_ep_database_entry_t *ep)
+{
+  sli_rd_probe_t *pr = sli_rd_ep_probe_update_check(ep);
+
+  if (!pr) {
+    return;
+  }
+  if (sli_rd_ep_step_sends(ep->state) && !sli_rd_probe_airtime(pr, ep)) {
     return;
   }
 
@@ -1268,9 +1935,15 @@ void rd_ep_probe_update(rd_ep_database_entry_t *ep)
     case EP_STATE_PROBE_SEC0_INFO:
       rd_ep_probe_handle_sec0_info(ep);
       break;
+    case EP_STATE_PROBE_VERSION:
+      rd_ep_probe_handle_version(ep);
+      break;
     case EP_STATE_PROBE_ZWAVE_PLUS:
       rd_ep_probe_handle_zwave_plus(ep);
       break;
+    case EP_STATE_MDNS_PROBE:
+      rd_ep_probe_handle_mdns_probe(ep);
+      break;
     case EP_STATE_MDNS_PROBE_IN_PROGRESS:
       break;
     case EP_STATE_PROBE_FAIL:
@@ -1282,6 +1955,15 @@ void rd_ep_probe_update(rd_ep_database_entry_t *ep)
   }
 }
 
+/* Interview steps run on the router thread and in serial API callbacks, the
+ * interview slots and node states are shared under rd_lock(). */
+void rd_ep_probe_update(rd_ep_database_entry_t *ep)
+{
+  rd_lock();
+  sli_rd_ep_probe_update_locked(ep);
+  rd_unlock();
+}
+
 void rd_set_wu_interval_callback(BYTE txStatus, void *user, TX_STATUS_TYPE *t)
 {
   (void) t;
@@ -1337,7 +2019,17 @@ void send_suc_id_timeout(sl_sleeptimer_timer_handle_t *handle, void *use)
   (void) handle;
   (void) use;
 
-  send_suc_id(TRANSMIT_COMPLETE_FAIL);
+  /* send_suc_id() loads node entries, which is not done in a timer
+   * callback. Try again shortly if the router queue is full. */
+  if (zw_zip_try_post_event(ZIP_EVENT_RD_SEND_SUC_ID_TIMEOUT, 0)
+      != SL_STATUS_OK) {
+    sl_sleeptimer_start_timer_ms(&send_suc_id_timer,
+                                 RD_TIMER_EVENT_RETRY_MS,
+                                 send_suc_id_timeout,
+                                 0,
+                                 1,
+                                 0);
+  }
 }
 
 void send_suc_id(uint8_t status)
@@ -1356,12 +2048,15 @@ void send_suc_id(uint8_t status)
       continue;
     }
 
-    rd_node = rd_node_get_raw(current_send_suc_id_dest);
-    if (!rd_node) {
+    if (!rd_node_exists(current_send_suc_id_dest)) {
       continue;
     }
 
-    if (is_virtual_node(rd_node->nodeid)) {
+    if (is_virtual_node(current_send_suc_id_dest)) {
+      continue;
+    }
+    rd_node = rd_node_get_raw(current_send_suc_id_dest);
+    if (!rd_node) {
       continue;
     }
 
@@ -1391,28 +2086,71 @@ void send_suc_id(uint8_t status)
   return;
 }
 
-void rd_probe_resume()
+/* A wake-up node is interviewed when it was just added or when it wakes up
+ * and asks for it (rd_register_new_node()), not by the background scan. */
+static bool sli_rd_probe_park(rd_node_database_entry_t *n)
+{
+  rd_ep_database_entry_t *ep;
+  rd_node_mode_t mode = RD_NODE_MODE_VALUE_GET(n);
+
+  if (((mode != MODE_NONLISTENING) && (mode != MODE_MAILBOX))
+      || (n->node_properties_flags & RD_NODE_FLAG_JUST_ADDED)
+      || (n->nodeid == MyNodeID)) {
+    return false;
+  }
+  DBG_PRINTF("Node %d is sleeping. Probe it when it wakes up.\n", n->nodeid);
+  for (ep = list_head(n->endpoints); ep != NULL; ep = list_item_next(ep)) {
+    ep->state = EP_STATE_PROBE_INFO;
+  }
+  n->state = STATUS_PROBE_FAIL;
+  sli_rd_probe_stats.parked++;
+  return true;
+}
+
+static void sli_rd_probe_resume_locked(void)
 {
   nodeid_t i;
   rd_node_database_entry_t *rd_node;
-
-  if (current_probe_entry) {
-    DBG_PRINTF("Resume probe of %u\n", current_probe_entry->nodeid);
-    rd_node_probe_update(current_probe_entry);
+  rd_node_hot_t hot;
+  /* One slot stays free for a node that was just added or woke up. */
+  uint8_t reserve = (sli_rd_probe_slots() > 1) ? 1 : 0;
+
+  for (int k = 0; k < RD_PROBE_MAX_ACTIVE; k++) {
+    if (sli_rd_probes[k].n && sli_rd_probes[k].held) {
+      sli_rd_probe_watch(&sli_rd_probes[k]);
+      sli_rd_probes[k].held = 0;
+      DBG_PRINTF("Resume probe of %u\n", sli_rd_probes[k].n->nodeid);
+      rd_node_probe_update(sli_rd_probes[k].n);
+    }
+  }
+  if (probe_lock || (bridge_state == booting)) {
     return;
   }
 
+  /* Only the nodes to interview are loaded. */
   for (i = 1; i <= ZW_MAX_NODES; i++) {
-    rd_node = rd_node_get_raw(i);
-    if (rd_node && (rd_node->state != STATUS_DONE && rd_node->state != STATUS_PROBE_FAIL
-                    && rd_node->state != STATUS_FAILING)) {
-      current_probe_entry = rd_node;
-      rd_node_probe_update(rd_node);
-      break;
+    if (sli_rd_probe_active() + reserve >= sli_rd_probe_slots()) {
+      return;
+    }
+    if (sli_rd_probe_stubs) {
+      rd_node = sli_rd_probe_stubs->node(i);
+      if (!rd_node || (rd_node->state >= STATUS_MDNS_PROBE)) {
+        continue;
+      }
+    } else {
+      if (!rd_node_hot_get(i, &hot) || (hot.state >= STATUS_MDNS_PROBE)) {
+        continue;
+      }
+      rd_node = rd_node_get_raw(i);
     }
+    if (!rd_node || sli_rd_probe_find(rd_node) || sli_rd_probe_park(rd_node)) {
+      continue;
+    }
+    rd_node_probe_update(rd_node);
   }
 
-  if ((i == (ZW_MAX_NODES + 1)) && (probe_lock == 0)) {
+  if ((sli_rd_probe_active() == 0) && (probe_lock == 0)
+      && !sli_rd_probe_stubs) {
     if (suc_changed) {
       suc_changed = 0;
       DBG_PRINTF("Suc changed, Sending new SUC Id to network \n");
@@ -1421,6 +2159,13 @@ void rd_probe_resume()
   }
 }
 
+void rd_probe_resume()
+{
+  rd_lock();
+  sli_rd_probe_resume_locked();
+  rd_unlock();
+}
+
 /**
  *  Lock/Unlock the node probe machine. When the node probe lock is enabled, all probing will stop.
  *  Probing is resumed when the lock is disabled. The probe lock is used during a add node process or during learn mode.
@@ -1442,28 +2187,53 @@ void rd_probe_lock(uint8_t enable)
  * probed because it is a self-destructing smart start node, this
  * function resets the probe lock.
  *
- * When removal of the node succeeds, \ref current_probe_entry will be
- * reset when the node is deleted.  We also clear \ref
- * current_probe_entry here so that this function can be used in the
- * "removal failed" scenarios.
+ * When removal of the node succeeds, its interview ends when the node
+ * is deleted.  We also end all interviews here so that this function
+ * can be used in the "removal failed" scenarios.  A node left in an
+ * interview state is started again by rd_probe_resume().
  */
 void rd_probe_cancel(void)
 {
-  probe_lock          = FALSE;
-  current_probe_entry = NULL;
+  probe_lock = FALSE;
+  sli_rd_probe_end_all();
 }
 
 u8_t rd_probe_in_progress()
 {
-  return (current_probe_entry != 0);
+  return (sli_rd_probe_active() != 0);
+}
+
+void rd_probe_get_stats(rd_probe_stats_t *stats)
+{
+  *stats        = sli_rd_probe_stats;
+  stats->active = sli_rd_probe_active();
+}
+
+void rd_probe_print_stats(void)
+{
+  rd_probe_stats_t st;
+
+  rd_probe_get_stats(&st);
+  LOG_PRINTF("RD probe: %lu started, %lu done, %lu failed, %lu stalled, "
+             "%lu parked\n",
+             st.started, st.completed, st.failed, st.stalled, st.parked);
+  LOG_PRINTF("RD probe: %d running, peak %d, %lu steps waited for airtime, "
+             "avg %lu ms\n",
+             st.active, st.peak, st.deferred,
+             (st.completed + st.failed)
+             ? st.total_ms / (st.completed + st.failed) : 0);
+  LOG_PRINTF("RD probe: node infos %lu unchanged, %lu changed, %lu asked for, "
+             "%lu endpoints unchanged\n",
+             st.nif_same, st.nif_new, st.nif_checks, st.ep_reused);
 }
 
 u8_t rd_node_in_probe(nodeid_t node)
 {
-  const rd_node_database_entry_t *rd_node;
-  rd_node = rd_node_get_raw(node);
-  if (rd_node && (rd_node->state != STATUS_DONE && rd_node->state != STATUS_PROBE_FAIL
-                  && rd_node->state != STATUS_FAILING)) {
+  rd_node_hot_t hot;
+
+  if (rd_node_hot_get(node, &hot)
+      && (hot.state != STATUS_DONE && hot.state != STATUS_PROBE_FAIL
+          && hot.state != STATUS_FAILING)) {
     return 1;
   }
   return 0;
@@ -1478,11 +2248,13 @@ void copy_endpoints(rd_ep_database_entry_t *src_ep, rd_node_database_entry_t *n)
   for (dest_ep = list_head(n->endpoints); dest_ep != NULL;
        dest_ep = list_item_next(dest_ep)) {
     if (dest_ep->endpoint_id > 1) { //only copy to endpoint id 2 and up
+      rd_name_index_remove_ep(dest_ep);
       dest_ep->endpoint_location = NULL;
 
       dest_ep->endpoint_name = NULL;
 
-      dest_ep->endpoint_info = rd_data_mem_alloc(src_ep->endpoint_info_len);
+      dest_ep->endpoint_info = rd_data_mem_alloc_cold(SL_PSRAM_POOL_RD_INFO,
+                                                      src_ep->endpoint_info_len);
       if (!dest_ep->endpoint_info) {
         ERR_PRINTF("copy_endpoints: no memory for endpoint_info\n");
         return;
@@ -1491,7 +2263,8 @@ void copy_endpoints(rd_ep_database_entry_t *src_ep, rd_node_database_entry_t *n)
              src_ep->endpoint_info,
              src_ep->endpoint_info_len);
 
-      dest_ep->endpoint_agg = rd_data_mem_alloc(src_ep->endpoint_aggr_len);
+      dest_ep->endpoint_agg = rd_data_mem_alloc_cold(SL_PSRAM_POOL_RD_INFO,
+                                                     src_ep->endpoint_aggr_len);
       if (!dest_ep->endpoint_agg) {
         ERR_PRINTF("copy_endpoints: no memory for endpoint_agg\n");
         rd_data_mem_free(dest_ep->endpoint_info);
@@ -1503,6 +2276,7 @@ void copy_endpoints(rd_ep_database_entry_t *src_ep, rd_node_database_entry_t *n)
 
       /** Length of #endpoint_info. */
       dest_ep->endpoint_info_len = src_ep->endpoint_info_len;
+      rd_ep_class_index(dest_ep);
       /** Length of #endpoint_name. */
       dest_ep->endpoint_name_len = 0;
       /** Length of #endpoint_location. */
@@ -1532,9 +2306,25 @@ static void sli_rd_node_probe_update_fail(rd_node_database_entry_t *n)
 
 static void sli_rd_node_probe_update_complete(rd_node_database_entry_t *n)
 {
+  sli_rd_probe_t *pr = sli_rd_probe_find(n);
+  uint32_t ms;
+
   /* Store all node data in persistent memory */
   rd_data_store_nvm_write(n);
-  current_probe_entry = NULL;
+  if (n->state == STATUS_DONE) {
+    nodemask_remove_node(n->nodeid, sli_rd_nif_retried);
+  }
+  if (pr) {
+    ms = clock_time() - pr->started;
+    if (n->state == STATUS_DONE) {
+      sli_rd_probe_stats.completed++;
+    } else {
+      sli_rd_probe_stats.failed++;
+    }
+    sli_rd_probe_stats.total_ms += ms;
+    LOG_PRINTF("Interview of node %d ended after %lu ms\n", n->nodeid, ms);
+    sli_rd_probe_end(pr);
+  }
 
   /* If a callback is registered for this node, trigger the callback
    * when the node has reached a final state. */
@@ -1546,7 +2336,10 @@ static int sli_rd_node_probe_update_node_info(rd_ep_database_entry_t *ep,
                                               rd_node_database_entry_t *n)
 {
   if (!ep) { // Abort the probe the node might have been removed
-    current_probe_entry = NULL;
+    sli_rd_probe_t *pr = sli_rd_probe_find(n);
+    if (pr) {
+      sli_rd_probe_end(pr);
+    }
     rd_probe_resume();
     return FALSE;
   }
@@ -1599,14 +2392,61 @@ static int sli_rd_node_probe_update_product_id(rd_node_database_entry_t *n)
   return TRUE;
 }
 
+static int sli_rd_node_probe_update_version(rd_node_database_entry_t *n)
+{
+  static ZW_VERSION_GET_FRAME version_get = {
+    COMMAND_CLASS_VERSION,
+    VERSION_GET
+  };
+  ts_param_t p;
+
+  ts_set_std(&p, n->nodeid);
+  return sl_zw_send_request(&p,
+                            (BYTE *) &version_get,
+                            sizeof(version_get),
+                            VERSION_REPORT,
+                            SL_REQUEST_TIMEOUT_MS,
+                            n,
+                            rd_probe_version_callback);
+}
+
+/* The step of a stub interview, once it has its slot and airtime. */
+static void sli_rd_probe_stub_update(rd_node_database_entry_t *n)
+{
+  sli_rd_probe_t *pr;
+
+  if (n->state < STATUS_MDNS_PROBE) {
+    sli_rd_probe_stubs->step(n);
+    return;
+  }
+  pr = sli_rd_probe_find(n);
+  if (pr) {
+    if (n->state == STATUS_DONE) {
+      sli_rd_probe_stats.completed++;
+    } else {
+      sli_rd_probe_stats.failed++;
+    }
+    sli_rd_probe_stats.total_ms += clock_time() - pr->started;
+    sli_rd_probe_end(pr);
+  }
+  rd_probe_resume();
+}
+
 static int sli_rd_node_probe_update_check(rd_node_database_entry_t *n)
 {
-  if (probe_lock) {
+  if (probe_lock || (bridge_state == booting)) {
+    sli_rd_probe_t *pr = sli_rd_probe_find(n);
+    if (pr) {
+      /* A held interview is not stalled. */
+      pr->held = 1;
+      sl_sleeptimer_stop_timer(&pr->timer);
+    }
     return FALSE;
   }
 
-  if (bridge_state == booting) {
-    return FALSE;
+  /* Real nodes wait for the end of the bench, see rd_probe_set_stubs(). */
+  if (sli_rd_probe_stubs) {
+    return sli_rd_probe_stubs->node(n->nodeid) == n;
   }
 
   if (n->nodeid == 0) {
@@ -1622,6 +2462,8 @@ static int sli_rd_node_probe_update_check(rd_node_database_entry_t *n)
 
 static void sli_rd_node_probe_update_product_id_ex(rd_node_database_entry_t *n)
 {
+  sli_rd_probe_t *pr;
+
   if (n->nodeid == MyNodeID) {
     n->productID      = router_cfg.product_id;
     n->manufacturerID = router_cfg.manufacturer_id;
@@ -1631,6 +2473,16 @@ static void sli_rd_node_probe_update_product_id_ex(rd_node_database_entry_t *n)
     return;
   }
 
+  pr = sli_rd_probe_find(n);
+  if (pr && pr->id_step == SLI_RD_ID_VENDOR) {
+    /* Without the firmware version the model is not known well enough. */
+    if (!sl_cmdclass_supported(n->nodeid, COMMAND_CLASS_VERSION)
+        || (sli_rd_node_probe_update_version(n) == FALSE)) {
+      sli_rd_node_probe_update_next(n);
+    }
+    return;
+  }
+
   if ((sli_cmdclass_flags_supported(n->nodeid, COMMAND_CLASS_MANUFACTURER_SPECIFIC)
        & SUPPORTED) == 0) {
     sli_rd_node_probe_update_next(n);
@@ -1644,11 +2496,7 @@ static void sli_rd_node_probe_update_product_id_ex(rd_node_database_entry_t *n)
 
 static void rd_node_probe_handle_created(rd_node_database_entry_t *n)
 {
-  if (current_probe_entry && current_probe_entry != n) {
-    return;
-  }
-  current_probe_entry = n;
-  n->probe_flags      = RD_NODE_FLAG_PROBE_STARTED;
+  n->probe_flags = RD_NODE_FLAG_PROBE_STARTED;
   sli_rd_node_probe_update_next(n);
 }
 
@@ -1710,6 +2558,57 @@ static void rd_node_probe_handle_find_endpoints(
   }
 }
 
+/* Only a sleeping node this gateway added gets its wake up interval set. */
+static void rd_node_probe_handle_check_wu_cc_version(rd_node_database_entry_t *n)
+{
+  uint8_t mode = n->mode & 0xff;
+
+  if ((n->nodeid == MyNodeID)
+      || ((mode != MODE_NONLISTENING) && (mode != MODE_MAILBOX))
+      || ((sli_cmdclass_flags_supported(n->nodeid, COMMAND_CLASS_WAKE_UP)
+           & SUPPORTED) == 0)) {
+    n->state = STATUS_PROBE_ENDPOINTS;
+  } else if (!(n->node_properties_flags & RD_NODE_FLAG_ADDED_BY_ME)) {
+    n->state = STATUS_PROBE_WAKE_UP_INTERVAL;
+  } else if (rd_node_cc_version_get(n, COMMAND_CLASS_WAKE_UP) >= 2) {
+    n->state = STATUS_GET_WU_CAP;
+  } else {
+    /* Version 1, or not known: set the default interval. */
+    n->state = STATUS_SET_WAKE_UP_INTERVAL;
+  }
+  rd_node_probe_update(n);
+}
+
+/* Interview the endpoints one at a time; each one that ends calls
+ * rd_node_probe_update() again. An endpoint that failed does not fail its
+ * node, it is interviewed again with the node. */
+static void rd_node_probe_handle_probe_endpoints(rd_node_database_entry_t *n)
+{
+  rd_ep_database_entry_t *ep;
+
+  for (ep = list_head(n->endpoints); ep != NULL; ep = list_item_next(ep)) {
+    if (ep->state == EP_STATE_MDNS_PROBE) {
+      /* Filled in by a profile, done here rather than one call deeper
+       * per endpoint. */
+      ep->state = EP_STATE_PROBE_DONE;
+    }
+    if ((ep->state != EP_STATE_PROBE_DONE)
+        && (ep->state != EP_STATE_PROBE_FAIL)) {
+      rd_ep_probe_update(ep);
+      return;
+    }
+  }
+  n->state = STATUS_MDNS_PROBE;
+  rd_node_probe_update(n);
+}
+
+/* No node is announced over mDNS, its names need no probe. */
+static void rd_node_probe_handle_mdns_probe(rd_node_database_entry_t *n)
+{
+  n->state = STATUS_DONE;
+  rd_node_probe_update(n);
+}
+
 static void rd_node_probe_handle_get_wu_cap(rd_node_database_entry_t *n,
                                             ts_param_t *p)
 {
@@ -1760,7 +2659,13 @@ static void rd_node_probe_handle_set_wu_interval(rd_node_database_entry_t *n,
 static void
 rd_node_probe_handle_assign_return_route(rd_node_database_entry_t *n)
 {
+  if (sli_rd_route_entry && (sli_rd_route_entry != n)) {
+    sli_rd_probe_wait(sli_rd_probe_find(n), NULL, RD_PROBE_ROUTE_RETRY_MS);
+    return;
+  }
+  sli_rd_route_entry = n;
   if (!ZW_AssignReturnRoute(n->nodeid, MyNodeID, sl_assign_route_callback)) {
+    sli_rd_route_entry = NULL;
     n->state = STATUS_PROBE_FAIL;
     rd_node_probe_update(n);
   }
@@ -1788,6 +2693,7 @@ static void rd_node_probe_handle_probe_wu_interval(
 static void rd_node_probe_handle_done(rd_node_database_entry_t *n)
 {
   rd_ep_database_entry_t *ep;
+  sli_rd_probe_t *pr;
   LOG_PRINTF("Probe of node %d is done\n", n->nodeid);
   for (ep = list_head(n->endpoints); ep != NULL; ep = list_item_next(ep)) {
     LOG_PRINTF("Info len %i\n", ep->endpoint_info_len);
@@ -1796,6 +2702,13 @@ static void rd_node_probe_handle_done(rd_node_database_entry_t *n)
   n->lastAwake  = clock_seconds();
   n->node_properties_flags &= ~RD_NODE_FLAG_JUST_ADDED;
   n->probe_flags = RD_NODE_FLAG_PROBE_HAS_COMPLETED;
+
+  pr = sli_rd_probe_find(n);
+  if (pr && (pr->id_step == SLI_RD_ID_DONE) && !pr->from_profile
+      && (n->security_flags & (NODE_FLAG_INFO_ONLY | NODE_FLAG_KNOWN_BAD))
+      == 0) {
+    rd_profile_store(n, &pr->id);
+  }
   sli_rd_node_probe_update_complete(n);
 }
 
@@ -1805,7 +2718,7 @@ static void rd_node_probe_handle_fail(rd_node_database_entry_t *n)
   sli_rd_node_probe_update_complete(n);
 }
 
-void rd_node_probe_update(rd_node_database_entry_t *n)
+static void sli_rd_node_probe_update_locked(rd_node_database_entry_t *n)
 {
   static ZW_MULTI_CHANNEL_END_POINT_GET_V4_FRAME multi_ep_get = {
     COMMAND_CLASS_MULTI_CHANNEL_V4,
@@ -1820,11 +2733,32 @@ void rd_node_probe_update(rd_node_database_entry_t *n)
   static ZW_WAKE_UP_INTERVAL_GET_FRAME wakeup_get = { COMMAND_CLASS_WAKE_UP,
                                                       WAKE_UP_INTERVAL_GET };
   ts_param_t p;
+  sli_rd_probe_t *pr;
 
   if (sli_rd_node_probe_update_check(n) == FALSE) {
     return;
   }
 
+  /* Interview states need a slot; without one the node waits for
+   * rd_probe_resume(). */
+  if (n->state < STATUS_MDNS_PROBE) {
+    pr = sli_rd_probe_find(n);
+    if (!pr) {
+      pr = sli_rd_probe_start(n, 0);
+      if (!pr) {
+        return;
+      }
+    }
+    if (sli_rd_node_step_sends(n->state) && !sli_rd_probe_airtime(pr, NULL)) {
+      return;
+    }
+  }
+
+  if (sli_rd_probe_stubs) {
+    sli_rd_probe_stub_update(n);
+    return;
+  }
+
   switch (n->state) {
     case STATUS_CREATED:
       rd_node_probe_handle_created(n);
@@ -1841,7 +2775,11 @@ void rd_node_probe_update(rd_node_database_entry_t *n)
     case STATUS_FIND_ENDPOINTS:
       rd_node_probe_handle_find_endpoints(n, &p, &multi_ep_find);
       break;
+    case STATUS_CHECK_WU_CC_VERSION:
+      rd_node_probe_handle_check_wu_cc_version(n);
+      break;
     case STATUS_PROBE_ENDPOINTS:
+      rd_node_probe_handle_probe_endpoints(n);
       break;
     case STATUS_GET_WU_CAP:
       rd_node_probe_handle_get_wu_cap(n, &p);
@@ -1855,6 +2793,10 @@ void rd_node_probe_update(rd_node_database_entry_t *n)
     case STATUS_PROBE_WAKE_UP_INTERVAL:
       rd_node_probe_handle_probe_wu_interval(n, &p, &wakeup_get);
       break;
+    case STATUS_MDNS_PROBE:
+    case STATUS_MDNS_EP_PROBE:
+      rd_node_probe_handle_mdns_probe(n);
+      break;
     case STATUS_DONE:
       rd_node_probe_handle_done(n);
       break;
@@ -1866,11 +2808,54 @@ void rd_node_probe_update(rd_node_database_entry_t *n)
   }
 }
 
+void rd_node_probe_update(rd_node_database_entry_t *n)
+{
+  rd_lock();
+  sli_rd_node_probe_update_locked(n);
+  rd_unlock();
+}
+
+bool rd_probe_set_stubs(const rd_probe_stubs_t *stubs)
+{
+  rd_lock();
+  if (stubs && (sli_rd_probe_active() || !stubs->slots
+                || stubs->slots > RD_PROBE_MAX_ACTIVE)) {
+    rd_unlock();
+    return false;
+  }
+  if (!stubs) {
+    sli_rd_probe_end_all();
+  }
+  sli_rd_probe_stubs = stubs;
+  rd_unlock();
+  if (!stubs) {
+    rd_probe_resume();
+  }
+  return true;
+}
+
 static void rd_reset_probe_completed_notifier(void)
 {
   memset(&node_probe_notifier, 0, sizeof(node_probe_notifier));
 }
 
+int rd_register_node_probe_notifier(nodeid_t node_id,
+                                    void *user,
+                                    void (*callback)(rd_ep_database_entry_t *ep,
+                                                     void *user))
+{
+  uint8_t ii;
+  for (ii = 0; ii < NUM_PROBES; ii++) {
+    if (node_probe_notifier[ii].node_id == 0) {
+      node_probe_notifier[ii].node_id  = node_id;
+      node_probe_notifier[ii].callback = callback;
+      node_probe_notifier[ii].user     = user;
+      return 1;
+    }
+  }
+  return 0;
+}
+
 static void rd_trigger_probe_completed_notifier(rd_node_database_entry_t *node)
 {
   uint8_t ii;
@@ -1950,11 +2935,10 @@ static void sli_rd_register_new_node(nodeid_t node,
     n->state = STATUS_PROBE_FAIL;
     rd_node_probe_update(n);
   } else {
-    /* Since status is CREATED, this node will be set as
-     * current_probe_entry if there is not already a current.  This
-     * ensures that if the probe machine is currently locked, it will
-     * resume probing as soon as it is unlocked and eventually get to
-     * this node.  */
+    /* Since status is CREATED, this node gets an interview slot if one
+     * is free.  This ensures that if the probe machine is currently
+     * locked or full, it will resume probing as soon as it is unlocked
+     * and eventually get to this node.  */
     rd_node_probe_update(n);
   }
 }
@@ -1978,15 +2962,17 @@ void rd_register_new_node(nodeid_t node, uint8_t node_properties_flags)
 
 void rd_exit()
 {
-  rd_node_database_entry_t *n;
+  rd_node_hot_t hot;
 
   sl_sleeptimer_stop_timer(&dead_node_timer);
   sl_sleeptimer_stop_timer(&nif_request_timer);
+  sl_sleeptimer_stop_timer(&sli_rd_nif_check_timer);
+  sli_rd_probe_end_all();
 
   for (nodeid_t i = 1; i <= ZW_MAX_NODES; i++) {
-    n = rd_node_get_raw(i);
-    if (n) {
-      n->mode |= MODE_FLAGS_DELETED;
+    if (rd_node_hot_get(i, &hot)) {
+      hot.mode |= MODE_FLAGS_DELETED;
+      rd_node_hot_set(i, &hot);
     }
   }
 }
@@ -1999,6 +2985,9 @@ void rd_remove_node(nodeid_t node)
   if (node == 0) {
     return;
   }
+  sl_state_cache_forget_node(node);
+  sl_mailbox_purge(node);
+  nodemask_remove_node(node, sli_rd_nif_retried);
   n = rd_node_get_raw(node);
   if (n == 0) {
     return;
@@ -2007,8 +2996,11 @@ void rd_remove_node(nodeid_t node)
   /*
    * Abort probe if we have one in progress.
    */
-  if (current_probe_entry == n) {
-    current_probe_entry = 0;
+  if (sli_rd_probe_find(n)) {
+    sli_rd_probe_end(sli_rd_probe_find(n));
+  }
+  if (sli_rd_route_entry == n) {
+    sli_rd_route_entry = 0;
   }
 
   DBG_PRINTF("Removing node %i %p\n", node, n);
@@ -2027,19 +3019,22 @@ static void sli_zw_rd_node_in_nvm_validate(nodeid_t i)
   if (i == MyNodeID) {
     return;
   }
-  rd_node_database_entry_t *rd_node;
+  rd_node_hot_t hot;
 
   DBG_PRINTF("Network has node %i\n", i);
-  rd_node = rd_node_entry_import(i);
-
-  if (rd_node == 0) {
+  if (!rd_node_entry_import(i) || !rd_node_hot_get(i, &hot)) {
     rd_register_new_node(i, 0x00);
     return;
   }
-  rd_node_database_entry_t *n = rd_node_get_raw(i);
-  rd_ep_database_entry_t *ep;
 
-  if (n->state == STATUS_CREATED) {
+  /* Only nodes that were never probed are loaded here. */
+  if (hot.state == STATUS_CREATED) {
+    rd_node_database_entry_t *n = rd_node_get_raw(i);
+    rd_ep_database_entry_t *ep;
+
+    if (!n) {
+      return;
+    }
     for (ep = list_head(n->endpoints); ep != NULL; ep = list_item_next(ep)) {
       ep->state = EP_STATE_PROBE_INFO;
     }
@@ -2053,23 +3048,25 @@ static void sli_zw_rd_node_in_nvm_validate(nodeid_t i)
       n->wakeUp_interval = 0;
       n->probe_flags     = RD_NODE_PROBE_NEVER_STARTED;
     }
-  } else if (n->state == STATUS_DONE) {
+    rd_node_hot_get(i, &hot);
+  } else if ((hot.state == STATUS_DONE) || (hot.state == STATUS_MDNS_PROBE)
+             || (hot.state == STATUS_MDNS_EP_PROBE)) {
     /* Here we just fake that the nodes has been alive recently.
      * This is to prevent that the node becomes failing without
      * reason*/
-    n->lastAwake = clock_seconds();
-    /* Schedule all names to be re-probed. */
-    n->state = STATUS_MDNS_PROBE;
-    for (ep = list_head(n->endpoints); ep != NULL; ep = list_item_next(ep)) {
-      ep->state = EP_STATE_MDNS_PROBE;
-    }
+    hot.lastAwake = clock_seconds();
+    /* No names are probed over mDNS; a node stored in those states by an
+     * older gateway is done, and so are its endpoints. */
+    hot.state = STATUS_DONE;
+    rd_node_set_ep_states(i, EP_STATE_PROBE_DONE);
   }
   /* Mark wakeup nodes without fixed interval as recently
    * alive. This prevents frames queued to them from being
    * dropped too early after a gateway restart. */
-  if (((n->mode & 0xff) == MODE_MAILBOX) && (n->wakeUp_interval == 0)) {
-    n->lastAwake = clock_seconds();
+  if (((hot.mode & 0xff) == MODE_MAILBOX) && (hot.wakeUp_interval == 0)) {
+    hot.lastAwake = clock_seconds();
   }
+  rd_node_hot_set(i, &hot);
 }
 
 static void sli_read_zw_rd_node_in_nvm(nodemask_t nodelist)
@@ -2090,6 +3087,7 @@ int rd_init(uint8_t lock)
 
   DWORD old_homeID;
 
+  rd_lock_init();
   data_store_init();
 
   old_homeID = homeID;
@@ -2103,12 +3101,20 @@ int rd_init(uint8_t lock)
   copy_virtual_nodes_mask_from_controller();
 
   nif_request_ep = 0;
+  sl_sleeptimer_stop_timer(&sli_rd_nif_check_timer);
+  memset(sli_rd_nif_check, 0, sizeof(sli_rd_nif_check));
+  memset(sli_rd_nif_retried, 0, sizeof(sli_rd_nif_retried));
+  sli_rd_nif_check_node = 0;
   if (rd_probe_in_progress()) {
-    ERR_PRINTF("RD re-initialized while probing node %u\n",
-               current_probe_entry->nodeid);
+    ERR_PRINTF("RD re-initialized while probing %u nodes\n",
+               sli_rd_probe_active());
   }
-  current_probe_entry = 0;
-  probe_lock          = lock;
+  sli_rd_probe_end_all();
+  sli_rd_route_entry = 0;
+  sl_airtime_budget_init(&sli_rd_probe_budget, RD_PROBE_AIRTIME_MS,
+                         clock_time());
+  rd_profile_init();
+  probe_lock = lock;
 
   SerialAPI_GetInitData(&ver,
                         &capabilities,
@@ -2137,6 +3143,7 @@ void rd_full_network_discovery()
   nodemask_t nodelist = { 0 };
   uint8_t ver, capabilities, len, chip_type, chip_data;
   uint16_t lr_nodelist_len = 0;
+  rd_node_hot_t hot;
 
   DBG_PRINTF("Re-synchronizing nodes\n");
 
@@ -2148,13 +3155,23 @@ void rd_full_network_discovery()
                         &chip_data);
   SerialAPI_GetLRNodeList(&lr_nodelist_len, NODEMASK_GET_LR(nodelist));
 
+  rd_lock();
   for (nodeid_t i = 1; i <= ZW_LR_MAX_NODE_ID_IN_NVM; i++) {
-    if (nodemask_test_node(i, nodelist)) {
-      rd_register_new_node(i, 0x00);
-    } else {
+    if (!nodemask_test_node(i, nodelist)) {
       rd_remove_node(i);
+    } else if (i == MyNodeID || !rd_node_hot_get(i, &hot)
+               || (hot.state != STATUS_DONE && hot.state != STATUS_FAILING)
+               || hot.nif_digest == 0) {
+      rd_register_new_node(i, 0x00);
+    } else if ((hot.mode & 0xff) != MODE_NONLISTENING
+               && (hot.mode & 0xff) != MODE_MAILBOX) {
+      nodemask_add_node(i, sli_rd_nif_check);
     }
   }
+  if (!sli_rd_nif_check_node) {
+    sli_rd_nif_check_next();
+  }
+  rd_unlock();
 }
 
 u8_t rd_probe_new_nodes()
@@ -2200,31 +3217,17 @@ rd_ep_database_entry_t *rd_group_ep_iterator_next(rd_group_entry_t *ge,
   return 0;
 }
 
-/**
- *
- * Supported  non Sec
- * Controlled non Sec
- * Supported Sec
- * Controlled Sec
- *
+/*
+ * Walk the NIF of an endpoint. Calls back with the support flag of every
+ * class listed; marks switch the flag of the classes that follow them.
  */
-int rd_ep_class_support(rd_ep_database_entry_t *ep, uint16_t cls)
+static void sli_rd_ep_class_walk(const rd_ep_database_entry_t *ep,
+                                 void (*cb)(uint16_t cls, u8_t flag, void *ctx),
+                                 void *ctx)
 {
-  int bSecureClass;
-  int bControlled;
-  u8_t result;
+  int bSecureClass = 0;
+  int bControlled  = 0;
   u16_t c;
-  if (!ep->endpoint_info) {
-    return 0;
-  }
-
-  if (ep->node->mode & MODE_FLAGS_DELETED) {
-    return 0;
-  }
-
-  bSecureClass = 0;
-  bControlled  = 0;
-  result       = 0;
 
   for (nodeid_t i = 2; i < ep->endpoint_info_len; i++) {
     c = ep->endpoint_info[i];
@@ -2243,11 +3246,97 @@ int rd_ep_class_support(rd_ep_database_entry_t *ep, uint16_t cls)
       bControlled  = 0;
     } else if (c == COMMAND_CLASS_MARK) {
       bControlled = 1;
-    } else if (c == cls) {
-      result |= 1 << ((bSecureClass << 1) | bControlled);
+    } else {
+      cb(c, 1 << ((bSecureClass << 1) | bControlled), ctx);
     }
   }
-  return result;
+}
+
+typedef struct {
+  uint16_t cls;
+  u8_t result;
+} sli_rd_class_match_t;
+
+static void sli_rd_class_match(uint16_t cls, u8_t flag, void *ctx)
+{
+  sli_rd_class_match_t *m = ctx;
+
+  if (cls == m->cls) {
+    m->result |= flag;
+  }
+}
+
+typedef struct {
+  uint8_t flags[RD_EP_CC_FLAGS_MAX / 2];
+  uint8_t classes;
+} sli_rd_class_table_t;
+
+static void sli_rd_class_table_add(uint16_t cls, u8_t flag, void *ctx)
+{
+  sli_rd_class_table_t *t = ctx;
+
+  // Two byte classes and 0xF0..0xFF are left to the NIF walk.
+  if (cls >= RD_EP_CC_FLAGS_MAX) {
+    return;
+  }
+  t->flags[cls >> 1] |= flag << ((cls & 1) * 4);
+  if (cls >= t->classes) {
+    t->classes = (uint8_t) (cls + 1);
+  }
+}
+
+void rd_ep_class_index(rd_ep_database_entry_t *ep)
+{
+  sli_rd_class_table_t t;
+  uint8_t len;
+
+  rd_data_mem_free(ep->cc_flags);
+  ep->cc_flags         = NULL;
+  ep->cc_flags_classes = 0;
+  if (!ep->endpoint_info) {
+    return;
+  }
+
+  memset(&t, 0, sizeof(t));
+  sli_rd_ep_class_walk(ep, sli_rd_class_table_add, &t);
+  // At least one byte, so a NULL table always means "not built".
+  len          = t.classes ? (uint8_t) ((t.classes + 1) / 2) : 1;
+  ep->cc_flags = rd_data_mem_alloc(len);
+  if (ep->cc_flags) {
+    memcpy(ep->cc_flags, t.flags, len);
+    ep->cc_flags_classes = t.classes;
+  }
+}
+
+/**
+ *
+ * Supported  non Sec
+ * Controlled non Sec
+ * Supported Sec
+ * Controlled Sec
+ *
+ */
+int rd_ep_class_support(rd_ep_database_entry_t *ep, uint16_t cls)
+{
+  sli_rd_class_match_t m = { cls, 0 };
+
+  if (!ep->endpoint_info) {
+    return 0;
+  }
+
+  if (ep->node->mode & MODE_FLAGS_DELETED) {
+    return 0;
+  }
+
+  if (ep->cc_flags && cls < RD_EP_CC_FLAGS_MAX) {
+    if (cls >= ep->cc_flags_classes) {
+      return 0;
+    }
+    return (ep->cc_flags[cls >> 1] >> ((cls & 1) * 4)) & 0xF;
+  }
+
+  sli_rd_ep_class_walk(ep, sli_rd_class_match, &m);
+  return m.result;
 }
 
 /*
@@ -2257,10 +3346,69 @@ int rd_ep_class_support(rd_ep_database_entry_t *ep, uint16_t cls)
 rd_ep_database_entry_t *rd_lookup_by_ep_name(const char *name,
                                              const char *location)
 {
-  (void) name;
-  (void) location;
+  size_t name_len = strlen(name);
+  size_t loc_len  = location ? strlen(location) : 0;
 
-  return 0;
+  if ((name_len > 0xFF) || (loc_len > 0xFF)) {
+    return 0;
+  }
+  return rd_name_index_find_ep(name, (u8_t) name_len, location, (u8_t) loc_len);
+}
+
+/* Replace *dst with a copy of src, keeping the old string if out of memory. */
+static bool sli_rd_ep_set_string(char **dst, u8_t *dst_len,
+                                 const char *src, u8_t len)
+{
+  char *p = NULL;
+
+  if (len) {
+    p = rd_data_mem_alloc_cold(SL_PSRAM_POOL_RD_NAME, len);
+    if (!p) {
+      ERR_PRINTF("rd: no memory for endpoint name\n");
+      return false;
+    }
+    memcpy(p, src, len);
+  }
+  rd_data_mem_free(*dst);
+  *dst     = p;
+  *dst_len = len;
+  return true;
+}
+
+void rd_update_ep_name(rd_ep_database_entry_t *ep, char *name, u8_t size)
+{
+  if (sli_rd_ep_set_string(&ep->endpoint_name, &ep->endpoint_name_len,
+                           name, size)) {
+    rd_name_index_set_ep(ep);
+    rd_data_store_mark_ep_dirty(ep, RD_DIRTY_EP | RD_DIRTY_EP_NAME);
+  }
+}
+
+void rd_update_ep_location(rd_ep_database_entry_t *ep, char *name, u8_t size)
+{
+  if (sli_rd_ep_set_string(&ep->endpoint_location, &ep->endpoint_loc_len,
+                           name, size)) {
+    rd_name_index_set_ep(ep);
+    rd_data_store_mark_ep_dirty(ep, RD_DIRTY_EP | RD_DIRTY_EP_LOCATION);
+  }
+}
+
+void rd_update_ep_name_and_location(rd_ep_database_entry_t *ep, char *name,
+                                    u8_t name_size, char *location,
+                                    u8_t location_size)
+{
+  bool changed;
+
+  changed  = sli_rd_ep_set_string(&ep->endpoint_name, &ep->endpoint_name_len,
+                                  name, name_size);
+  changed |= sli_rd_ep_set_string(&ep->endpoint_location,
+                                  &ep->endpoint_loc_len,
+                                  location, location_size);
+  if (changed) {
+    rd_name_index_set_ep(ep);
+    rd_data_store_mark_ep_dirty(ep, RD_DIRTY_EP | RD_DIRTY_EP_NAME
+                                | RD_DIRTY_EP_LOCATION);
+  }
 }
 
 rd_group_entry_t *rd_lookup_group_by_name(const char *name)
@@ -2276,8 +3424,10 @@ rd_group_entry_t *rd_lookup_group_by_name(const char *name)
 void rd_free_node_dbe(rd_node_database_entry_t *n)
 {
   if (n) {
+    rd_lock();
     ASSERT(n->refCnt > 0);
     n->refCnt--;
+    rd_unlock();
   }
 }
 
@@ -2294,28 +3444,35 @@ rd_ep_database_entry_t *rd_get_ep(nodeid_t nodeid, uint8_t epid)
       break;
     }
   }
-  rd_free_node_dbe(n);
+  /* The reference is kept for the caller, see rd_free_ep(). */
+  if (ep == NULL) {
+    rd_free_node_dbe(n);
+  }
   return ep;
 }
 
-bool sleeping_node_is_in_firmware_upgrade(nodeid_t nodeid)
+void rd_free_ep(rd_ep_database_entry_t *ep)
 {
-  rd_node_database_entry_t *n = rd_get_node_dbe(nodeid);
-  if (n && (n->mode == MODE_FIRMWARE_UPGRADE)) {
-    return true;
+  if (ep) {
+    rd_free_node_dbe(ep->node);
   }
-  return false;
+}
+
+bool sleeping_node_is_in_firmware_upgrade(nodeid_t nodeid)
+{
+  rd_node_hot_t hot;
+
+  return rd_node_hot_get(nodeid, &hot) && (hot.mode == MODE_FIRMWARE_UPGRADE);
 }
 
 rd_node_mode_t rd_get_node_mode(nodeid_t nodeid)
 {
   /* Choose a better default value in case lookup fails */
-  rd_node_mode_t mode         = MODE_FLAGS_DELETED;
-  rd_node_database_entry_t *n = rd_get_node_dbe(nodeid);
+  rd_node_mode_t mode = MODE_FLAGS_DELETED;
+  rd_node_hot_t hot;
 
-  if (n) {
-    mode = n->mode;
-    rd_free_node_dbe(n);
+  if (rd_node_hot_get(nodeid, &hot)) {
+    mode = hot.mode;
   }
   return mode;
 }
@@ -2333,11 +3490,11 @@ void rd_mark_node_deleted(nodeid_t nodeid)
 rd_node_state_t rd_get_node_state(nodeid_t nodeid)
 {
   /* Choose a better default value in case lookup fails */
-  rd_node_state_t state       = STATUS_PROBE_FAIL;
-  rd_node_database_entry_t *n = rd_get_node_dbe(nodeid);
-  if (n) {
-    state = n->state;
-    rd_free_node_dbe(n);
+  rd_node_state_t state = STATUS_PROBE_FAIL;
+  rd_node_hot_t hot;
+
+  if (rd_node_hot_get(nodeid, &hot)) {
+    state = hot.state;
   }
   return state;
 }
@@ -2402,7 +3559,7 @@ BYTE sl_set_cache_entry_flag_masked(nodeid_t nodeid, BYTE value, BYTE mask)
   n = rd_get_node_dbe(nodeid);
   if (n) {
     n->security_flags = (n->security_flags & (~mask)) | value;
-    rd_data_store_update(n);
+    rd_data_store_mark_dirty(n, RD_DIRTY_NODE);
 
     rd_free_node_dbe(n);
   } else {
@@ -2416,31 +3573,14 @@ BYTE sl_set_cache_entry_flag_masked(nodeid_t nodeid, BYTE value, BYTE mask)
  */
 BYTE sl_get_cache_entry_flag(nodeid_t nodeid)
 {
-  rd_node_database_entry_t *n;
-  uint8_t rc;
+  rd_node_hot_t hot;
 
-  if (is_virtual_node(nodeid)) {
-    n = rd_get_node_dbe(MyNodeID);
-  } else {
-    n = rd_get_node_dbe(nodeid);
-    if (n) {
-      if (nodeid != n->nodeid) {
-        ERR_PRINTF("Attempt to get security flag from a node entry with "
-                   "inconsistent node ID inside, nodeid: %d, n->nodeid: %d\n",
-                   nodeid,
-                   n->nodeid);
-        assert(0);
-      }
-    }
-  }
-
-  if (!n) {
+  /* Asked for every frame sent, so the entry is not loaded for it. */
+  if (!rd_node_hot_get(is_virtual_node(nodeid) ? MyNodeID : nodeid, &hot)) {
     ERR_PRINTF("sl_get_cache_entry_flag: on non existing node=%i\n", nodeid);
     return 0;
   }
-  rc = n->security_flags;
-  rd_free_node_dbe(n);
-  return rc;
+  return hot.security_flags;
 }
 
 int isNodeController(nodeid_t nodeid)
@@ -2465,6 +3605,12 @@ int isNodeController(nodeid_t nodeid)
 void rd_node_is_unreachable(nodeid_t node)
 {
   rd_node_database_entry_t *n;
+  rd_node_hot_t hot;
+
+  /* Only a node in STATUS_DONE can become failing, see rd_set_failing(). */
+  if (!rd_node_hot_get(node, &hot) || (hot.state != STATUS_DONE)) {
+    return;
+  }
   n = rd_get_node_dbe(node);
   if (n) {
     /* Mailbox nodes are managed by dead_nodes_worker */
@@ -2480,9 +3626,19 @@ void rd_node_is_unreachable(nodeid_t node)
 void rd_node_is_alive(nodeid_t node)
 {
   rd_node_database_entry_t *n;
+  rd_node_hot_t hot;
+
+  if (!rd_node_hot_get(node, &hot)) {
+    return;
+  }
+  hot.lastAwake = clock_seconds();
+  rd_node_hot_set(node, &hot);
+  /* Load the entry only if the failing state must change. */
+  if (hot.state != STATUS_FAILING) {
+    return;
+  }
   n = rd_get_node_dbe(node);
   if (n) {
-    n->lastAwake = clock_seconds();
     rd_set_failing(n, FALSE);
     rd_free_node_dbe(n);
   }
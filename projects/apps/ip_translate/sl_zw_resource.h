@@ -70,6 +70,19 @@
  * on the PAN side, the Resource Directory may trigger gratuitous mDNS
  * packets on the LAN side (e.g., mDNS goodbye).
  *
+ * #### Concurrent Interviews ####
+ *
+ * Up to #RD_PROBE_MAX_ACTIVE nodes are interviewed at once, each with
+ * its own context and timer. Every step of an interview takes an
+ * estimated #RD_PROBE_STEP_AIRTIME_MS from a budget of
+ * #RD_PROBE_AIRTIME_MS per second, and waits on its timer when the
+ * budget is spent. An interview that makes no progress for
+ * #RD_PROBE_STALL_MS fails, so it cannot hold its slot forever.
+ *
+ * Wake-up nodes are interviewed when they were just added or when they
+ * wake up and ask for it; one slot is kept free for them, see
+ * rd_probe_resume().
+ *
  * #### Network Management Interaction ####
  * The Resource Directory also works closely with \ref NW_CMD_handler.
  * The NetworkManagement module can create and destroy entries in the
@@ -96,6 +109,42 @@
 
 #define RD_ALL_NODES 0
 
+/** Interviews run at once. Each has at most one request outstanding. */
+#ifndef RD_PROBE_MAX_ACTIVE
+#define RD_PROBE_MAX_ACTIVE 4
+#endif
+
+/** Airtime per second the interviews may use together, in ms. */
+#ifndef RD_PROBE_AIRTIME_MS
+#define RD_PROBE_AIRTIME_MS 250
+#endif
+
+/** Estimated airtime of one interview step, a request and its report. */
+#ifndef RD_PROBE_STEP_AIRTIME_MS
+#define RD_PROBE_STEP_AIRTIME_MS 30
+#endif
+
+/** An interview without progress for this long fails. */
+#ifndef RD_PROBE_STALL_MS
+#define RD_PROBE_STALL_MS 60000
+#endif
+
+typedef struct {
+  uint32_t started;    /**< Interviews started. */
+  uint32_t completed;  /**< Interviews ended in #STATUS_DONE. */
+  uint32_t failed;     /**< Interviews ended in #STATUS_PROBE_FAIL. */
+  uint32_t stalled;    /**< Interviews failed by #RD_PROBE_STALL_MS. */
+  uint32_t deferred;   /**< Steps that waited for airtime. */
+  uint32_t parked;     /**< Wake-up nodes left until they wake up. */
+  uint32_t total_ms;   /**< Time of all ended interviews. */
+  uint32_t nif_same;   /**< Node infos matching the stored digest. */
+  uint32_t nif_new;    /**< Node infos that started an interview. */
+  uint32_t nif_checks; /**< Node infos asked for by rd_full_network_discovery(). */
+  uint32_t ep_reused;  /**< Endpoints kept, their capabilities unchanged. */
+  uint8_t active;      /**< Interviews running now. */
+  uint8_t peak;        /**< Most interviews running at once. */
+} rd_probe_stats_t;
+
 /**
  *
  */
@@ -132,7 +181,14 @@ typedef struct rd_group_entry {
  */
 void rd_register_new_node(nodeid_t node, uint8_t node_properties_flags);
 /**
- * Do a complete re-discovery and "hijack" wakeup nodes
+ * Re-discover the network: nodes no longer in the controller are removed
+ * and new ones are interviewed.
+ *
+ * A node that was interviewed and whose node info digest is known is not
+ * interviewed again. Its node info is asked for instead, one node at a
+ * time within the interview airtime budget, and rd_nif_request_notify()
+ * starts an interview only if it changed. Wake-up nodes are left until
+ * they send their node info. Nodes whose interview failed are interviewed.
  */
 void rd_full_network_discovery();
 
@@ -187,10 +243,9 @@ void rd_probe_lock(uint8_t enable);
  * probed because it is a self-destructing smart start node, this
  * function resets the probe lock.
  *
- * When removal of the node succeeds, \ref current_probe_entry will be
- * reset when the node is deleted.  We also clear \ref
- * current_probe_entry here so that this function can be used in the
- * "removal failed" scenarios.
+ * When removal of the node succeeds, its interview ends when the node
+ * is deleted.  We also end all interviews here so that this function
+ * can be used in the "removal failed" scenarios.
  */
 void rd_probe_cancel(void);
 
@@ -243,8 +298,22 @@ rd_ep_database_entry_t* rd_group_ep_iterator_next(rd_group_entry_t* ge, rd_ep_da
  */
 int rd_ep_class_support(rd_ep_database_entry_t* ep, uint16_t cls);
 
-/** Called from \ref sl_appl_controller_update, when a node info is
- * received or if the ZW_RequestNodeInfo is failed.
+/**
+ * Rebuild the command class flags of an end point from its
+ * #endpoint_info. Must be called whenever #endpoint_info changes, so that
+ * rd_ep_class_support() answers with a single lookup.
+ *
+ * \param ep Pointer to the #rd_ep_database_entry for the endpoint.
+ */
+void rd_ep_class_index(rd_ep_database_entry_t* ep);
+
+/** Called on the router thread through rd_nif_request_post(), when a
+ * node info is received or if the ZW_RequestNodeInfo is failed.
+ *
+ * A node info that is not the one an interview waits for is compared with
+ * the digest stored for endpoint 0 of the node. If it matches, the node is
+ * only marked alive (rd_node_is_alive()). If it differs, or the last
+ * interview of the node failed, the node is interviewed again.
  *
  * @param bStatus if the request went ok
  * \param bNodeID Node id of the node that send node info
@@ -253,6 +322,24 @@ int rd_ep_class_support(rd_ep_database_entry_t* ep, uint16_t cls);
  */
 void rd_nif_request_notify(uint8_t bStatus, nodeid_t bNodeID, uint8_t* nif, uint8_t nif_len);
 
+/**
+ * Hand a node info from \ref sl_appl_controller_update to the router
+ * thread as #ZIP_EVENT_RD_NIF_RECEIVED.
+ *
+ * The controller update runs on the serial API thread, which must not
+ * run interview steps. The node info is copied into a block pool buffer;
+ * it is dropped when no buffer is free or the router queue is full.
+ *
+ * \param bStatus if the request went ok
+ * \param bNodeID Node id of the node that send node info
+ * \param nif Pointer to Application Node information, copied
+ * \param nif_len Node info length.
+ */
+void rd_nif_request_post(uint8_t bStatus,
+                         nodeid_t bNodeID,
+                         const uint8_t* nif,
+                         uint8_t nif_len);
+
 /** Register a node probe-completion notifier.
  *
  * \param node_id The node that needs to be probed.
@@ -287,10 +374,19 @@ u8_t rd_node_exists(nodeid_t node);
 /**
  * Get an endpoint entry in the \ref node_db from nodeid and epid.
  *
+ * The entry of the node is held as with rd_get_node_dbe(); rd_free_ep()
+ * MUST be called when the endpoint entry is no longer needed.
+ *
  * @return A pointer to an endpoint entry or NULL.
  */
 rd_ep_database_entry_t* rd_get_ep(nodeid_t nodeid, uint8_t epid);
 
+/**
+ * MUST be called when an endpoint entry from rd_get_ep() is no longer
+ * needed. Does nothing for NULL.
+ */
+void rd_free_ep(rd_ep_database_entry_t* ep);
+
 /**
  * Get the entire mode field of the node with id \p nodeid.
  *
@@ -364,6 +460,42 @@ rd_update_ep_name_and_location(rd_ep_database_entry_t* ep, char* name,
  */
 u8_t rd_probe_in_progress();
 
+/** Copy the interview counters. */
+void rd_probe_get_stats(rd_probe_stats_t *stats);
+
+/** Print the interview counters. */
+void rd_probe_print_stats(void);
+
+/**
+ * Interview steps replaced by stubs, for the scheduler bench.
+ *
+ * While set, rd_probe_resume() takes the nodes to interview from node()
+ * instead of the RD, and rd_node_probe_update() gives them slots and
+ * airtime as usual but calls step() instead of sending the request of
+ * n->state. step() stands for the request and its callback: it must later
+ * change n->state and call rd_node_probe_update() again, from a thread.
+ * A node in a final state ends its interview without being stored or
+ * announced. Interviews of real nodes wait until the stubs are cleared.
+ */
+typedef struct {
+  /** Entry of node id, or NULL; only entries returned here are probed. */
+  rd_node_database_entry_t *(*node)(nodeid_t id);
+  /** Send the request of n->state, called with rd_lock() held. */
+  void (*step)(rd_node_database_entry_t *n);
+  /** Interviews at once, 1 to #RD_PROBE_MAX_ACTIVE. */
+  uint8_t slots;
+} rd_probe_stubs_t;
+
+/**
+ * Set or clear the interview stubs.
+ *
+ * \param stubs Stubs to use, NULL to end the stub interviews and resume
+ *              those of the RD.
+ * \return false if stubs are given while interviews are running, or with
+ *         slots out of range.
+ */
+bool rd_probe_set_stubs(const rd_probe_stubs_t *stubs);
+
 /**
  * Mark the mode of node MODE_FLAGS_DELETED so that
  */
@@ -372,22 +504,25 @@ void rd_mark_node_deleted(nodeid_t nodeid);
 /**
  * Check node database to see if there are any more nodes to probe.
  *
- * If a probe is already ongoing (#current_probe_entry is not NULL), resume that probe.
+ * Interviews that were held by the probe lock are resumed.
  *
- * Then probe all nodes not in one of the final states: #STATUS_DONE,
- * #STATUS_PROBE_FAIL, or #STATUS_FAILING.
+ * Then free interview slots are given to nodes that are not in one of
+ * the final states (#STATUS_DONE, #STATUS_PROBE_FAIL, #STATUS_FAILING),
+ * keeping one slot free for a node that was just added or woke up. A
+ * wake-up node that was not just added is set to #STATUS_PROBE_FAIL, to
+ * be interviewed when it wakes up. Nodes waiting for mDNS
+ * (#STATUS_MDNS_PROBE) are not interviews and take no slot.
  *
  * Post #ZIP_EVENT_ALL_NODES_PROBED when all nodes are in a final
  * state and the probe machine is unlocked.
  */
 void rd_probe_resume();
 
-/** Start probe of \a n or resume probe of #current_probe_entry.
+/** Start or continue the interview of \a n.
  *
  * Do nothing if probe machine is locked, bridge is \ref booting, \ref
- * ZIP_MDNS is not running or another node probe is on/going.
- *
- * Set #current_probe_entry to \a n if it is not set.
+ * ZIP_MDNS is not running or all #RD_PROBE_MAX_ACTIVE interview slots
+ * are taken by other nodes; rd_probe_resume() starts \a n later.
  *
  * When probe is complete, store node data in eeprom file, send out
  * mDNS notification for all endpoints, and trigger ep probe callback
@@ -396,10 +531,52 @@ void rd_probe_resume();
  * Finally call \ref rd_probe_resume(), to trigger probe of the next
  * node.
  *
+ * Steps also run from serial API callbacks, so this and the other probe
+ * entry points hold rd_lock().
+ *
  * \param n A node to probe.
  */
 void rd_node_probe_update(rd_node_database_entry_t* n);
 
+/**
+ * Tell the next node in the network that the gateway is the SUC/SIS.
+ *
+ * \param status Transmit status of the previous node, or
+ *               TRANSMIT_COMPLETE_FAIL when it timed out.
+ */
+void send_suc_id(uint8_t status);
+
+/**
+ * Continue or fail the interview whose timer posted ZIP_EVENT_RD_PROBE_TIMEOUT.
+ *
+ * The interview timers expire in interrupt context, so the timed steps
+ * run from here, on the router thread, under rd_lock(). An event of a
+ * timer that was started again or stopped meanwhile is ignored.
+ *
+ * \param slot ev_data of the event.
+ */
+void rd_probe_timeout(void *slot);
+
+/**
+ * Fail the endpoint interview waiting for a node info, on
+ * ZIP_EVENT_RD_NIF_REQUEST_TIMEOUT.
+ */
+void rd_nif_request_timeout(void);
+
+/**
+ * Ask the next node of the network discovery for its node info, on
+ * ZIP_EVENT_RD_NIF_CHECK_TIMEOUT.
+ */
+void rd_nif_check_timeout(void);
+
+/**
+ * Pass a node info posted by rd_nif_request_post() to
+ * rd_nif_request_notify(), on ZIP_EVENT_RD_NIF_RECEIVED.
+ *
+ * \param data ev_data of the event, freed here.
+ */
+void rd_nif_received(void *data);
+
 /**
  * Check whether a frame should be forwarded to the unsolicited destination or not, based on
  *    - its command type supporting/controlling,
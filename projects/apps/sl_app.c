@@ -33,6 +33,7 @@
 #include "modules/sl_hw_rng.h"
 #include "modules/sl_mbedtls_thread_impl.h"
 #include "modules/sl_psram.h"
+#include "modules/sl_block_pool.h"
 #include "apps/SerialAPI/sl_uart_drv.h"
 #include "apps/ip_translate/sl_discover.h"
 
@@ -90,6 +91,8 @@ void sl_app_thread(void *argument)
   sl_hw_hrng_init();
 
   sl_cli_init();
+  // Frame buffers, needed before the first serial frame is queued
+  sl_block_pool_init();
   sl_serial_api_init();
 
   // wait wlan connected.
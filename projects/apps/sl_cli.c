@@ -19,6 +19,17 @@
  */
 
 #include "sl_ota/sl_bridge_ota.h"
+#include "sl_ota/sl_node_ota.h"
+#include "modules/sl_psram_arena.h"
+#include "modules/sl_block_pool.h"
+#include "modules/sl_rd_data_store.h"
+#include "Net/sl_udp_utils.h"
+#include "ip_bridge/sl_shared_get.h"
+#include "ip_bridge/sl_state_cache.h"
+#include "ip_bridge/sl_mailbox.h"
+#include "ip_translate/sl_zw_resource.h"
+#include "Z-Wave/CC/RD_profile.h"
+#include "test/sl_test.h"
 #include "sl_common_log.h"
 #include "sl_cli.h"
 #include "console.h"
@@ -100,6 +111,186 @@ static const console_descriptive_command_t sli_ota_command = {
                      CONSOLE_ARG_END }
 };
 
+sl_status_t sli_ota_status_handler(console_args_t *arguments);
+static const char *sli_ota_status_arg_help[]                      = {};
+static const console_descriptive_command_t sli_ota_status_command = {
+  .description   = "Node OTA progress",
+  .argument_help = sli_ota_status_arg_help,
+  .handler       = sli_ota_status_handler,
+  .argument_list = { CONSOLE_ARG_END }
+};
+
+sl_status_t sli_psram_bench_handler(console_args_t *arguments);
+static const char *sli_psram_bench_arg_help[]                      = {};
+static const console_descriptive_command_t sli_psram_bench_command = {
+  .description   = "PSRAM read/write/copy throughput",
+  .argument_help = sli_psram_bench_arg_help,
+  .handler       = sli_psram_bench_handler,
+  .argument_list = { CONSOLE_ARG_END }
+};
+
+sl_status_t sli_psram_stat_handler(console_args_t *arguments);
+static const char *sli_psram_stat_arg_help[]                      = {};
+static const console_descriptive_command_t sli_psram_stat_command = {
+  .description   = "PSRAM arena pool usage",
+  .argument_help = sli_psram_stat_arg_help,
+  .handler       = sli_psram_stat_handler,
+  .argument_list = { CONSOLE_ARG_END }
+};
+
+sl_status_t sli_udp_stat_handler(console_args_t *arguments);
+static const char *sli_udp_stat_arg_help[]                      = {};
+static const console_descriptive_command_t sli_udp_stat_command = {
+  .description   = "UDP send socket pool and Z/IP replay cache counters",
+  .argument_help = sli_udp_stat_arg_help,
+  .handler       = sli_udp_stat_handler,
+  .argument_list = { CONSOLE_ARG_END }
+};
+
+sl_status_t sli_pkt_stat_handler(console_args_t *arguments);
+static const char *sli_pkt_stat_arg_help[]                      = {};
+static const console_descriptive_command_t sli_pkt_stat_command = {
+  .description   = "Inbound packet buffer pool counters",
+  .argument_help = sli_pkt_stat_arg_help,
+  .handler       = sli_pkt_stat_handler,
+  .argument_list = { CONSOLE_ARG_END }
+};
+
+sl_status_t sli_get_stat_handler(console_args_t *arguments);
+static const char *sli_get_stat_arg_help[]                      = {};
+static const console_descriptive_command_t sli_get_stat_command = {
+  .description   = "Client Get counters, including shared Gets",
+  .argument_help = sli_get_stat_arg_help,
+  .handler       = sli_get_stat_handler,
+  .argument_list = { CONSOLE_ARG_END }
+};
+
+sl_status_t sli_cache_stat_handler(console_args_t *arguments);
+static const char *sli_cache_stat_arg_help[]                      = {};
+static const console_descriptive_command_t sli_cache_stat_command = {
+  .description   = "Last known state cache counters",
+  .argument_help = sli_cache_stat_arg_help,
+  .handler       = sli_cache_stat_handler,
+  .argument_list = { CONSOLE_ARG_END }
+};
+
+sl_status_t sli_mbox_stat_handler(console_args_t *arguments);
+static const char *sli_mbox_stat_arg_help[]                      = {};
+static const console_descriptive_command_t sli_mbox_stat_command = {
+  .description   = "Wake-up node mailbox counters and queues",
+  .argument_help = sli_mbox_stat_arg_help,
+  .handler       = sli_mbox_stat_handler,
+  .argument_list = { CONSOLE_ARG_END }
+};
+
+sl_status_t sli_pool_stat_handler(console_args_t *arguments);
+static const char *sli_pool_stat_arg_help[]                      = {};
+static const console_descriptive_command_t sli_pool_stat_command = {
+  .description   = "Frame buffer block pool counters and heap watermarks",
+  .argument_help = sli_pool_stat_arg_help,
+  .handler       = sli_pool_stat_handler,
+  .argument_list = { CONSOLE_ARG_END }
+};
+
+sl_status_t sli_cc_bench_handler(console_args_t *arguments);
+static const char *sli_cc_bench_arg_help[]                      = {};
+static const console_descriptive_command_t sli_cc_bench_command = {
+  .description   = "Command class lookup cost, NIF walk vs endpoint flags",
+  .argument_help = sli_cc_bench_arg_help,
+  .handler       = sli_cc_bench_handler,
+  .argument_list = { CONSOLE_ARG_END }
+};
+
+sl_status_t sli_rd_store_stat_handler(console_args_t *arguments);
+static const char *sli_rd_store_stat_arg_help[]                      = {};
+static const console_descriptive_command_t sli_rd_store_stat_command = {
+  .description   = "Resource directory NVM3 write counters",
+  .argument_help = sli_rd_store_stat_arg_help,
+  .handler       = sli_rd_store_stat_handler,
+  .argument_list = { CONSOLE_ARG_END }
+};
+
+sl_status_t sli_rd_store_bench_handler(console_args_t *arguments);
+static const char *sli_rd_store_bench_arg_help[]                      = {};
+static const console_descriptive_command_t sli_rd_store_bench_command = {
+  .description   = "Check that resource directory updates are coalesced",
+  .argument_help = sli_rd_store_bench_arg_help,
+  .handler       = sli_rd_store_bench_handler,
+  .argument_list = { CONSOLE_ARG_END }
+};
+
+sl_status_t sli_rd_record_bench_handler(console_args_t *arguments);
+static const char *sli_rd_record_bench_arg_help[]                      = {};
+static const console_descriptive_command_t sli_rd_record_bench_command = {
+  .description   = "Check that resource directory nodes survive their NVM3 record",
+  .argument_help = sli_rd_record_bench_arg_help,
+  .handler       = sli_rd_record_bench_handler,
+  .argument_list = { CONSOLE_ARG_END }
+};
+
+sl_status_t sli_rd_cache_bench_handler(console_args_t *arguments);
+static const char *sli_rd_cache_bench_arg_help[]                      = {};
+static const console_descriptive_command_t sli_rd_cache_bench_command = {
+  .description   = "Measure loading resource directory nodes on demand",
+  .argument_help = sli_rd_cache_bench_arg_help,
+  .handler       = sli_rd_cache_bench_handler,
+  .argument_list = { CONSOLE_ARG_END }
+};
+
+sl_status_t sli_rd_profile_bench_handler(console_args_t *arguments);
+static const char *sli_rd_profile_bench_arg_help[]                      = {};
+static const console_descriptive_command_t sli_rd_profile_bench_command = {
+  .description   = "Check that a device profile fills in a node",
+  .argument_help = sli_rd_profile_bench_arg_help,
+  .handler       = sli_rd_profile_bench_handler,
+  .argument_list = { CONSOLE_ARG_END }
+};
+
+sl_status_t sli_probe_sched_bench_handler(console_args_t *arguments);
+static const char *sli_probe_sched_bench_arg_help[]                      = {};
+static const console_descriptive_command_t sli_probe_sched_bench_command = {
+  .description   = "Interview stub nodes with one and with concurrent slots",
+  .argument_help = sli_probe_sched_bench_arg_help,
+  .handler       = sli_probe_sched_bench_handler,
+  .argument_list = { CONSOLE_ARG_END }
+};
+
+sl_status_t sli_ota_decode_bench_handler(console_args_t *arguments);
+static const char *sli_ota_decode_bench_arg_help[]                      = {};
+static const console_descriptive_command_t sli_ota_decode_bench_command = {
+  .description   = "Decode test LZ4 and delta OTA images",
+  .argument_help = sli_ota_decode_bench_arg_help,
+  .handler       = sli_ota_decode_bench_handler,
+  .argument_list = { CONSOLE_ARG_END }
+};
+
+sl_status_t sli_getshare_handler(console_args_t *arguments);
+static const char *sli_getshare_arg_help[]                      = {};
+static const console_descriptive_command_t sli_getshare_command = {
+  .description   = "Check shared client Gets",
+  .argument_help = sli_getshare_arg_help,
+  .handler       = sli_getshare_handler,
+  .argument_list = { CONSOLE_ARG_END }
+};
+
+sl_status_t sli_rd_versions_bench_handler(console_args_t *arguments);
+static const char *sli_rd_versions_bench_arg_help[]                      = {};
+static const console_descriptive_command_t sli_rd_versions_bench_command = {
+  .description   = "Check the per-node CC version table",
+  .argument_help = sli_rd_versions_bench_arg_help,
+  .handler       = sli_rd_versions_bench_handler,
+  .argument_list = { CONSOLE_ARG_END }
+};
+
+sl_status_t sli_rd_names_bench_handler(console_args_t *arguments);
+static const char *sli_rd_names_bench_arg_help[]                      = {};
+static const console_descriptive_command_t sli_rd_names_bench_command = {
+  .description   = "Check the RD name index",
+  .argument_help = sli_rd_names_bench_arg_help,
+  .handler       = sli_rd_names_bench_handler,
+  .argument_list = { CONSOLE_ARG_END }
+};
+
 sl_status_t sli_setkey_handler(console_args_t *arguments);
 static const char *sli_setkey_arg_help[]                      = {};
 static const console_descriptive_command_t sli_setkey_command = {
@@ -133,6 +324,26 @@ const console_database_t console_command_database = {
                            { "setkey", &sli_setkey_command },
                            { "tls", &sli_tls_command },
                            { "ota", &sli_ota_command },
+                           { "otastat", &sli_ota_status_command },
+                           { "psrambench", &sli_psram_bench_command },
+                           { "psramstat", &sli_psram_stat_command },
+                           { "udpstat", &sli_udp_stat_command },
+                           { "pktstat", &sli_pkt_stat_command },
+                           { "getstat", &sli_get_stat_command },
+                           { "cachestat", &sli_cache_stat_command },
+                           { "mboxstat", &sli_mbox_stat_command },
+                           { "poolstat", &sli_pool_stat_command },
+                           { "ccbench", &sli_cc_bench_command },
+                           { "rdstat", &sli_rd_store_stat_command },
+                           { "rdbench", &sli_rd_store_bench_command },
+                           { "rdrecord", &sli_rd_record_bench_command },
+                           { "rdcache", &sli_rd_cache_bench_command },
+                           { "probebench", &sli_probe_sched_bench_command },
+                           { "rdprofile", &sli_rd_profile_bench_command },
+                           { "otadecode", &sli_ota_decode_bench_command },
+                           { "getshare", &sli_getshare_command },
+                           { "ccver", &sli_rd_versions_bench_command },
+                           { "rdnames", &sli_rd_names_bench_command },
                            { "route", &sli_ip_route_command })
 };
 
@@ -251,6 +462,150 @@ sl_status_t sli_tls_connect_handler(console_args_t *arguments)
   return SL_STATUS_OK;
 }
 
+sl_status_t sli_ota_status_handler(console_args_t *arguments)
+{
+  (void) arguments;
+  sl_node_ota_print_progress();
+  return SL_STATUS_OK;
+}
+
+sl_status_t sli_psram_bench_handler(console_args_t *arguments)
+{
+  (void) arguments;
+  sl_test_psram_bench();
+  return SL_STATUS_OK;
+}
+
+sl_status_t sli_psram_stat_handler(console_args_t *arguments)
+{
+  (void) arguments;
+  sl_psram_arena_print_stats();
+  return SL_STATUS_OK;
+}
+
+sl_status_t sli_udp_stat_handler(console_args_t *arguments)
+{
+  (void) arguments;
+  sl_udp_socket_pool_print_stats();
+  sl_zip_replay_print_stats();
+  return SL_STATUS_OK;
+}
+
+sl_status_t sli_pkt_stat_handler(console_args_t *arguments)
+{
+  (void) arguments;
+  sl_tcpip_buf_print_stats();
+  return SL_STATUS_OK;
+}
+
+sl_status_t sli_get_stat_handler(console_args_t *arguments)
+{
+  (void) arguments;
+  sl_shared_get_print_stats();
+  return SL_STATUS_OK;
+}
+
+sl_status_t sli_cache_stat_handler(console_args_t *arguments)
+{
+  (void) arguments;
+  sl_state_cache_print_stats();
+  return SL_STATUS_OK;
+}
+
+sl_status_t sli_mbox_stat_handler(console_args_t *arguments)
+{
+  (void) arguments;
+  sl_mailbox_print_stats();
+  return SL_STATUS_OK;
+}
+
+sl_status_t sli_pool_stat_handler(console_args_t *arguments)
+{
+  (void) arguments;
+  sl_block_pool_print_stats();
+  return SL_STATUS_OK;
+}
+
+sl_status_t sli_cc_bench_handler(console_args_t *arguments)
+{
+  (void) arguments;
+  sl_test_cc_class_bench();
+  return SL_STATUS_OK;
+}
+
+sl_status_t sli_rd_store_stat_handler(console_args_t *arguments)
+{
+  (void) arguments;
+  rd_data_store_print_stats();
+  rd_node_cache_print_stats();
+  rd_probe_print_stats();
+  rd_profile_print_stats();
+  return SL_STATUS_OK;
+}
+
+sl_status_t sli_rd_store_bench_handler(console_args_t *arguments)
+{
+  (void) arguments;
+  sl_test_rd_store_bench();
+  return SL_STATUS_OK;
+}
+
+sl_status_t sli_rd_record_bench_handler(console_args_t *arguments)
+{
+  (void) arguments;
+  sl_test_rd_record_bench();
+  return SL_STATUS_OK;
+}
+
+sl_status_t sli_rd_cache_bench_handler(console_args_t *arguments)
+{
+  (void) arguments;
+  sl_test_rd_cache_bench();
+  return SL_STATUS_OK;
+}
+
+sl_status_t sli_rd_profile_bench_handler(console_args_t *arguments)
+{
+  (void) arguments;
+  sl_test_rd_profile_bench();
+  return SL_STATUS_OK;
+}
+
+sl_status_t sli_probe_sched_bench_handler(console_args_t *arguments)
+{
+  (void) arguments;
+  sl_test_probe_sched_bench();
+  return SL_STATUS_OK;
+}
+
+sl_status_t sli_ota_decode_bench_handler(console_args_t *arguments)
+{
+  (void) arguments;
+  sl_test_ota_decode_bench();
+  return SL_STATUS_OK;
+}
+
+sl_status_t sli_getshare_handler(console_args_t *arguments)
+{
+  (void) arguments;
+  sl_test_shared_get_bench();
+  return SL_STATUS_OK;
+}
+
+sl_status_t sli_rd_versions_bench_handler(console_args_t *arguments)
+{
+  (void) arguments;
+  sl_test_rd_versions_bench();
+  return SL_STATUS_OK;
+}
+
+sl_status_t sli_rd_names_bench_handler(console_args_t *arguments)
+{
+  (void) arguments;
+  sl_test_rd_names_bench();
+  return SL_STATUS_OK;
+}
+
 // setkey ABCD11111335353532
 extern uint8_t networkKey[16];
 extern void sec0_set_key(uint8_t *netkey);
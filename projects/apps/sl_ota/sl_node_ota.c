@@ -16,6 +16,7 @@
  ******************************************************************************/
 
 #include "stdio.h"
+#include "stdlib.h"
 #include "stdbool.h"
 #include "cmsis_os2.h"
 #include "Serialapi.h"
@@ -33,21 +34,104 @@
 #include "Net/ZW_zip_classcmd.h"
 #include "SerialAPI/sl_serial.h"
 #include "threads/sl_tcpip_handler.h"
-#include "threads/sl_infra_if.h"
+#include "threads/sl_zw_netif.h"
+
+#include "sl_node_ota.h"
 
 #define FW_UPDATE_SEGMENT_SIZE 40
 #define FW_TARGET_ID           0x0402
+#define FW_REPORT_LAST         0x80
+
+static sl_node_ota_session_t sl_node_sessions[SL_NODE_OTA_MAX_SESSIONS];
+static uint8_t sl_node_rr = 0;
+static osMutexId_t sl_node_ota_mutex = NULL;
+
+#define node_ota_lock()   osMutexAcquire(sl_node_ota_mutex, osWaitForever)
+#define node_ota_unlock() osMutexRelease(sl_node_ota_mutex)
+
+static const char *sli_node_ota_state_name(sl_node_ota_state_t st)
+{
+  switch (st) {
+    case SL_NODE_OTA_IDLE:
+      return "idle";
+    case SL_NODE_OTA_REQUESTED:
+      return "requested";
+    case SL_NODE_OTA_TRANSFER:
+      return "transfer";
+    case SL_NODE_OTA_DONE:
+      return "done";
+    case SL_NODE_OTA_FAILED:
+      return "failed";
+    default:
+      return "unknown";
+  }
+}
+
+static sl_node_ota_session_t *sli_node_ota_find(nodeid_t nodeid)
+{
+  for (int i = 0; i < SL_NODE_OTA_MAX_SESSIONS; i++) {
+    if (sl_node_sessions[i].state != SL_NODE_OTA_IDLE
+        && sl_node_sessions[i].nodeid == nodeid) {
+      return &sl_node_sessions[i];
+    }
+  }
+  return NULL;
+}
 
-static uint32_t sl_node_fszie = 0;
-static uint8_t sl_nodeid_md = 0;
+static bool sli_node_ota_active(const sl_node_ota_session_t *s)
+{
+  return s->state == SL_NODE_OTA_REQUESTED || s->state == SL_NODE_OTA_TRANSFER;
+}
+
+static void sli_node_ota_log_progress(const sl_node_ota_session_t *s)
+{
+  uint32_t pct = s->freports
+                 ? (100UL * s->sent_reports) / s->freports : 0;
+  LOG_PRINTF("OTA node %d: %s %d/%d fragments (%ld%%)\n",
+             s->nodeid,
+             sli_node_ota_state_name(s->state),
+             s->sent_reports,
+             s->freports,
+             pct);
+}
+
+/* Wrap a Z/IP frame as if it came from the unsolicited destination and
+ * queue it to the node. Never blocks, the caller may be the tcpip thread. */
+static int sli_node_ota_post(nodeid_t nodeid, uint8_t *zipbuf, uint16_t pktlen)
+{
+  struct in6_addr in;
+  memcpy(in.un.u8_addr, router_cfg.unsolicited_dest.u8, 16);
+  uip_ip6addr_t node_addr;
+  sl_zw_netif_node_addr(nodeid, &node_addr);
+  sl_tcpip_buf_t *tcpipzip = sl_zip_packet_v6(
+    &in,
+    router_cfg.unsolicited_port,
+    &node_addr,
+    zipbuf,
+    pktlen);
+
+  if (!tcpipzip) {
+    ERR_PRINTF("OMG NO MEM!\n");
+    return -1;
+  }
+  if (zw_tcpip_try_post_event(1, tcpipzip) != SL_STATUS_OK) {
+    sl_tcpip_buf_release(tcpipzip);
+    return -1;
+  }
+  return 0;
+}
 
 /**
  * @brief Send a Firmware Update Meta Data Request Get (0x7A 0x03) command to the OTA node.
  *
+ * @param nodeid Node ID of the OTA target.
+ * @param seq Z/IP sequence number.
  * @param checksum The firmware checksum (CRC).
  * @return 0 on success, -1 on error.
  */
-int sl_node_ota_send_md_request(uint16_t checksum)
+static int sli_node_ota_send_md_request(nodeid_t nodeid,
+                                        uint8_t seq,
+                                        uint16_t checksum)
 {
   ZW_COMMAND_ZIP_PACKET *zippkt;
   uint8_t zipbuf[128];
@@ -57,7 +141,7 @@ int sl_node_ota_send_md_request(uint16_t checksum)
   zippkt->cmd       = COMMAND_ZIP_PACKET;
   zippkt->flags0    = 0x00; // no ack request
   zippkt->flags1    = 0x50; // security enabled.
-  zippkt->seqNo     = 0x01; // Example sequence number
+  zippkt->seqNo     = seq;
   zippkt->sEndpoint = 0;
   zippkt->dEndpoint = 0;
   zip_payload       = zippkt->payload;
@@ -82,42 +166,29 @@ int sl_node_ota_send_md_request(uint16_t checksum)
   // Send the Z-Wave command
   uint16_t pktlen = sizeof(ZW_COMMAND_ZIP_PACKET)
                     + sizeof(ZW_FIRMWARE_UPDATE_MD_REQUEST_GET_V3_FRAME);
-  struct in6_addr in;
-  memcpy(in.un.u8_addr, router_cfg.unsolicited_dest.u8, 16);
-  char addr_str[INET6_ADDRSTRLEN];
-  snprintf(addr_str, sizeof(addr_str), "%s%x", SL_INFRA_IF_RIO_PREFIX, sl_nodeid_md);
-  sl_tcpip_buf_t *tcpipzip = sl_zip_packet_v6(
-    &in,
-    router_cfg.unsolicited_port,
-    addr_str,   // Local IP address, can be NULL for default
-    zipbuf,
-    pktlen);
-
-  if (tcpipzip) {
-    LOG_PRINTF("SEND MD REQUEST: \n");
-    sl_print_hex_buf(zipbuf, pktlen);
-    zw_tcpip_post_event(1, tcpipzip);
-  } else {
-    ERR_PRINTF("OMG NO MEM!\n");
-    return -1;
-  }
 
-  return 0;
+  LOG_PRINTF("SEND MD REQUEST to node %d: \n", nodeid);
+  sl_print_hex_buf(zipbuf, pktlen);
+  return sli_node_ota_post(nodeid, zipbuf, pktlen);
 }
 
 /**
  * @brief Send a firmware chunk packet to the OTA node.
  *
+ * @param nodeid Node ID of the OTA target.
+ * @param seq Z/IP sequence number.
  * @param data Pointer to the chunk data buffer.
  * @param dlen Length of the chunk data.
  * @param pros Chunk properties (bit 7 = 1 if last chunk).
  * @param ch_id Chunk sequence number.
  * @return 0 on success, -1 on error.
  */
-int sl_node_ota_send_md_packet(uint8_t *data,
-                               uint16_t dlen,
-                               uint8_t pros,
-                               uint16_t ch_id)
+static int sli_node_ota_send_md_packet(nodeid_t nodeid,
+                                       uint8_t seq,
+                                       uint8_t *data,
+                                       uint16_t dlen,
+                                       uint8_t pros,
+                                       uint16_t ch_id)
 {
   ZW_COMMAND_ZIP_PACKET *zippkt;
   uint8_t zipbuf[128];
@@ -127,7 +198,7 @@ int sl_node_ota_send_md_packet(uint8_t *data,
   zippkt->cmd       = COMMAND_ZIP_PACKET;
   zippkt->flags0    = 0x00;           // no ack request
   zippkt->flags1    = 0x50;           // security enabled.
-  zippkt->seqNo     = (ch_id & 0xFF); // Example sequence number
+  zippkt->seqNo     = seq;
   zippkt->sEndpoint = 0;
   zippkt->dEndpoint = 0;
   zip_payload       = zippkt->payload;
@@ -147,88 +218,317 @@ int sl_node_ota_send_md_packet(uint8_t *data,
 
   uint16_t pktlen = sizeof(ZW_COMMAND_ZIP_PACKET) - 1 + 4   // for md header.
                     + dlen + 2;                         // 2 for checksum
-  struct in6_addr in;
-  memcpy(in.un.u8_addr, router_cfg.unsolicited_dest.u8, 16);
-  char addr_str[INET6_ADDRSTRLEN];
-  snprintf(addr_str, sizeof(addr_str), "%s%x", SL_INFRA_IF_RIO_PREFIX, sl_nodeid_md);
 
-  sl_tcpip_buf_t *tcpipzip = sl_zip_packet_v6(
-    &in,
-    router_cfg.unsolicited_port,
-    addr_str,   // Local IP address, can be NULL for default
-    zipbuf,
-    pktlen);
+  DBG_PRINTF("SEND MD packet: %d to node %d\n", ch_id, nodeid);
+  return sli_node_ota_post(nodeid, zipbuf, pktlen);
+}
 
-  if (tcpipzip) {
-    LOG_PRINTF("SEND MD packet: %d\n", ch_id);
-    zw_tcpip_post_event(1, tcpipzip);
-  } else {
-    ERR_PRINTF("OMG NO MEM!\n");
+/*
+ * Queue the MD Request Get of a session that has not sent one yet. The
+ * session is released after SL_NODE_OTA_REQUEST_TRIES failed attempts so it
+ * does not hold its slot. Returns true if it must be retried.
+ */
+static bool sli_node_ota_request(sl_node_ota_session_t *s)
+{
+  bool retry = false;
+  nodeid_t nodeid;
+  uint16_t checksum;
+  uint8_t seq;
+  int rc;
+
+  node_ota_lock();
+  if (s->state != SL_NODE_OTA_REQUESTED || s->requested) {
+    node_ota_unlock();
+    return false;
+  }
+  nodeid   = s->nodeid;
+  seq      = s->seq;
+  checksum = s->checksum;
+  node_ota_unlock();
+
+  rc = sli_node_ota_send_md_request(nodeid, seq, checksum);
+
+  node_ota_lock();
+  if (s->state == SL_NODE_OTA_REQUESTED && s->nodeid == nodeid
+      && !s->requested) {
+    if (rc == 0) {
+      s->seq++;
+      s->requested = true;
+      s->last_tick = osKernelGetTickCount();
+    } else if (++s->tries >= SL_NODE_OTA_REQUEST_TRIES) {
+      ERR_PRINTF("OTA node %d: MD Request Get not sent, session released\n",
+                 nodeid);
+      memset(s, 0, sizeof(*s));
+    } else {
+      retry = true;
+    }
+  }
+  node_ota_unlock();
+  return retry;
+}
+
+/* Fail an active session whose node has been silent too long. */
+static void sli_node_ota_check_timeout(sl_node_ota_session_t *s, uint32_t now)
+{
+  uint32_t limit = SL_NODE_OTA_TIMEOUT_MS * osKernelGetTickFreq() / 1000U;
+
+  if (sli_node_ota_active(s) && s->requested
+      && now - s->last_tick > limit) {
+    WRN_PRINTF("OTA node %d timed out\n", s->nodeid);
+    s->state   = SL_NODE_OTA_FAILED;
+    s->pending = 0;
+    sli_node_ota_log_progress(s);
+  }
+}
+
+/**
+ * @brief Abort all node sessions; called before the staged image changes.
+ */
+void sl_node_ota_abort_all(void)
+{
+  if (sl_node_ota_mutex == NULL) {
+    return;
+  }
+  node_ota_lock();
+  for (int i = 0; i < SL_NODE_OTA_MAX_SESSIONS; i++) {
+    if (sli_node_ota_active(&sl_node_sessions[i])) {
+      WRN_PRINTF("OTA node %d aborted, image replaced\n",
+                 sl_node_sessions[i].nodeid);
+    }
+    sl_node_sessions[i].state = SL_NODE_OTA_IDLE;
+  }
+  node_ota_unlock();
+}
+
+/**
+ * @brief Start update sessions for several nodes from the staged image.
+ */
+int sl_node_ota_start(uint32_t fsize,
+                      uint16_t checksum,
+                      const nodeid_t *nodes,
+                      uint8_t count)
+{
+  uint16_t freports = (fsize + FW_UPDATE_SEGMENT_SIZE - 1)
+                      / FW_UPDATE_SEGMENT_SIZE;
+  int started = 0;
+  bool retry = false;
+
+  if (fsize == 0 || nodes == NULL) {
+    ERR_PRINTF("Invalid firmware size: %ld\n", fsize);
+    return 0;
+  }
+  if (sl_node_ota_mutex == NULL) {
+    sl_node_ota_mutex = osMutexNew(NULL);
+  }
+
+  node_ota_lock();
+  memset(sl_node_sessions, 0, sizeof(sl_node_sessions));
+  for (uint8_t i = 0; i < count && i < SL_NODE_OTA_MAX_SESSIONS; i++) {
+    if (nodes[i] == 0) {
+      continue;
+    }
+    sl_node_ota_session_t *s = &sl_node_sessions[started];
+    s->nodeid    = nodes[i];
+    s->state     = SL_NODE_OTA_REQUESTED;
+    s->seq       = 0x01;
+    s->last_tick = osKernelGetTickCount();
+    // Sessions keep the image they were started with.
+    s->fsize     = fsize;
+    s->freports  = freports;
+    s->checksum  = checksum;
+    started++;
+  }
+  node_ota_unlock();
+
+  LOG_PRINTF("FW: %ld, %d fragments, %d nodes\n",
+             fsize,
+             freports,
+             started);
+  for (int i = 0; i < started; i++) {
+    retry |= sli_node_ota_request(&sl_node_sessions[i]);
+  }
+  if (retry) {
+    // Queue full: the tcpip thread loop retries the requests.
+    sl_tcpip_wakeup();
+  }
+  return started;
+}
+
+/**
+ * @brief Queue the fragments requested by a node's Firmware Update MD Get.
+ */
+int sl_node_ota_handle_md_get(nodeid_t nodeid, uint16_t ch_id, uint16_t ch_num)
+{
+  if (ch_id == 0 || sl_node_ota_mutex == NULL) {
+    ERR_PRINTF("Wrong chunk id\n");
     return -1;
   }
 
+  node_ota_lock();
+  sl_node_ota_session_t *s = sli_node_ota_find(nodeid);
+  if (s == NULL || !sli_node_ota_active(s)) {
+    node_ota_unlock();
+    ERR_PRINTF("No OTA session for node %d\n", nodeid);
+    return -1;
+  }
+  s->state       = SL_NODE_OTA_TRANSFER;
+  s->next_report = ch_id;
+  s->pending     = ch_num;
+  s->last_tick   = osKernelGetTickCount();
+  sli_node_ota_log_progress(s);
+  node_ota_unlock();
+  // Fragments go out from the tcpip thread loop.
+  sl_tcpip_wakeup();
   return 0;
 }
 
 /**
- * @brief Send multiple firmware chunk packets to the OTA node.
- *
- * @param ch_id Starting chunk sequence number (starts from 1).
- * @param ch_num Number of chunks to send.
- * @return 0 on success, -1 on error.
+ * @brief Record the Request Report or Status Report of a node.
  */
-int sl_node_ota_send_md_chunks(uint16_t ch_id, uint16_t ch_num)
+void sl_node_ota_handle_status(nodeid_t nodeid, bool done, uint8_t status)
 {
-  // ch_id: start from 1.
-  uint32_t addr                        = PSRAM_NODE_IMG_BASE_ADDRESS;
-  uint8_t data[FW_UPDATE_SEGMENT_SIZE] = { 0 };
-  uint32_t size;
-  uint8_t chunk_size = FW_UPDATE_SEGMENT_SIZE;
-  uint8_t pros       = 0;
+  if (sl_node_ota_mutex == NULL) {
+    return;
+  }
+  node_ota_lock();
+  sl_node_ota_session_t *s = sli_node_ota_find(nodeid);
+  if (s != NULL && (done || status != 0xFF)) {
+    s->state   = (done && status == 0xFF) ? SL_NODE_OTA_DONE
+                 : SL_NODE_OTA_FAILED;
+    s->pending = 0;
+    sli_node_ota_log_progress(s);
+  }
+  node_ota_unlock();
+}
 
-  if (ch_id == 0) {
-    ERR_PRINTF("Wrong chunk id\n");
-    return 0;
+/**
+ * @brief Send at most one pending fragment per session, round robin.
+ */
+bool sl_node_ota_process(void)
+{
+  uint8_t data[FW_UPDATE_SEGMENT_SIZE];
+  uint32_t now = osKernelGetTickCount();
+  bool more = false;
+
+  if (sl_node_ota_mutex == NULL) {
+    return false;
   }
 
-  addr = PSRAM_NODE_IMG_BASE_ADDRESS + ((ch_id - 1) * FW_UPDATE_SEGMENT_SIZE);
-  uint16_t next = ch_id + ch_num;
-  for (int i = ch_id; i < next; i++) {
-    if (pros == 0x80) {
-      LOG_PRINTF("Last chunk done. wait zw network\n");
-      break;
+  node_ota_lock();
+  for (int i = 0; i < SL_NODE_OTA_MAX_SESSIONS; i++) {
+    sli_node_ota_check_timeout(&sl_node_sessions[i], now);
+  }
+  node_ota_unlock();
+  for (int i = 0; i < SL_NODE_OTA_MAX_SESSIONS; i++) {
+    more |= sli_node_ota_request(&sl_node_sessions[i]);
+  }
+
+  for (int n = 0; n < SL_NODE_OTA_MAX_SESSIONS; n++) {
+    uint8_t idx = (sl_node_rr + n) % SL_NODE_OTA_MAX_SESSIONS;
+    sl_node_ota_session_t *s = &sl_node_sessions[idx];
+    nodeid_t nodeid;
+    uint16_t ch_id;
+    uint16_t freports;
+    uint32_t fsize;
+    uint8_t seq;
+
+    node_ota_lock();
+    if (s->state != SL_NODE_OTA_TRANSFER || s->pending == 0) {
+      node_ota_unlock();
+      continue;
+    }
+    ch_id    = s->next_report;
+    nodeid   = s->nodeid;
+    seq      = s->seq;
+    freports = s->freports;
+    fsize    = s->fsize;
+    node_ota_unlock();
+
+    if (ch_id > freports) {
+      node_ota_lock();
+      s->pending = 0;
+      node_ota_unlock();
+      continue;
+    }
+
+    uint32_t offset   = (uint32_t) (ch_id - 1) * FW_UPDATE_SEGMENT_SIZE;
+    uint16_t chunk    = FW_UPDATE_SEGMENT_SIZE;
+    uint8_t pros      = 0;
+    if (ch_id == freports) {
+      chunk = fsize - offset;
+      pros  = FW_REPORT_LAST;
+    }
+    sl_psram_read_auto_mode(PSRAM_NODE_IMG_BASE_ADDRESS + offset,
+                            data,
+                            chunk);
+    if (sli_node_ota_send_md_packet(nodeid, seq, data, chunk, pros, ch_id)
+        != 0) {
+      /* Send queue full: retry this session first on the next round. */
+      sl_node_rr = idx;
+      return true;
     }
-    LOG_PRINTF("read MD packet: %d\n", i);
 
-    size = i * FW_UPDATE_SEGMENT_SIZE;
-    if (size > sl_node_fszie) {
-      chunk_size = sl_node_fszie % FW_UPDATE_SEGMENT_SIZE;
-      pros       = 0x80;
+    node_ota_lock();
+    if (s->state == SL_NODE_OTA_TRANSFER && s->next_report == ch_id) {
+      s->seq++;
+      s->next_report++;
+      s->pending = pros ? 0 : s->pending - 1;
+      if (ch_id > s->sent_reports) {
+        s->sent_reports = ch_id;
+      }
+      s->last_tick = osKernelGetTickCount();
     }
+    more |= s->pending != 0;
+    node_ota_unlock();
+  }
+  sl_node_rr = (sl_node_rr + 1) % SL_NODE_OTA_MAX_SESSIONS;
+  return more;
+}
 
-    sl_psram_read_auto_mode(addr, data, chunk_size);
-    if (sl_node_ota_send_md_packet(data, chunk_size, pros, i) != 0) {
-      ERR_PRINTF("Failed to send firmware chunk.\n");
-      return -1;
+/**
+ * @brief Kernel ticks until the first active session times out.
+ */
+uint32_t sl_node_ota_timeout(void)
+{
+  uint32_t limit = SL_NODE_OTA_TIMEOUT_MS * osKernelGetTickFreq() / 1000U;
+  uint32_t now   = osKernelGetTickCount();
+  uint32_t next  = osWaitForever;
+
+  if (sl_node_ota_mutex == NULL) {
+    return next;
+  }
+  node_ota_lock();
+  for (int i = 0; i < SL_NODE_OTA_MAX_SESSIONS; i++) {
+    const sl_node_ota_session_t *s = &sl_node_sessions[i];
+    uint32_t idle = now - s->last_tick;
+    if (!sli_node_ota_active(s) || !s->requested) {
+      continue;
+    }
+    if (idle >= limit) {
+      next = 0;
+      break;
+    }
+    if (limit - idle < next) {
+      next = limit - idle;
     }
-    addr += FW_UPDATE_SEGMENT_SIZE;
   }
-  return 0;
+  node_ota_unlock();
+  return next;
 }
 
 /**
- * @brief Set the firmware size and node ID for the OTA process.
- *
- * @param s Firmware size in bytes.
- * @param nodeid Node ID of the OTA target.
+ * @brief Print the progress of every node session.
  */
-void sl_node_ota_set_fsize(uint32_t s, uint8_t nodeid)
+void sl_node_ota_print_progress(void)
 {
-  if (s == 0 || nodeid == 0) {
-    ERR_PRINTF("Invalid firmware size: %ld or node %d\n", s, nodeid);
+  if (sl_node_ota_mutex == NULL) {
     return;
   }
-  LOG_PRINTF("FW: %ld, n: %d\n", s, nodeid);
-  sl_node_fszie = s;
-  sl_nodeid_md = nodeid;
+  node_ota_lock();
+  for (int i = 0; i < SL_NODE_OTA_MAX_SESSIONS; i++) {
+    if (sl_node_sessions[i].state != SL_NODE_OTA_IDLE) {
+      sli_node_ota_log_progress(&sl_node_sessions[i]);
+    }
+  }
+  node_ota_unlock();
 }
@@ -14,28 +14,116 @@
  * sections of the MSLA applicable to Source Code.
  *
  ******************************************************************************/
+#ifndef SL_NODE_OTA_H
+#define SL_NODE_OTA_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "Common/sl_rd_types.h"
+
+/** Number of nodes that can be updated from one staged image at once. */
+#define SL_NODE_OTA_MAX_SESSIONS 8
+
+/** A session fails when its node stays silent this long. */
+#define SL_NODE_OTA_TIMEOUT_MS 60000
+
+/** Attempts to queue the MD Request Get before a session is released. */
+#define SL_NODE_OTA_REQUEST_TRIES 3
+
+typedef enum {
+  SL_NODE_OTA_IDLE = 0,
+  SL_NODE_OTA_REQUESTED, /**< MD Request Get sent, waiting for the node. */
+  SL_NODE_OTA_TRANSFER,  /**< Node is pulling fragments with MD Get. */
+  SL_NODE_OTA_DONE,
+  SL_NODE_OTA_FAILED,
+} sl_node_ota_state_t;
+
+/**
+ * One firmware update of one node. All sessions read the same staged image
+ * in PSRAM, which stays read-only while any session is active.
+ */
+typedef struct {
+  nodeid_t nodeid;
+  sl_node_ota_state_t state;
+  uint8_t seq;             /**< Z/IP sequence number of the next frame. */
+  uint16_t next_report;    /**< Next fragment to send (starts from 1). */
+  uint16_t pending;        /**< Fragments left from the last MD Get. */
+  uint16_t sent_reports;   /**< Highest fragment sent so far. */
+  uint32_t last_tick;      /**< Kernel tick of the last activity. */
+  bool requested;          /**< MD Request Get queued to the node. */
+  uint8_t tries;           /**< Failed attempts to queue the MD Request Get. */
+  uint32_t fsize;          /**< Size of the image the session serves. */
+  uint16_t freports;       /**< Fragments of that image. */
+  uint16_t checksum;       /**< CRC of that image. */
+} sl_node_ota_session_t;
+
+/**
+ * @brief Abort all node sessions; called before the staged image changes.
+ */
+void sl_node_ota_abort_all(void);
 
 /**
- * @brief Send a Firmware Update Meta Data Request Get (0x7A 0x03) command to the OTA node.
+ * @brief Start update sessions for several nodes from the staged image.
  *
+ * Sends a Firmware Update Meta Data Request Get (0x7A 0x03) to every node.
+ *
+ * @param fsize Size of the staged image in bytes.
  * @param checksum The firmware checksum (CRC).
- * @return 0 on success, -1 on error.
+ * @param nodes Node IDs of the OTA targets.
+ * @param count Number of entries in nodes.
+ * @return Number of sessions started.
+ */
+int sl_node_ota_start(uint32_t fsize,
+                      uint16_t checksum,
+                      const nodeid_t *nodes,
+                      uint8_t count);
+
+/**
+ * @brief Queue the fragments requested by a node's Firmware Update MD Get.
+ *
+ * Fragments are not sent from here; sl_node_ota_process() interleaves them
+ * with those of the other sessions.
+ *
+ * @param nodeid Node that sent the MD Get.
+ * @param ch_id Starting chunk sequence number (starts from 1).
+ * @param ch_num Number of chunks requested.
+ * @return 0 on success, -1 if the node has no active session.
  */
-int sl_node_ota_send_md_request(uint16_t checksum);
+int sl_node_ota_handle_md_get(nodeid_t nodeid, uint16_t ch_id, uint16_t ch_num);
 
 /**
- * @brief Set the firmware size and node ID for the OTA process.
+ * @brief Record the Request Report or Status Report of a node.
  *
- * @param s Firmware size in bytes.
- * @param nodeid Node ID of the OTA target.
+ * @param nodeid Reporting node.
+ * @param done true for a Status Report (session ends), false for a
+ *             Request Report (session ends only on failure).
+ * @param status Status field of the report (0xFF = OK).
  */
-void sl_node_ota_set_fsize(uint32_t s, uint8_t nodeid);
+void sl_node_ota_handle_status(nodeid_t nodeid, bool done, uint8_t status);
 
 /**
- * @brief Send multiple firmware chunk packets to the OTA node.
+ * @brief Send at most one pending fragment per session, round robin.
  *
- * @param ch_id Starting chunk sequence number (starts from 1).
- * @param ch_num Number of chunks to send.
- * @return 0 on success, -1 on error.
+ * Called from the tcpip thread loop so fragments for different nodes are
+ * interleaved in its queue. Also retries MD Request Gets that could not be
+ * queued and fails sessions whose node went silent.
+ *
+ * @return true if fragments or requests are still pending, the caller should
+ *         call again shortly.
+ */
+bool sl_node_ota_process(void);
+
+/**
+ * @brief Kernel ticks until the first active session times out.
+ *
+ * @return Ticks until sl_node_ota_process() must run again, osWaitForever if
+ *         no session is waiting on its node.
  */
-int sl_node_ota_send_md_chunks(uint16_t ch_id, uint16_t ch_num);
+uint32_t sl_node_ota_timeout(void);
+
+/**
+ * @brief Print the progress of every node session.
+ */
+void sl_node_ota_print_progress(void);
+
+#endif /* SL_NODE_OTA_H */
@@ -28,6 +28,7 @@
 
 #include "sl_node_ota.h"
 #include "sl_controller_ota.h"
+#include "sl_ota_decode.h"
 
 #include "sl_ota.h"
 
@@ -38,6 +39,11 @@
 #define FW_HEADER_SIZE 64
 #define CHUNK_SIZE     1024
 
+/* Optional header tail: encoding (1), delta base size (4), base MD5 (16). */
+#define FW_HDR_CTRL_EXT_OFFSET 20
+#define FW_HDR_NODE_EXT_OFFSET 22
+#define FW_HDR_DELTA_EXT_LEN   21
+
 typedef struct {
   uint8_t type;
   uint16_t data_len;
@@ -69,12 +75,114 @@ sl_fw_info_t sl_node_fw_info = {
   .fw_size = 0,
 };
 
+static sl_ota_decoder_t sl_ctrl_decoder;
+static sl_ota_decoder_t sl_node_decoder;
+
+/* Nodes that will be updated from the staged node image. */
+static nodeid_t sl_node_targets[SL_NODE_OTA_MAX_SESSIONS];
+static uint8_t sl_node_target_cnt = 0;
+
 int sl_node_ota_setup(void);
 
+/* Bytes of the header tail taken by the encoding fields. */
+static int32_t sli_ota_encoding_ext_len(const uint8_t *ext, int32_t ext_len)
+{
+  if (ext_len <= 0) {
+    return 0;
+  }
+  return (ext[0] == SL_OTA_ENCODING_DELTA) ? FW_HDR_DELTA_EXT_LEN : 1;
+}
+
+/**
+ * @brief Collect the node targets of a node image header.
+ *
+ * The first target is the node ID of the base header; more can follow the
+ * encoding fields as count (1) + node IDs (2 each, MSB first).
+ */
+static void sli_ota_node_targets(nodeid_t first,
+                                 const uint8_t *ext,
+                                 int32_t ext_len)
+{
+  int32_t off = sli_ota_encoding_ext_len(ext, ext_len);
+
+  sl_node_target_cnt = 0;
+  sl_node_targets[sl_node_target_cnt++] = first;
+  if (off >= ext_len) {
+    return;
+  }
+  uint8_t cnt = ext[off++];
+  for (uint8_t i = 0; i < cnt && off + 1 < ext_len
+       && sl_node_target_cnt < SL_NODE_OTA_MAX_SESSIONS; i++, off += 2) {
+    sl_node_targets[sl_node_target_cnt++] = (ext[off] << 8) | ext[off + 1];
+  }
+}
+
+/**
+ * @brief Prepare the decoder of a staging slot from the header tail.
+ *
+ * For a delta image the base announced in the header must be what is
+ * currently staged in the slot; it is copied to the scratch region so the
+ * new image can be decoded in place over it.
+ */
+static sl_status_t sli_ota_begin_image(sl_ota_decoder_t *dec,
+                                       const uint8_t *ext,
+                                       int32_t ext_len,
+                                       uint32_t slot,
+                                       uint32_t slot_size,
+                                       uint32_t fw_size)
+{
+  sl_ota_encoding_t enc = SL_OTA_ENCODING_RAW;
+  uint32_t base_size    = 0;
+
+  if (ext_len > 0) {
+    enc = (sl_ota_encoding_t) ext[0];
+  }
+  if (fw_size > slot_size) {
+    ERR_PRINTF("Image size %ld exceeds slot size %ld\n", fw_size, slot_size);
+    return SL_STATUS_FAIL;
+  }
+
+  if (enc == SL_OTA_ENCODING_DELTA) {
+    uint8_t md5[16] = { 0 };
+    if (ext_len < FW_HDR_DELTA_EXT_LEN) {
+      ERR_PRINTF("Delta header too short.\n");
+      return SL_STATUS_FAIL;
+    }
+    base_size = ext[1] | (ext[2] << 8) | (ext[3] << 16) | (ext[4] << 24);
+    if (base_size > slot_size || base_size > OTA_SCRATCH_PSRAM_SIZE) {
+      ERR_PRINTF("Invalid delta base size %ld\n", base_size);
+      return SL_STATUS_FAIL;
+    }
+    calc_md5((uint8_t *) slot, base_size, md5);
+    if (memcmp(md5, &ext[5], sizeof(md5)) != 0) {
+      ERR_PRINTF("Delta base MD5 mismatch, staged image differs.\n");
+      return SL_STATUS_FAIL;
+    }
+    sl_psram_copy(PSRAM_OTA_SCRATCH_BASE_ADDRESS, slot, base_size);
+  } else if (enc != SL_OTA_ENCODING_RAW && enc != SL_OTA_ENCODING_LZ4) {
+    ERR_PRINTF("Unsupported image encoding %d\n", enc);
+    return SL_STATUS_FAIL;
+  }
+
+  LOG_PRINTF("Image encoding: %d\n", enc);
+  sl_ota_decoder_init(dec,
+                      enc,
+                      slot,
+                      fw_size,
+                      PSRAM_OTA_SCRATCH_BASE_ADDRESS,
+                      base_size);
+  return SL_STATUS_OK;
+}
+
 /*
  * note: packet = type (1byte) len (2byte) data (len bytes)
  *        type = SL_FWUP_RPS_HEADER:  header.
  *        else: firmware data.
+ *       controller/node header = size (4) [nodeid (2)] md5 (16)
+ *                                [encoding (1) [base size (4) base md5 (16)]]
+ *                                [node only: count (1) nodeid (2) ...]
+ *        size and md5 describe the decoded image; data chunks carry the
+ *        encoded stream and are decoded into PSRAM as they arrive.
  */
 /**
  * @brief Handle an OTA bridge data chunk.
@@ -179,20 +287,33 @@ sl_status_t sl_ota_download_controller_fw(void *data, uint16_t len)
       LOG_PRINTF("\r\n Image size = %ld, md5: ", sl_ctrl_fw_info.fw_size);
       sl_print_hex_to_string(sl_ctrl_fw_info.md5, 16);
       LOG_PRINTF("\n");
+      if (sli_ota_begin_image(&sl_ctrl_decoder,
+                              &chkpkt->data[FW_HDR_CTRL_EXT_OFFSET],
+                              chkpkt->data_len - FW_HDR_CTRL_EXT_OFFSET,
+                              PSRAM_CONTROLLER_IMG_BASE_ADDRESS,
+                              NCP_IMG_PSRAM_SIZE,
+                              sl_ctrl_fw_info.fw_size) != SL_STATUS_OK) {
+        sl_ctrl_fw_info.fw_size = 0;
+        return SL_STATUS_FAIL;
+      }
     } else {
-      uint32_t addr = sl_ctrl_fw_info.chk_id * CHUNK_SIZE;
-      sl_psram_write_auto_mode((PSRAM_CONTROLLER_IMG_BASE_ADDRESS + addr),
-                               chkpkt->data,
-                               chkpkt->data_len);
-      LOG_PRINTF("chunk: %ld/%ld, write to 0x%lx\n",
+      if (sl_ota_decoder_feed(&sl_ctrl_decoder,
+                              chkpkt->data,
+                              chkpkt->data_len) != SL_STATUS_OK) {
+        return SL_STATUS_FAIL;
+      }
+      LOG_PRINTF("chunk: %ld/%ld, decoded to 0x%lx\n",
                  sl_ctrl_fw_info.chk_id,
                  sl_ctrl_fw_info.chk_tot,
-                 addr);
+                 sl_ctrl_decoder.out_pos);
       sl_ctrl_fw_info.chk_id++;
     }
   } else {
     if (sl_ctrl_fw_info.fw_size) {
       uint8_t md5[16] = { 0 };
+      if (sl_ota_decoder_finish(&sl_ctrl_decoder) != SL_STATUS_OK) {
+        return SL_STATUS_FAIL;
+      }
       calc_md5((uint8_t *) PSRAM_CONTROLLER_IMG_BASE_ADDRESS,
                sl_ctrl_fw_info.fw_size,
                md5);
@@ -272,21 +393,39 @@ sl_status_t sl_ota_download_node_fw(void *data, uint16_t len)
       LOG_PRINTF("\r\n Image size = %ld, md5: ", sl_node_fw_info.fw_size);
       sl_print_hex_to_string(sl_node_fw_info.md5, 16);
       LOG_PRINTF("\n");
-      sl_node_ota_set_fsize(sl_node_fw_info.fw_size, nodeid);
+      // sessions read the slot that is about to be overwritten.
+      sl_node_ota_abort_all();
+      if (sli_ota_begin_image(&sl_node_decoder,
+                              &chkpkt->data[FW_HDR_NODE_EXT_OFFSET],
+                              chkpkt->data_len - FW_HDR_NODE_EXT_OFFSET,
+                              PSRAM_NODE_IMG_BASE_ADDRESS,
+                              NODE_IMG_PSRAM_SIZE,
+                              sl_node_fw_info.fw_size) != SL_STATUS_OK) {
+        sl_node_fw_info.fw_size = 0;
+        return SL_STATUS_FAIL;
+      }
+      sli_ota_node_targets(nodeid,
+                           &chkpkt->data[FW_HDR_NODE_EXT_OFFSET],
+                           chkpkt->data_len - FW_HDR_NODE_EXT_OFFSET);
+      LOG_PRINTF("Node image for %d node(s)\n", sl_node_target_cnt);
     } else {
-      uint32_t addr = sl_node_fw_info.chk_id * CHUNK_SIZE;
-      sl_psram_write_auto_mode((PSRAM_NODE_IMG_BASE_ADDRESS + addr),
-                               chkpkt->data,
-                               chkpkt->data_len);
-      LOG_PRINTF("chunk: %ld/%ld, write to 0x%lx\n",
+      if (sl_ota_decoder_feed(&sl_node_decoder,
+                              chkpkt->data,
+                              chkpkt->data_len) != SL_STATUS_OK) {
+        return SL_STATUS_FAIL;
+      }
+      LOG_PRINTF("chunk: %ld/%ld, decoded to 0x%lx\n",
                  sl_node_fw_info.chk_id,
                  sl_node_fw_info.chk_tot,
-                 addr);
+                 sl_node_decoder.out_pos);
       sl_node_fw_info.chk_id++;
     }
   } else {
     if (sl_node_fw_info.fw_size) {
       uint8_t md5[16] = { 0 };
+      if (sl_ota_decoder_finish(&sl_node_decoder) != SL_STATUS_OK) {
+        return SL_STATUS_FAIL;
+      }
       calc_md5((uint8_t *) PSRAM_NODE_IMG_BASE_ADDRESS,
                sl_node_fw_info.fw_size,
                md5);
@@ -311,7 +450,7 @@ sl_status_t sl_ota_download_node_fw(void *data, uint16_t len)
 }
 
 /**
- * @brief Setup the OTA process for a node (calculate chunk, checksum, send request).
+ * @brief Setup the OTA process for the target nodes (calculate chunk, checksum, send request).
  * @return 0 if successful, -1 if error.
  */
 int sl_node_ota_setup(void)
@@ -324,8 +463,14 @@ int sl_node_ota_setup(void)
   sl_node_fw_info.chk_tot = sl_node_fw_info.fw_size / CHUNK_SIZE;
   sl_node_fw_info.chk_id = 0;
 
+  // one checksum pass over the staged image, shared by every session.
   uint16_t checksum = zgw_crc16(CRC_INIT_VALUE, (uint8_t*)PSRAM_NODE_IMG_BASE_ADDRESS, sl_node_fw_info.fw_size);
 
-  sl_node_ota_send_md_request(checksum); // 0x1602.
+  if (sl_node_ota_start(sl_node_fw_info.fw_size,
+                        checksum,
+                        sl_node_targets,
+                        sl_node_target_cnt) == 0) {
+    return -1;
+  }
   return 0;
 }
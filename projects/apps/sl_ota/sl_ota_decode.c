@@ -0,0 +1,332 @@
+/*******************************************************************************
+ * @file  sl_ota_decode.c
+ * @brief Streaming decoder for compressed and delta OTA images
+ *******************************************************************************
+ * # License
+ * <b>Copyright 2025 Silicon Laboratories Inc. www.silabs.com</b>
+ *******************************************************************************
+ *
+ * The licensor of this software is Silicon Laboratories Inc. Your use of this
+ * software is governed by the terms of Silicon Labs Master Software License
+ * Agreement (MSLA) available at
+ * www.silabs.com/about-us/legal/master-software-license-agreement. This
+ * software is distributed to you in Source Code format and is governed by the
+ * sections of the MSLA applicable to Source Code.
+ *
+ ******************************************************************************/
+
+#include <string.h>
+#include "sl_common_log.h"
+#include "modules/sl_psram.h"
+#include "sl_ota_decode.h"
+
+#define LZ4_MIN_MATCH 4
+#define LZ4_RUN_MASK  0x0F
+#define VARINT_MAX_SHIFT 28
+
+/* Decoder states. LZ4 and delta streams use disjoint ranges. */
+enum {
+  ST_LZ4_TOKEN = 0,
+  ST_LZ4_LIT_LEN,
+  ST_LZ4_LITERALS,
+  ST_LZ4_OFF_LO,
+  ST_LZ4_OFF_HI,
+  ST_LZ4_MATCH_LEN,
+  ST_DELTA_OP,
+  ST_DELTA_OFFSET,
+  ST_DELTA_LEN,
+  ST_DELTA_INSERT,
+};
+
+/****************************************************************************/
+/*                            PRIVATE FUNCTIONS                             */
+/****************************************************************************/
+
+static bool sli_ota_decode_fail(sl_ota_decoder_t *dec, const char *why)
+{
+  ERR_PRINTF("OTA decode error at out %ld in %ld: %s\n",
+             dec->out_pos,
+             dec->in_total,
+             why);
+  dec->error = true;
+  return false;
+}
+
+static bool sli_ota_out_write(sl_ota_decoder_t *dec,
+                              const uint8_t *data,
+                              uint32_t n)
+{
+  if (n > dec->out_size - dec->out_pos) {
+    return sli_ota_decode_fail(dec, "output overflow");
+  }
+  sl_psram_write_auto_mode(dec->out_base + dec->out_pos, (uint8_t *) data, n);
+  dec->out_pos += n;
+  return true;
+}
+
+/*
+ * LZ4 match: the source may overlap the destination. It is copied forward
+ * in chunks of at most offset bytes, each one only reads output written
+ * before it, through the same PSRAM path as the literals.
+ */
+static bool sli_ota_lz4_match(sl_ota_decoder_t *dec)
+{
+  uint32_t len = dec->match_len + LZ4_MIN_MATCH;
+  uint32_t n;
+
+  if (len > dec->out_size - dec->out_pos) {
+    return sli_ota_decode_fail(dec, "match overflow");
+  }
+  while (len) {
+    n = len < dec->offset ? len : dec->offset;
+    sl_psram_copy(dec->out_base + dec->out_pos,
+                  dec->out_base + dec->out_pos - dec->offset,
+                  n);
+    dec->out_pos += n;
+    len          -= n;
+  }
+  dec->state = ST_LZ4_TOKEN;
+  return true;
+}
+
+static void sli_ota_lz4_after_lit_len(sl_ota_decoder_t *dec)
+{
+  dec->state = dec->lit_len ? ST_LZ4_LITERALS : ST_LZ4_OFF_LO;
+}
+
+static uint32_t sli_ota_feed_lz4(sl_ota_decoder_t *dec,
+                                 const uint8_t *data,
+                                 uint32_t len)
+{
+  uint32_t i = 0;
+
+  while (i < len && !dec->error) {
+    uint8_t b = data[i];
+    switch (dec->state) {
+      case ST_LZ4_TOKEN:
+        i++;
+        dec->token   = b;
+        dec->lit_len = b >> 4;
+        if (dec->lit_len == LZ4_RUN_MASK) {
+          dec->state = ST_LZ4_LIT_LEN;
+        } else {
+          sli_ota_lz4_after_lit_len(dec);
+        }
+        break;
+      case ST_LZ4_LIT_LEN:
+        i++;
+        dec->lit_len += b;
+        if (b != 0xFF) {
+          sli_ota_lz4_after_lit_len(dec);
+        }
+        break;
+      case ST_LZ4_LITERALS: {
+        uint32_t n = len - i;
+        if (n > dec->lit_len) {
+          n = dec->lit_len;
+        }
+        if (!sli_ota_out_write(dec, &data[i], n)) {
+          break;
+        }
+        i            += n;
+        dec->lit_len -= n;
+        if (dec->lit_len == 0) {
+          dec->state = ST_LZ4_OFF_LO;
+        }
+        break;
+      }
+      case ST_LZ4_OFF_LO:
+        i++;
+        dec->offset = b;
+        dec->state  = ST_LZ4_OFF_HI;
+        break;
+      case ST_LZ4_OFF_HI:
+        i++;
+        dec->offset |= (uint32_t) b << 8;
+        if (dec->offset == 0 || dec->offset > dec->out_pos) {
+          sli_ota_decode_fail(dec, "bad match offset");
+          break;
+        }
+        dec->match_len = dec->token & LZ4_RUN_MASK;
+        if (dec->match_len == LZ4_RUN_MASK) {
+          dec->state = ST_LZ4_MATCH_LEN;
+        } else {
+          sli_ota_lz4_match(dec);
+        }
+        break;
+      case ST_LZ4_MATCH_LEN:
+        i++;
+        dec->match_len += b;
+        if (b != 0xFF) {
+          sli_ota_lz4_match(dec);
+        }
+        break;
+      default:
+        sli_ota_decode_fail(dec, "bad state");
+        break;
+    }
+  }
+  return i;
+}
+
+/* LEB128 varint accumulation; returns true once the last byte is seen. */
+static bool sli_ota_varint(sl_ota_decoder_t *dec, uint32_t *val, uint8_t b)
+{
+  if (dec->shift > VARINT_MAX_SHIFT) {
+    return !sli_ota_decode_fail(dec, "varint too long");
+  }
+  *val       |= (uint32_t) (b & 0x7F) << dec->shift;
+  dec->shift += 7;
+  if (b & 0x80) {
+    return false;
+  }
+  dec->shift = 0;
+  return true;
+}
+
+static void sli_ota_delta_op_done(sl_ota_decoder_t *dec)
+{
+  if (dec->token == SL_OTA_DELTA_OP_COPY) {
+    if (dec->offset > dec->src_size
+        || dec->match_len > dec->src_size - dec->offset) {
+      sli_ota_decode_fail(dec, "copy outside base image");
+      return;
+    }
+    if (!sli_ota_out_write(dec,
+                           (const uint8_t *) (dec->src_base + dec->offset),
+                           dec->match_len)) {
+      return;
+    }
+    dec->state = ST_DELTA_OP;
+  } else {
+    dec->lit_len = dec->match_len;
+    dec->state   = dec->lit_len ? ST_DELTA_INSERT : ST_DELTA_OP;
+  }
+}
+
+static uint32_t sli_ota_feed_delta(sl_ota_decoder_t *dec,
+                                   const uint8_t *data,
+                                   uint32_t len)
+{
+  uint32_t i = 0;
+
+  while (i < len && !dec->error) {
+    uint8_t b = data[i];
+    switch (dec->state) {
+      case ST_DELTA_OP:
+        i++;
+        dec->token     = b;
+        dec->offset    = 0;
+        dec->match_len = 0;
+        dec->shift     = 0;
+        if (b == SL_OTA_DELTA_OP_COPY) {
+          dec->state = ST_DELTA_OFFSET;
+        } else if (b == SL_OTA_DELTA_OP_INSERT) {
+          dec->state = ST_DELTA_LEN;
+        } else {
+          sli_ota_decode_fail(dec, "unknown delta op");
+        }
+        break;
+      case ST_DELTA_OFFSET:
+        i++;
+        if (sli_ota_varint(dec, &dec->offset, b)) {
+          dec->state = ST_DELTA_LEN;
+        }
+        break;
+      case ST_DELTA_LEN:
+        i++;
+        if (sli_ota_varint(dec, &dec->match_len, b)) {
+          sli_ota_delta_op_done(dec);
+        }
+        break;
+      case ST_DELTA_INSERT: {
+        uint32_t n = len - i;
+        if (n > dec->lit_len) {
+          n = dec->lit_len;
+        }
+        if (!sli_ota_out_write(dec, &data[i], n)) {
+          break;
+        }
+        i            += n;
+        dec->lit_len -= n;
+        if (dec->lit_len == 0) {
+          dec->state = ST_DELTA_OP;
+        }
+        break;
+      }
+      default:
+        sli_ota_decode_fail(dec, "bad state");
+        break;
+    }
+  }
+  return i;
+}
+
+/****************************************************************************/
+/*                            PUBLIC FUNCTIONS                              */
+/****************************************************************************/
+
+void sl_ota_decoder_init(sl_ota_decoder_t *dec,
+                         sl_ota_encoding_t encoding,
+                         uint32_t out_base,
+                         uint32_t out_size,
+                         uint32_t src_base,
+                         uint32_t src_size)
+{
+  memset(dec, 0, sizeof(*dec));
+  dec->encoding = encoding;
+  dec->out_base = out_base;
+  dec->out_size = out_size;
+  dec->src_base = src_base;
+  dec->src_size = src_size;
+  dec->state    = (encoding == SL_OTA_ENCODING_DELTA) ? ST_DELTA_OP
+                  : ST_LZ4_TOKEN;
+}
+
+sl_status_t sl_ota_decoder_feed(sl_ota_decoder_t *dec,
+                                const uint8_t *data,
+                                uint32_t len)
+{
+  if (dec->error) {
+    return SL_STATUS_FAIL;
+  }
+
+  switch (dec->encoding) {
+    case SL_OTA_ENCODING_RAW:
+      sli_ota_out_write(dec, data, len);
+      break;
+    case SL_OTA_ENCODING_LZ4:
+      sli_ota_feed_lz4(dec, data, len);
+      break;
+    case SL_OTA_ENCODING_DELTA:
+      sli_ota_feed_delta(dec, data, len);
+      break;
+    default:
+      sli_ota_decode_fail(dec, "unknown encoding");
+      break;
+  }
+  dec->in_total += len;
+  return dec->error ? SL_STATUS_FAIL : SL_STATUS_OK;
+}
+
+sl_status_t sl_ota_decoder_finish(sl_ota_decoder_t *dec)
+{
+  if (dec->error) {
+    return SL_STATUS_FAIL;
+  }
+  if (dec->out_pos != dec->out_size) {
+    ERR_PRINTF("OTA decode short: %ld/%ld bytes\n",
+               dec->out_pos,
+               dec->out_size);
+    return SL_STATUS_FAIL;
+  }
+  /* An LZ4 block ends right after the literals of its last sequence. */
+  if ((dec->encoding == SL_OTA_ENCODING_LZ4 && dec->state != ST_LZ4_OFF_LO)
+      || (dec->encoding == SL_OTA_ENCODING_DELTA
+          && dec->state != ST_DELTA_OP)) {
+    ERR_PRINTF("OTA decode stream truncated\n");
+    return SL_STATUS_FAIL;
+  }
+  LOG_PRINTF("OTA decoded %ld bytes from %ld\n", dec->out_pos, dec->in_total);
+  return SL_STATUS_OK;
+}
@@ -0,0 +1,95 @@
+/*******************************************************************************
+ * @file  sl_ota_decode.h
+ * @brief Streaming decoder for compressed and delta OTA images
+ *******************************************************************************
+ * # License
+ * <b>Copyright 2025 Silicon Laboratories Inc. www.silabs.com</b>
+ *******************************************************************************
+ *
+ * The licensor of this software is Silicon Laboratories Inc. Your use of this
+ * software is governed by the terms of Silicon Labs Master Software License
+ * Agreement (MSLA) available at
+ * www.silabs.com/about-us/legal/master-software-license-agreement. This
+ * software is distributed to you in Source Code format and is governed by the
+ * sections of the MSLA applicable to Source Code.
+ *
+ ******************************************************************************/
+#ifndef SL_OTA_DECODE_H
+#define SL_OTA_DECODE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "sl_status.h"
+
+/**
+ * Image encodings, carried in the optional encoding byte that follows the
+ * MD5 in the RPS header chunk. Old servers do not send the byte and get RAW.
+ *
+ * LZ4:   a single LZ4 block (no frame header) covering the whole image.
+ *        Back-references are resolved against the output already written to
+ *        the PSRAM staging slot, so no window buffer is kept in SRAM.
+ * DELTA: a stream of COPY/INSERT operations against the image previously
+ *        staged in the same slot (see tools/sl_ota_pack.py for the format).
+ */
+typedef enum {
+  SL_OTA_ENCODING_RAW   = 0,
+  SL_OTA_ENCODING_LZ4   = 1,
+  SL_OTA_ENCODING_DELTA = 2,
+} sl_ota_encoding_t;
+
+/** Delta operation codes. */
+#define SL_OTA_DELTA_OP_COPY   0x00
+#define SL_OTA_DELTA_OP_INSERT 0x01
+
+typedef struct {
+  sl_ota_encoding_t encoding;
+  uint32_t out_base;  /**< Staging address the image is decoded into. */
+  uint32_t out_size;  /**< Expected decoded image size. */
+  uint32_t out_pos;   /**< Bytes decoded so far. */
+  uint32_t src_base;  /**< Delta base image address. */
+  uint32_t src_size;  /**< Delta base image size. */
+  uint32_t in_total;  /**< Encoded bytes consumed so far. */
+  uint8_t state;
+  uint8_t shift;
+  uint8_t token;
+  uint32_t lit_len;
+  uint32_t match_len;
+  uint32_t offset;
+  bool error;
+} sl_ota_decoder_t;
+
+/**
+ * @brief Prepare a decoder for a new image.
+ * @param dec Decoder context.
+ * @param encoding Encoding announced in the image header.
+ * @param out_base Address of the staging slot receiving the decoded image.
+ * @param out_size Decoded image size announced in the header.
+ * @param src_base Delta base image address (ignored unless DELTA).
+ * @param src_size Delta base image size (ignored unless DELTA).
+ */
+void sl_ota_decoder_init(sl_ota_decoder_t *dec,
+                         sl_ota_encoding_t encoding,
+                         uint32_t out_base,
+                         uint32_t out_size,
+                         uint32_t src_base,
+                         uint32_t src_size);
+
+/**
+ * @brief Decode one received chunk straight into the staging slot.
+ * @param dec Decoder context.
+ * @param data Encoded chunk.
+ * @param len Chunk length.
+ * @return SL_STATUS_OK, or SL_STATUS_FAIL on a malformed stream or overflow.
+ */
+sl_status_t sl_ota_decoder_feed(sl_ota_decoder_t *dec,
+                                const uint8_t *data,
+                                uint32_t len);
+
+/**
+ * @brief Check the stream ended on an operation boundary with the full image.
+ * @param dec Decoder context.
+ * @return SL_STATUS_OK if exactly out_size bytes were produced.
+ */
+sl_status_t sl_ota_decoder_finish(sl_ota_decoder_t *dec);
+
+#endif /* SL_OTA_DECODE_H */
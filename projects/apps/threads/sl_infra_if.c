@@ -77,12 +77,15 @@ void sli_infra_if_send_icmpv6_ra(const char *ifname)
   struct icmp6_ra_hdr *ra = (struct icmp6_ra_hdr *)ra_buf;
   int offset = sizeof(struct icmp6_ra_hdr);
 
-  // Create raw ICMPv6 socket
-  sock = socket(AF_INET6, SOCK_RAW, IPPROTO_ICMPV6);
-  if (sock < 0) {
-    LOG_PRINTF("Failed to create ICMPv6 socket: %d\n", errno);
-    return;
+  // Raw ICMPv6 socket, kept open across RA periods
+  if (sli_infra_if_socket < 0) {
+    sli_infra_if_socket = socket(AF_INET6, SOCK_RAW, IPPROTO_ICMPV6);
+    if (sli_infra_if_socket < 0) {
+      LOG_PRINTF("Failed to create ICMPv6 socket: %d\n", errno);
+      return;
+    }
   }
+  sock = sli_infra_if_socket;
 
   // Bind to interface
   unsigned int ifindex = if_nametoindex(ifname);
@@ -119,11 +122,12 @@ void sli_infra_if_send_icmpv6_ra(const char *ifname)
   ssize_t sent = sendto(sock, ra_buf, offset, 0, (struct sockaddr *)&dst_addr, sizeof(dst_addr));
   if (sent < 0) {
     LOG_PRINTF("Failed to send RA: %d\n", errno);
+    // Reopen on the next period
+    close(sock);
+    sli_infra_if_socket = -1;
   } else {
     LOG_PRINTF("Sent RA (%d bytes) on %s\n", (int)sent, ifname);
   }
-
-  close(sock);
 #endif
 }
 
@@ -15,11 +15,13 @@
  *
  ******************************************************************************/
 
+#include <string.h>
 #include "FreeRTOS.h"
 #include "task.h"
 #include "Common/sl_common_log.h"
 #include "Common/sl_gw_info.h"
 #include "Common/sl_tcpip_def.h"
+#include "Net/sl_udp_utils.h"
 
 #include "Z-Wave/include/ZW_classcmd.h"
 #include "Z-Wave/include/ZW_transport_api.h"
@@ -33,6 +35,8 @@
 #include "utls/sl_ipnode_utils.h"
 
 #include "ip_bridge/sl_classic_zip_node.h"
+#include "ip_bridge/sl_mailbox.h"
+#include "sl_ota/sl_node_ota.h"
 
 #include "sl_ts_thread.h"
 
@@ -48,14 +52,39 @@ const osThreadAttr_t sl_tcpip_attr = {
   .reserved   = 0,
 };
 
-static osMessageQueueId_t sli_tcpip_queue;
+#define SL_TCPIP_FLAG_WAKE       0x0001
+#define SL_TCPIP_INFLIGHT_MAX    8      ///< Requests taken off the queue
+#define SL_TCPIP_REQUEUE_MS      250    ///< Retry interval of a parked request
+#define SL_TCPIP_PARK_TIMEOUT_MS 65000  ///< Parked requests fail after this
+#define SL_TCPIP_OTA_INTERVAL_MS 5      ///< Poll interval while OTA has work
+
+typedef enum {
+  SLI_TCPIP_REQ_FREE = 0,
+  SLI_TCPIP_REQ_READY,   ///< Received, not handed to the Z/IP node yet
+  SLI_TCPIP_REQ_ACTIVE,  ///< Handed to the Z/IP node, waiting for completion
+  SLI_TCPIP_REQ_PARKED,  ///< Requeued, retried at due
+} sli_tcpip_req_state_t;
 
-#define zw_send_lock()   // osMutexAcquire(sli_tcpip_mutex, osWaitForever)
-#define zw_send_unlock() // osMutexRelease(sli_tcpip_mutex)
+/* One request taken off the queue, with its completion context. */
+typedef struct {
+  sl_tcpip_buf_t *buf;
+  nodeid_t node;
+  uint8_t state;
+  uint8_t retries;
+  bool waiting_sent;       ///< ZIP NACK+Waiting sent to the client
+  bool from_mailbox;       ///< Taken back from the mailbox of a woken node
+  volatile bool done;      ///< Completion arrived, status is valid
+  uint8_t status;
+  uint32_t seq;            ///< Arrival order, keeps per-node ordering
+  uint32_t parked_at;
+  uint32_t due;
+} sli_tcpip_req_t;
 
-static bool zw_sending = false;
+static osMessageQueueId_t sli_tcpip_queue;
+static osThreadId_t sli_tcpip_thread_id;
 
-sl_sleeptimer_timer_handle_t zw_sending_timer;
+static sli_tcpip_req_t sli_tcpip_reqs[SL_TCPIP_INFLIGHT_MAX];
+static uint32_t sli_tcpip_seq;
 
 /*===========================================================================*/
 /**
@@ -71,9 +100,39 @@ sl_status_t zw_tcpip_post_event(uint32_t event, void *data)
   sl_cc_net_ev_t msg = { .ev = event, .ev_data = data };
 
   status = osMessageQueuePut(sli_tcpip_queue, (void *) &msg, 0, osWaitForever);
+  sl_tcpip_wakeup();
   return status;
 }
 
+/*===========================================================================*/
+/**
+ * @brief Post an event without blocking.
+ *
+ * Used by producers running on the tcpip thread itself, which would
+ * otherwise deadlock waiting for room in their own queue.
+ */
+sl_status_t zw_tcpip_try_post_event(uint32_t event, void *data)
+{
+  sl_cc_net_ev_t msg = { .ev = event, .ev_data = data };
+
+  if (osMessageQueuePut(sli_tcpip_queue, (void *) &msg, 0, 0) == osOK) {
+    sl_tcpip_wakeup();
+    return SL_STATUS_OK;
+  }
+  return SL_STATUS_FULL;
+}
+
+/*===========================================================================*/
+/**
+ * @brief Wake the tcpip thread; safe from timers and other threads.
+ */
+void sl_tcpip_wakeup(void)
+{
+  if (sli_tcpip_thread_id) {
+    osThreadFlagsSet(sli_tcpip_thread_id, SL_TCPIP_FLAG_WAKE);
+  }
+}
+
 /*===========================================================================*/
 /**
  * @brief .
@@ -112,90 +171,265 @@ const char *transmit_status_name(int state)
   }
 }
 
-static void queue_send_done(BYTE status, BYTE *sent_buffer, uint16_t send_len)
+/* May run on another thread: only record the result, the tcpip thread
+ * acts on it in sli_tcpip_reap(). */
+static void queue_send_done(BYTE status, BYTE *sent_buffer, uint16_t send_len,
+                            void *user)
 {
   (void) sent_buffer; // Unused parameter
   (void) send_len;    // Unused parameter
-  zw_sending = false;
-  zw_send_unlock();
+  sli_tcpip_req_t *r = user;
 
-  LOG_PRINTF("queue_send_done to node status: %s\n",
+  LOG_PRINTF("queue_send_done to node %d status: %s\n",
+             r->node,
              transmit_status_name(status));
 
-  if (status == TRANSMIT_COMPLETE_OK) {
-    // Reserved for future use.
-  }
+  r->status        = status;
+  r->done          = true;
+  sl_tcpip_wakeup();
+}
 
-  if (status == TRANSMIT_COMPLETE_REQUEUE) {
-    return;
+static void sli_tcpip_req_free(sli_tcpip_req_t *r)
+{
+  if (r->from_mailbox) {
+    sl_mailbox_done(r->node, r->status);
   }
+  sl_zip_replay_forget(&r->buf->zw_con.conn, r->buf->zip_packet);
+  sl_tcpip_buf_release(r->buf);
+  memset(r, 0, sizeof(*r));
+}
+
+/* Tell the client the request is held, so it does not retransmit. */
+static void sli_tcpip_send_waiting(sli_tcpip_req_t *r, int flags0)
+{
+  ZW_COMMAND_ZIP_PACKET *zip = r->buf->zip_packet;
+  zwave_connection_t c;
 
-  if (status == TRANSMIT_COMPLETE_REQUEUE_QUEUED) {
-    /* This happens if NetworkManagement or ResourceDirectory are busy
-     * or if (Mailbox is sending and this frame does not have mailbox
-     * or re-q flag set). */
-    /* Frames for sleeping nodes must be queued in mailbox.  All other
-     * frames are sent to long queue. */
+  if (!(zip->flags0 & ZIP_PACKET_FLAGS0_ACK_REQ)) {
     return;
   }
+  c           = r->buf->zw_con;
+  c.seq       = zip->seqNo;
+  c.lendpoint = zip->dEndpoint;
+  c.rendpoint = zip->sEndpoint;
+  SendUDPStatus(flags0, zip->flags1, &c);
 }
 
-void sl_zw_sending_timeour_cb(sl_sleeptimer_timer_handle_t *t, void *d)
+/* Finish requests whose completion arrived; requeued ones are parked. */
+static void sli_tcpip_reap(void)
 {
-  (void) t; // Unused parameter
-  (void) d; // Unused parameter
-  zw_sending = false;
-  printf("zw_sending out\n");
+  uint32_t now = osKernelGetTickCount();
+
+  for (int i = 0; i < SL_TCPIP_INFLIGHT_MAX; i++) {
+    sli_tcpip_req_t *r = &sli_tcpip_reqs[i];
+
+    if (r->state == SLI_TCPIP_REQ_ACTIVE && r->done) {
+      r->done = false;
+      if (r->status == TRANSMIT_COMPLETE_REQUEUE
+          || r->status == TRANSMIT_COMPLETE_REQUEUE_QUEUED) {
+        if (r->retries == 0) {
+          r->parked_at = now;
+        }
+        if (r->retries < UINT8_MAX) {
+          r->retries++;
+        }
+        r->state = SLI_TCPIP_REQ_PARKED;
+        r->due   = now + pdMS_TO_TICKS(SL_TCPIP_REQUEUE_MS);
+        if (!r->waiting_sent) {
+          sli_tcpip_send_waiting(r, ZIP_PACKET_FLAGS0_NACK_RES
+                                 | ZIP_PACKET_FLAGS0_NACK_WAIT);
+          r->waiting_sent = true;
+        }
+      } else {
+        sli_tcpip_req_free(r);
+      }
+    } else if (r->state == SLI_TCPIP_REQ_PARKED
+               && now - r->parked_at >= pdMS_TO_TICKS(SL_TCPIP_PARK_TIMEOUT_MS)) {
+      ERR_PRINTF("tcpip: request to node %d timed out while parked\n", r->node);
+      sli_tcpip_send_waiting(r, ZIP_PACKET_FLAGS0_NACK_RES);
+      r->status = TRANSMIT_COMPLETE_FAIL;
+      sli_tcpip_req_free(r);
+    }
+  }
 }
 
-void sl_tcpip_thread(void *arg)
+/* Next queued packet that is not a retransmission, or NULL. */
+static sl_tcpip_buf_t *sli_tcpip_get_new(void)
 {
-  (void) arg; // Unused parameter
   sl_cc_net_ev_t msg;
-  nodeid_t node;
-  BOOL already_requeued = 0;
+  sl_tcpip_buf_t *buf;
 
-  while (1) {
-    // wait a event.
-    if (!zw_sending && zw_tcpip_get_event(&msg, /*osWaitForever*/ 1) == osOK) {
-      zw_sending = true;
-      // process event;
-      sl_tcpip_buf_t *tcpip_buf = (sl_tcpip_buf_t *) msg.ev_data;
-
-      DBG_PRINTF("\nTIME: %ld, lipaddr: ", xTaskGetTickCount());
-      uip_debug_ipaddr_print(&tcpip_buf->zw_con.lipaddr);
-      DBG_PRINTF("\n");
-      DBG_PRINTF("\nripaddr: ")
-      uip_debug_ipaddr_print(&tcpip_buf->zw_con.ripaddr);
-      DBG_PRINTF("\n");
-      node = sl_node_of_ip(&(tcpip_buf->zw_con.lipaddr));
-      DBG_PRINTF("destination: %d\n", node);
-
-      // backup tcpip buf
-      sl_backup_uip_buf(tcpip_buf);
-      sl_backup_zip_buf(tcpip_buf->zip_data, tcpip_buf->zip_data_len); // pass node id.
-
-      if (!ClassicZIPNode_input(node,
-                                queue_send_done,
-                                FALSE,
-                                already_requeued)) {
-        ERR_PRINTF("ClassicZIPNode_input: return error.\n");
-        queue_send_done(TRANSMIT_COMPLETE_FAIL, 0, 0);
+  while (zw_tcpip_get_event(&msg, 0) == SL_STATUS_OK) {
+    buf = (sl_tcpip_buf_t *) msg.ev_data;
+    // A retransmission is answered from the replay cache, never resent.
+    if (!sl_zip_replay_check(&buf->zw_con.conn, buf->zip_packet)) {
+      return buf;
+    }
+    sl_tcpip_buf_release(buf);
+  }
+  return NULL;
+}
+
+/*
+ * Move queued packets into free request slots. Requests released by the
+ * mailbox of a woken node go first, the node only listens for a short time.
+ */
+static void sli_tcpip_accept(void)
+{
+  for (int i = 0; i < SL_TCPIP_INFLIGHT_MAX; i++) {
+    sli_tcpip_req_t *r = &sli_tcpip_reqs[i];
+    nodeid_t node;
+
+    if (r->state != SLI_TCPIP_REQ_FREE) {
+      continue;
+    }
+    r->buf = sl_mailbox_next(&node);
+    if (r->buf) {
+      r->from_mailbox = true;
+      r->node         = node;
+    } else {
+      r->buf = sli_tcpip_get_new();
+      if (r->buf == NULL) {
+        return;
       }
-      DBG_PRINTF("TIME: %ld\n",
-                 xTaskGetTickCount());
-      // consider wait for zwave frame to be sent.
-      /* free data*/
-      if (tcpip_buf->zip_data) {
-        free(tcpip_buf->zip_data);
+      r->node = sl_node_of_ip(&r->buf->zw_con.lipaddr);
+    }
+    r->seq   = sli_tcpip_seq++;
+    r->state = SLI_TCPIP_REQ_READY;
+  }
+}
+
+/* Oldest request that may start now; a node's requests start in order. */
+static sli_tcpip_req_t *sli_tcpip_next(void)
+{
+  uint32_t now          = osKernelGetTickCount();
+  sli_tcpip_req_t *best = NULL;
+
+  for (int i = 0; i < SL_TCPIP_INFLIGHT_MAX; i++) {
+    sli_tcpip_req_t *r = &sli_tcpip_reqs[i];
+    bool blocked       = false;
+
+    if (r->state == SLI_TCPIP_REQ_FREE || r->state == SLI_TCPIP_REQ_ACTIVE
+        || (r->state == SLI_TCPIP_REQ_PARKED && (int32_t) (now - r->due) < 0)) {
+      continue;
+    }
+    for (int j = 0; j < SL_TCPIP_INFLIGHT_MAX; j++) {
+      sli_tcpip_req_t *o = &sli_tcpip_reqs[j];
+      if (o != r && o->state != SLI_TCPIP_REQ_FREE && o->node == r->node
+          && (int32_t) (o->seq - r->seq) < 0) {
+        blocked = true;
+        break;
       }
+    }
+    if (!blocked && (best == NULL || (int32_t) (r->seq - best->seq) < 0)) {
+      best = r;
+    }
+  }
+  return best;
+}
+
+static void sli_tcpip_start(sli_tcpip_req_t *r)
+{
+  DBG_PRINTF("\nTIME: %ld, lipaddr: ", xTaskGetTickCount());
+  uip_debug_ipaddr_print(&r->buf->zw_con.lipaddr);
+  DBG_PRINTF("\n");
+  DBG_PRINTF("\nripaddr: ")
+  uip_debug_ipaddr_print(&r->buf->zw_con.ripaddr);
+  DBG_PRINTF("\n");
+  DBG_PRINTF("destination: %d\n", r->node);
+
+  // current packet, kept until the next one so completions can read it.
+  sl_backup_pkt_set(r->buf);
+
+  r->state = SLI_TCPIP_REQ_ACTIVE;
+  r->done  = false;
+  if (!ClassicZIPNode_input(r->node,
+                            queue_send_done,
+                            r,
+                            r->from_mailbox,
+                            r->retries != 0)) {
+    ERR_PRINTF("ClassicZIPNode_input: return error.\n");
+    if (!r->done) {
+      queue_send_done(TRANSMIT_COMPLETE_FAIL, 0, 0, r);
+    }
+  }
+}
+
+/*
+ * Start requests while the Z/IP node has a free session. Requests to
+ * different nodes overlap; sli_tcpip_next() keeps one active per node.
+ */
+static void sli_tcpip_dispatch(void)
+{
+  sli_tcpip_req_t *r;
+
+  sli_tcpip_reap();
+  while (ClassicZIPNode_can_accept() && (r = sli_tcpip_next()) != NULL) {
+    sli_tcpip_start(r);
+    // Most commands complete inside ClassicZIPNode_input().
+    sli_tcpip_reap();
+  }
+}
+
+/* Ticks until a parked request is due, or osWaitForever. */
+static uint32_t sli_tcpip_timeout(void)
+{
+  uint32_t now     = osKernelGetTickCount();
+  uint32_t timeout = osWaitForever;
 
-      if (msg.ev_data) {
-        free(msg.ev_data);
+  for (int i = 0; i < SL_TCPIP_INFLIGHT_MAX; i++) {
+    sli_tcpip_req_t *r = &sli_tcpip_reqs[i];
+    if (r->state == SLI_TCPIP_REQ_PARKED) {
+      int32_t left = (int32_t) (r->due - now);
+      if (left <= 0) {
+        return 0;
+      }
+      if ((uint32_t) left < timeout) {
+        timeout = (uint32_t) left;
       }
     }
+  }
+  return timeout;
+}
+
+void sl_tcpip_thread(void *arg)
+{
+  (void) arg; // Unused parameter
+  uint32_t timeout = 0;
+  uint32_t session_timeout;
+
+  while (1) {
+    // Sleep until a packet, a completion, a send-data event or a retry.
+    osThreadFlagsWait(SL_TCPIP_FLAG_WAKE, osFlagsWaitAny, timeout);
+
+    sli_tcpip_accept();
+    sli_tcpip_dispatch();
     sl_zw_layer_data_process();
-    osDelay(5);
+    sli_tcpip_dispatch();
+
+    timeout = sli_tcpip_timeout();
+    session_timeout = ClassicZIPNode_process();
+    if (session_timeout < timeout) {
+      timeout = session_timeout;
+    }
+    // interleave node firmware fragments with the regular traffic.
+    if (sl_node_ota_process()
+        && timeout > pdMS_TO_TICKS(SL_TCPIP_OTA_INTERVAL_MS)) {
+      timeout = pdMS_TO_TICKS(SL_TCPIP_OTA_INTERVAL_MS);
+    }
+    // wake up to fail node sessions that went silent.
+    session_timeout = sl_node_ota_timeout();
+    if (session_timeout < timeout) {
+      timeout = session_timeout;
+    }
+    if (osMessageQueueGetCount(sli_tcpip_queue)) {
+      for (int i = 0; i < SL_TCPIP_INFLIGHT_MAX; i++) {
+        if (sli_tcpip_reqs[i].state == SLI_TCPIP_REQ_FREE) {
+          timeout = 0;
+          break;
+        }
+      }
+    }
   }
 }
 
@@ -215,7 +449,10 @@ void sl_tcpip_init(void)
 {
   LOG_PRINTF("tcpip thread start\n");
   sli_tcpip_queue = osMessageQueueNew(20, sizeof(sl_cc_net_ev_t), NULL);
-  if (!osThreadNew((osThreadFunc_t) sl_tcpip_thread, NULL, &sl_tcpip_attr)) {
+  sli_tcpip_thread_id = osThreadNew((osThreadFunc_t) sl_tcpip_thread,
+                                    NULL,
+                                    &sl_tcpip_attr);
+  if (!sli_tcpip_thread_id) {
     LOG_PRINTF("tcpip thread start FAIL!!!!\n");
   }
 }
@@ -18,8 +18,25 @@
 #ifndef APPS_THREADS_SL_TCPIP_HANDLER_H_
 #define APPS_THREADS_SL_TCPIP_HANDLER_H_
 
+#include <stdint.h>
+#include "sl_status.h"
+
 void sl_tcpip_init(void);
 
 sl_status_t zw_tcpip_post_event(uint32_t event, void *data);
 
+/**
+ * @brief Post an event without blocking; fails if the queue is full.
+ */
+sl_status_t zw_tcpip_try_post_event(uint32_t event, void *data);
+
+/**
+ * @brief Wake the tcpip thread, which otherwise sleeps until a packet
+ *        arrives or a parked request is due.
+ *
+ * Call after posting work the thread polls, e.g. send-data events.
+ * Safe from timer callbacks and other threads.
+ */
+void sl_tcpip_wakeup(void);
+
 #endif /* APPS_THREADS_SL_TCPIP_HANDLER_H_ */
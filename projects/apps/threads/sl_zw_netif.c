@@ -30,6 +30,11 @@
 
 #include "lwip/icmp6.h"
 #include "lwip/inet.h"
+#include "lwip/inet_chksum.h"
+#include "lwip/ip6.h"
+#include "lwip/tcpip.h"
+#include "lwip/prot/ip6.h"
+#include "lwip/prot/udp.h"
 #include "lwip/sockets.h"
 #include "lwip/netif.h"
 #include "lwip/ethip6.h"
@@ -41,13 +46,18 @@
 #define INTERFACE_ZW_NAME1 'w' ///< ZW Network interface name 1
 
 #define ZW_NETIF_NODE_MAX 40 ///< Maximum number of ZW nodes
+#define ZW_NETIF_INDEX_SIZE 64 ///< Address index slots, power of two > node max
+#define ZW_NETIF_INDEX_NONE 0    ///< Empty index slot, others hold slot + 1
 
 #define SL_ZW_NETIF_MOCK_ENABLE 0
 
 static struct netif zw_netif;
 static sl_zw_netif_node_t zw_netif_nodes[ZW_NETIF_NODE_MAX];
+/* Open addressing index from node address to zw_netif_nodes slot + 1. */
+static uint8_t zw_netif_index[ZW_NETIF_INDEX_SIZE];
+/* SL_INFRA_IF_RIO_PREFIX, converted once at init. */
+static uint32_t zw_netif_prefix[2];
 NETIF_DECLARE_EXT_CALLBACK(sl_platform_netif_ext_callback);
-static void sli_zw_netif_udp_listener(void *argument);
 
 extern void print_heap_usage(void);
 
@@ -107,128 +117,190 @@ static void sli_zw_netif_udp_callback(const struct sl_zw_netif_node *node,
 }
 #endif
 
-static int match_prefix(const struct in6_addr *addr, const char *prefix)
+/*
+ * Node ID carried by a prefix::<node id> address, as built by
+ * sl_zw_netif_node_addr(), or 0 for any other address.
+ */
+static nodeid_t sli_zw_netif_derived_id(const uint32_t *addr)
 {
-  uint32_t prefix_arr[4];
-  inet_pton(AF_INET6, prefix, prefix_arr);
-  const uint32_t *addr_arr = (const uint32_t *)addr;
-  return (addr_arr[0] == prefix_arr[0] && addr_arr[1] == prefix_arr[1]);
+  if (addr[0] != zw_netif_prefix[0] || addr[1] != zw_netif_prefix[1]
+      || addr[2] != 0 || (addr[3] & PP_HTONL(0xFFFF0000UL)) != 0) {
+    return 0;
+  }
+  return (nodeid_t) lwip_ntohl(addr[3]);
 }
 
-static int find_node_by_ip6(const char *dststr)
+/* Derived addresses hash to their node ID, others fold all four words. */
+static uint32_t sli_zw_netif_hash(const uint32_t *addr)
 {
-  for (uint8_t i = 0; i < ZW_NETIF_NODE_MAX; i++) {
-    if (zw_netif_nodes[i].in_use) {
-      char node_addr_str[INET6_ADDRSTRLEN];
-      if (inet_ntop(AF_INET6,
-                    &zw_netif_nodes[i].ip6_addr,
-                    node_addr_str,
-                    sizeof(node_addr_str))
-          && strcmp(node_addr_str, dststr) == 0) {
-        return i;
-      }
-    }
+  uint32_t h = sli_zw_netif_derived_id(addr);
+
+  if (h == 0) {
+    h = addr[0] ^ addr[1] ^ addr[2] ^ addr[3];
+    h ^= h >> 16;
+    h *= 0x45d9f3bUL;
+    h ^= h >> 16;
   }
-  return -1;
+  return h & (ZW_NETIF_INDEX_SIZE - 1);
 }
 
-static void process_udp_packet(struct sockaddr_in6 *src_addr,
-                               struct in6_pktinfo *pktinfo,
-                               char *buf,
-                               int len)
+static void sli_zw_netif_index_add(uint8_t slot)
 {
-  char dststr[INET6_ADDRSTRLEN];
-  if (!inet_ntop(AF_INET6, &pktinfo->ipi6_addr, dststr, sizeof(dststr))) {
-    return;
+  uint32_t i = sli_zw_netif_hash(zw_netif_nodes[slot].ip6_addr.addr);
+
+  while (zw_netif_index[i] != ZW_NETIF_INDEX_NONE) {
+    if (zw_netif_index[i] == slot + 1) {
+      return;
+    }
+    i = (i + 1) & (ZW_NETIF_INDEX_SIZE - 1);
   }
-  int node_idx = find_node_by_ip6(dststr);
-  if (node_idx >= 0) {
-    sl_tcpip_buf_t *zippkt = sl_zip_packet_v6(&src_addr->sin6_addr,
-                                              src_addr->sin6_port,
-                                              dststr,
-                                              (uint8_t *) buf,
-                                              (uint16_t)len);
-    if (zippkt) {
-      zw_tcpip_post_event(1, zippkt);
+  zw_netif_index[i] = slot + 1;
+}
+
+/* Removal is rare, rebuilding keeps the probe chains intact. */
+static void sli_zw_netif_index_rebuild(void)
+{
+  memset(zw_netif_index, ZW_NETIF_INDEX_NONE, sizeof(zw_netif_index));
+  for (uint8_t i = 0; i < ZW_NETIF_NODE_MAX; i++) {
+    if (zw_netif_nodes[i].in_use && zw_netif_nodes[i].has_addr) {
+      sli_zw_netif_index_add(i);
     }
   }
 }
 
-static struct in6_pktinfo *extract_pktinfo(struct msghdr *msg)
+static sl_zw_netif_node_t *sli_zw_netif_find(const uint32_t *addr)
 {
-  for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(msg); cmsg != NULL;
-       cmsg = CMSG_NXTHDR(msg, cmsg)) {
-    if (cmsg->cmsg_level == IPPROTO_IPV6
-        && cmsg->cmsg_type == IPV6_PKTINFO) {
-      return (struct in6_pktinfo *) CMSG_DATA(cmsg);
+  uint32_t i = sli_zw_netif_hash(addr);
+
+  while (zw_netif_index[i] != ZW_NETIF_INDEX_NONE) {
+    sl_zw_netif_node_t *node = &zw_netif_nodes[zw_netif_index[i] - 1];
+    if (memcmp(node->ip6_addr.addr, addr, 16) == 0) {
+      return node;
     }
+    i = (i + 1) & (ZW_NETIF_INDEX_SIZE - 1);
   }
   return NULL;
 }
 
-static void sli_zw_netif_udp_listener(void *argument)
+/* Answer an ICMPv6 Echo Request to a node address on behalf of the node. */
+static void sli_zw_netif_echo_reply(struct pbuf *p,
+                                    const ip6_addr_t *node,
+                                    const ip6_addr_t *src)
+{
+  u16_t len = (u16_t) (p->tot_len - IP6_HLEN);
+  struct icmp6_echo_hdr *echo;
+  struct pbuf *q;
+
+  q = pbuf_alloc(PBUF_IP, len, PBUF_RAM);
+  if (q == NULL) {
+    return;
+  }
+  pbuf_copy_partial(p, q->payload, len, IP6_HLEN);
+  echo         = (struct icmp6_echo_hdr *) q->payload;
+  echo->type   = ICMP6_TYPE_EREP;
+  echo->chksum = 0;
+  echo->chksum = ip6_chksum_pseudo(q, IP6_NEXTH_ICMP6, len, node, src);
+  ip6_output(q, node, src, IP6_DEFAULT_HOPLIMIT, 0, IP6_NEXTH_ICMP6);
+  pbuf_free(q);
+}
+
+/*
+ * LWIP_HOOK_IP6_INPUT, so this runs in the lwIP thread for every IPv6
+ * packet received. Node addresses are not lwIP addresses; packets to one are
+ * taken over here, everything else goes on through ip6_input(). Headers are
+ * parsed in place and the pbuf is handed to the tcpip thread with the Z/IP
+ * payload, see sl_tcpip_buf_from_pbuf().
+ */
+int sl_zw_netif_ip6_input(struct pbuf *p, struct netif *inp)
 {
-  (void) argument;
-
-  int sock;
-  struct sockaddr_in6 addr;
-
-  sock = socket(AF_INET6, SOCK_DGRAM, 0);
-  if (sock < 0) {
-    LOG_PRINTF("UDP socket create failed: %d\n", errno);
-    osThreadExit();
-  }
-
-  memset(&addr, 0, sizeof(addr));
-  addr.sin6_family = AF_INET6;
-  addr.sin6_port   = htons(SL_ZW_NETIF_UDP_LISTENER_PORT); // Choose your port
-  addr.sin6_addr   = in6addr_any; // Bind to all addresses
-  bind(sock, (struct sockaddr *) &addr, sizeof(addr));
-
-  // Enable receiving destination address info
-  int on = 1;
-  setsockopt(sock, IPPROTO_IPV6, IPV6_RECVPKTINFO, &on, sizeof(on));
-
-  LOG_PRINTF("Listening for UDP packets to %s\\%d on port %d (IPv6)...\n",
-             SL_INFRA_IF_RIO_PREFIX,
-             SL_INFRA_IF_RIO_PREFIX_LEN,
-             SL_ZW_NETIF_UDP_LISTENER_PORT);
-
-  while (1) {
-    struct sockaddr_in6 src_addr;
-    struct iovec iov;
-    struct msghdr msg;
-    char buf[128];
-    char cmsgbuf[CMSG_SPACE(sizeof(struct in6_pktinfo))];
-    iov.iov_base = buf;
-    iov.iov_len  = sizeof(buf);
-    memset(&msg, 0, sizeof(msg));
-    msg.msg_name       = &src_addr;
-    msg.msg_namelen    = sizeof(src_addr);
-    msg.msg_iov        = &iov;
-    msg.msg_iovlen     = 1;
-    msg.msg_control    = cmsgbuf;
-    msg.msg_controllen = sizeof(cmsgbuf);
-
-    int len = recvmsg(sock, &msg, 0);
-    if (len > 0) {
-      struct in6_pktinfo *pktinfo = extract_pktinfo(&msg);
-      LOG_PRINTF("pktinfo: %p\n", pktinfo);
-      if (pktinfo && match_prefix(&pktinfo->ipi6_addr, SL_INFRA_IF_RIO_PREFIX)) {
-        process_udp_packet(&src_addr, pktinfo, buf, len);
-      }
+  struct ip6_hdr *ip6hdr;
+  struct udp_hdr *udphdr;
+  ip6_addr_t src, dst;
+  struct in6_addr from;
+  sl_tcpip_buf_t *pkt;
+  u16_t plen, ulen, sport;
+
+  if (p->len < IP6_HLEN) {
+    return 0;
+  }
+  ip6hdr = (struct ip6_hdr *) p->payload;
+  if (IP6H_V(ip6hdr) != 6) {
+    return 0;
+  }
+  ip6_addr_copy_from_packed(dst, ip6hdr->dest);
+  if (sli_zw_netif_find(dst.addr) == NULL) {
+    return 0;
+  }
+  ip6_addr_copy_from_packed(src, ip6hdr->src);
+  ip6_addr_assign_zone(&src, IP6_UNICAST, inp);
+  plen = IP6H_PLEN(ip6hdr);
+  if (plen > p->tot_len - IP6_HLEN) {
+    goto drop;
+  }
+  // Drop link padding so the checksums below only cover the packet.
+  pbuf_realloc(p, (u16_t) (IP6_HLEN + plen));
+
+  if (IP6H_NEXTH(ip6hdr) == IP6_NEXTH_ICMP6) {
+    if (p->len >= IP6_HLEN + sizeof(struct icmp6_echo_hdr)
+        && *((u8_t *) p->payload + IP6_HLEN) == ICMP6_TYPE_EREQ) {
+      sli_zw_netif_echo_reply(p, &dst, &src);
+    }
+    goto drop;
+  }
+  // Extension headers are not used by Z/IP clients.
+  if (IP6H_NEXTH(ip6hdr) != IP6_NEXTH_UDP || p->len < IP6_HLEN + UDP_HLEN) {
+    goto drop;
+  }
+  udphdr = (struct udp_hdr *) ((u8_t *) p->payload + IP6_HLEN);
+  ulen   = lwip_ntohs(udphdr->len);
+  if (udphdr->dest != PP_HTONS(SL_ZW_NETIF_UDP_LISTENER_PORT)
+      || ulen < UDP_HLEN || ulen > plen
+      || ulen - UDP_HLEN > SL_TCPIP_BUF_DATA_SIZE) {
+    goto drop;
+  }
+  if (udphdr->chksum != 0) {
+    u16_t sum;
+
+    pbuf_remove_header(p, IP6_HLEN);
+    sum = ip6_chksum_pseudo(p, IP6_NEXTH_UDP, ulen, &src, &dst);
+    pbuf_add_header(p, IP6_HLEN);
+    if (sum != 0) {
+      goto drop;
     }
   }
+
+  // The headers are gone once the pbuf is taken over.
+  sport = udphdr->src;
+  memcpy(&from, src.addr, sizeof(from));
+  pkt = sl_tcpip_buf_from_pbuf(p, IP6_HLEN + UDP_HLEN, ulen - UDP_HLEN);
+  if (pkt == NULL) {
+    sl_tcpip_buf_count_drop();
+    return 1;
+  }
+  sl_zip_packet_v6_fill(pkt,
+                        &from,
+                        sport,
+                        (const uip_ip6addr_t *) dst.addr,
+                        (uint16_t) (ulen - UDP_HLEN));
+  // Never block the lwIP thread, a full queue drops like a full socket.
+  if (zw_tcpip_try_post_event(1, pkt) != SL_STATUS_OK) {
+    sl_tcpip_buf_count_drop();
+    sl_tcpip_buf_release(pkt);
+  }
+  return 1;
+
+  drop:
+  pbuf_free(p);
+  return 1;
 }
 
+/* Nothing is routed to zw_netif, node traffic never leaves through it. */
 static err_t zw_netif_output(struct netif *netif,
                              struct pbuf *p,
                              const ip6_addr_t *ipaddr)
 {
-  // Here you can implement forwarding, NAT, or custom logic
-  // For now, just log or drop
-  (void) netif; // Unused parameter
-  (void) p;     // Unused parameter
+  (void) netif;  // Unused parameter
+  (void) p;      // Unused parameter
   (void) ipaddr; // Unused parameter
   return ERR_OK;
 }
@@ -268,12 +340,96 @@ static void zw_netif_setup(void)
   netif_set_up(&zw_netif);
 }
 
+void sl_zw_netif_node_addr(nodeid_t id, uip_ip6addr_t *addr)
+{
+  uint32_t w[4] = { zw_netif_prefix[0], zw_netif_prefix[1], 0,
+                    lwip_htonl(id) };
+  memcpy(addr->u8, w, sizeof(w));
+}
+
+bool sl_zw_netif_has_addr(const uip_ip6addr_t *addr)
+{
+  return addr && sli_zw_netif_find((const uint32_t *) addr->u8) != NULL;
+}
+
+int sl_zw_netif_send_udp(const uip_ip6addr_t *src,
+                         uint16_t sport,
+                         const uip_ip6addr_t *dst,
+                         uint16_t dport,
+                         const uint8_t *data,
+                         uint16_t len)
+{
+  ip6_addr_t s, d;
+  struct udp_hdr *udphdr;
+  struct netif *out;
+  struct pbuf *q;
+  err_t err = ERR_RTE;
+
+  q = pbuf_alloc(PBUF_IP, (u16_t) (UDP_HLEN + len), PBUF_RAM);
+  if (q == NULL) {
+    return -1;
+  }
+  udphdr         = (struct udp_hdr *) q->payload;
+  udphdr->src    = lwip_htons(sport);
+  udphdr->dest   = lwip_htons(dport);
+  udphdr->len    = lwip_htons(q->tot_len);
+  udphdr->chksum = 0;
+  memcpy((u8_t *) q->payload + UDP_HLEN, data, len);
+  ip6_addr_set_zero(&s);
+  ip6_addr_set_zero(&d);
+  memcpy(s.addr, src->u8, sizeof(s.addr));
+  memcpy(d.addr, dst->u8, sizeof(d.addr));
+  udphdr->chksum = ip6_chksum_pseudo(q, IP6_NEXTH_UDP, q->tot_len, &s, &d);
+  if (udphdr->chksum == 0) {
+    udphdr->chksum = 0xffff;
+  }
+
+  // The source is not an lwIP address, so it is given to lwIP explicitly.
+  LOCK_TCPIP_CORE();
+  out = ip6_route(&s, &d);
+  if (out) {
+    err = ip6_output_if_src(q, &s, &d, UDP_TTL, 0, IP6_NEXTH_UDP, out);
+  }
+  UNLOCK_TCPIP_CORE();
+  pbuf_free(q);
+  if (err != ERR_OK) {
+    LOG_PRINTF("Node UDP send failed: %d\n", err);
+    return -1;
+  }
+  return len;
+}
+
+sl_zw_netif_node_t *sl_zw_netif_get_node(nodeid_t id)
+{
+  uip_ip6addr_t addr;
+  sl_zw_netif_node_t *node;
+
+  sl_zw_netif_node_addr(id, &addr);
+  node = sli_zw_netif_find((const uint32_t *) addr.u8);
+  if (node) {
+    return node;
+  }
+  // Nodes without an address yet are not indexed.
+  for (uint8_t idx = 0; idx < ZW_NETIF_NODE_MAX; idx++) {
+    if (zw_netif_nodes[idx].in_use && zw_netif_nodes[idx].id == id) {
+      return &zw_netif_nodes[idx];
+    }
+  }
+  return NULL;
+}
+
 sl_zw_netif_node_t *sl_zw_netif_create_node(nodeid_t id)
 {
-  sl_zw_netif_node_t *node = NULL;
+  sl_zw_netif_node_t *node = sl_zw_netif_get_node(id);
+
+  // Re-registering a node (e.g. a re-probe) keeps its entry.
+  if (node) {
+    return node;
+  }
   for (uint8_t idx = 0; idx < ZW_NETIF_NODE_MAX; idx++) {
     if (zw_netif_nodes[idx].in_use == false) {
       node = &zw_netif_nodes[idx];
+      break;
     }
   }
   if (!node) {
@@ -292,6 +448,7 @@ sl_status_t sl_zw_netif_remove_node(sl_zw_netif_node_t *node)
     return SL_STATUS_FAIL;
   }
   memset(node, 0, sizeof(sl_zw_netif_node_t));
+  sli_zw_netif_index_rebuild();
   return SL_STATUS_OK;
 }
 
@@ -300,23 +457,14 @@ sl_status_t sl_zw_netif_add_ip6_address(sl_zw_netif_node_t *node)
   if (node == NULL) {
     return SL_STATUS_FAIL;
   }
-  ip6_addr_t addr;
-  err_t err;
-  char addr_str[INET6_ADDRSTRLEN];
-  sprintf(addr_str, "%s%x", SL_INFRA_IF_RIO_PREFIX, node->id);
-  if (inet_pton(AF_INET6, addr_str, &addr) != 1) {
-    LOG_PRINTF("Failed to convert IPv6 string to address: %s\n", addr_str);
-    return SL_STATUS_FAIL;
-  }
-  err = netif_add_ip6_address(&zw_netif, &addr, (s8_t *) &node->addr_idx);
-  if (err != ERR_OK) {
-    LOG_PRINTF("Failed to add IPv6 address: %d\n", err);
-    return SL_STATUS_FAIL;
-  }
-  netif_ip6_addr_set_state(&zw_netif,
-                           (s8_t) node->addr_idx,
-                           IP6_ADDR_PREFERRED);
-  memcpy(&node->ip6_addr, &addr, sizeof(ip6_addr_t));
+  uip_ip6addr_t derived;
+
+  // Not an lwIP address: sl_zw_netif_ip6_input() takes indexed addresses only.
+  sl_zw_netif_node_addr(node->id, &derived);
+  ip6_addr_set_zero(&node->ip6_addr);
+  memcpy(node->ip6_addr.addr, derived.u8, sizeof(node->ip6_addr.addr));
+  node->has_addr = true;
+  sli_zw_netif_index_add((uint8_t) (node - zw_netif_nodes));
   return SL_STATUS_OK;
 }
 
@@ -325,7 +473,8 @@ sl_status_t sl_zw_netif_remove_ip6_address(sl_zw_netif_node_t *node)
   if (node == NULL) {
     return SL_STATUS_FAIL;
   }
-  netif_ip6_addr_set_state(&zw_netif, (s8_t) node->addr_idx, IP6_ADDR_INVALID);
+  node->has_addr = false;
+  sli_zw_netif_index_rebuild();
   return SL_STATUS_OK;
 }
 
@@ -339,76 +488,21 @@ sl_status_t sl_zw_netif_register_callback(sl_zw_netif_node_t *node,
   return SL_STATUS_OK;
 }
 
-sl_status_t sl_zw_netif_create_socket_udp(sl_zw_netif_node_t *node)
+void sl_zw_netif_init(void)
 {
-  if (node == NULL) {
-    return SL_STATUS_FAIL;
-  }
-  if (node->sock >= 0) {
-    LOG_PRINTF("Socket already created\n");
-    return SL_STATUS_FAIL;
-  }
-  int sock = socket(AF_INET6, SOCK_DGRAM, 0);
-  if (sock < 0) {
-    LOG_PRINTF("UDP socket create failed: %d\n", errno);
-    return SL_STATUS_FAIL;
-  }
-  // Bind the socket to the node's IPv6 address so that packets sent from this socket use it as the source address
-  struct sockaddr_in6 bind_addr;
-  memset(&bind_addr, 0, sizeof(bind_addr));
-  bind_addr.sin6_family = AF_INET6;
-  bind_addr.sin6_port   = 0; // Let the OS choose the port
-  memcpy(&bind_addr.sin6_addr, &node->ip6_addr, sizeof(bind_addr.sin6_addr));
-  if (bind(sock, (struct sockaddr *) &bind_addr, sizeof(bind_addr)) < 0) {
-    LOG_PRINTF("UDP socket bind failed: %d\n", errno);
-    close(sock);
-    return SL_STATUS_FAIL;
-  }
-  node->sock = sock;
-  return SL_STATUS_OK;
-}
+  ip6_addr_t prefix;
 
-sl_status_t sl_zw_netif_socket_send(sl_zw_netif_node_t *node,
-                                    const char *buf,
-                                    size_t len,
-                                    const char *ip6_str,
-                                    uint16_t port)
-{
-  if (node == NULL || buf == NULL || node->sock <= 0) {
-    return SL_STATUS_FAIL;
-  }
-  struct sockaddr_in6 dest_addr;
-  memset(&dest_addr, 0, sizeof(dest_addr));
-  dest_addr.sin6_family = AF_INET6;
-  dest_addr.sin6_port   = htons(port);
-  inet_pton(AF_INET6, ip6_str, &dest_addr.sin6_addr);
-
-  ssize_t sent = sendto(node->sock,
-                        buf,
-                        len,
-                        0,
-                        (struct sockaddr *) &dest_addr,
-                        sizeof(dest_addr));
-  if (sent < 0) {
-    LOG_PRINTF("UDP socket send failed: %d\n", errno);
-    return SL_STATUS_FAIL;
+  if (inet_pton(AF_INET6, SL_INFRA_IF_RIO_PREFIX, &prefix) != 1) {
+    LOG_PRINTF("Invalid node prefix %s\n", SL_INFRA_IF_RIO_PREFIX);
   }
-  return SL_STATUS_OK;
-}
+  memcpy(zw_netif_prefix, prefix.addr, sizeof(zw_netif_prefix));
+  sli_zw_netif_index_rebuild();
+  sl_tcpip_buf_pool_init();
 
-void sl_zw_netif_init(void)
-{
   netif_add_ext_callback(&sl_platform_netif_ext_callback,
                          sli_platform_netif_ext_callback_fn);
   zw_netif_setup();
 
-  static const osThreadAttr_t zw_netif_udp_attr = {
-    .name       = "zw_netif_udpd",
-    .stack_size = 3072,
-    .priority   = osPriorityNormal,
-  };
-  osThreadNew(sli_zw_netif_udp_listener, NULL, &zw_netif_udp_attr);
-
 #if SL_ZW_NETIF_MOCK_ENABLE
   sl_zw_netif_node_t *node_1 = sl_zw_netif_create_node(6);
   sl_zw_netif_node_t *node_2 = sl_zw_netif_create_node(9);
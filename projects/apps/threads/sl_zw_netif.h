@@ -30,11 +30,10 @@ typedef void (*sl_zw_netif_recv_cb_t)(const struct sl_zw_netif_node *node, const
 
 typedef struct sl_zw_netif_node {
   ip6_addr_t ip6_addr;          ///< IPv6 address
-  int sock;                     ///< Socket for UDP communication
   nodeid_t id;                  ///< Node ID
-  uint8_t addr_idx;             ///< Netif address index
   sl_zw_netif_recv_cb_t cb;     ///< Callback function for receiving data
   bool in_use;                  ///< Flag to indicate if the node is in use
+  bool has_addr;                ///< ip6_addr is assigned and indexed
 } sl_zw_netif_node_t;
 
 /**
@@ -42,9 +41,58 @@ typedef struct sl_zw_netif_node {
  */
 void sl_zw_netif_init(void);
 
+/**
+ * @brief Builds the IPv6 address of a node: the node prefix with the node ID
+ * as interface identifier.
+ *
+ * @param id Node ID.
+ * @param addr Receives the address.
+ */
+void sl_zw_netif_node_addr(nodeid_t id, uip_ip6addr_t *addr);
+
+/**
+ * @brief Tells whether an address is the IPv6 address of a node.
+ *
+ * @param addr Address to look up, may be NULL.
+ * @return true if a node holds the address, see sl_zw_netif_add_ip6_address().
+ */
+bool sl_zw_netif_has_addr(const uip_ip6addr_t *addr);
+
+/**
+ * @brief Sends a UDP datagram from the IPv6 address of a node.
+ *
+ * Node addresses are not lwIP addresses, so sockets cannot be bound to them;
+ * the datagram is built here and handed to ip6_output_if_src() on the
+ * interface lwIP routes the destination to.
+ *
+ * @param src Node address, the source of the datagram.
+ * @param sport Source port (host order).
+ * @param dst Destination address.
+ * @param dport Destination port (host order).
+ * @param data Payload.
+ * @param len Payload length.
+ * @return Number of bytes sent, or -1 on error.
+ */
+int sl_zw_netif_send_udp(const uip_ip6addr_t *src,
+                         uint16_t sport,
+                         const uip_ip6addr_t *dst,
+                         uint16_t dport,
+                         const uint8_t *data,
+                         uint16_t len);
+
+/**
+ * @brief Looks up the virtual node with the specified node ID.
+ *
+ * @param id Node ID.
+ * @return Pointer to the node, or NULL if it was never created.
+ */
+sl_zw_netif_node_t* sl_zw_netif_get_node(nodeid_t id);
+
 /**
  * @brief Creates a new virtual Z-Wave network node with the specified node ID.
  *
+ * Returns the existing node if one was already created for the ID.
+ *
  * @param id The node ID to assign to the new node.
  * @return Pointer to the created sl_zw_netif_node_t structure, or NULL on failure.
  */
@@ -61,6 +109,10 @@ sl_status_t sl_zw_netif_remove_node(sl_zw_netif_node_t* node);
 /**
  * @brief Adds an IPv6 address to the specified Z-Wave network node.
  *
+ * The address is not an lwIP netif address: packets to it are taken out of
+ * ip6_input() by LWIP_HOOK_IP6_INPUT, and packets from it are sent with
+ * sl_zw_netif_send_udp().
+ *
  * @param node Pointer to the node to which the IPv6 address will be added.
  * @return SL_STATUS_OK if the address was successfully added, SL_STATUS_FAIL otherwise.
  */
@@ -83,24 +135,4 @@ sl_status_t sl_zw_netif_remove_ip6_address(sl_zw_netif_node_t* node);
  */
 sl_status_t sl_zw_netif_register_callback(sl_zw_netif_node_t* node, sl_zw_netif_recv_cb_t cb);
 
-/**
- * @brief Creates a UDP socket for the specified Z-Wave network node.
- *
- * @param node Pointer to the node for which the UDP socket will be created.
- * @return SL_STATUS_OK if the socket was successfully created, SL_STATUS_FAIL otherwise.
- */
-sl_status_t sl_zw_netif_create_socket_udp(sl_zw_netif_node_t* node);
-
-/**
- * @brief Sends data over a UDP socket from the specified node.
- *
- * @param node Pointer to the node sending the data.
- * @param buf Pointer to the buffer containing the data to send.
- * @param len Length of the data to send.
- * @param ip6_str String representation of the destination IPv6 address.
- * @param port Destination port number.
- * @return SL_STATUS_OK if the data was successfully sent, SL_STATUS_FAIL otherwise.
- */
-sl_status_t sl_zw_netif_socket_send(sl_zw_netif_node_t* node, const char *buf, size_t len, const char *ip6_str, uint16_t port);
-
 #endif // SL_ZW_NETIF_H
@@ -45,6 +45,8 @@
 
 #include "ip_bridge/sl_bridge.h"
 #include "ip_bridge/sl_classic_zip_node.h"
+#include "ip_bridge/sl_state_cache.h"
+#include "ip_bridge/sl_mailbox.h"
 
 #include "sl_ts_thread.h"
 #include "sl_cc_handler.h"
@@ -147,11 +149,20 @@ void sl_application_cmd_zip_handler(ts_param_t *p,
       break;
   } // end case
   sl_zw_send_data_appl_rx_notify(p, (const uint8_t *) pCmd, cmdLength);
+  // Before the request handler, solicited reports are cached as well.
+  sl_state_cache_record(p, (const uint8_t *) pCmd, cmdLength);
   // process data from request command.
   if (sl_send_request_appl_cmd_handler(p, pCmd, cmdLength)) {
     return;
   }
 
+  if (pCmd->ZW_Common.cmdClass == COMMAND_CLASS_WAKE_UP
+      && pCmd->ZW_Common.cmd == WAKE_UP_NOTIFICATION
+      && sl_mailbox_wakeup(p->snode)) {
+    // The node listens for a few seconds, deliver its mailbox now.
+    return;
+  }
+
   zwave_connection_t c;
   memset(&c, 0, sizeof(c));
 
@@ -349,13 +360,13 @@ void sl_appl_controller_update(
        */
       break;
     case UPDATE_STATE_NODE_INFO_RECEIVED:
-      // Reserved for future use.
+      rd_nif_request_post(TRUE, bNodeID, pCmd, bLen);
       break;
     case UPDATE_STATE_NODE_INFO_REQ_DONE:
       // Reserved for future use.
       break;
     case UPDATE_STATE_NODE_INFO_REQ_FAILED:
-      // Reserved for future use.
+      rd_nif_request_post(FALSE, bNodeID, NULL, 0);
       break;
     case UPDATE_STATE_ROUTING_PENDING:
       // Reserved for future use.
@@ -781,6 +792,23 @@ sl_status_t zw_zip_post_event(uint32_t event, void *data)
   return SL_STATUS_OK;
 }
 
+/*===========================================================================*/
+/**
+ * @brief Post an event without blocking.
+ *
+ * Used from timer callbacks, which must not wait and must not touch the
+ * resource directory themselves.
+ */
+sl_status_t zw_zip_try_post_event(uint32_t event, void *data)
+{
+  sl_cc_net_ev_t msg = { .ev = event, .ev_data = data };
+
+  if (osMessageQueuePut(sli_zip_queue, (void *) &msg, 0, 0) == osOK) {
+    return SL_STATUS_OK;
+  }
+  return SL_STATUS_FULL;
+}
+
 /*===========================================================================*/
 /**
  * @brief .
@@ -847,8 +875,22 @@ void sl_router_process(void)
       zgw_component_start(ZGW_BU);
     } else if (ev == ZIP_EVENT_COMPONENT_DONE) {
       // Reserved for future use.
+    } else if (ev == ZIP_EVENT_STATE_CACHE_REFRESH) {
+      sl_state_cache_refresh();
+    } else if (ev == ZIP_EVENT_RD_SEND_SUC_ID_TIMEOUT) {
+      send_suc_id(TRANSMIT_COMPLETE_FAIL);
+    } else if (ev == ZIP_EVENT_RD_PROBE_TIMEOUT) {
+      rd_probe_timeout(data);
+    } else if (ev == ZIP_EVENT_RD_NIF_REQUEST_TIMEOUT) {
+      rd_nif_request_timeout();
+    } else if (ev == ZIP_EVENT_RD_NIF_CHECK_TIMEOUT) {
+      rd_nif_check_timeout();
+    } else if (ev == ZIP_EVENT_RD_NIF_RECEIVED) {
+      rd_nif_received(data);
     }
   }
+  rd_data_store_poll();
+  rd_node_cache_trim(RD_NODE_CACHE_SIZE);
 }
 
 void sl_router_init(void)
@@ -20,6 +20,7 @@
 
 #include "Net/ZW_udp_server.h"
 #include "Common/sl_rd_types.h"
+#include "sl_status.h"
 
 /**
  * State flags of the \ref ZIP_Router components.
@@ -99,6 +100,12 @@ void sl_appl_controller_update(BYTE bStatus,
                                BYTE bLen,
                                BYTE *prospectHomeID);
 
+/**
+ * @brief Post an event to the router thread without blocking; safe from
+ *        timer callbacks. Fails if the queue is full.
+ */
+sl_status_t zw_zip_try_post_event(uint32_t event, void *data);
+
 /**
  * @brief Initializes the Z-Wave router module.
  */
@@ -19,10 +19,14 @@
 #include <assert.h>
 #include <string.h>
 #include "sl_zw_frm.h"
+#include "modules/sl_block_pool.h"
+
+_Static_assert(sizeof(zw_frame_buffer_element_t) <= SL_BLOCK_POOL_LARGE_SIZE,
+               "frame buffer does not fit the large block class");
 
 zw_frame_buffer_element_t *zw_frame_buffer_alloc()
 {
-  return malloc(sizeof(zw_frame_buffer_element_t));
+  return sl_block_pool_alloc(sizeof(zw_frame_buffer_element_t));
 }
 
 zw_frame_buffer_element_t *zw_frame_buffer_create(const ts_param_t *p,
@@ -44,7 +48,5 @@ zw_frame_buffer_element_t *zw_frame_buffer_create(const ts_param_t *p,
 
 void zw_frame_buffer_free(zw_frame_buffer_element_t *e)
 {
-  if (e) {
-    free(e);
-  }
+  sl_block_pool_free(e);
 }
@@ -20,10 +20,14 @@
 #include <stdlib.h>
 #include <string.h>
 #include "assert.h"
+#include "modules/sl_block_pool.h"
+
+_Static_assert(sizeof(zw_frame_ip_buffer_element_t) <= SL_BLOCK_POOL_LARGE_SIZE,
+               "IP frame buffer does not fit the large block class");
 
 zw_frame_ip_buffer_element_t *zw_frame_ip_buffer_alloc()
 {
-  return malloc(sizeof(zw_frame_ip_buffer_element_t));
+  return sl_block_pool_alloc(sizeof(zw_frame_ip_buffer_element_t));
 }
 
 zw_frame_ip_buffer_element_t *
@@ -46,7 +50,5 @@ zw_frame_ip_buffer_create(const zwave_connection_t *p,
 
 void zw_frame_ip_buffer_free(zw_frame_ip_buffer_element_t *e)
 {
-  if (e) {
-    free(e);
-  }
+  sl_block_pool_free(e);
 }
@@ -43,6 +43,7 @@
 
 #include "sl_sleeptimer.h"
 #include "sl_status.h"
+#include "threads/sl_tcpip_handler.h"
 
 #define MAX_BUF_ENDPOINT_DATA 512
 
@@ -617,8 +618,12 @@ typedef struct {
 sl_status_t zw_send_data_post_event(uint32_t event, void *data)
 {
   sl_cc_net_ev_t msg = { .ev = event, .ev_data = data };
+  sl_status_t status;
 
-  return osMessageQueuePut(sli_zw_event_queue, (void *) &msg, 0, osWaitForever);;
+  status = osMessageQueuePut(sli_zw_event_queue, (void *) &msg, 0, osWaitForever);
+  // Events are handled on the tcpip thread.
+  sl_tcpip_wakeup();
+  return status;
 }
 
 /*===========================================================================*/
@@ -768,7 +773,7 @@ void sl_zw_send_data_queue_init(void)
 void sl_zw_layer_data_process(void)
 {
   sl_cc_net_ev_t msg;
-  if (zw_send_data_get_event(&msg, 1) == osOK) {
+  while (zw_send_data_get_event(&msg, 0) == osOK) {
     // process event;
     zw_send_data_event_process(msg.ev, msg.ev_data);
     if (msg.ev_data) {
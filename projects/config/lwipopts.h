@@ -108,6 +108,11 @@ a lot of data that needs to be copied, this should be set high. */
 #define LWIP_IPV6_AUTOCONFIG          (LWIP_IPV6)
 #define LWIP_IPV6_DUP_DETECT_ATTEMPTS 0
 #define LWIP_IPV6_ND                  (LWIP_IPV6)
+/* Packets to node addresses are taken over by zw_netif, see sl_zw_netif.c */
+struct pbuf;
+struct netif;
+int sl_zw_netif_ip6_input(struct pbuf *p, struct netif *inp);
+#define LWIP_HOOK_IP6_INPUT(p, inp)   sl_zw_netif_ip6_input(p, inp)
 #endif
 
 /* ---------- TCP options ---------- */
@@ -253,7 +258,8 @@ a lot of data that needs to be copied, this should be set high. */
 
 #define LWIP_NETIF_TX_SINGLE_PBUF 1
 #define LWIP_NETBUF_RECVINFO 1
-#define LWIP_IPV6_NUM_ADDRESSES 35
+/* Node addresses are not netif addresses, see LWIP_HOOK_IP6_INPUT. */
+#define LWIP_IPV6_NUM_ADDRESSES 6
 
 /*
    --------------------------------------
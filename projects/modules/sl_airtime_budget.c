@@ -0,0 +1,65 @@
+/*******************************************************************************
+ * @file  sl_airtime_budget.c
+ * @brief Token bucket limiting the airtime used by background traffic
+ *******************************************************************************
+ * # License
+ * <b>Copyright 2025 Silicon Laboratories Inc. www.silabs.com</b>
+ *******************************************************************************
+ *
+ * The licensor of this software is Silicon Laboratories Inc. Your use of this
+ * software is governed by the terms of Silicon Labs Master Software License
+ * Agreement (MSLA) available at
+ * www.silabs.com/about-us/legal/master-software-license-agreement. This
+ * software is distributed to you in Source Code format and is governed by the
+ * sections of the MSLA applicable to Source Code.
+ *
+ ******************************************************************************/
+#include "modules/sl_airtime_budget.h"
+
+void sl_airtime_budget_init(sl_airtime_budget_t *b, uint32_t rate_ms,
+                            uint32_t now_ms)
+{
+  if (rate_ms == 0) {
+    rate_ms = 1;
+  } else if (rate_ms > 1000) {
+    rate_ms = 1000;
+  }
+  b->rate_ms   = rate_ms;
+  b->tokens_us = rate_ms * 1000;
+  b->last_ms   = now_ms;
+  b->granted   = 0;
+  b->delayed   = 0;
+}
+
+/* One ms of time refills rate_ms us of airtime. */
+static void sli_airtime_budget_refill(sl_airtime_budget_t *b, uint32_t now_ms)
+{
+  uint32_t max     = b->rate_ms * 1000;
+  uint32_t elapsed = now_ms - b->last_ms;
+
+  b->last_ms = now_ms;
+  if (elapsed >= 1000 || b->tokens_us + elapsed * b->rate_ms >= max) {
+    b->tokens_us = max;
+  } else {
+    b->tokens_us += elapsed * b->rate_ms;
+  }
+}
+
+uint32_t sl_airtime_budget_take(sl_airtime_budget_t *b, uint32_t cost_ms,
+                                uint32_t now_ms)
+{
+  uint32_t cost_us = cost_ms * 1000;
+
+  sli_airtime_budget_refill(b, now_ms);
+  /* A cost above the bucket size is granted from a full bucket. */
+  if (cost_us > b->rate_ms * 1000) {
+    cost_us = b->rate_ms * 1000;
+  }
+  if (b->tokens_us >= cost_us) {
+    b->tokens_us -= cost_us;
+    b->granted++;
+    return 0;
+  }
+  b->delayed++;
+  return (cost_us - b->tokens_us + b->rate_ms - 1) / b->rate_ms;
+}
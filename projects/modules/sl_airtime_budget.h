@@ -0,0 +1,54 @@
+/*******************************************************************************
+ * @file  sl_airtime_budget.h
+ * @brief Token bucket limiting the airtime used by background traffic
+ *******************************************************************************
+ * # License
+ * <b>Copyright 2025 Silicon Laboratories Inc. www.silabs.com</b>
+ *******************************************************************************
+ *
+ * The licensor of this software is Silicon Laboratories Inc. Your use of this
+ * software is governed by the terms of Silicon Labs Master Software License
+ * Agreement (MSLA) available at
+ * www.silabs.com/about-us/legal/master-software-license-agreement. This
+ * software is distributed to you in Source Code format and is governed by the
+ * sections of the MSLA applicable to Source Code.
+ *
+ ******************************************************************************/
+#ifndef MODULES_SL_AIRTIME_BUDGET_H_
+#define MODULES_SL_AIRTIME_BUDGET_H_
+
+#include <stdint.h>
+
+/**
+ * Background senders (node interviews) take an estimated airtime for each
+ * frame exchange from a bucket that refills at a fixed rate, so they leave
+ * the rest of the channel to user traffic. The bucket holds at most one
+ * second worth of airtime.
+ *
+ * Time is passed in by the caller, which keeps the bucket usable from a
+ * simulation.
+ */
+typedef struct {
+  uint32_t rate_ms;   /**< Airtime granted per second, in ms. */
+  uint32_t tokens_us; /**< Airtime available now, in us. */
+  uint32_t last_ms;   /**< Time of the last refill. */
+  uint32_t granted;   /**< Requests granted. */
+  uint32_t delayed;   /**< Requests told to wait. */
+} sl_airtime_budget_t;
+
+/**
+ * @brief Start with a full bucket.
+ * @param rate_ms Airtime granted per second, in ms, 1 to 1000.
+ */
+void sl_airtime_budget_init(sl_airtime_budget_t *b, uint32_t rate_ms,
+                            uint32_t now_ms);
+
+/**
+ * @brief Take cost_ms of airtime.
+ * @return 0 if granted, else the ms to wait before asking again. Nothing
+ *         is taken when the caller has to wait.
+ */
+uint32_t sl_airtime_budget_take(sl_airtime_budget_t *b, uint32_t cost_ms,
+                                uint32_t now_ms);
+
+#endif /* MODULES_SL_AIRTIME_BUDGET_H_ */
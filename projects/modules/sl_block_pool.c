@@ -0,0 +1,202 @@
+/*******************************************************************************
+ * @file  sl_block_pool.c
+ * @brief Fixed-block SRAM pools for per-frame buffers
+ *******************************************************************************
+ * # License
+ * <b>Copyright 2025 Silicon Laboratories Inc. www.silabs.com</b>
+ *******************************************************************************
+ *
+ * The licensor of this software is Silicon Laboratories Inc. Your use of this
+ * software is governed by the terms of Silicon Labs Master Software License
+ * Agreement (MSLA) available at
+ * www.silabs.com/about-us/legal/master-software-license-agreement. This
+ * software is distributed to you in Source Code format and is governed by the
+ * sections of the MSLA applicable to Source Code.
+ *
+ ******************************************************************************/
+#include <string.h>
+#include <modules/sl_block_pool.h>
+#include "FreeRTOS.h"
+#include "task.h"
+#include "sl_common_log.h"
+
+/* Free blocks are chained through their payload. */
+typedef struct sli_block_free {
+  struct sli_block_free *next;
+} sli_block_free_t;
+
+typedef struct {
+  uint32_t size;
+  uint32_t count;
+  uint8_t *mem;
+  sli_block_free_t *free_list;
+} sli_block_class_t;
+
+/****************************************************************************/
+/*                            LOCAL VARIABLES                               */
+/****************************************************************************/
+
+/* Word arrays keep every block 4-byte aligned. */
+static uint32_t sli_block_small[SL_BLOCK_POOL_SMALL_COUNT
+                                * SL_BLOCK_POOL_SMALL_SIZE / 4];
+static uint32_t sli_block_medium[SL_BLOCK_POOL_MEDIUM_COUNT
+                                 * SL_BLOCK_POOL_MEDIUM_SIZE / 4];
+static uint32_t sli_block_large[SL_BLOCK_POOL_LARGE_COUNT
+                                * SL_BLOCK_POOL_LARGE_SIZE / 4];
+
+static sli_block_class_t sli_block_classes[SL_BLOCK_POOL_COUNT] = {
+  { SL_BLOCK_POOL_SMALL_SIZE, SL_BLOCK_POOL_SMALL_COUNT,
+    (uint8_t *) sli_block_small, NULL },
+  { SL_BLOCK_POOL_MEDIUM_SIZE, SL_BLOCK_POOL_MEDIUM_COUNT,
+    (uint8_t *) sli_block_medium, NULL },
+  { SL_BLOCK_POOL_LARGE_SIZE, SL_BLOCK_POOL_LARGE_COUNT,
+    (uint8_t *) sli_block_large, NULL },
+};
+static sl_block_pool_stats_t sli_block_stats[SL_BLOCK_POOL_COUNT];
+
+static const char *const sli_block_class_names[SL_BLOCK_POOL_COUNT] = {
+  "small",
+  "medium",
+  "large",
+};
+
+/****************************************************************************/
+/*                            PRIVATE FUNCTIONS                             */
+/****************************************************************************/
+
+/* Usable from tasks and from sleeptimer callbacks alike. */
+static UBaseType_t sli_block_lock(void)
+{
+  return taskENTER_CRITICAL_FROM_ISR();
+}
+
+static void sli_block_unlock(UBaseType_t state)
+{
+  taskEXIT_CRITICAL_FROM_ISR(state);
+}
+
+/* Class owning p, or -1 if p is not the start of a pool block. */
+static int sli_block_owner(const void *p)
+{
+  const uint8_t *b = p;
+
+  for (int c = 0; c < SL_BLOCK_POOL_COUNT; c++) {
+    const sli_block_class_t *k = &sli_block_classes[c];
+    if (b >= k->mem && b < k->mem + k->size * k->count) {
+      return ((uint32_t) (b - k->mem) % k->size) == 0 ? c : -1;
+    }
+  }
+  return -1;
+}
+
+/****************************************************************************/
+/*                            PUBLIC FUNCTIONS                              */
+/****************************************************************************/
+
+void sl_block_pool_init(void)
+{
+  UBaseType_t state = sli_block_lock();
+
+  for (int c = 0; c < SL_BLOCK_POOL_COUNT; c++) {
+    sli_block_class_t *k = &sli_block_classes[c];
+    k->free_list = NULL;
+    for (uint32_t i = k->count; i > 0; i--) {
+      sli_block_free_t *f = (sli_block_free_t *) (k->mem + (i - 1) * k->size);
+      f->next      = k->free_list;
+      k->free_list = f;
+    }
+  }
+  memset(sli_block_stats, 0, sizeof(sli_block_stats));
+  sli_block_unlock(state);
+}
+
+void *sl_block_pool_alloc(uint32_t size)
+{
+  sli_block_free_t *f = NULL;
+  sl_block_pool_stats_t *st;
+  UBaseType_t state;
+  int cls = -1;
+
+  for (int c = 0; c < SL_BLOCK_POOL_COUNT; c++) {
+    if (size <= sli_block_classes[c].size) {
+      cls = c;
+      break;
+    }
+  }
+  if (cls < 0) {
+    ERR_PRINTF("Block pool: no class for %ld bytes\n", size);
+    return NULL;
+  }
+
+  // A full class is a sizing error; do not borrow from a larger one.
+  st    = &sli_block_stats[cls];
+  state = sli_block_lock();
+  f     = sli_block_classes[cls].free_list;
+  if (f) {
+    sli_block_classes[cls].free_list = f->next;
+    st->allocs++;
+    if (++st->in_use > st->peak) {
+      st->peak = st->in_use;
+    }
+  } else {
+    st->failures++;
+  }
+  sli_block_unlock(state);
+  return f;
+}
+
+void sl_block_pool_free(void *p)
+{
+  sli_block_free_t *f = p;
+  UBaseType_t state;
+  int cls;
+
+  if (p == NULL) {
+    return;
+  }
+  cls = sli_block_owner(p);
+  if (cls < 0) {
+    ERR_PRINTF("Block pool: bad free %p\n", p);
+    return;
+  }
+
+  state                            = sli_block_lock();
+  f->next                          = sli_block_classes[cls].free_list;
+  sli_block_classes[cls].free_list = f;
+  sli_block_stats[cls].in_use--;
+  sli_block_unlock(state);
+}
+
+bool sl_block_pool_get_stats(sl_block_pool_class_t cls,
+                             sl_block_pool_stats_t *stats)
+{
+  UBaseType_t state;
+
+  if (cls >= SL_BLOCK_POOL_COUNT) {
+    return false;
+  }
+  state  = sli_block_lock();
+  *stats = sli_block_stats[cls];
+  sli_block_unlock(state);
+  return true;
+}
+
+void sl_block_pool_print_stats(void)
+{
+  sl_block_pool_stats_t st;
+
+  for (int c = 0; c < SL_BLOCK_POOL_COUNT; c++) {
+    sl_block_pool_get_stats((sl_block_pool_class_t) c, &st);
+    LOG_PRINTF("  %-6s %3ld B in use %2ld/%2ld peak %2ld allocs %6ld fail %ld\n",
+               sli_block_class_names[c],
+               sli_block_classes[c].size,
+               st.in_use,
+               sli_block_classes[c].count,
+               st.peak,
+               st.allocs,
+               st.failures);
+  }
+  LOG_PRINTF("Heap free %u bytes, minimum ever %u bytes\n",
+             (unsigned int) xPortGetFreeHeapSize(),
+             (unsigned int) xPortGetMinimumEverFreeHeapSize());
+}
@@ -0,0 +1,103 @@
+/*******************************************************************************
+ * @file  sl_block_pool.h
+ * @brief Fixed-block SRAM pools for per-frame buffers
+ *******************************************************************************
+ * # License
+ * <b>Copyright 2025 Silicon Laboratories Inc. www.silabs.com</b>
+ *******************************************************************************
+ *
+ * The licensor of this software is Silicon Laboratories Inc. Your use of this
+ * software is governed by the terms of Silicon Labs Master Software License
+ * Agreement (MSLA) available at
+ * www.silabs.com/about-us/legal/master-software-license-agreement. This
+ * software is distributed to you in Source Code format and is governed by the
+ * sections of the MSLA applicable to Source Code.
+ *
+ ******************************************************************************/
+#ifndef MODULES_SL_BLOCK_POOL_H_
+#define MODULES_SL_BLOCK_POOL_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/**
+ * Buffers that live for one frame (serial receive queue, Z-Wave frame
+ * buffers) come from static size classes instead of the FreeRTOS heap, so
+ * days of traffic cannot fragment the heap. A request is served by the
+ * smallest class that fits and fails when that class is empty; it never
+ * falls back to malloc().
+ *
+ * The large class holds a full frame buffer: FRAME_BUFFER_ELEMENT_SIE data
+ * bytes, which already leave room for the multi channel, S0 and S2
+ * encapsulation of a Z/IP payload, plus the ts_param_t or
+ * zwave_connection_t header in front of them.
+ *
+ * Blocks may be freed from sleeptimer callbacks, so the pools are guarded
+ * by a short critical section rather than a mutex.
+ */
+
+/** Block size and count of each class, smallest first. */
+#ifndef SL_BLOCK_POOL_SMALL_SIZE
+#define SL_BLOCK_POOL_SMALL_SIZE  64
+#endif
+#ifndef SL_BLOCK_POOL_SMALL_COUNT
+#define SL_BLOCK_POOL_SMALL_COUNT 16
+#endif
+#ifndef SL_BLOCK_POOL_MEDIUM_SIZE
+#define SL_BLOCK_POOL_MEDIUM_SIZE  128
+#endif
+#ifndef SL_BLOCK_POOL_MEDIUM_COUNT
+#define SL_BLOCK_POOL_MEDIUM_COUNT 8
+#endif
+#ifndef SL_BLOCK_POOL_LARGE_SIZE
+#define SL_BLOCK_POOL_LARGE_SIZE  384
+#endif
+#ifndef SL_BLOCK_POOL_LARGE_COUNT
+#define SL_BLOCK_POOL_LARGE_COUNT 14
+#endif
+
+typedef enum {
+  SL_BLOCK_POOL_SMALL = 0,
+  SL_BLOCK_POOL_MEDIUM,
+  SL_BLOCK_POOL_LARGE,
+  SL_BLOCK_POOL_COUNT
+} sl_block_pool_class_t;
+
+typedef struct {
+  uint32_t in_use;    /**< Blocks currently allocated. */
+  uint32_t peak;      /**< Highest in_use seen. */
+  uint32_t allocs;    /**< Successful allocations. */
+  uint32_t failures;  /**< Allocations refused because the class was empty. */
+} sl_block_pool_stats_t;
+
+/**
+ * @brief Chain the free blocks; called once at startup before any frame
+ * is received.
+ */
+void sl_block_pool_init(void);
+
+/**
+ * @brief Allocate a block from the smallest class that holds size bytes.
+ * @return Block address, or NULL if size is larger than the largest class
+ * or that class is empty.
+ */
+void *sl_block_pool_alloc(uint32_t size);
+
+/**
+ * @brief Return a block to its class. NULL is ignored.
+ */
+void sl_block_pool_free(void *p);
+
+/**
+ * @brief Copy the statistics of one class.
+ * @return false for an invalid class.
+ */
+bool sl_block_pool_get_stats(sl_block_pool_class_t cls,
+                             sl_block_pool_stats_t *stats);
+
+/**
+ * @brief Print per-class usage and the heap watermarks.
+ */
+void sl_block_pool_print_stats(void);
+
+#endif /* MODULES_SL_BLOCK_POOL_H_ */
@@ -18,15 +18,183 @@
  *
  */
 
+#include <stdbool.h>
 #include <modules/sl_psram.h>
+#include <modules/sl_psram_arena.h>
+#include "cmsis_os2.h"
 #include "rsi_board.h"
 #include "sl_common_log.h"
 #include "sl_si91x_psram_handle.h"
+#if (SL_PSRAM_DMA_ENABLE)
+#include "sl_si91x_dma.h"
+#endif
+
+#define SL_PSRAM_DMA_INSTANCE   0
+#define SL_PSRAM_DMA_TIMEOUT_MS 100
+#define WORD_MASK               (sizeof(uint32_t) - 1)
 
 /****************************************************************************/
 /*                            LOCAL VARIABLES                               */
 /****************************************************************************/
 
+#if (SL_PSRAM_DMA_ENABLE)
+static uint32_t sli_psram_dma_channel = 0;
+static bool sli_psram_dma_ready = false;
+static volatile bool sli_psram_dma_error = false;
+static osSemaphoreId_t sli_psram_dma_done = NULL;
+static osMutexId_t sli_psram_dma_mutex = NULL;
+#endif
+
+/****************************************************************************/
+/*                            PRIVATE FUNCTIONS                             */
+/****************************************************************************/
+
+/*
+ * CPU copy with 32-bit accesses on both sides. The destination is aligned
+ * first; a misaligned source is read as aligned words and shifted into
+ * place, so the bus never sees byte or unaligned accesses for the body.
+ * Volatile keeps the compiler from turning the loops back into a (byte
+ * wise, newlib-nano) memcpy call.
+ */
+static void sli_psram_copy_cpu(uint8_t *dst, const uint8_t *src, uint32_t len)
+{
+  while (len && ((uintptr_t) dst & WORD_MASK)) {
+    *dst++ = *src++;
+    len--;
+  }
+
+  volatile uint32_t *d = (volatile uint32_t *) dst;
+  uint32_t off         = (uintptr_t) src & WORD_MASK;
+
+  if (len >= sizeof(uint32_t)) {
+    if (off == 0) {
+      const volatile uint32_t *s = (const volatile uint32_t *) src;
+      while (len >= 4 * sizeof(uint32_t)) {
+        uint32_t w0 = s[0];
+        uint32_t w1 = s[1];
+        uint32_t w2 = s[2];
+        uint32_t w3 = s[3];
+        d[0] = w0;
+        d[1] = w1;
+        d[2] = w2;
+        d[3] = w3;
+        d   += 4;
+        s   += 4;
+        len -= 4 * sizeof(uint32_t);
+      }
+      while (len >= sizeof(uint32_t)) {
+        *d++ = *s++;
+        len -= sizeof(uint32_t);
+      }
+      src = (const uint8_t *) s;
+    } else {
+      /* Little endian merge of two aligned source words. */
+      const volatile uint32_t *s = (const volatile uint32_t *) (src - off);
+      uint32_t rs = off * 8;
+      uint32_t ls = 32 - rs;
+      uint32_t lo = *s++;
+      while (len >= sizeof(uint32_t)) {
+        uint32_t hi = *s++;
+        *d++ = (lo >> rs) | (hi << ls);
+        lo   = hi;
+        len -= sizeof(uint32_t);
+      }
+      src = (const uint8_t *) (s - 1) + off;
+    }
+    dst = (uint8_t *) d;
+  }
+
+  while (len--) {
+    *dst++ = *src++;
+  }
+}
+
+#if (SL_PSRAM_DMA_ENABLE)
+static void sli_psram_dma_complete_cb(uint32_t channel, void *data)
+{
+  (void) channel;
+  (void) data;
+  osSemaphoreRelease(sli_psram_dma_done);
+}
+
+static void sli_psram_dma_error_cb(uint32_t channel, void *data)
+{
+  (void) channel;
+  (void) data;
+  sli_psram_dma_error = true;
+  osSemaphoreRelease(sli_psram_dma_done);
+}
+
+static void sli_psram_dma_init(void)
+{
+  sl_dma_init_t dma_init = { .dma_number = SL_PSRAM_DMA_INSTANCE };
+  sl_dma_callback_t cb   = { .transfer_complete_cb = sli_psram_dma_complete_cb,
+                             .error_cb             = sli_psram_dma_error_cb };
+
+  sli_psram_dma_done  = osSemaphoreNew(1, 0, NULL);
+  sli_psram_dma_mutex = osMutexNew(NULL);
+  if (sli_psram_dma_done == NULL || sli_psram_dma_mutex == NULL) {
+    ERR_PRINTF("PSRAM DMA: no memory for sync objects\r\n");
+    return;
+  }
+  if (sl_si91x_dma_init(&dma_init) != SL_STATUS_OK
+      || sl_si91x_dma_allocate_channel(SL_PSRAM_DMA_INSTANCE,
+                                       &sli_psram_dma_channel,
+                                       0) != SL_STATUS_OK
+      || sl_si91x_dma_register_callbacks(SL_PSRAM_DMA_INSTANCE,
+                                         sli_psram_dma_channel,
+                                         &cb) != SL_STATUS_OK) {
+    ERR_PRINTF("PSRAM DMA unavailable, using CPU copies\r\n");
+    return;
+  }
+  sli_psram_dma_ready = true;
+}
+
+/*
+ * Word-aligned bulk transfer on the PSRAM DMA channel. Returns false when
+ * the caller must fall back to the CPU copy.
+ */
+static bool sli_psram_copy_dma(uint8_t *dst, const uint8_t *src, uint32_t len)
+{
+  bool ok;
+
+  if (!sli_psram_dma_ready
+      || osKernelGetState() != osKernelRunning
+      || (((uintptr_t) dst | (uintptr_t) src | len) & WORD_MASK)) {
+    return false;
+  }
+
+  osMutexAcquire(sli_psram_dma_mutex, osWaitForever);
+  // Drop a completion of a transfer that timed out before it arrived.
+  (void) osSemaphoreAcquire(sli_psram_dma_done, 0);
+  sli_psram_dma_error = false;
+  ok = (sl_si91x_dma_simple_transfer(SL_PSRAM_DMA_INSTANCE,
+                                     sli_psram_dma_channel,
+                                     (void *) src,
+                                     (void *) dst,
+                                     len) == SL_STATUS_OK)
+       && (osSemaphoreAcquire(sli_psram_dma_done,
+                              SL_PSRAM_DMA_TIMEOUT_MS) == osOK)
+       && !sli_psram_dma_error;
+  if (!ok) {
+    sl_si91x_dma_stop_transfer(SL_PSRAM_DMA_INSTANCE, sli_psram_dma_channel);
+    ERR_PRINTF("PSRAM DMA transfer failed, retry with CPU\r\n");
+  }
+  osMutexRelease(sli_psram_dma_mutex);
+  return ok;
+}
+#endif
+
+static void sli_psram_copy(uint8_t *dst, const uint8_t *src, uint32_t len)
+{
+#if (SL_PSRAM_DMA_ENABLE)
+  if (len >= SL_PSRAM_DMA_MIN_SIZE && sli_psram_copy_dma(dst, src, len)) {
+    return;
+  }
+#endif
+  sli_psram_copy_cpu(dst, src, len);
+}
+
 /****************************************************************************/
 /*                            PUBLIC FUNCTIONS                              */
 /****************************************************************************/
@@ -51,6 +219,11 @@ sl_psram_return_type_t sl_psram_init()
     return status;
   }
 
+#if (SL_PSRAM_DMA_ENABLE)
+  sli_psram_dma_init();
+#endif
+  sl_psram_arena_init();
+
   return status;
 }
 
@@ -58,20 +231,22 @@ void sl_psram_write_auto_mode(uint32_t addr,
                               uint8_t* SourceBuf,
                               uint32_t num_of_elements)
 {
-  uint8_t* psram_buf_wrt_pointer = (uint8_t*) addr;
-
-  for (uint32_t index = 0; index < num_of_elements; index++) {
-    psram_buf_wrt_pointer[index] = SourceBuf[index];
-  }
+  sli_psram_copy((uint8_t *) addr, SourceBuf, num_of_elements);
 }
 
 void sl_psram_read_auto_mode(uint32_t addr,
                              uint8_t* DestBuf,
                              uint32_t num_of_elements)
 {
-  uint8_t* psram_buf_read_pointer = (uint8_t*) addr;
+  sli_psram_copy(DestBuf, (const uint8_t *) addr, num_of_elements);
+}
 
-  for (uint32_t index = 0; index < num_of_elements; index++) {
-    DestBuf[index] = psram_buf_read_pointer[index];
-  }
+void sl_psram_copy(uint32_t dst_addr, uint32_t src_addr, uint32_t len)
+{
+  sli_psram_copy((uint8_t *) dst_addr, (const uint8_t *) src_addr, len);
+}
+
+void sl_psram_copy_cpu(uint8_t *dst, const uint8_t *src, uint32_t len)
+{
+  sli_psram_copy_cpu(dst, src, len);
 }
@@ -27,12 +27,32 @@
  * physical PSRAM base  | 0x0               | 0x1F4 000 // 2MB
  * Controller image     | 0x1F4000          | 0xFA 000 // 1MB
  * Node image           | 0x2EE000          | 0x40 000 // 256KB
+ * OTA delta base copy  | 0x32E000          | 0xFA 000 // 1MB
+ * Cold table arena     | 0x428000          | 0x100 000 // 1MB
  *
  **/
 #define NCP_IMG_PSRAM_BASE_ADDRESS 0x1F4000
 #define NODE_IMG_PSRAM_BASE_ADDRESS 0x2EE000
+#define OTA_SCRATCH_PSRAM_BASE_ADDRESS 0x32E000
+#define NCP_IMG_PSRAM_SIZE 0xFA000
+#define NODE_IMG_PSRAM_SIZE 0x40000
+#define OTA_SCRATCH_PSRAM_SIZE 0xFA000
+#define ARENA_PSRAM_BASE_ADDRESS 0x428000
+#define ARENA_PSRAM_SIZE 0x100000
 #define PSRAM_CONTROLLER_IMG_BASE_ADDRESS (PSRAM_BASE_ADDRESS + NCP_IMG_PSRAM_BASE_ADDRESS)
 #define PSRAM_NODE_IMG_BASE_ADDRESS       (PSRAM_BASE_ADDRESS + NODE_IMG_PSRAM_BASE_ADDRESS)
+#define PSRAM_OTA_SCRATCH_BASE_ADDRESS    (PSRAM_BASE_ADDRESS + OTA_SCRATCH_PSRAM_BASE_ADDRESS)
+#define PSRAM_ARENA_BASE_ADDRESS          (PSRAM_BASE_ADDRESS + ARENA_PSRAM_BASE_ADDRESS)
+
+/** Use the uDMA for large word-aligned transfers. */
+#ifndef SL_PSRAM_DMA_ENABLE
+#define SL_PSRAM_DMA_ENABLE 1
+#endif
+
+/** Transfers shorter than this are cheaper as CPU word copies. */
+#ifndef SL_PSRAM_DMA_MIN_SIZE
+#define SL_PSRAM_DMA_MIN_SIZE 512
+#endif
 
 /**
  * @brief Initialize the PSRAM module.
@@ -46,7 +66,10 @@
 sl_psram_return_type_t sl_psram_init();
 
 /**
- * @brief To write data to PSRAM in auto mode using DMA.
+ * @brief To write data to PSRAM in auto mode.
+ *
+ * Uses 32-bit accesses for the aligned body and the uDMA for large aligned
+ * transfers; unaligned heads and tails are copied byte by byte.
  * @param[in] addr
  *   PSRAM address for the write operation.
  * @param[in] SourceBuf
@@ -60,7 +83,7 @@ void sl_psram_write_auto_mode(uint32_t addr,
                               uint32_t num_of_elements);
 
 /**
- * @brief To read data from PSRAM in manual mode using DMA.
+ * @brief To read data from PSRAM in auto mode, same strategy as the write.
  * @param[in] addr
  *   PSRAM address for the read operation.
  * @param[out] DestBuf
@@ -73,4 +96,20 @@ void sl_psram_read_auto_mode(uint32_t addr,
                              uint8_t* DestBuf,
                              uint32_t num_of_elements);
 
+/**
+ * @brief Copy between two memory-mapped PSRAM (or SRAM) areas.
+ * @param[in] dst_addr
+ *   Destination address.
+ * @param[in] src_addr
+ *   Source address. The areas must not overlap.
+ * @param[in] len
+ *   Number of bytes.
+ */
+void sl_psram_copy(uint32_t dst_addr, uint32_t src_addr, uint32_t len);
+
+/**
+ * @brief Word-wide CPU copy without the DMA path, for benchmarks.
+ */
+void sl_psram_copy_cpu(uint8_t *dst, const uint8_t *src, uint32_t len);
+
 #endif /* MODULES_SL_PSRAM_H_ */
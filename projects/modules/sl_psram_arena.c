@@ -0,0 +1,231 @@
+/*******************************************************************************
+ * @file  sl_psram_arena.c
+ * @brief Pool allocator for cold bridge tables kept in PSRAM
+ *******************************************************************************
+ * # License
+ * <b>Copyright 2025 Silicon Laboratories Inc. www.silabs.com</b>
+ *******************************************************************************
+ *
+ * The licensor of this software is Silicon Laboratories Inc. Your use of this
+ * software is governed by the terms of Silicon Labs Master Software License
+ * Agreement (MSLA) available at
+ * www.silabs.com/about-us/legal/master-software-license-agreement. This
+ * software is distributed to you in Source Code format and is governed by the
+ * sections of the MSLA applicable to Source Code.
+ *
+ ******************************************************************************/
+
+#include <string.h>
+#include <modules/sl_psram.h>
+#include <modules/sl_psram_arena.h>
+#include "cmsis_os2.h"
+#include "sl_common_log.h"
+
+#define ARENA_MIN_SHIFT   4  // 16 byte blocks
+#define ARENA_MAX_SHIFT   12 // 4 KB blocks
+#define ARENA_CLASSES     (ARENA_MAX_SHIFT - ARENA_MIN_SHIFT + 1)
+#define ARENA_MAGIC       0xA7E4
+
+/* Block header, kept in PSRAM in front of the payload. */
+typedef struct {
+  uint16_t magic;
+  uint8_t cls;
+  uint8_t pool;
+  uint32_t size;     // requested size, for the statistics
+} sli_arena_hdr_t;
+
+/* Free blocks are chained through their payload. */
+typedef struct sli_arena_free {
+  struct sli_arena_free *next;
+} sli_arena_free_t;
+
+/****************************************************************************/
+/*                            LOCAL VARIABLES                               */
+/****************************************************************************/
+
+static uint8_t *sli_arena_base  = NULL;
+static uint32_t sli_arena_used  = 0;
+static sli_arena_free_t *sli_arena_free_list[ARENA_CLASSES];
+static sl_psram_pool_stats_t sli_arena_stats[SL_PSRAM_POOL_COUNT];
+static osMutexId_t sli_arena_mutex = NULL;
+
+static const char *const sli_arena_pool_names[SL_PSRAM_POOL_COUNT] = {
+  "rd_info",
+  "rd_name",
+  "ip_assoc",
+  "mailbox",
+};
+
+/****************************************************************************/
+/*                            PRIVATE FUNCTIONS                             */
+/****************************************************************************/
+
+static void sli_arena_lock(void)
+{
+  if (sli_arena_mutex) {
+    osMutexAcquire(sli_arena_mutex, osWaitForever);
+  }
+}
+
+static void sli_arena_unlock(void)
+{
+  if (sli_arena_mutex) {
+    osMutexRelease(sli_arena_mutex);
+  }
+}
+
+/* Smallest class whose block holds the header and size bytes, or -1. */
+static int sli_arena_class(uint32_t size)
+{
+  uint32_t need = size + sizeof(sli_arena_hdr_t);
+
+  if (size > (1UL << ARENA_MAX_SHIFT)) {
+    return -1;
+  }
+  for (int c = 0; c < ARENA_CLASSES; c++) {
+    if (need <= (1UL << (c + ARENA_MIN_SHIFT))) {
+      return c;
+    }
+  }
+  return -1;
+}
+
+/****************************************************************************/
+/*                            PUBLIC FUNCTIONS                              */
+/****************************************************************************/
+
+void sl_psram_arena_init(void)
+{
+  if (sli_arena_mutex == NULL) {
+    sli_arena_mutex = osMutexNew(NULL);
+  }
+  sli_arena_lock();
+  sli_arena_base = (uint8_t *) PSRAM_ARENA_BASE_ADDRESS;
+  sli_arena_used = 0;
+  memset(sli_arena_free_list, 0, sizeof(sli_arena_free_list));
+  memset(sli_arena_stats, 0, sizeof(sli_arena_stats));
+  sli_arena_unlock();
+  LOG_PRINTF("PSRAM arena: %d KB at 0x%lx\n",
+             ARENA_PSRAM_SIZE / 1024,
+             (uint32_t) PSRAM_ARENA_BASE_ADDRESS);
+}
+
+void *sl_psram_arena_alloc(sl_psram_pool_t pool, uint32_t size)
+{
+  sli_arena_hdr_t *hdr = NULL;
+  sl_psram_pool_stats_t *st;
+  int cls;
+
+  if (pool >= SL_PSRAM_POOL_COUNT || sli_arena_base == NULL) {
+    return NULL;
+  }
+  st  = &sli_arena_stats[pool];
+  cls = sli_arena_class(size);
+
+  sli_arena_lock();
+  if (cls >= 0) {
+    if (sli_arena_free_list[cls]) {
+      hdr                      = (sli_arena_hdr_t *) sli_arena_free_list[cls];
+      sli_arena_free_list[cls] = sli_arena_free_list[cls]->next;
+    } else if (sli_arena_used + (1UL << (cls + ARENA_MIN_SHIFT))
+               <= ARENA_PSRAM_SIZE) {
+      hdr             = (sli_arena_hdr_t *) (sli_arena_base + sli_arena_used);
+      sli_arena_used += 1UL << (cls + ARENA_MIN_SHIFT);
+    }
+  }
+  if (hdr == NULL) {
+    st->failures++;
+    sli_arena_unlock();
+    return NULL;
+  }
+
+  hdr->magic = ARENA_MAGIC;
+  hdr->cls   = (uint8_t) cls;
+  hdr->pool  = (uint8_t) pool;
+  hdr->size  = size;
+  st->in_use += size;
+  st->blocks++;
+  st->allocs++;
+  if (st->in_use > st->peak) {
+    st->peak = st->in_use;
+  }
+  sli_arena_unlock();
+  return hdr + 1;
+}
+
+void sl_psram_arena_free(void *p)
+{
+  sli_arena_hdr_t *hdr;
+  sl_psram_pool_stats_t *st;
+  uint8_t cls;
+
+  if (!sl_psram_arena_owns(p)) {
+    return;
+  }
+  hdr = (sli_arena_hdr_t *) p - 1;
+  if (hdr->magic != ARENA_MAGIC || hdr->cls >= ARENA_CLASSES
+      || hdr->pool >= SL_PSRAM_POOL_COUNT) {
+    ERR_PRINTF("PSRAM arena: bad free %p\n", p);
+    return;
+  }
+
+  sli_arena_lock();
+  st          = &sli_arena_stats[hdr->pool];
+  st->in_use -= hdr->size;
+  st->blocks--;
+  cls        = hdr->cls;
+  hdr->magic = 0;
+  ((sli_arena_free_t *) hdr)->next = sli_arena_free_list[cls];
+  sli_arena_free_list[cls]         = (sli_arena_free_t *) hdr;
+  sli_arena_unlock();
+}
+
+bool sl_psram_arena_owns(const void *p)
+{
+  const uint8_t *b = p;
+
+  return sli_arena_base != NULL
+         && b >= sli_arena_base + sizeof(sli_arena_hdr_t)
+         && b < sli_arena_base + sli_arena_used;
+}
+
+bool sl_psram_arena_get_stats(sl_psram_pool_t pool,
+                              sl_psram_pool_stats_t *stats)
+{
+  if (pool >= SL_PSRAM_POOL_COUNT) {
+    return false;
+  }
+  sli_arena_lock();
+  *stats = sli_arena_stats[pool];
+  sli_arena_unlock();
+  return true;
+}
+
+void sl_psram_arena_print_stats(void)
+{
+  sl_psram_pool_stats_t st;
+  uint32_t free_blocks = 0;
+
+  sli_arena_lock();
+  for (int c = 0; c < ARENA_CLASSES; c++) {
+    for (sli_arena_free_t *f = sli_arena_free_list[c]; f; f = f->next) {
+      free_blocks++;
+    }
+  }
+  LOG_PRINTF("PSRAM arena: carved %ld/%d bytes, %ld blocks on free lists\n",
+             sli_arena_used,
+             ARENA_PSRAM_SIZE,
+             free_blocks);
+  sli_arena_unlock();
+
+  for (int i = 0; i < SL_PSRAM_POOL_COUNT; i++) {
+    sl_psram_arena_get_stats((sl_psram_pool_t) i, &st);
+    LOG_PRINTF("  %-8s in use %6ld peak %6ld blocks %4ld allocs %6ld fail %ld\n",
+               sli_arena_pool_names[i],
+               st.in_use,
+               st.peak,
+               st.blocks,
+               st.allocs,
+               st.failures);
+  }
+}
@@ -0,0 +1,86 @@
+/*******************************************************************************
+ * @file  sl_psram_arena.h
+ * @brief Pool allocator for cold bridge tables kept in PSRAM
+ *******************************************************************************
+ * # License
+ * <b>Copyright 2025 Silicon Laboratories Inc. www.silabs.com</b>
+ *******************************************************************************
+ *
+ * The licensor of this software is Silicon Laboratories Inc. Your use of this
+ * software is governed by the terms of Silicon Labs Master Software License
+ * Agreement (MSLA) available at
+ * www.silabs.com/about-us/legal/master-software-license-agreement. This
+ * software is distributed to you in Source Code format and is governed by the
+ * sections of the MSLA applicable to Source Code.
+ *
+ ******************************************************************************/
+#ifndef MODULES_SL_PSRAM_ARENA_H_
+#define MODULES_SL_PSRAM_ARENA_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/**
+ * The arena holds large structures that are read rarely compared to the
+ * packet path (names, NIF copies, association tables). PSRAM reads are
+ * several times slower than SRAM, so per-packet objects must stay on the
+ * FreeRTOS heap; `psrambench` in the CLI prints both latencies.
+ *
+ * Blocks come from power-of-two size classes carved from the arena on
+ * demand and recycled through per-class free lists. Every block carries its
+ * pool so usage is accounted per pool.
+ */
+
+/** Arena pools, used for accounting only; all pools share the arena. */
+typedef enum {
+  SL_PSRAM_POOL_RD_INFO = 0, /**< Endpoint NIF copies and aggregated members. */
+  SL_PSRAM_POOL_RD_NAME,     /**< Node and endpoint names and locations. */
+  SL_PSRAM_POOL_IP_ASSOC,    /**< IP association table. */
+  SL_PSRAM_POOL_MAILBOX,     /**< Requests queued for wake-up nodes. */
+  SL_PSRAM_POOL_COUNT
+} sl_psram_pool_t;
+
+typedef struct {
+  uint32_t in_use;     /**< Requested bytes currently allocated. */
+  uint32_t peak;       /**< Highest in_use seen. */
+  uint32_t blocks;     /**< Blocks currently allocated. */
+  uint32_t allocs;     /**< Successful allocations. */
+  uint32_t failures;   /**< Allocations that did not fit. */
+} sl_psram_pool_stats_t;
+
+/**
+ * @brief Set up the arena; called by sl_psram_init() once PSRAM is up.
+ */
+void sl_psram_arena_init(void);
+
+/**
+ * @brief Allocate a block from the arena.
+ * @param pool Pool charged for the block.
+ * @param size Requested size, zero is allowed and returns a valid block.
+ * @return Block address, or NULL if the arena is not ready or full.
+ */
+void *sl_psram_arena_alloc(sl_psram_pool_t pool, uint32_t size);
+
+/**
+ * @brief Return a block to the arena. NULL is ignored.
+ */
+void sl_psram_arena_free(void *p);
+
+/**
+ * @brief Check whether a pointer was returned by sl_psram_arena_alloc().
+ */
+bool sl_psram_arena_owns(const void *p);
+
+/**
+ * @brief Copy the statistics of one pool.
+ * @return false for an invalid pool.
+ */
+bool sl_psram_arena_get_stats(sl_psram_pool_t pool,
+                              sl_psram_pool_stats_t *stats);
+
+/**
+ * @brief Print arena and per-pool usage.
+ */
+void sl_psram_arena_print_stats(void);
+
+#endif /* MODULES_SL_PSRAM_ARENA_H_ */
@@ -26,7 +26,13 @@
 #include "lib/memb.h"
 #include "stddef.h"
 #include "string.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include "sl_sleeptimer.h"
 #include "sl_gw_info.h"
+#include "apps/ip_translate/sl_zw_resource.h"
+#include "modules/sl_rd_record.h"
+#include "apps/Z-Wave/CC/RD_profile.h"
 
 // Below are depends from "sl_bridge_ip_assoc.h" and "zip_router_config.h, remove comments to build
 
@@ -52,7 +58,9 @@ typedef struct  _Gw_PeerProfile_St_{
 /****************************************************************************/
 
 #define DATA_BASE_SCHEMA_VERSION_MAJOR 1
-#define DATA_BASE_SCHEMA_VERSION_MINOR 0
+/* 1.1 adds the endpoint slot list of each node, 1.2 stores each node with
+   its endpoints as one record, see sl_rd_record.h. */
+#define DATA_BASE_SCHEMA_VERSION_MINOR 2
 
 #define MAX_NODE                          40
 #define MAX_ENDPOINT_PER_NODE             4
@@ -100,6 +108,27 @@ typedef struct  _Gw_PeerProfile_St_{
 #define NUMBER_OF_PEER_PROFILE            10
 #define MAX_PEER_PROFILE_KEY_OFFSET      (PEER_PROFILE_KEY_OFFSET + NUMBER_OF_PEER_PROFILE) // 1202 + 10 = 1212
 
+// Endpoint slots of each node, one byte per slot, key is nodeid - 1 + offset
+#define NODE_EP_SLOTS_KEY_OFFSET          MAX_PEER_PROFILE_KEY_OFFSET // 1212
+#define MAX_NODE_EP_SLOTS_KEY_OFFSET      (NODE_EP_SLOTS_KEY_OFFSET + MAX_NODE) // 1212 + 40 = 1252
+
+// Node record, key is nodeid - 1 + offset. The node, endpoint and slot keys
+// above are only read to convert stores older than 1.2. Records are not
+// bound by MAX_NODE, the range has room for Long Range node IDs.
+#define MAX_RECORD_NODE                   ZW_LR_MAX_NODE_ID // 100
+#define NODE_RECORD_KEY_OFFSET            MAX_NODE_EP_SLOTS_KEY_OFFSET // 1252
+#define MAX_NODE_RECORD_KEY_OFFSET        (NODE_RECORD_KEY_OFFSET + MAX_RECORD_NODE) // 1252 + 100 = 1352
+
+// Device profile, key is slot + offset, see RD_profile.h. Profiles describe
+// device models rather than the network, rd_data_store_invalidate() keeps
+// them.
+#define PROFILE_KEY_OFFSET                MAX_NODE_RECORD_KEY_OFFSET // 1352
+#define MAX_PROFILE_KEY_OFFSET            (PROFILE_KEY_OFFSET + RD_PROFILE_MAX) // 1352 + 16 = 1368
+
+#if ZW_MAX_NODES > MAX_RECORD_NODE
+#error "Node records do not cover ZW_MAX_NODES"
+#endif
+
 /****************************************************************************/
 /*                            LOCAL VARIABLES                               */
 /****************************************************************************/
@@ -114,9 +143,19 @@ typedef struct rd_network_database_entry {
   uint8_t version_minor;
 } rd_network_database_entry_t;
 
-uint16_t sli_endpoint_key_counter = 0;
 uint8_t sli_ip_association_key_counter = 0;
 
+/* Node owning each endpoint slot of a store older than 1.2, 0 for a free
+   slot. Only used while converting it. */
+static nodeid_t sli_ep_slot_owner[MAX_ENDPOINT];
+
+/* RD_DIRTY_x of each node. */
+static uint8_t sli_node_dirty[MAX_RECORD_NODE];
+static bool sli_store_pending;
+static uint32_t sli_store_first_change;
+static uint32_t sli_store_last_change;
+static rd_data_store_stats_t sli_store_stats;
+
 /****************************************************************************/
 /*                            PRIVATE FUNCTIONS                             */
 /****************************************************************************/
@@ -132,12 +171,144 @@ sl_status_t sli_pointer_data_to_nvm3(uint16_t offset_key, void* data, size_t dat
 
   status = nvm3_writeData(nvm3_defaultHandle, offset_key,
                           data, dataLen);
+  sli_store_stats.writes++;
   if (status != SL_STATUS_OK) {
+    sli_store_stats.errors++;
     LOG_PRINTF("Save pointer to nvm3 fail: %ld", status);
   }
   return status;
 }
 
+static bool sli_store_records_migrate(uint8_t minor);
+
+/* Dirty flags are set from sleeptimer callbacks too. */
+static UBaseType_t sli_store_lock(void)
+{
+  return taskENTER_CRITICAL_FROM_ISR();
+}
+
+static void sli_store_unlock(UBaseType_t state)
+{
+  taskEXIT_CRITICAL_FROM_ISR(state);
+}
+
+static bool sli_store_node_valid(const rd_node_database_entry_t *n)
+{
+  if (n->nodeid == 0 || n->nodeid > MAX_RECORD_NODE) {
+    LOG_PRINTF("Node %d cannot be stored, max %d\n", n->nodeid, MAX_RECORD_NODE);
+    return false;
+  }
+  return true;
+}
+
+static void sli_store_mark(nodeid_t nodeid, uint8_t flags)
+{
+  UBaseType_t state = sli_store_lock();
+  uint32_t now      = sl_sleeptimer_get_tick_count();
+
+  sli_node_dirty[nodeid - 1] |= flags;
+  if (!sli_store_pending) {
+    sli_store_pending      = true;
+    sli_store_first_change = now;
+  }
+  sli_store_last_change = now;
+  sli_store_stats.updates++;
+  sli_store_unlock(state);
+}
+
+static uint8_t sli_store_take(uint8_t *flags)
+{
+  UBaseType_t state = sli_store_lock();
+  uint8_t f         = *flags;
+
+  *flags = 0;
+  sli_store_unlock(state);
+  return f;
+}
+
+/* Read the slot lists of a 1.1 store into sli_ep_slot_owner. */
+static void sli_store_slots_load(void)
+{
+  uint8_t slots[MAX_ENDPOINT];
+  uint32_t type;
+  size_t len;
+
+  memset(sli_ep_slot_owner, 0, sizeof(sli_ep_slot_owner));
+  for (nodeid_t nodeid = 1; nodeid <= MAX_NODE; nodeid++) {
+    if (nvm3_getObjectInfo(nvm3_defaultHandle,
+                           NODE_EP_SLOTS_KEY_OFFSET + nodeid - 1,
+                           &type, &len) != SL_STATUS_OK
+        || len == 0 || len > sizeof(slots)) {
+      continue;
+    }
+    if (nvm3_readData(nvm3_defaultHandle, NODE_EP_SLOTS_KEY_OFFSET + nodeid - 1,
+                      slots, len) != SL_STATUS_OK) {
+      continue;
+    }
+    for (size_t i = 0; i < len; i++) {
+      if (slots[i] < MAX_ENDPOINT) {
+        sli_ep_slot_owner[slots[i]] = nodeid;
+      }
+    }
+  }
+}
+
+/* A 1.0 store has no slot lists; scan its endpoint entries instead. */
+static void sli_store_slots_scan(void)
+{
+  rd_ep_database_entry_t e;
+
+  memset(sli_ep_slot_owner, 0, sizeof(sli_ep_slot_owner));
+  for (uint8_t slot = 0; slot < MAX_ENDPOINT; slot++) {
+    if (nvm3_readData(nvm3_defaultHandle, slot + ENDPOINT_DATA_KEY_OFFSET,
+                      &e, RD_EP_STORE_SIZE) == SL_STATUS_OK
+        && e.nodeID > 0 && e.nodeID <= MAX_NODE) {
+      sli_ep_slot_owner[slot] = e.nodeID;
+    }
+  }
+}
+
+/*
+ * Write the node as one record, whatever part of it is dirty. Returns false
+ * if the stored record is not up to date; the node stays dirty and the
+ * changes are retried by the next flush.
+ */
+static bool sli_store_node_flush(rd_node_database_entry_t *n)
+{
+  uint8_t flags = sli_store_take(&sli_node_dirty[n->nodeid - 1]);
+  uint32_t size, len;
+  sl_status_t status;
+  uint8_t *buf;
+
+  if (!flags) {
+    return true;
+  }
+  size = rd_record_size(n);
+  if (size > RD_RECORD_MAX_SIZE) {
+    LOG_PRINTF("Node %d record of %ld bytes too large\n", n->nodeid, size);
+    sli_store_stats.errors++;
+    sli_store_mark(n->nodeid, flags);
+    return false;
+  }
+  buf = malloc(size);
+  if (!buf) {
+    LOG_PRINTF("Out of memory\n");
+    sli_store_stats.errors++;
+    sli_store_mark(n->nodeid, flags);
+    return false;
+  }
+  len    = rd_record_encode(n, buf, size);
+  status = sli_pointer_data_to_nvm3(NODE_RECORD_KEY_OFFSET + n->nodeid - 1,
+                                    buf, len);
+  free(buf);
+  if (status != SL_STATUS_OK) {
+    sli_store_mark(n->nodeid, flags);
+    return false;
+  }
+  sli_store_stats.bytes += len;
+  return true;
+}
+
 static void clear_database()
 {
   sl_status_t status;
@@ -197,6 +368,12 @@ bool data_store_init(void)
     if (network_database.homeID != homeID || network_database.nodeID != MyNodeID) {
       LOG_PRINTF("Network data mismatch, clearing database.\n");
       clear_database();
+    } else if (network_database.version_major == DATA_BASE_SCHEMA_VERSION_MAJOR
+               && network_database.version_minor < DATA_BASE_SCHEMA_VERSION_MINOR
+               && sli_store_records_migrate(network_database.version_minor)) {
+      network_database.version_minor = DATA_BASE_SCHEMA_VERSION_MINOR;
+      nvm3_writeData(nvm3_defaultHandle, NETWORK_KEY_OFFSET,
+                     &network_database, sizeof(rd_network_database_entry_t));
     }
   }
 
@@ -210,16 +387,18 @@ bool data_store_init(void)
  */
 void data_store_exit(void)
 {
+  rd_data_store_flush();
   nvm3_deinitDefault();
 }
 
 /***************************** Node database **********************/
 
-static bool read_endpoint_from_nvm3(int i, rd_ep_database_entry_t *e, nodeid_t nodeid, rd_node_database_entry_t *n)
+static bool sli_store_legacy_read_ep(int i, rd_ep_database_entry_t *e, nodeid_t nodeid, rd_node_database_entry_t *n)
 {
   sl_status_t status;
+  int slot = i - ENDPOINT_DATA_KEY_OFFSET;
 
-  status = nvm3_readData(nvm3_defaultHandle, i, e, sizeof(rd_ep_database_entry_t));
+  status = nvm3_readData(nvm3_defaultHandle, i, e, RD_EP_STORE_SIZE);
   if (status != SL_STATUS_OK) {
     LOG_PRINTF("Endpoint ID %i not found, nvm3 read error: %ld\n", i, status);
     return false;
@@ -228,50 +407,56 @@ static bool read_endpoint_from_nvm3(int i, rd_ep_database_entry_t *e, nodeid_t n
     return false;
   }
 
-  e->endpoint_name = rd_data_mem_alloc(e->endpoint_name_len);
-  e->endpoint_location = rd_data_mem_alloc(e->endpoint_loc_len);
-  e->endpoint_agg = rd_data_mem_alloc(e->endpoint_aggr_len);
-  e->endpoint_info = rd_data_mem_alloc(e->endpoint_info_len);
+  e->endpoint_name = rd_data_mem_alloc_cold(SL_PSRAM_POOL_RD_NAME,
+                                            e->endpoint_name_len);
+  e->endpoint_location = rd_data_mem_alloc_cold(SL_PSRAM_POOL_RD_NAME,
+                                                e->endpoint_loc_len);
+  e->endpoint_agg = rd_data_mem_alloc_cold(SL_PSRAM_POOL_RD_INFO,
+                                           e->endpoint_aggr_len);
+  e->endpoint_info = rd_data_mem_alloc_cold(SL_PSRAM_POOL_RD_INFO,
+                                            e->endpoint_info_len);
   if ((!e->endpoint_name) || (!e->endpoint_location)
       || (!e->endpoint_agg) || (!e->endpoint_info)) {
     LOG_PRINTF("Out of memory\n");
     return false;
   }
 
-  status = nvm3_readData(nvm3_defaultHandle, i + ENDPOINT_NAME_KEY_OFFSET,
+  status = nvm3_readData(nvm3_defaultHandle, slot + ENDPOINT_NAME_KEY_OFFSET,
                          e->endpoint_name, e->endpoint_name_len);
   if (status != SL_STATUS_OK) {
     LOG_PRINTF("Failed to read endpoint name from NVM3: %ld\n", status);
     return false;
   }
 
-  status = nvm3_readData(nvm3_defaultHandle, i + ENDPOINT_LOCATION_KEY_OFFSET,
+  status = nvm3_readData(nvm3_defaultHandle, slot + ENDPOINT_LOCATION_KEY_OFFSET,
                          e->endpoint_location, e->endpoint_loc_len);
   if (status != SL_STATUS_OK) {
     LOG_PRINTF("Failed to read endpoint location from NVM3: %ld\n", status);
     return false;
   }
 
-  status = nvm3_readData(nvm3_defaultHandle, i + ENDPOINT_AGG_KEY_OFFSET,
+  status = nvm3_readData(nvm3_defaultHandle, slot + ENDPOINT_AGG_KEY_OFFSET,
                          e->endpoint_agg, e->endpoint_aggr_len);
   if (status != SL_STATUS_OK) {
     LOG_PRINTF("Failed to read endpoint agg from NVM3: %ld\n", status);
     return false;
   }
 
-  status = nvm3_readData(nvm3_defaultHandle, i + ENDPOINT_INFO_KEY_OFFSET,
+  status = nvm3_readData(nvm3_defaultHandle, slot + ENDPOINT_INFO_KEY_OFFSET,
                          e->endpoint_info, e->endpoint_info_len);
   if (status != SL_STATUS_OK) {
     LOG_PRINTF("Failed to read endpoint info from NVM3: %ld\n", status);
     return false;
   }
+  rd_ep_class_index(e);
 
   list_add(n->endpoints, e);
   n->nEndpoints++;
   return true;
 }
 
-rd_node_database_entry_t* rd_data_store_read(nodeid_t nodeID)
+/* Read a node stored as separate objects by a store older than 1.2. */
+static rd_node_database_entry_t *sli_store_legacy_read(nodeid_t nodeID)
 {
   sl_status_t status;
   rd_node_database_entry_t *n = NULL;
@@ -297,13 +482,13 @@ rd_node_database_entry_t* rd_data_store_read(nodeid_t nodeID)
   }
 
   // Get nodename, dsk, node_cc_versions in node database
-  n->nodename = rd_data_mem_alloc(n->nodeNameLen);
+  n->nodename = rd_data_mem_alloc_cold(SL_PSRAM_POOL_RD_NAME, n->nodeNameLen);
   n->dsk = rd_data_mem_alloc(n->dskLen);
   n->node_cc_versions = rd_data_mem_alloc(n->node_cc_versions_len);
 
   if ((!n->nodename) || (!n->dsk) || (!n->node_cc_versions)) {
     LOG_PRINTF("Out of memory\n");
-    rd_data_store_mem_free(n);
+    rd_data_store_mem_release(n);
     return NULL;
   }
 
@@ -311,23 +496,24 @@ rd_node_database_entry_t* rd_data_store_read(nodeid_t nodeID)
                          n->nodename, n->nodeNameLen);
   if (status != SL_STATUS_OK) {
     LOG_PRINTF("Failed to read node name from nvm3: %ld\n", status);
-    rd_data_store_mem_free(n);
+    rd_data_store_mem_release(n);
     return NULL;
   }
   status = nvm3_readData(nvm3_defaultHandle, n->nodeid + DSK_DATA_KEY_OFFSET,
                          n->dsk, n->dskLen);
   if (status != SL_STATUS_OK) {
     LOG_PRINTF("Failed to read dsk from nvm3: %ld\n", status);
-    rd_data_store_mem_free(n);
+    rd_data_store_mem_release(n);
     return NULL;
   }
   status = nvm3_readData(nvm3_defaultHandle, n->nodeid + NODE_CC_VERSIONS_OFFSET,
                          n->node_cc_versions, n->node_cc_versions_len);
   if (status != SL_STATUS_OK) {
     LOG_PRINTF("Failed to read node cc versions from nvm3: %ld\n", status);
-    rd_data_store_mem_free(n);
+    rd_data_store_mem_release(n);
     return NULL;
   }
+  rd_node_cc_versions_upgrade(n);
 
   // Get endpoint database entry data
   LIST_STRUCT_INIT(n, endpoints);
@@ -335,14 +521,19 @@ rd_node_database_entry_t* rd_data_store_read(nodeid_t nodeID)
   n->nEndpoints = 0;
   n->refCnt = 0;
 
-  for (int i = ENDPOINT_DATA_KEY_OFFSET; i < MAX_ENDPOINT_DATA_KEY_OFFSET; i++) {
+  for (int slot = 0; slot < MAX_ENDPOINT; slot++) {
+    if (sli_ep_slot_owner[slot] != nodeID) {
+      continue;
+    }
     rd_ep_database_entry_t *e = rd_data_mem_alloc(sizeof(rd_ep_database_entry_t));
     if (!e) {
       LOG_PRINTF("Out of memory\n");
-      rd_data_store_mem_free(n);
+      rd_data_store_mem_release(n);
       return NULL;
     }
-    if (!read_endpoint_from_nvm3(i, e, n->nodeid, n)) {
+    e->cap_digest = 0;
+    e->cc_flags   = NULL;
+    if (!sli_store_legacy_read_ep(slot + ENDPOINT_DATA_KEY_OFFSET, e, n->nodeid, n)) {
       rd_store_mem_free_ep(e);
       continue;
     }
@@ -351,86 +542,135 @@ rd_node_database_entry_t* rd_data_store_read(nodeid_t nodeID)
   return n;
 }
 
-/**
- * @brief Write a node database entry and its endpoints to NVM3.
- *
- * Persists the given node database entry and all associated endpoint data to NVM3.
- *
- * @param n Pointer to the node database entry to write.
- */
-void rd_data_store_nvm_write(rd_node_database_entry_t *n)
+/* Delete the objects of a store older than 1.2. */
+static void sli_store_legacy_delete(void)
 {
-  sl_status_t status;
-  rd_ep_database_entry_t *e;
-  // Save rd_node_database_entry_t to nvm3
-  status = nvm3_writeData(nvm3_defaultHandle, n->nodeid,
-                          (rd_node_database_entry_t *)n,
-                          sizeof(rd_node_database_entry_t));
-  if (status != SL_STATUS_OK) {
-    LOG_PRINTF("Write data to nvm3 fail: %ld\n\r", status);
-    return;
+  for (int i = 0; i <= MAX_NODE; i++) {
+    nvm3_deleteObject(nvm3_defaultHandle, i);
+  }
+  for (int i = NODE_NAME_DATA_KEY_OFFSET; i < MAX_ENDPOINT_LOCATION_KEY_OFFSET; i++) {
+    nvm3_deleteObject(nvm3_defaultHandle, i);
+  }
+  for (int i = NODE_EP_SLOTS_KEY_OFFSET; i < MAX_NODE_EP_SLOTS_KEY_OFFSET; i++) {
+    nvm3_deleteObject(nvm3_defaultHandle, i);
   }
+}
 
-  // Save nodename, dsk, node_cc_versions to nvm3
-  status = sli_pointer_data_to_nvm3(n->nodeid + NODE_NAME_DATA_KEY_OFFSET,
-                                    (uint8_t *)n->nodename, n->nodeNameLen);
-  if (status != SL_STATUS_OK) {
-    LOG_PRINTF("Write node name to nvm3 fail: %ld\n\r", status);
-    return;
+/*
+ * Rewrite every node of an older store as a record. The old objects are
+ * only deleted once all records are written; otherwise they are kept and
+ * false is returned, so the store stays at its version and the next start
+ * converts it again.
+ */
+static bool sli_store_records_migrate(uint8_t minor)
+{
+  rd_node_database_entry_t *n;
+  int count  = 0;
+  int failed = 0;
+
+  LOG_PRINTF("Converting RD store %d.%d to node records\n",
+             DATA_BASE_SCHEMA_VERSION_MAJOR, minor);
+  if (minor < 1) {
+    sli_store_slots_scan();
+  } else {
+    sli_store_slots_load();
+  }
+  for (nodeid_t nodeid = 1; nodeid <= MAX_NODE; nodeid++) {
+    n = sli_store_legacy_read(nodeid);
+    if (!n) {
+      continue;
+    }
+    sli_node_dirty[nodeid - 1] = RD_DIRTY_ALL;
+    if (!sli_store_node_flush(n)) {
+      failed++;
+    }
+    sli_node_dirty[nodeid - 1] = 0;
+    rd_data_store_mem_release(n);
+    count++;
+  }
+  memset(sli_ep_slot_owner, 0, sizeof(sli_ep_slot_owner));
+  if (failed) {
+    LOG_PRINTF("Converted %d of %d nodes, old store kept\n",
+               count - failed, count);
+    return false;
   }
+  sli_store_legacy_delete();
+  LOG_PRINTF("Converted %d nodes\n", count);
+  return true;
+}
 
-  status = sli_pointer_data_to_nvm3(n->nodeid + DSK_DATA_KEY_OFFSET,
-                                    (uint8_t *)n->dsk, n->dskLen);
-  if (status != SL_STATUS_OK) {
-    LOG_PRINTF("Write dsk to nvm3 fail: %ld\n\r", status);
-    return;
+/* Read the record of a node into a new buffer, free it with free(). */
+static uint8_t *sli_store_record_load(nodeid_t nodeID, size_t *len)
+{
+  uint32_t type;
+  uint8_t *buf;
+
+  if (nodeID == 0 || nodeID > MAX_RECORD_NODE
+      || nvm3_getObjectInfo(nvm3_defaultHandle,
+                            NODE_RECORD_KEY_OFFSET + nodeID - 1,
+                            &type, len) != SL_STATUS_OK) {
+    LOG_PRINTF("Node ID %i not found\n", nodeID);
+    return NULL;
+  }
+  buf = malloc(*len);
+  if (!buf) {
+    LOG_PRINTF("Out of memory\n");
+    return NULL;
+  }
+  if (nvm3_readData(nvm3_defaultHandle, NODE_RECORD_KEY_OFFSET + nodeID - 1,
+                    buf, *len) != SL_STATUS_OK) {
+    LOG_PRINTF("Failed to read node %i from nvm3\n", nodeID);
+    free(buf);
+    return NULL;
   }
+  sli_store_stats.reads++;
+  return buf;
+}
 
-  status = sli_pointer_data_to_nvm3(n->nodeid + NODE_CC_VERSIONS_OFFSET,
-                                    (cc_version_pair_t *)n->node_cc_versions,
-                                    n->node_cc_versions_len);
-  if (status != SL_STATUS_OK) {
-    LOG_PRINTF("Write node cc version to nvm3 fail: %ld\n\r", status);
-    return;
+rd_node_database_entry_t* rd_data_store_read(nodeid_t nodeID)
+{
+  rd_node_database_entry_t *n;
+  size_t len;
+  uint8_t *buf = sli_store_record_load(nodeID, &len);
+
+  if (!buf) {
+    return NULL;
   }
+  n = rd_record_decode(buf, len);
+  free(buf);
+  if (n && n->nodeid != nodeID) {
+    LOG_PRINTF("Node ID mismatch\n");
+    rd_data_store_mem_release(n);
+    return NULL;
+  }
+  return n;
+}
 
-  // Save endpoint to nvm3
-  for (e = list_head(n->endpoints); e; e = list_item_next(e)) {
-    e->nodeID = n->nodeid;
-    status = nvm3_writeData(nvm3_defaultHandle,
-                            sli_endpoint_key_counter + ENDPOINT_DATA_KEY_OFFSET,
-                            e, sizeof(rd_ep_database_entry_t));
-    if (status != SL_STATUS_OK) {
-      LOG_PRINTF("Write endpoint database entry to nvm3 fail: %ld\n\r", status);
-      return;
-    }
+bool rd_data_store_peek(nodeid_t nodeID, rd_record_node_cb_t node_cb,
+                        rd_record_ep_cb_t ep_cb, void *ctx)
+{
+  size_t len;
+  uint8_t *buf = sli_store_record_load(nodeID, &len);
+  bool ok;
 
-    status = sli_pointer_data_to_nvm3(sli_endpoint_key_counter + ENDPOINT_INFO_KEY_OFFSET,
-                                      e->endpoint_info, e->endpoint_info_len);
-    if (status != SL_STATUS_OK) {
-      LOG_PRINTF("Write endpoint info to nvm3 fail: %ld\n\r", status);
-      return;
-    }
-    status = sli_pointer_data_to_nvm3(sli_endpoint_key_counter + ENDPOINT_AGG_KEY_OFFSET,
-                                      e->endpoint_agg, e->endpoint_aggr_len);
-    if (status != SL_STATUS_OK) {
-      LOG_PRINTF("Write endpoint agg to nvm3 fail: %ld\n\r", status);
-      return;
-    }
-    status = sli_pointer_data_to_nvm3(sli_endpoint_key_counter + ENDPOINT_LOCATION_KEY_OFFSET,
-                                      e->endpoint_location, e->endpoint_loc_len);
-    if (status != SL_STATUS_OK) {
-      LOG_PRINTF("Write endpoint location to nvm3 fail: %ld\n\r", status);
-      return;
-    }
-    status = sli_pointer_data_to_nvm3(sli_endpoint_key_counter + ENDPOINT_NAME_KEY_OFFSET,
-                                      e->endpoint_name, e->endpoint_name_len);
-    if (status != SL_STATUS_OK) {
-      LOG_PRINTF("Write endpoint name to nvm3 fail: %ld\n\r", status);
-      return;
-    }
-    sli_endpoint_key_counter++;
+  if (!buf) {
+    return false;
   }
+  ok = rd_record_peek(buf, len, node_cb, ep_cb, ctx);
+  free(buf);
+  return ok;
+}
+
+/**
+ * @brief Write a node database entry and its endpoints to NVM3.
+ *
+ * Persists the given node database entry and all associated endpoint data to NVM3.
+ *
+ * @param n Pointer to the node database entry to write.
+ */
+void rd_data_store_nvm_write(rd_node_database_entry_t *n)
+{
+  rd_data_store_mark_dirty(n, RD_DIRTY_ALL);
 }
 
 /**
@@ -443,38 +683,154 @@ void rd_data_store_nvm_write(rd_node_database_entry_t *n)
 void rd_data_store_nvm_free(rd_node_database_entry_t *n)
 {
   sl_status_t status;
-  rd_ep_database_entry_t e;
 
-  // Delete node entry
-  status = nvm3_deleteObject(nvm3_defaultHandle, n->nodeid);
-  if (status != SL_STATUS_OK) {
-    LOG_PRINTF("Fail to delete a node database entry in db: %ld\n", status);
-    // no node in db, just return
+  if (!sli_store_node_valid(n)) {
     return;
   }
+  sli_store_take(&sli_node_dirty[n->nodeid - 1]);
 
-  // Delete endpoint entry
-  for (int i = ENDPOINT_DATA_KEY_OFFSET; i < MAX_ENDPOINT_DATA_KEY_OFFSET; i++) {
-    nvm3_readData(nvm3_defaultHandle, i, &e, sizeof(rd_ep_database_entry_t));
-    if (e.nodeID == n->nodeid) {
-      status = nvm3_deleteObject(nvm3_defaultHandle, i);
-      if (status != SL_STATUS_OK) {
-        LOG_PRINTF("Fail to delete endpoint database entry %d in db", e.nodeID);
-      }
-    }
+  // The record holds the node and all its endpoints
+  status = nvm3_deleteObject(nvm3_defaultHandle,
+                             NODE_RECORD_KEY_OFFSET + n->nodeid - 1);
+  if (status != SL_STATUS_OK) {
+    LOG_PRINTF("Fail to delete a node database entry in db: %ld\n", status);
+    return;
   }
+  sli_store_stats.deletes++;
 }
 
 /**
- * @brief Update a node database entry in NVM3.
- *
- * (Currently not implemented; placeholder for future update logic.)
+ * @brief Mark a node database entry and its endpoint entries for writing.
  *
  * @param n Pointer to the node database entry to update.
  */
 void rd_data_store_update(rd_node_database_entry_t *n)
 {
-  (void)n;
+  rd_data_store_mark_dirty(n, RD_DIRTY_NODE | RD_DIRTY_ENDPOINTS);
+}
+
+void rd_data_store_mark_dirty(rd_node_database_entry_t *n, uint8_t flags)
+{
+  if (sli_store_node_valid(n)) {
+    sli_store_mark(n->nodeid, flags);
+  }
+}
+
+void rd_data_store_mark_ep_dirty(rd_ep_database_entry_t *ep, uint8_t flags)
+{
+  (void) flags;
+  rd_data_store_mark_dirty(ep->node, RD_DIRTY_ENDPOINTS);
+}
+
+void rd_data_store_poll(void)
+{
+  uint32_t now = sl_sleeptimer_get_tick_count();
+
+  if (!sli_store_pending) {
+    return;
+  }
+  if ((now - sli_store_last_change)
+      >= sl_sleeptimer_ms_to_tick(RD_DATA_STORE_FLUSH_DELAY_MS)
+      || (now - sli_store_first_change)
+      >= sl_sleeptimer_ms_to_tick(RD_DATA_STORE_FLUSH_MAX_MS)) {
+    rd_data_store_flush();
+  }
+}
+
+void rd_data_store_flush(void)
+{
+  rd_node_database_entry_t *n;
+  uint32_t writes = sli_store_stats.writes;
+
+  sli_store_pending = false;
+  for (nodeid_t i = 1; i <= MAX_RECORD_NODE; i++) {
+    if (!sli_node_dirty[i - 1]) {
+      continue;
+    }
+    n = rd_node_get_loaded(i);
+    if (n) {
+      sli_store_node_flush(n);
+    } else {
+      sli_store_take(&sli_node_dirty[i - 1]);
+    }
+  }
+  if (sli_store_stats.writes != writes) {
+    sli_store_stats.flushes++;
+  }
+}
+
+bool rd_data_store_flush_node(rd_node_database_entry_t *n)
+{
+  return sli_store_node_valid(n) && sli_store_node_flush(n);
+}
+
+void rd_data_store_get_stats(rd_data_store_stats_t *stats)
+{
+  UBaseType_t state = sli_store_lock();
+
+  *stats = sli_store_stats;
+  sli_store_unlock(state);
+}
+
+void rd_data_store_print_stats(void)
+{
+  rd_data_store_stats_t st;
+
+  rd_data_store_get_stats(&st);
+  LOG_PRINTF("RD store: updates %ld flushes %ld writes %ld deletes %ld "
+             "errors %ld pending %d\n",
+             st.updates, st.flushes, st.writes, st.deletes, st.errors,
+             sli_store_pending);
+  LOG_PRINTF("RD store: %ld record bytes written, %ld records read\n",
+             st.bytes, st.reads);
+}
+
+/****************** Device profiles **********************/
+
+uint8_t *rd_data_store_profile_read(uint8_t slot, size_t *len)
+{
+  uint32_t type;
+  uint8_t *buf;
+
+  if (slot >= RD_PROFILE_MAX
+      || nvm3_getObjectInfo(nvm3_defaultHandle, PROFILE_KEY_OFFSET + slot,
+                            &type, len) != SL_STATUS_OK) {
+    return NULL;
+  }
+  buf = malloc(*len);
+  if (!buf) {
+    LOG_PRINTF("Out of memory\n");
+    return NULL;
+  }
+  if (nvm3_readData(nvm3_defaultHandle, PROFILE_KEY_OFFSET + slot,
+                    buf, *len) != SL_STATUS_OK) {
+    LOG_PRINTF("Failed to read profile %d from nvm3\n", slot);
+    free(buf);
+    return NULL;
+  }
+  return buf;
+}
+
+bool rd_data_store_profile_write(uint8_t slot, const uint8_t *buf, uint32_t len)
+{
+  if (slot >= RD_PROFILE_MAX) {
+    return false;
+  }
+  if (sli_pointer_data_to_nvm3(PROFILE_KEY_OFFSET + slot, (void *) buf, len)
+      != SL_STATUS_OK) {
+    return false;
+  }
+  sli_store_stats.bytes += len;
+  return true;
+}
+
+void rd_data_store_profile_delete(uint8_t slot)
+{
+  if (slot < RD_PROFILE_MAX
+      && nvm3_deleteObject(nvm3_defaultHandle, PROFILE_KEY_OFFSET + slot)
+      == SL_STATUS_OK) {
+    sli_store_stats.deletes++;
+  }
 }
 
 /****************** IP associations **********************/
@@ -592,7 +948,12 @@ void rd_data_store_invalidate()
     nvm3_deleteObject(nvm3_defaultHandle, i);
   }
 
-  sli_endpoint_key_counter = 0;
+  for (int i = NODE_EP_SLOTS_KEY_OFFSET; i < MAX_NODE_RECORD_KEY_OFFSET; i++) {
+    nvm3_deleteObject(nvm3_defaultHandle, i);
+  }
+
+  memset(sli_node_dirty, 0, sizeof(sli_node_dirty));
+  sli_store_pending = false;
 }
 
 void rd_data_store_version_get(uint8_t *major, uint8_t *minor)
@@ -616,6 +977,18 @@ void rd_data_store_version_get(uint8_t *major, uint8_t *minor)
 /********************* Standard memory allocations *************************/
 
 void rd_data_store_mem_free(rd_node_database_entry_t *n)
+{
+  /* Unloading a node must not lose its changes, a deleted node has none. */
+  if ((n->nodeid > 0) && (n->nodeid <= MAX_RECORD_NODE)) {
+    if (!(n->mode & MODE_FLAGS_DELETED)) {
+      sli_store_node_flush(n);
+    }
+    sli_store_take(&sli_node_dirty[n->nodeid - 1]);
+  }
+  rd_data_store_mem_release(n);
+}
+
+void rd_data_store_mem_release(rd_node_database_entry_t *n)
 {
   rd_ep_database_entry_t *ep;
 
@@ -651,6 +1024,7 @@ void rd_store_mem_free_ep(rd_ep_database_entry_t *ep)
   if (ep->endpoint_location) {
     rd_data_mem_free(ep->endpoint_location);
   }
+  rd_data_mem_free(ep->cc_flags);
   rd_data_mem_free(ep);
 }
 
@@ -659,9 +1033,17 @@ void* rd_data_mem_alloc(uint8_t size)
   return malloc(size);
 }
 
+void* rd_data_mem_alloc_cold(sl_psram_pool_t pool, uint16_t size)
+{
+  void *p = sl_psram_arena_alloc(pool, size);
+  return p ? p : malloc(size);
+}
+
 void rd_data_mem_free(void *p)
 {
-  if (p) {
+  if (sl_psram_arena_owns(p)) {
+    sl_psram_arena_free(p);
+  } else if (p) {
     free(p);
   }
 }
@@ -23,6 +23,8 @@
 #include "lib/memb.h"
 #include "sl_uip_def.h"
 #include "apps/Z-Wave/CC/RD_internal.h"
+#include "modules/sl_psram_arena.h"
+#include "modules/sl_rd_record.h"
 
 /**
  * IP association types.
@@ -55,6 +57,49 @@ typedef struct {
   uint8_t mark_removal; /**< Set as a result of remove commands */
 } ip_association_t;
 
+/**
+ * Parts of a node that differ from NVM3, see rd_data_store_mark_dirty().
+ * A node and its endpoints are stored as one record, so any of them makes
+ * the whole record be written once.
+ */
+#define RD_DIRTY_NODE        0x01 /**< The node entry itself. */
+#define RD_DIRTY_NODE_NAME   0x02
+#define RD_DIRTY_DSK         0x04
+#define RD_DIRTY_CC_VERSIONS 0x08
+#define RD_DIRTY_ENDPOINTS   0x10 /**< Endpoints added or removed. */
+#define RD_DIRTY_ALL         0x1F
+
+/**
+ * Parts of an endpoint that differ from NVM3, see
+ * rd_data_store_mark_ep_dirty().
+ */
+#define RD_DIRTY_EP          0x01 /**< The endpoint entry itself. */
+#define RD_DIRTY_EP_INFO     0x02
+#define RD_DIRTY_EP_AGG      0x04
+#define RD_DIRTY_EP_NAME     0x08
+#define RD_DIRTY_EP_LOCATION 0x10
+#define RD_DIRTY_EP_ALL      0x1F
+
+/** Quiet time after the last change before dirty objects are written. */
+#ifndef RD_DATA_STORE_FLUSH_DELAY_MS
+#define RD_DATA_STORE_FLUSH_DELAY_MS 2000
+#endif
+
+/** Longest time a change may stay unwritten while updates keep coming. */
+#ifndef RD_DATA_STORE_FLUSH_MAX_MS
+#define RD_DATA_STORE_FLUSH_MAX_MS 30000
+#endif
+
+typedef struct {
+  uint32_t updates;  /**< Calls marking something dirty. */
+  uint32_t flushes;  /**< Flushes that found something to write. */
+  uint32_t writes;   /**< nvm3_writeData() calls. */
+  uint32_t deletes;  /**< Node records deleted. */
+  uint32_t errors;   /**< Failed writes, the record stays as it was. */
+  uint32_t bytes;    /**< Record bytes written. */
+  uint32_t reads;    /**< Node records read. */
+} rd_data_store_stats_t;
+
 /**
  * Read in the persistent data storage header.
  *
@@ -74,6 +119,7 @@ bool data_store_init(void);
 /**
  * @brief Shut down the data store clean.
  *
+ * Pending changes are written first.
  */
 void data_store_exit(void);
 
@@ -84,10 +130,23 @@ void data_store_exit(void);
  */
 rd_node_database_entry_t* rd_data_store_read(nodeid_t nodeID);
 
+/**
+ * Walk the stored record of a node without decoding it, see
+ * rd_record_peek(). Used at boot to learn about nodes whose entry is not
+ * loaded.
+ *
+ * @return false if the node is not stored, its record is malformed or
+ *         node_cb rejected it.
+ */
+bool rd_data_store_peek(nodeid_t nodeID, rd_record_node_cb_t node_cb,
+                        rd_record_ep_cb_t ep_cb, void *ctx);
+
 /**
  * Write a rd_node_database_entry_t and all its endpoints to storage.
  * This is called when a new node is added. Note that this call would clean up
  * the old entry together with its endpoints and create a new one.
+ *
+ * The write is deferred like rd_data_store_mark_dirty().
  */
 void rd_data_store_nvm_write(rd_node_database_entry_t *n);
 
@@ -100,13 +159,63 @@ void rd_data_store_nvm_write(rd_node_database_entry_t *n);
  */
 void rd_data_store_update(rd_node_database_entry_t *n);
 
+/**
+ * Mark objects of a node (RD_DIRTY_x) for writing.
+ *
+ * Nothing is written here. The node record is written by
+ * rd_data_store_poll() once no change has been made for
+ * #RD_DATA_STORE_FLUSH_DELAY_MS, so a burst of changes while probing costs
+ * one write. Safe to call from timer callbacks.
+ */
+void rd_data_store_mark_dirty(rd_node_database_entry_t *n, uint8_t flags);
+
+/**
+ * Mark objects of an endpoint (RD_DIRTY_EP_x) for writing.
+ */
+void rd_data_store_mark_ep_dirty(rd_ep_database_entry_t *ep, uint8_t flags);
+
+/**
+ * Write dirty node records if the quiet time has passed. Called periodically
+ * from the router thread.
+ */
+void rd_data_store_poll(void);
+
+/**
+ * Write all dirty node records now.
+ */
+void rd_data_store_flush(void);
+
+/**
+ * Write the record of one node now if it is dirty.
+ *
+ * @return true if the stored record matches the entry.
+ */
+bool rd_data_store_flush_node(rd_node_database_entry_t *n);
+
+/**
+ * Copy the write counters.
+ */
+void rd_data_store_get_stats(rd_data_store_stats_t *stats);
+
+/**
+ * Print the write counters.
+ */
+void rd_data_store_print_stats(void);
+
 /**
  * Free up all storage associated with a node and its endpoints from \ref node_db.
+ * Pending changes are written first, unless the node is deleted.
  *
  * @param n Pointer to the node in \ref node_db.
  */
 void rd_data_store_mem_free(rd_node_database_entry_t *n);
 
+/**
+ * Free a node and its endpoints without writing pending changes. For
+ * entries that are not in \ref node_db, such as a partly decoded record.
+ */
+void rd_data_store_mem_release(rd_node_database_entry_t *n);
+
 /**
  * Free the endpoint data, the dynamic data, and the node pointer for
  * a node in the \ref rd_data_store.
@@ -124,6 +233,32 @@ void rd_store_mem_free_ep(rd_ep_database_entry_t* ep);
 void* rd_data_mem_alloc(uint8_t size);
 void rd_data_mem_free(void* p);
 
+/**
+ * Allocate rarely accessed RD data (names, NIF copies) from the PSRAM arena,
+ * falling back to the heap when the arena is unavailable or full.
+ * Free with rd_data_mem_free().
+ */
+void* rd_data_mem_alloc_cold(sl_psram_pool_t pool, uint16_t size);
+
+/**
+ * Read device profile slot (0 to #RD_PROFILE_MAX - 1) into a new buffer,
+ * free it with free().
+ *
+ * @return NULL if the slot is empty.
+ */
+uint8_t *rd_data_store_profile_read(uint8_t slot, size_t *len);
+
+/**
+ * Write a device profile slot now. Profiles are written once per device
+ * model, so they are not deferred like node records.
+ */
+bool rd_data_store_profile_write(uint8_t slot, const uint8_t *buf, uint32_t len);
+
+/**
+ * Delete a device profile slot.
+ */
+void rd_data_store_profile_delete(uint8_t slot);
+
 /**
  * Corrupt the magic field of EEPROM to make sure EEPROM will be reformatted.
  */
@@ -0,0 +1,509 @@
+/*******************************************************************************
+ * @file  sl_rd_record.c
+ * @brief Packed NVM3 record of one resource directory node
+ *******************************************************************************
+ * # License
+ * <b>Copyright 2025 Silicon Laboratories Inc. www.silabs.com</b>
+ *******************************************************************************
+ *
+ * The licensor of this software is Silicon Laboratories Inc. Your use of this
+ * software is governed by the terms of Silicon Labs Master Software License
+ * Agreement (MSLA) available at
+ * www.silabs.com/about-us/legal/master-software-license-agreement. This
+ * software is distributed to you in Source Code format and is governed by the
+ * sections of the MSLA applicable to Source Code.
+ *
+ ******************************************************************************/
+#include <stdbool.h>
+#include <string.h>
+#include "modules/sl_rd_record.h"
+#include "modules/sl_rd_data_store.h"
+#include "apps/ip_translate/sl_zw_resource.h"
+#include "sl_common_log.h"
+
+/* Value lengths of the fixed TLVs. */
+#define RD_TLV_NODE_LEN 32
+#define RD_TLV_EP_LEN   10
+#define RD_TLV_HDR_LEN  2
+
+/* Bit of a node or endpoint field TLV in the set decoded so far. */
+#define RD_TLV_BIT(t)    (1UL << ((t) & 0x1F))
+#define RD_TLV_EP_FIELDS (RD_TLV_BIT(RD_TLV_EP_INFO) | RD_TLV_BIT(RD_TLV_EP_AGG) \
+                          | RD_TLV_BIT(RD_TLV_EP_NAME)                          \
+                          | RD_TLV_BIT(RD_TLV_EP_LOCATION))
+
+typedef struct {
+  uint8_t *p;
+  uint8_t *end;
+} sli_rd_writer_t;
+
+/****************************************************************************/
+/*                            PRIVATE FUNCTIONS                             */
+/****************************************************************************/
+
+static void sli_put_u16(uint8_t *p, uint16_t v)
+{
+  p[0] = v & 0xFF;
+  p[1] = v >> 8;
+}
+
+static void sli_put_u32(uint8_t *p, uint32_t v)
+{
+  sli_put_u16(p, v & 0xFFFF);
+  sli_put_u16(p + 2, v >> 16);
+}
+
+static uint16_t sli_get_u16(const uint8_t *p)
+{
+  return p[0] | (p[1] << 8);
+}
+
+static uint32_t sli_get_u32(const uint8_t *p)
+{
+  return sli_get_u16(p) | ((uint32_t) sli_get_u16(p + 2) << 16);
+}
+
+/* Reserve a TLV and return its value, or NULL if out of space. */
+static uint8_t *sli_tlv_begin(sli_rd_writer_t *w, uint8_t type, uint8_t len)
+{
+  uint8_t *v;
+
+  if (w->p == NULL || w->end - w->p < RD_TLV_HDR_LEN + len) {
+    w->p = NULL;
+    return NULL;
+  }
+  w->p[0] = type;
+  w->p[1] = len;
+  v       = w->p + RD_TLV_HDR_LEN;
+  w->p   += RD_TLV_HDR_LEN + len;
+  return v;
+}
+
+/* Variable length TLVs are left out when empty. */
+static void sli_tlv_put(sli_rd_writer_t *w, uint8_t type,
+                        const void *data, uint8_t len)
+{
+  uint8_t *v;
+
+  if (!data || !len) {
+    return;
+  }
+  v = sli_tlv_begin(w, type, len);
+  if (v) {
+    memcpy(v, data, len);
+  }
+}
+
+static uint32_t sli_tlv_size(const void *data, uint8_t len)
+{
+  return (data && len) ? RD_TLV_HDR_LEN + len : 0;
+}
+
+static void sli_node_pack(const rd_node_database_entry_t *n, uint8_t *v)
+{
+  sli_put_u32(v, n->wakeUp_interval);
+  sli_put_u32(v + 4, n->lastAwake);
+  sli_put_u32(v + 8, n->lastUpdate);
+  sli_put_u16(v + 12, n->nodeid);
+  v[14] = n->security_flags;
+  sli_put_u16(v + 15, (uint16_t) n->mode);
+  v[17] = (uint8_t) n->state;
+  sli_put_u16(v + 18, n->manufacturerID);
+  sli_put_u16(v + 20, n->productType);
+  sli_put_u16(v + 22, n->productID);
+  v[24] = n->nodeType;
+  v[25] = n->nAggEndpoints;
+  v[26] = n->node_version_cap_and_zwave_sw;
+  sli_put_u16(v + 27, n->probe_flags);
+  sli_put_u16(v + 29, n->node_properties_flags);
+  v[31] = n->node_is_zws_probed;
+}
+
+static void sli_node_unpack(rd_node_database_entry_t *n, const uint8_t *v)
+{
+  n->wakeUp_interval               = sli_get_u32(v);
+  n->lastAwake                     = sli_get_u32(v + 4);
+  n->lastUpdate                    = sli_get_u32(v + 8);
+  n->nodeid                        = sli_get_u16(v + 12);
+  n->security_flags                = v[14];
+  n->mode                          = (rd_node_mode_t) sli_get_u16(v + 15);
+  n->state                         = (rd_node_state_t) v[17];
+  n->manufacturerID                = sli_get_u16(v + 18);
+  n->productType                   = sli_get_u16(v + 20);
+  n->productID                     = sli_get_u16(v + 22);
+  n->nodeType                      = v[24];
+  n->nAggEndpoints                 = v[25];
+  n->node_version_cap_and_zwave_sw = v[26];
+  n->probe_flags                   = sli_get_u16(v + 27);
+  n->node_properties_flags         = sli_get_u16(v + 29);
+  n->node_is_zws_probed            = v[31];
+}
+
+static void sli_ep_pack(const rd_ep_database_entry_t *e, uint8_t *v)
+{
+  v[0] = e->endpoint_id;
+  v[1] = (uint8_t) e->state;
+  sli_put_u16(v + 2, e->installer_iconID);
+  sli_put_u16(v + 4, e->user_iconID);
+  // Lengths are implied by the TLVs.
+  sli_put_u32(v + 6, e->cap_digest);
+}
+
+static void sli_ep_unpack(rd_ep_database_entry_t *e, const uint8_t *v)
+{
+  e->endpoint_id      = v[0];
+  e->state            = (rd_ep_state_t) v[1];
+  e->installer_iconID = sli_get_u16(v + 2);
+  e->user_iconID      = sli_get_u16(v + 4);
+  e->cap_digest       = sli_get_u32(v + 6);
+}
+
+/*
+ * Step to the next TLV. Returns 1 with the TLV in type, len and value, 0 at
+ * the end of the record, -1 if the TLV runs past it.
+ */
+static int sli_tlv_next(const uint8_t **p, const uint8_t *end,
+                        uint8_t *type, uint8_t *len, const uint8_t **value)
+{
+  if (*p >= end) {
+    return 0;
+  }
+  if (end - *p < RD_TLV_HDR_LEN || end - *p < RD_TLV_HDR_LEN + (*p)[1]) {
+    return -1;
+  }
+  *type  = (*p)[0];
+  *len   = (*p)[1];
+  *value = *p + RD_TLV_HDR_LEN;
+  *p    += RD_TLV_HDR_LEN + *len;
+  return 1;
+}
+
+/*
+ * Record a field TLV in seen. Returns false if the node or the current
+ * endpoint already had it; #RD_TLV_EP starts the fields of a new endpoint.
+ */
+static bool sli_tlv_first(uint32_t *seen, uint8_t type)
+{
+  if (type == RD_TLV_EP) {
+    *seen &= ~RD_TLV_EP_FIELDS;
+  } else if ((type >= RD_TLV_NODE && type <= RD_TLV_CC_VERSIONS)
+             || (type >= RD_TLV_EP_INFO && type <= RD_TLV_EP_LOCATION)) {
+    if (*seen & RD_TLV_BIT(type)) {
+      return false;
+    }
+    *seen |= RD_TLV_BIT(type);
+  }
+  return true;
+}
+
+/* Copy a TLV value into a new buffer of the given pool, -1 for heap. */
+static void *sli_dup(const uint8_t *v, uint8_t len, int pool)
+{
+  void *p = (pool < 0) ? rd_data_mem_alloc(len)
+            : rd_data_mem_alloc_cold((sl_psram_pool_t) pool, len);
+
+  if (p) {
+    memcpy(p, v, len);
+  }
+  return p;
+}
+
+/* Names, locations and the DSK belong to one node; a template has none. */
+static uint32_t sli_record_size(const rd_node_database_entry_t *n, bool names)
+{
+  uint32_t size = 1 + RD_TLV_HDR_LEN + RD_TLV_NODE_LEN;
+  const rd_ep_database_entry_t *e;
+
+  if (names) {
+    size += sli_tlv_size(n->nodename, n->nodeNameLen);
+    size += sli_tlv_size(n->dsk, n->dskLen);
+  }
+  size += sli_tlv_size(n->node_cc_versions, n->node_cc_versions_len);
+  for (e = list_head(n->endpoints); e; e = list_item_next(e)) {
+    size += RD_TLV_HDR_LEN + RD_TLV_EP_LEN;
+    size += sli_tlv_size(e->endpoint_info, e->endpoint_info_len);
+    size += sli_tlv_size(e->endpoint_agg, e->endpoint_aggr_len);
+    if (names) {
+      size += sli_tlv_size(e->endpoint_name, e->endpoint_name_len);
+      size += sli_tlv_size(e->endpoint_location, e->endpoint_loc_len);
+    }
+  }
+  return size;
+}
+
+static uint32_t sli_record_encode(const rd_node_database_entry_t *n,
+                                  uint8_t *buf,
+                                  uint32_t size,
+                                  bool names)
+{
+  sli_rd_writer_t w = { buf + 1, buf + size };
+  const rd_ep_database_entry_t *e;
+  uint8_t *v;
+
+  if (size < 1) {
+    return 0;
+  }
+  buf[0] = RD_RECORD_FORMAT;
+
+  v = sli_tlv_begin(&w, RD_TLV_NODE, RD_TLV_NODE_LEN);
+  if (v) {
+    sli_node_pack(n, v);
+  }
+  if (names) {
+    sli_tlv_put(&w, RD_TLV_NODE_NAME, n->nodename, n->nodeNameLen);
+    sli_tlv_put(&w, RD_TLV_DSK, n->dsk, n->dskLen);
+  }
+  sli_tlv_put(&w, RD_TLV_CC_VERSIONS, n->node_cc_versions,
+              n->node_cc_versions_len);
+
+  for (e = list_head(n->endpoints); e; e = list_item_next(e)) {
+    v = sli_tlv_begin(&w, RD_TLV_EP, RD_TLV_EP_LEN);
+    if (v) {
+      sli_ep_pack(e, v);
+    }
+    sli_tlv_put(&w, RD_TLV_EP_INFO, e->endpoint_info, e->endpoint_info_len);
+    sli_tlv_put(&w, RD_TLV_EP_AGG, e->endpoint_agg, e->endpoint_aggr_len);
+    if (names) {
+      sli_tlv_put(&w, RD_TLV_EP_NAME, e->endpoint_name, e->endpoint_name_len);
+      sli_tlv_put(&w, RD_TLV_EP_LOCATION, e->endpoint_location,
+                  e->endpoint_loc_len);
+    }
+  }
+  return w.p ? (uint32_t) (w.p - buf) : 0;
+}
+
+/****************************************************************************/
+/*                            PUBLIC FUNCTIONS                              */
+/****************************************************************************/
+
+uint32_t rd_record_size(const rd_node_database_entry_t *n)
+{
+  return sli_record_size(n, true);
+}
+
+uint32_t rd_record_encode(const rd_node_database_entry_t *n,
+                          uint8_t *buf,
+                          uint32_t size)
+{
+  return sli_record_encode(n, buf, size, true);
+}
+
+uint32_t rd_record_template_size(const rd_node_database_entry_t *n)
+{
+  return sli_record_size(n, false);
+}
+
+uint32_t rd_record_template_encode(const rd_node_database_entry_t *n,
+                                   uint8_t *buf,
+                                   uint32_t size)
+{
+  return sli_record_encode(n, buf, size, false);
+}
+
+rd_node_database_entry_t *rd_record_decode(const uint8_t *buf, uint32_t len)
+{
+  const uint8_t *p   = buf + 1;
+  const uint8_t *end = buf + len;
+  rd_node_database_entry_t *n;
+  rd_ep_database_entry_t *e = NULL;
+  bool have_node            = false;
+  bool oom                  = false;
+  uint32_t seen             = 0;
+  const uint8_t *v;
+  uint8_t type, l;
+  int rc;
+
+  if (len < 1 || buf[0] != RD_RECORD_FORMAT) {
+    LOG_PRINTF("Unknown RD record format\n");
+    return NULL;
+  }
+  n = rd_data_mem_alloc(sizeof(rd_node_database_entry_t));
+  if (!n) {
+    LOG_PRINTF("Out of memory\n");
+    return NULL;
+  }
+  memset(n, 0, sizeof(rd_node_database_entry_t));
+  LIST_STRUCT_INIT(n, endpoints);
+
+  while (!oom && (rc = sli_tlv_next(&p, end, &type, &l, &v)) != 0) {
+    if (rc < 0) {
+      goto malformed;
+    }
+    if (type >= RD_TLV_EP_INFO && type <= RD_TLV_EP_LOCATION && !e) {
+      goto malformed;
+    }
+    // A repeated field would replace, and leak, the copy decoded before.
+    if (!sli_tlv_first(&seen, type)) {
+      goto malformed;
+    }
+    switch (type) {
+      case RD_TLV_NODE:
+        if (l < RD_TLV_NODE_LEN) {
+          goto malformed;
+        }
+        sli_node_unpack(n, v);
+        have_node = true;
+        break;
+      case RD_TLV_NODE_NAME:
+        n->nodename    = sli_dup(v, l, SL_PSRAM_POOL_RD_NAME);
+        n->nodeNameLen = l;
+        oom            = !n->nodename;
+        break;
+      case RD_TLV_DSK:
+        n->dsk    = sli_dup(v, l, -1);
+        n->dskLen = l;
+        oom       = !n->dsk;
+        break;
+      case RD_TLV_CC_VERSIONS:
+        n->node_cc_versions     = sli_dup(v, l, -1);
+        n->node_cc_versions_len = l;
+        oom                     = !n->node_cc_versions;
+        break;
+      case RD_TLV_EP:
+        if (l < RD_TLV_EP_LEN) {
+          goto malformed;
+        }
+        e = rd_data_mem_alloc(sizeof(rd_ep_database_entry_t));
+        if (!e) {
+          oom = true;
+          break;
+        }
+        memset(e, 0, sizeof(rd_ep_database_entry_t));
+        sli_ep_unpack(e, v);
+        e->node = n;
+        list_add(n->endpoints, e);
+        n->nEndpoints++;
+        break;
+      case RD_TLV_EP_INFO:
+        e->endpoint_info     = sli_dup(v, l, SL_PSRAM_POOL_RD_INFO);
+        e->endpoint_info_len = l;
+        oom                  = !e->endpoint_info;
+        break;
+      case RD_TLV_EP_AGG:
+        e->endpoint_agg      = sli_dup(v, l, SL_PSRAM_POOL_RD_INFO);
+        e->endpoint_aggr_len = l;
+        oom                  = !e->endpoint_agg;
+        break;
+      case RD_TLV_EP_NAME:
+        e->endpoint_name     = sli_dup(v, l, SL_PSRAM_POOL_RD_NAME);
+        e->endpoint_name_len = l;
+        oom                  = !e->endpoint_name;
+        break;
+      case RD_TLV_EP_LOCATION:
+        e->endpoint_location = sli_dup(v, l, SL_PSRAM_POOL_RD_NAME);
+        e->endpoint_loc_len  = l;
+        oom                  = !e->endpoint_location;
+        break;
+      default:
+        break;
+    }
+  }
+  if (oom) {
+    LOG_PRINTF("Out of memory\n");
+    rd_data_store_mem_release(n);
+    return NULL;
+  }
+  if (!have_node) {
+    goto malformed;
+  }
+
+  for (e = list_head(n->endpoints); e; e = list_item_next(e)) {
+    e->nodeID = n->nodeid;
+    rd_ep_class_index(e);
+  }
+  if (!n->node_cc_versions) {
+    n->node_cc_versions = rd_data_mem_alloc(RD_CC_VERSION_COUNT);
+    if (!n->node_cc_versions) {
+      rd_data_store_mem_release(n);
+      return NULL;
+    }
+    n->node_cc_versions_len = RD_CC_VERSION_COUNT;
+    rd_mem_cc_versions_set_default(RD_CC_VERSION_COUNT, n->node_cc_versions);
+  }
+  return n;
+
+  malformed:
+  LOG_PRINTF("Malformed RD record\n");
+  rd_data_store_mem_release(n);
+  return NULL;
+}
+
+bool rd_record_peek(const uint8_t *buf, uint32_t len,
+                    rd_record_node_cb_t node_cb,
+                    rd_record_ep_cb_t ep_cb, void *ctx)
+{
+  const uint8_t *p   = buf + 1;
+  const uint8_t *end = buf + len;
+  rd_node_database_entry_t n;
+  rd_ep_database_entry_t e;
+  bool have_node = false;
+  bool have_ep   = false;
+  uint32_t seen  = 0;
+  const uint8_t *v;
+  uint8_t type, l;
+  int rc;
+
+  if (len < 1 || buf[0] != RD_RECORD_FORMAT) {
+    return false;
+  }
+  memset(&n, 0, sizeof(n));
+  LIST_STRUCT_INIT(&n, endpoints);
+
+  while ((rc = sli_tlv_next(&p, end, &type, &l, &v)) != 0) {
+    if (rc < 0) {
+      return false;
+    }
+    if (type >= RD_TLV_EP_INFO && type <= RD_TLV_EP_LOCATION && !have_ep) {
+      return false;
+    }
+    if (!sli_tlv_first(&seen, type)) {
+      return false;
+    }
+    switch (type) {
+      case RD_TLV_NODE:
+        if (l < RD_TLV_NODE_LEN) {
+          return false;
+        }
+        sli_node_unpack(&n, v);
+        have_node = true;
+        break;
+      case RD_TLV_NODE_NAME:
+        n.nodename    = (char *) v;
+        n.nodeNameLen = l;
+        break;
+      case RD_TLV_DSK:
+        n.dsk    = (uint8_t *) v;
+        n.dskLen = l;
+        break;
+      case RD_TLV_EP:
+        if (l < RD_TLV_EP_LEN) {
+          return false;
+        }
+        if (have_ep) {
+          ep_cb(&e, ctx);
+        } else if (!have_node || !node_cb(&n, ctx)) {
+          return false;
+        }
+        memset(&e, 0, sizeof(e));
+        sli_ep_unpack(&e, v);
+        e.node  = &n;
+        have_ep = true;
+        break;
+      case RD_TLV_EP_NAME:
+        e.endpoint_name     = (char *) v;
+        e.endpoint_name_len = l;
+        break;
+      case RD_TLV_EP_LOCATION:
+        e.endpoint_location = (char *) v;
+        e.endpoint_loc_len  = l;
+        break;
+      default:
+        break;
+    }
+  }
+  if (have_ep) {
+    ep_cb(&e, ctx);
+    return true;
+  }
+  return have_node && node_cb(&n, ctx);
+}
@@ -0,0 +1,114 @@
+/*******************************************************************************
+ * @file  sl_rd_record.h
+ * @brief Packed NVM3 record of one resource directory node
+ *******************************************************************************
+ * # License
+ * <b>Copyright 2025 Silicon Laboratories Inc. www.silabs.com</b>
+ *******************************************************************************
+ *
+ * The licensor of this software is Silicon Laboratories Inc. Your use of this
+ * software is governed by the terms of Silicon Labs Master Software License
+ * Agreement (MSLA) available at
+ * www.silabs.com/about-us/legal/master-software-license-agreement. This
+ * software is distributed to you in Source Code format and is governed by the
+ * sections of the MSLA applicable to Source Code.
+ *
+ ******************************************************************************/
+#ifndef MODULES_SL_RD_RECORD_H_
+#define MODULES_SL_RD_RECORD_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "apps/Z-Wave/CC/RD_internal.h"
+
+/**
+ * A node, its name, DSK, CC versions and all its endpoints are stored as
+ * one NVM3 object:
+ *
+ *   format (1 byte), then TLVs of type (1 byte), length (1 byte), value.
+ *
+ * Fixed fields are packed little endian without padding or pointers.
+ * Endpoint TLVs (#RD_TLV_EP_INFO ...) belong to the #RD_TLV_EP before
+ * them. Each field appears at most once per node or endpoint, a record
+ * repeating one is rejected. Unknown types are skipped, so fields can be
+ * added without a new format.
+ */
+#define RD_RECORD_FORMAT 1
+
+/** Largest record written; a node needing more is not stored. */
+#ifndef RD_RECORD_MAX_SIZE
+#define RD_RECORD_MAX_SIZE 2048
+#endif
+
+typedef enum {
+  RD_TLV_NODE        = 0x01, /**< Fixed node fields. */
+  RD_TLV_NODE_NAME   = 0x02,
+  RD_TLV_DSK         = 0x03,
+  RD_TLV_CC_VERSIONS = 0x04,
+  RD_TLV_EP          = 0x10, /**< Fixed endpoint fields, starts an endpoint. */
+  RD_TLV_EP_INFO     = 0x11,
+  RD_TLV_EP_AGG      = 0x12,
+  RD_TLV_EP_NAME     = 0x13,
+  RD_TLV_EP_LOCATION = 0x14,
+} rd_record_tlv_t;
+
+/**
+ * @brief Bytes needed by rd_record_encode() for n.
+ */
+uint32_t rd_record_size(const rd_node_database_entry_t *n);
+
+/**
+ * @brief Encode n and its endpoints into buf.
+ * @return Record length, or 0 if buf is too small.
+ */
+uint32_t rd_record_encode(const rd_node_database_entry_t *n,
+                          uint8_t *buf,
+                          uint32_t size);
+
+/**
+ * @brief Bytes needed by rd_record_template_encode() for n.
+ */
+uint32_t rd_record_template_size(const rd_node_database_entry_t *n);
+
+/**
+ * @brief Encode n like rd_record_encode(), leaving out what belongs to one
+ * node only: its name, its DSK and the names and locations of its
+ * endpoints. Used for device profiles, see RD_profile.h.
+ * @return Record length, or 0 if buf is too small.
+ */
+uint32_t rd_record_template_encode(const rd_node_database_entry_t *n,
+                                   uint8_t *buf,
+                                   uint32_t size);
+
+/**
+ * @brief Decode a record into a newly allocated node entry with its
+ * endpoints, as rd_data_store_read() returns it.
+ * @return The entry, or NULL if the record is malformed or memory ran out.
+ */
+rd_node_database_entry_t *rd_record_decode(const uint8_t *buf, uint32_t len);
+
+/**
+ * Called by rd_record_peek() with the node, before its endpoints. The
+ * endpoint list is empty and the CC versions are left out. Return false to
+ * skip the endpoints.
+ */
+typedef bool (*rd_record_node_cb_t)(const rd_node_database_entry_t *n,
+                                    void *ctx);
+
+/** Called by rd_record_peek() for each endpoint, with ep->node set. */
+typedef void (*rd_record_ep_cb_t)(const rd_ep_database_entry_t *ep, void *ctx);
+
+/**
+ * @brief Walk a record without allocating anything.
+ *
+ * Strings passed to the callbacks point into buf and must not be kept.
+ * rd_record_encode() writes the node TLVs before the endpoints, which this
+ * relies on.
+ *
+ * @return true if the record is well formed and node_cb accepted it.
+ */
+bool rd_record_peek(const uint8_t *buf, uint32_t len,
+                    rd_record_node_cb_t node_cb,
+                    rd_record_ep_cb_t ep_cb, void *ctx);
+
+#endif /* MODULES_SL_RD_RECORD_H_ */
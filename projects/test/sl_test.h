@@ -0,0 +1,59 @@
+/*******************************************************************************
+ * @file  sl_test.h
+ * @brief On-device benches run from the CLI
+ *******************************************************************************
+ * # License
+ * <b>Copyright 2025 Silicon Laboratories Inc. www.silabs.com</b>
+ *******************************************************************************
+ *
+ * The licensor of this software is Silicon Laboratories Inc. Your use of this
+ * software is governed by the terms of Silicon Labs Master Software License
+ * Agreement (MSLA) available at
+ * www.silabs.com/about-us/legal/master-software-license-agreement. This
+ * software is distributed to you in Source Code format and is governed by the
+ * sections of the MSLA applicable to Source Code.
+ *
+ ******************************************************************************/
+#ifndef TEST_SL_TEST_H_
+#define TEST_SL_TEST_H_
+
+/**
+ * Each bench prints its results and the number of failed checks. They are
+ * built by the devs_zw_917_test component and only meant for development
+ * images; see the notes of each bench before running it on a live network.
+ */
+
+/** PSRAM copy, fill and pointer chase throughput. */
+void sl_test_psram_bench(void);
+
+/** Endpoint command class flag lookups against the class list scan. */
+void sl_test_cc_class_bench(void);
+
+/** Coalesced NVM3 writes of the resource directory. */
+void sl_test_rd_store_bench(void);
+
+/** Encode and decode of the resource directory records. */
+void sl_test_rd_record_bench(void);
+
+/** Hot node cache lookups. */
+void sl_test_rd_cache_bench(void);
+
+/** Interview profile matching and reuse. */
+void sl_test_rd_profile_bench(void);
+
+/** Concurrent interview scheduling under the airtime budget, on stub nodes. */
+void sl_test_probe_sched_bench(void);
+
+/** LZ4 and delta OTA image decoding. */
+void sl_test_ota_decode_bench(void);
+
+/** Shared client Gets on the temporary association path. */
+void sl_test_shared_get_bench(void);
+
+/** Per-node command class version table. */
+void sl_test_rd_versions_bench(void);
+
+/** Resource directory name index. */
+void sl_test_rd_names_bench(void);
+
+#endif /* TEST_SL_TEST_H_ */
@@ -0,0 +1,210 @@
+#include <string.h>
+#include "sl_common_log.h"
+#include "test/sl_test.h"
+#include "modules/sl_psram.h"
+#include "utls/zgw_crc.h"
+#include "apps/sl_ota/sl_ota_decode.h"
+
+/* The bench overwrites the OTA scratch region, never run it during OTA. */
+#define BENCH_OUT        PSRAM_OTA_SCRATCH_BASE_ADDRESS
+#define BENCH_BASE       (PSRAM_OTA_SCRATCH_BASE_ADDRESS + 0x10000)
+#define BENCH_CHUNK      7 /* Splits every field across chunks. */
+#define BENCH_LIT_HEAD   20
+#define BENCH_MATCH_LEN  4000
+#define BENCH_LIT_TAIL   300
+#define BENCH_LZ4_SIZE   (BENCH_LIT_HEAD + BENCH_MATCH_LEN + BENCH_LIT_TAIL)
+#define BENCH_COPY1_OFF  100
+#define BENCH_COPY1_LEN  500
+#define BENCH_INSERT_LEN 10
+#define BENCH_COPY2_LEN  300
+#define BENCH_DELTA_SIZE (BENCH_COPY1_LEN + BENCH_INSERT_LEN + BENCH_COPY2_LEN)
+
+static uint8_t bench_expect[BENCH_LZ4_SIZE];
+static uint8_t bench_stream[BENCH_LZ4_SIZE];
+static uint32_t bench_failed;
+
+static uint8_t bench_byte(uint32_t i)
+{
+  return (uint8_t) (i * 7 + (i >> 5));
+}
+
+/* Put an LZ4 length above the 4 bit field of the token. */
+static uint32_t bench_lz4_len(uint8_t *p, uint32_t len)
+{
+  uint32_t n = 0;
+
+  for (len -= 15; len >= 0xFF; len -= 0xFF) {
+    p[n++] = 0xFF;
+  }
+  p[n++] = (uint8_t) len;
+  return n;
+}
+
+/*
+ * One LZ4 block: a sequence of BENCH_LIT_HEAD literals and a match
+ * repeating them, then a last sequence of BENCH_LIT_TAIL literals. Both
+ * lengths need extra length bytes, the match a run of 0xFF.
+ */
+static uint32_t bench_build_lz4(void)
+{
+  uint32_t n = 0, i;
+
+  bench_stream[n++] = 0xFF;
+  n += bench_lz4_len(&bench_stream[n], BENCH_LIT_HEAD);
+  for (i = 0; i < BENCH_LIT_HEAD; i++) {
+    bench_expect[i]   = bench_byte(i);
+    bench_stream[n++] = bench_expect[i];
+  }
+  bench_stream[n++] = BENCH_LIT_HEAD;
+  bench_stream[n++] = 0;
+  n += bench_lz4_len(&bench_stream[n], BENCH_MATCH_LEN - 4);
+  for (; i < BENCH_LIT_HEAD + BENCH_MATCH_LEN; i++) {
+    bench_expect[i] = bench_expect[i - BENCH_LIT_HEAD];
+  }
+  bench_stream[n++] = 0xF0;
+  n += bench_lz4_len(&bench_stream[n], BENCH_LIT_TAIL);
+  for (; i < BENCH_LZ4_SIZE; i++) {
+    bench_expect[i]   = bench_byte(i * 3);
+    bench_stream[n++] = bench_expect[i];
+  }
+  return n;
+}
+
+static uint32_t bench_varint(uint8_t *p, uint32_t v)
+{
+  uint32_t n = 0;
+
+  while (v >= 0x80) {
+    p[n++] = (uint8_t) (v | 0x80);
+    v    >>= 7;
+  }
+  p[n++] = (uint8_t) v;
+  return n;
+}
+
+/*
+ * A delta against the LZ4 image as base: a copy from inside it, an insert
+ * and a copy from its start.
+ */
+static uint32_t bench_build_delta(const uint8_t *base)
+{
+  uint32_t n = 0, o = 0;
+
+  bench_stream[n++] = SL_OTA_DELTA_OP_COPY;
+  n += bench_varint(&bench_stream[n], BENCH_COPY1_OFF);
+  n += bench_varint(&bench_stream[n], BENCH_COPY1_LEN);
+  memcpy(&bench_expect[o], &base[BENCH_COPY1_OFF], BENCH_COPY1_LEN);
+  o += BENCH_COPY1_LEN;
+
+  bench_stream[n++] = SL_OTA_DELTA_OP_INSERT;
+  n += bench_varint(&bench_stream[n], BENCH_INSERT_LEN);
+  for (uint32_t i = 0; i < BENCH_INSERT_LEN; i++) {
+    bench_expect[o]   = (uint8_t) (0xA0 + i);
+    bench_stream[n++] = bench_expect[o++];
+  }
+
+  bench_stream[n++] = SL_OTA_DELTA_OP_COPY;
+  n += bench_varint(&bench_stream[n], 0);
+  n += bench_varint(&bench_stream[n], BENCH_COPY2_LEN);
+  memcpy(&bench_expect[o], base, BENCH_COPY2_LEN);
+  return n;
+}
+
+static sl_status_t bench_decode(sl_ota_encoding_t enc,
+                                uint32_t out_size,
+                                uint32_t base_size,
+                                uint32_t len)
+{
+  sl_ota_decoder_t dec;
+  uint32_t n;
+
+  sl_ota_decoder_init(&dec, enc, BENCH_OUT, out_size, BENCH_BASE, base_size);
+  for (uint32_t off = 0; off < len; off += n) {
+    n = (len - off < BENCH_CHUNK) ? len - off : BENCH_CHUNK;
+    if (sl_ota_decoder_feed(&dec, &bench_stream[off], n) != SL_STATUS_OK) {
+      return SL_STATUS_FAIL;
+    }
+  }
+  return sl_ota_decoder_finish(&dec);
+}
+
+/* A well formed image must decode to the expected bytes and CRC. */
+static void bench_expect_ok(const char *name,
+                            sl_ota_encoding_t enc,
+                            uint32_t size,
+                            uint32_t base_size,
+                            uint32_t len)
+{
+  const uint8_t *out = (const uint8_t *) BENCH_OUT;
+  uint16_t crc_out, crc_exp;
+
+  if (bench_decode(enc, size, base_size, len) != SL_STATUS_OK) {
+    ERR_PRINTF("ota decode bench: %s not decoded\n", name);
+    bench_failed++;
+    return;
+  }
+  crc_out = zgw_crc16(CRC_INIT_VALUE, (uint8_t *) out, size);
+  crc_exp = zgw_crc16(CRC_INIT_VALUE, bench_expect, size);
+  if (memcmp(out, bench_expect, size) != 0 || crc_out != crc_exp) {
+    ERR_PRINTF("ota decode bench: %s differs, crc %04x expected %04x\n",
+               name, crc_out, crc_exp);
+    bench_failed++;
+    return;
+  }
+  SL_LOG_PRINT("ota decode: %s %ld -> %ld bytes, crc %04x\n",
+               name, len, size, crc_out);
+}
+
+static void bench_expect_fail(const char *name,
+                              sl_ota_encoding_t enc,
+                              uint32_t size,
+                              uint32_t base_size,
+                              uint32_t len)
+{
+  if (bench_decode(enc, size, base_size, len) == SL_STATUS_OK) {
+    ERR_PRINTF("ota decode bench: %s accepted\n", name);
+    bench_failed++;
+  }
+}
+
+/*
+ * Decode LZ4 and delta images built here into the OTA scratch region, fed
+ * in small chunks, and check the output and its CRC. Truncated and corrupt
+ * images must be rejected.
+ */
+void sl_test_ota_decode_bench(void)
+{
+  uint32_t len;
+
+  bench_failed = 0;
+
+  len = bench_build_lz4();
+  bench_expect_ok("lz4", SL_OTA_ENCODING_LZ4, BENCH_LZ4_SIZE, 0, len);
+  /* Ends inside the literals of the last sequence */
+  bench_expect_fail("lz4 truncated", SL_OTA_ENCODING_LZ4,
+                    BENCH_LZ4_SIZE, 0, len - 3);
+  /* Image larger than announced */
+  bench_expect_fail("lz4 too long", SL_OTA_ENCODING_LZ4,
+                    BENCH_LZ4_SIZE - 1, 0, len);
+  /* Match offset before the start of the output */
+  bench_stream[2 + BENCH_LIT_HEAD] = BENCH_LIT_HEAD + 1;
+  bench_expect_fail("lz4 bad offset", SL_OTA_ENCODING_LZ4,
+                    BENCH_LZ4_SIZE, 0, len);
+
+  /* The LZ4 image becomes the delta base. */
+  bench_build_lz4();
+  memcpy((uint8_t *) BENCH_BASE, bench_expect, BENCH_LZ4_SIZE);
+  len = bench_build_delta((const uint8_t *) BENCH_BASE);
+  bench_expect_ok("delta", SL_OTA_ENCODING_DELTA, BENCH_DELTA_SIZE,
+                  BENCH_LZ4_SIZE, len);
+  bench_expect_fail("delta truncated", SL_OTA_ENCODING_DELTA,
+                    BENCH_DELTA_SIZE, BENCH_LZ4_SIZE, len - 1);
+  /* The first copy runs past the end of a shorter base */
+  bench_expect_fail("delta outside base", SL_OTA_ENCODING_DELTA,
+                    BENCH_DELTA_SIZE, BENCH_COPY1_OFF + 10, len);
+  bench_stream[0] = 0x7E;
+  bench_expect_fail("delta bad op", SL_OTA_ENCODING_DELTA,
+                    BENCH_DELTA_SIZE, BENCH_LZ4_SIZE, len);
+
+  SL_LOG_PRINT("ota decode: %ld failed\n", bench_failed);
+}
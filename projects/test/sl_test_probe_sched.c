@@ -0,0 +1,149 @@
+#include <string.h>
+#include "cmsis_os2.h"
+#include "sl_common_log.h"
+#include "sl_common_type.h"
+#include "test/sl_test.h"
+#include "apps/ip_translate/sl_zw_resource.h"
+#include "apps/Z-Wave/CC/RD_internal.h"
+
+#define SIM_NODES        12
+#define SIM_FIRST_ID     2
+#define SIM_WAKEUP_EVERY 6      /* Every 6th node is a wake-up node */
+#define SIM_TIMEOUT_MS   180000 /* Give up on a run after this long */
+
+/* Stub nodes, never added to the RD. */
+static rd_node_database_entry_t sim_nodes[SIM_NODES];
+static uint32_t sim_steps_done[SIM_NODES];
+static uint32_t sim_due[SIM_NODES]; /* clock_time() the report comes in */
+static bool sim_pending[SIM_NODES];
+
+/* Steps of an interview: node steps, then the probe of each endpoint. */
+static uint32_t sim_steps(int node)
+{
+  return 8 + 4 * (node % 3);
+}
+
+/* Time from sending a step to handling its report, routed nodes are slower. */
+static uint32_t sim_latency_ms(int node)
+{
+  return 120 + (node * 37) % 400;
+}
+
+static int sim_is_wakeup(int node)
+{
+  return node % SIM_WAKEUP_EVERY == SIM_WAKEUP_EVERY - 1;
+}
+
+static rd_node_database_entry_t *sim_node(nodeid_t id)
+{
+  if (id < SIM_FIRST_ID || id >= SIM_FIRST_ID + SIM_NODES) {
+    return NULL;
+  }
+  return &sim_nodes[id - SIM_FIRST_ID];
+}
+
+/* Stands for the request of the step; its report is handled by sim_run(). */
+static void sim_step(rd_node_database_entry_t *n)
+{
+  int i = n - sim_nodes;
+
+  sim_due[i]     = clock_time() + sim_latency_ms(i);
+  sim_pending[i] = true;
+}
+
+static void sim_init(void)
+{
+  memset(sim_nodes, 0, sizeof(sim_nodes));
+  memset(sim_steps_done, 0, sizeof(sim_steps_done));
+  memset(sim_pending, 0, sizeof(sim_pending));
+  for (int i = 0; i < SIM_NODES; i++) {
+    LIST_STRUCT_INIT(&sim_nodes[i], endpoints);
+    sim_nodes[i].nodeid = SIM_FIRST_ID + i;
+    sim_nodes[i].mode   = sim_is_wakeup(i) ? MODE_NONLISTENING
+                          : MODE_ALWAYSLISTENING;
+    /* A step that sends, so each one is charged airtime. */
+    sim_nodes[i].state = STATUS_PROBE_PRODUCT_ID;
+  }
+}
+
+/*
+ * Interview the stub nodes through rd_probe_resume() and
+ * rd_node_probe_update() with `slots` interviews at once, and return the
+ * time until the last one ended, or 0 if the run did not finish.
+ */
+static uint32_t sim_run(uint8_t slots)
+{
+  const rd_probe_stubs_t stubs = { sim_node, sim_step, slots };
+  uint32_t start, now;
+  int left = SIM_NODES;
+
+  sim_init();
+  if (!rd_probe_set_stubs(&stubs)) {
+    ERR_PRINTF("probe sched: interviews are running, try again later\n");
+    return 0;
+  }
+  start = clock_time();
+  rd_probe_resume();
+  while (left && clock_time() - start < SIM_TIMEOUT_MS) {
+    osDelay(5);
+    now  = clock_time();
+    left = 0;
+    rd_lock();
+    for (int i = 0; i < SIM_NODES; i++) {
+      rd_node_database_entry_t *n = &sim_nodes[i];
+
+      if (sim_pending[i] && (int32_t) (now - sim_due[i]) >= 0) {
+        sim_pending[i] = false;
+        if (++sim_steps_done[i] == sim_steps(i)) {
+          n->state = STATUS_DONE;
+        }
+        rd_node_probe_update(n);
+      }
+      left += n->state < STATUS_MDNS_PROBE;
+    }
+    rd_unlock();
+  }
+  now = clock_time() - start;
+  rd_probe_set_stubs(NULL);
+  if (left) {
+    ERR_PRINTF("probe sched: %d interviews did not end\n", left);
+    return 0;
+  }
+  return now;
+}
+
+/*
+ * Interview a stub network with one interview at a time, then with
+ * RD_PROBE_MAX_ACTIVE sharing the airtime budget. The slot, airtime,
+ * parking and resume logic of the RD runs as is; only the requests are
+ * stubs, answered after a per-node latency. Runs for about a minute in
+ * real time, interviews of real nodes wait until it ends.
+ */
+void sl_test_probe_sched_bench(void)
+{
+  rd_probe_stats_t before, after;
+  uint32_t one, many;
+
+  rd_probe_get_stats(&before);
+  one = sim_run(1);
+  rd_probe_get_stats(&after);
+  if (!one) {
+    return;
+  }
+  SL_LOG_PRINT("probe sched: %d nodes, %ld parked, airtime %d ms/s\n",
+               SIM_NODES, after.parked - before.parked, RD_PROBE_AIRTIME_MS);
+  SL_LOG_PRINT("probe sched: 1 slot %ld ms (%ld waits)\n",
+               one, after.deferred - before.deferred);
+
+  before = after;
+  many   = sim_run(RD_PROBE_MAX_ACTIVE);
+  rd_probe_get_stats(&after);
+  if (!many) {
+    return;
+  }
+  SL_LOG_PRINT("probe sched: %d slots %ld ms (%ld waits)\n",
+               RD_PROBE_MAX_ACTIVE, many, after.deferred - before.deferred);
+  if (many > one) {
+    ERR_PRINTF("probe sched: concurrent discovery is slower\n");
+  }
+}
@@ -0,0 +1,136 @@
+#include <stdlib.h>
+#include <string.h>
+#include "FreeRTOS.h"
+#include "sl_sleeptimer.h"
+#include "sl_common_log.h"
+#include "test/sl_test.h"
+#include "modules/sl_psram.h"
+
+/* The benchmark overwrites the OTA scratch region, never run it during OTA. */
+#define BENCH_PSRAM_SRC   PSRAM_OTA_SCRATCH_BASE_ADDRESS
+#define BENCH_PSRAM_DST   (PSRAM_OTA_SCRATCH_BASE_ADDRESS + BENCH_TOTAL)
+#define BENCH_BLOCK       4096
+#define BENCH_TOTAL       (64 * BENCH_BLOCK)
+#define BENCH_CHASE_WORDS (BENCH_BLOCK / sizeof(uint32_t))
+#define BENCH_CHASE_LOADS 100000
+
+typedef void (*bench_copy_fn_t)(uint8_t *dst, const uint8_t *src, uint32_t len);
+
+/* Previous implementation, kept as the baseline. */
+static void bench_copy_bytes(uint8_t *dst, const uint8_t *src, uint32_t len)
+{
+  volatile uint8_t *d = dst;
+  for (uint32_t i = 0; i < len; i++) {
+    d[i] = src[i];
+  }
+}
+
+static void bench_copy_auto(uint8_t *dst, const uint8_t *src, uint32_t len)
+{
+  sl_psram_copy((uint32_t) dst, (uint32_t) src, len);
+}
+
+static void bench_print(const char *name, uint64_t ticks, uint32_t block)
+{
+  uint32_t freq = sl_sleeptimer_get_timer_frequency();
+  // KB/s with integer math, printf float support is not linked in.
+  uint32_t kbps = ticks ? (uint32_t) (((uint64_t) BENCH_TOTAL * freq)
+                                      / (ticks * 1024)) : 0;
+  SL_LOG_PRINT("%-14s block %5ld: %4ld.%02ld MB/s\n",
+               name,
+               block,
+               kbps / 1024,
+               ((kbps % 1024) * 100) / 1024);
+}
+
+/* dst/src_step: 0 keeps the SRAM side fixed, block advances the PSRAM side. */
+static uint64_t bench_run(bench_copy_fn_t fn,
+                          uint8_t *dst,
+                          uint32_t dst_step,
+                          const uint8_t *src,
+                          uint32_t src_step,
+                          uint32_t block)
+{
+  uint64_t start = sl_sleeptimer_get_tick_count64();
+  for (uint32_t off = 0; off < BENCH_TOTAL; off += block) {
+    fn(dst + (dst_step ? off : 0), src + (src_step ? off : 0), block);
+  }
+  return sl_sleeptimer_get_tick_count64() - start;
+}
+
+/*
+ * Dependent random loads, the access pattern of a table lookup. Every word
+ * holds the index of the next one, so loads cannot overlap.
+ */
+static void bench_latency(const char *name, uint32_t *words)
+{
+  uint32_t freq = sl_sleeptimer_get_timer_frequency();
+  uint32_t idx  = 0;
+  uint64_t start, ticks;
+
+  // Odd stride through a power-of-two table visits every word once.
+  for (uint32_t i = 0; i < BENCH_CHASE_WORDS; i++) {
+    words[i] = (i + 97) % BENCH_CHASE_WORDS;
+  }
+  start = sl_sleeptimer_get_tick_count64();
+  for (uint32_t i = 0; i < BENCH_CHASE_LOADS; i++) {
+    idx = ((volatile uint32_t *) words)[idx];
+  }
+  ticks = sl_sleeptimer_get_tick_count64() - start;
+  SL_LOG_PRINT("%-14s random load: %ld ns (end %ld)\n",
+               name,
+               (uint32_t) ((ticks * 1000000000ULL) / freq / BENCH_CHASE_LOADS),
+               idx);
+}
+
+void sl_test_psram_bench(void)
+{
+  static const uint32_t blocks[] = { 40, 1024, BENCH_BLOCK };
+  uint8_t *psram_src = (uint8_t *) BENCH_PSRAM_SRC;
+  uint8_t *psram_dst = (uint8_t *) BENCH_PSRAM_DST;
+  uint8_t *sram      = malloc(BENCH_BLOCK);
+
+  if (sram == NULL) {
+    ERR_PRINTF("psram bench: no memory\n");
+    return;
+  }
+  for (uint32_t i = 0; i < BENCH_BLOCK; i++) {
+    sram[i] = (uint8_t) i;
+  }
+
+  SL_LOG_PRINT("PSRAM benchmark, %d bytes per test\n", BENCH_TOTAL);
+  for (uint32_t b = 0; b < sizeof(blocks) / sizeof(blocks[0]); b++) {
+    uint32_t blk = blocks[b];
+    bench_print("write byte",
+                bench_run(bench_copy_bytes, psram_src, blk, sram, 0, blk), blk);
+    bench_print("write word",
+                bench_run(sl_psram_copy_cpu, psram_src, blk, sram, 0, blk), blk);
+    bench_print("write auto",
+                bench_run(bench_copy_auto, psram_src, blk, sram, 0, blk), blk);
+    bench_print("read byte",
+                bench_run(bench_copy_bytes, sram, 0, psram_src, blk, blk), blk);
+    bench_print("read word",
+                bench_run(sl_psram_copy_cpu, sram, 0, psram_src, blk, blk), blk);
+    bench_print("read auto",
+                bench_run(bench_copy_auto, sram, 0, psram_src, blk, blk), blk);
+    bench_print("copy byte",
+                bench_run(bench_copy_bytes, psram_dst, blk, psram_src, blk, blk),
+                blk);
+    bench_print("copy word",
+                bench_run(sl_psram_copy_cpu, psram_dst, blk, psram_src, blk,
+                          blk),
+                blk);
+    bench_print("copy auto",
+                bench_run(bench_copy_auto, psram_dst, blk, psram_src, blk, blk),
+                blk);
+  }
+
+  if (memcmp(psram_dst, psram_src, BENCH_TOTAL) != 0) {
+    ERR_PRINTF("psram bench: copy verify FAILED\n");
+  }
+
+  // Cost of moving a table from the heap to the PSRAM arena.
+  bench_latency("sram", (uint32_t *) sram);
+  bench_latency("psram", (uint32_t *) psram_src);
+  free(sram);
+}
@@ -0,0 +1,137 @@
+#include <string.h>
+#include "FreeRTOS.h"
+#include "sl_sleeptimer.h"
+#include "sl_common_log.h"
+#include "test/sl_test.h"
+#include "ZW_classcmd.h"
+#include "apps/ip_translate/sl_zw_resource.h"
+
+#define BENCH_ROUNDS 200
+
+/* Classes asked for on the frame path: transport, security and bridging. */
+static const uint16_t bench_classes[] = {
+  COMMAND_CLASS_CRC_16_ENCAP,
+  COMMAND_CLASS_SECURITY,
+  COMMAND_CLASS_SECURITY_2,
+  COMMAND_CLASS_MULTI_CHANNEL_V2,
+  COMMAND_CLASS_ASSOCIATION_V2,
+  COMMAND_CLASS_MULTI_CHANNEL_ASSOCIATION_V2,
+  COMMAND_CLASS_MANUFACTURER_SPECIFIC,
+  COMMAND_CLASS_ZWAVEPLUS_INFO,
+};
+
+/* Previous implementation, kept as the baseline. */
+static int bench_class_parse(rd_ep_database_entry_t *ep, uint16_t cls)
+{
+  int bSecureClass = 0;
+  int bControlled  = 0;
+  u8_t result      = 0;
+  u16_t c;
+
+  if (!ep->endpoint_info) {
+    return 0;
+  }
+  for (nodeid_t i = 2; i < ep->endpoint_info_len; i++) {
+    c = ep->endpoint_info[i];
+    if ((c & 0xF0) == 0xF0 && (i < ep->endpoint_info_len - 1)) {
+      i++;
+      c = ((c & 0xFF) << 8) | ep->endpoint_info[i];
+    }
+    if (c == COMMAND_CLASS_SECURITY_SCHEME0_MARK) {
+      bSecureClass = 1;
+      bControlled  = 0;
+    } else if (c == COMMAND_CLASS_MARK) {
+      bControlled = 1;
+    } else if (c == cls) {
+      result |= 1 << ((bSecureClass << 1) | bControlled);
+    }
+  }
+  return result;
+}
+
+/*
+ * Both lookups must agree for every endpoint on every one-byte class, which
+ * covers each nibble of the flags table and the classes past its end, and
+ * on the extended classes listed in the NIFs. Returns the mismatches.
+ */
+static uint32_t bench_compare(uint32_t *checked)
+{
+  uint32_t bad = 0;
+  int a, b;
+
+  for (rd_ep_database_entry_t *ep = rd_ep_first(RD_ALL_NODES); ep;
+       ep = rd_ep_next(RD_ALL_NODES, ep)) {
+    for (uint16_t c = 0; c < 0x100; c++) {
+      a = bench_class_parse(ep, c);
+      b = rd_ep_class_support(ep, c);
+      (*checked)++;
+      if (a != b) {
+        ERR_PRINTF("cc bench: node %d ep %d class 0x%02x: walk %d flags %d\n",
+                   ep->nodeID, ep->endpoint_id, c, a, b);
+        bad++;
+      }
+    }
+    for (nodeid_t i = 2; ep->endpoint_info && i + 1 < ep->endpoint_info_len;
+         i++) {
+      uint16_t c = ep->endpoint_info[i];
+      if ((c & 0xF0) != 0xF0) {
+        continue;
+      }
+      c = (c << 8) | ep->endpoint_info[++i];
+      a = bench_class_parse(ep, c);
+      b = rd_ep_class_support(ep, c);
+      (*checked)++;
+      if (a != b) {
+        ERR_PRINTF("cc bench: node %d ep %d class 0x%04x: walk %d flags %d\n",
+                   ep->nodeID, ep->endpoint_id, c, a, b);
+        bad++;
+      }
+    }
+  }
+  return bad;
+}
+
+static uint64_t bench_run(int (*fn)(rd_ep_database_entry_t *, uint16_t),
+                          uint32_t *lookups,
+                          uint32_t *sum)
+{
+  uint64_t start = sl_sleeptimer_get_tick_count64();
+
+  for (uint32_t r = 0; r < BENCH_ROUNDS; r++) {
+    for (rd_ep_database_entry_t *ep = rd_ep_first(RD_ALL_NODES); ep;
+         ep = rd_ep_next(RD_ALL_NODES, ep)) {
+      for (uint32_t c = 0; c < sizeof(bench_classes) / sizeof(bench_classes[0]);
+           c++) {
+        *sum += fn(ep, bench_classes[c]);
+        (*lookups)++;
+      }
+    }
+  }
+  return sl_sleeptimer_get_tick_count64() - start;
+}
+
+/*
+ * Cost of one command class lookup, NIF walk against the per-endpoint
+ * flags, over the endpoints currently in the resource directory.
+ */
+void sl_test_cc_class_bench(void)
+{
+  uint32_t freq    = sl_sleeptimer_get_timer_frequency();
+  uint32_t n_parse = 0, n_index = 0;
+  uint32_t s_parse = 0, s_index = 0;
+  uint32_t checked = 0, bad;
+  uint64_t t_parse, t_index;
+
+  t_parse = bench_run(bench_class_parse, &n_parse, &s_parse);
+  t_index = bench_run(rd_ep_class_support, &n_index, &s_index);
+  if (n_parse == 0) {
+    SL_LOG_PRINT("cc bench: no endpoints\n");
+    return;
+  }
+  bad = bench_compare(&checked);
+  SL_LOG_PRINT("cc lookup: %ld of %ld results differ\n", bad, checked);
+  SL_LOG_PRINT("cc lookup, %ld per run: walk %ld ns, flags %ld ns\n",
+               n_parse,
+               (uint32_t) ((t_parse * 1000000000ULL) / freq / n_parse),
+               (uint32_t) ((t_index * 1000000000ULL) / freq / n_index));
+}
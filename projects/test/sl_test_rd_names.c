@@ -0,0 +1,135 @@
+#include <string.h>
+#include "sl_common_log.h"
+#include "test/sl_test.h"
+#include "apps/ip_translate/sl_zw_resource.h"
+#include "apps/Z-Wave/CC/RD_name_index.h"
+#include "apps/Z-Wave/CC/zw_network_info.h"
+
+#define BENCH_NAME(s) (s), (u8_t) (sizeof(s) - 1)
+
+static uint32_t bench_failed;
+
+static void bench_check(const char *name, bool ok)
+{
+  if (!ok) {
+    ERR_PRINTF("rd names bench: %s\n", name);
+    bench_failed++;
+  }
+}
+
+static void bench_set_ep(rd_ep_database_entry_t *ep,
+                         char *name, u8_t name_len,
+                         char *location, u8_t loc_len)
+{
+  ep->endpoint_name     = name;
+  ep->endpoint_name_len = name_len;
+  ep->endpoint_location = location;
+  ep->endpoint_loc_len  = loc_len;
+  rd_name_index_set_ep(ep);
+}
+
+/* Rebuild the index of the nodes in the RD, as after rd_node_entry_import(). */
+static void bench_reindex(void)
+{
+  rd_name_index_clear();
+  for (nodeid_t i = 1; i <= ZW_MAX_NODES; i++) {
+    if (rd_node_exists(i)) {
+      rd_name_index_add_node(rd_node_get_raw(i));
+    }
+  }
+}
+
+/*
+ * Insert, rename and remove names in the index, then fill its entry pool
+ * and check that lookups still find names through the scan fallback.
+ *
+ * The names are set on the entry of the gateway in RAM only and put back
+ * afterwards, nothing is written to NVM. The index is then rebuilt from the
+ * RD, so never run this while names are being changed.
+ */
+void sl_test_rd_names_bench(void)
+{
+  static char node_name[] = "Bench-Node";
+  static char ep_name[]   = "Bench-Lamp";
+  static char ep_loc[]    = "Kitchen";
+  static char ep_loc2[]   = "Hall";
+  rd_node_database_entry_t *n = rd_node_get_raw(MyNodeID);
+  rd_ep_database_entry_t *ep  = n ? list_head(n->endpoints) : NULL;
+  rd_ep_database_entry_t saved_ep;
+  char *saved_name;
+  u8_t saved_name_len;
+
+  if (!ep) {
+    SL_LOG_PRINT("rd names bench: no gateway entry\n");
+    return;
+  }
+  bench_failed   = 0;
+  saved_name     = n->nodename;
+  saved_name_len = n->nodeNameLen;
+  saved_ep       = *ep;
+
+  /* Insert */
+  n->nodename    = node_name;
+  n->nodeNameLen = sizeof(node_name) - 1;
+  rd_name_index_remove_node(n->nodeid);
+  rd_name_index_add_node(n);
+  bench_set_ep(ep, ep_name, sizeof(ep_name) - 1, ep_loc, sizeof(ep_loc) - 1);
+  bench_check("node not found",
+              rd_name_index_find_node(BENCH_NAME("bench-NODE")) == n);
+  bench_check("node found by prefix",
+              rd_name_index_find_node(BENCH_NAME("Bench-Nod")) == NULL);
+  bench_check("endpoint not found",
+              rd_name_index_find_ep(BENCH_NAME("bench-lamp"),
+                                    BENCH_NAME("KITCHEN")) == ep);
+  bench_check("service not found",
+              rd_name_index_find_service(BENCH_NAME("Bench-Lamp.Kitchen"))
+              == ep);
+  bench_check("endpoint found without its location",
+              rd_name_index_find_service(BENCH_NAME("Bench-Lamp")) == NULL);
+
+  /* Rename */
+  bench_set_ep(ep, ep_name, sizeof(ep_name) - 1, ep_loc2, sizeof(ep_loc2) - 1);
+  bench_check("old location still found",
+              rd_name_index_find_service(BENCH_NAME("Bench-Lamp.Kitchen"))
+              == NULL);
+  bench_check("new location not found",
+              rd_name_index_find_service(BENCH_NAME("bench-lamp.hall")) == ep);
+  bench_set_ep(ep, ep_name, sizeof(ep_name) - 1, NULL, 0);
+  bench_check("endpoint without location not found",
+              rd_name_index_find_service(BENCH_NAME("Bench-Lamp")) == ep);
+
+  /* Remove */
+  rd_name_index_remove_ep(ep);
+  bench_check("removed endpoint found",
+              rd_name_index_find_service(BENCH_NAME("Bench-Lamp")) == NULL);
+  bench_check("node removed with its endpoint",
+              rd_name_index_find_node(BENCH_NAME("Bench-Node")) == n);
+  rd_name_index_remove_node(n->nodeid);
+  bench_check("removed node found",
+              rd_name_index_find_node(BENCH_NAME("Bench-Node")) == NULL);
+
+  /* Overflow: the pool is filled with copies, then they are dropped and
+     the names are only found by the scans. */
+  rd_name_index_add_node(n);
+  for (int i = 0; i < RD_NAME_INDEX_SIZE; i++) {
+    rd_name_index_add_ep(ep);
+  }
+  rd_name_index_remove_node(n->nodeid);
+  bench_check("node not found by scan",
+              rd_name_index_find_node(BENCH_NAME("BENCH-NODE")) == n);
+  bench_check("endpoint not found by scan",
+              rd_name_index_find_service(BENCH_NAME("bench-lamp")) == ep);
+  rd_name_index_clear();
+  bench_check("scan after clear",
+              rd_name_index_find_node(BENCH_NAME("Bench-Node")) == NULL);
+
+  n->nodename            = saved_name;
+  n->nodeNameLen         = saved_name_len;
+  ep->endpoint_name      = saved_ep.endpoint_name;
+  ep->endpoint_name_len  = saved_ep.endpoint_name_len;
+  ep->endpoint_location  = saved_ep.endpoint_location;
+  ep->endpoint_loc_len   = saved_ep.endpoint_loc_len;
+  bench_reindex();
+
+  SL_LOG_PRINT("rd names: %ld failed\n", bench_failed);
+}
@@ -0,0 +1,348 @@
+#include <stdlib.h>
+#include <string.h>
+#include "sl_sleeptimer.h"
+#include "sl_common_log.h"
+#include "test/sl_test.h"
+#include "modules/sl_rd_data_store.h"
+#include "modules/sl_rd_record.h"
+#include "apps/Z-Wave/CC/RD_profile.h"
+#include "apps/ip_translate/sl_zw_resource.h"
+
+#define BENCH_UPDATES 50
+
+/*
+ * A burst of updates to one node must end up as one write of its record.
+ * The record is rewritten with its current content, so running this leaves
+ * the stored RD as it was.
+ */
+void sl_test_rd_store_bench(void)
+{
+  rd_ep_database_entry_t *ep = rd_ep_first(RD_ALL_NODES);
+  rd_data_store_stats_t before, after;
+  uint64_t start, ticks;
+
+  if (!ep) {
+    SL_LOG_PRINT("rd store bench: no endpoints\n");
+    return;
+  }
+  rd_data_store_flush();
+  rd_data_store_get_stats(&before);
+
+  for (int i = 0; i < BENCH_UPDATES; i++) {
+    rd_data_store_mark_dirty(ep->node, RD_DIRTY_NODE);
+    rd_data_store_mark_ep_dirty(ep, RD_DIRTY_EP | RD_DIRTY_EP_NAME);
+    rd_data_store_poll();
+  }
+  rd_data_store_get_stats(&after);
+  if (after.writes != before.writes) {
+    ERR_PRINTF("rd store bench: %ld writes before the quiet time\n",
+               after.writes - before.writes);
+  }
+
+  start = sl_sleeptimer_get_tick_count64();
+  rd_data_store_flush();
+  ticks = sl_sleeptimer_get_tick_count64() - start;
+  rd_data_store_get_stats(&after);
+
+  if (after.writes - before.writes != 1) {
+    ERR_PRINTF("rd store bench: %ld writes, expected 1\n",
+               after.writes - before.writes);
+  }
+  SL_LOG_PRINT("rd store: %d updates, %ld writes, flush %ld us\n",
+               2 * BENCH_UPDATES,
+               after.writes - before.writes,
+               (uint32_t) ((ticks * 1000000ULL)
+                           / sl_sleeptimer_get_timer_frequency()));
+}
+
+static int bench_bytes_equal(const void *a, const void *b, uint8_t len)
+{
+  return len == 0 || (a && b && memcmp(a, b, len) == 0);
+}
+
+static int bench_node_equal(const rd_node_database_entry_t *a,
+                            const rd_node_database_entry_t *b)
+{
+  const rd_ep_database_entry_t *x, *y;
+
+  if (a->wakeUp_interval != b->wakeUp_interval
+      || a->lastAwake != b->lastAwake || a->lastUpdate != b->lastUpdate
+      || a->nodeid != b->nodeid || a->security_flags != b->security_flags
+      || a->mode != b->mode || a->state != b->state
+      || a->manufacturerID != b->manufacturerID
+      || a->productType != b->productType || a->productID != b->productID
+      || a->nodeType != b->nodeType || a->nEndpoints != b->nEndpoints
+      || a->nAggEndpoints != b->nAggEndpoints
+      || a->node_version_cap_and_zwave_sw != b->node_version_cap_and_zwave_sw
+      || a->probe_flags != b->probe_flags
+      || a->node_properties_flags != b->node_properties_flags
+      || a->node_is_zws_probed != b->node_is_zws_probed
+      || a->nodeNameLen != b->nodeNameLen || a->dskLen != b->dskLen
+      || a->node_cc_versions_len != b->node_cc_versions_len
+      || !bench_bytes_equal(a->nodename, b->nodename, a->nodeNameLen)
+      || !bench_bytes_equal(a->dsk, b->dsk, a->dskLen)
+      || !bench_bytes_equal(a->node_cc_versions, b->node_cc_versions,
+                            a->node_cc_versions_len)) {
+    return 0;
+  }
+  for (x = list_head(a->endpoints), y = list_head(b->endpoints); x && y;
+       x = list_item_next((void *) x), y = list_item_next((void *) y)) {
+    if (x->endpoint_id != y->endpoint_id || x->state != y->state
+        || x->installer_iconID != y->installer_iconID
+        || x->user_iconID != y->user_iconID
+        || x->cap_digest != y->cap_digest
+        || x->endpoint_info_len != y->endpoint_info_len
+        || x->endpoint_aggr_len != y->endpoint_aggr_len
+        || x->endpoint_name_len != y->endpoint_name_len
+        || x->endpoint_loc_len != y->endpoint_loc_len
+        || !bench_bytes_equal(x->endpoint_info, y->endpoint_info,
+                              x->endpoint_info_len)
+        || !bench_bytes_equal(x->endpoint_agg, y->endpoint_agg,
+                              x->endpoint_aggr_len)
+        || !bench_bytes_equal(x->endpoint_name, y->endpoint_name,
+                              x->endpoint_name_len)
+        || !bench_bytes_equal(x->endpoint_location, y->endpoint_location,
+                              x->endpoint_loc_len)) {
+      return 0;
+    }
+  }
+  return x == NULL && y == NULL;
+}
+
+/* Bytes and objects the node took before it was stored as one record. */
+static uint32_t bench_legacy_size(const rd_node_database_entry_t *n,
+                                  uint32_t *objects)
+{
+  const rd_ep_database_entry_t *e;
+  uint32_t size = sizeof(rd_node_database_entry_t) + n->nodeNameLen
+                  + n->dskLen + n->node_cc_versions_len;
+
+  *objects += 4;
+  for (e = list_head(n->endpoints); e; e = list_item_next((void *) e)) {
+    size += RD_EP_STORE_SIZE + e->endpoint_info_len + e->endpoint_aggr_len
+            + e->endpoint_name_len + e->endpoint_loc_len;
+    *objects += 5;
+  }
+  return size;
+}
+
+/*
+ * A record of n with a name TLV appended twice, to the node or to its last
+ * endpoint, must be rejected.
+ */
+static bool bench_duplicate_rejected(const rd_node_database_entry_t *n,
+                                     uint8_t type)
+{
+  uint32_t size = rd_record_size(n) + 2 * 3; /* type, length, one byte */
+  rd_node_database_entry_t *copy;
+  uint8_t *buf = malloc(size);
+  uint32_t len;
+
+  if (!buf) {
+    return true;
+  }
+  len = rd_record_encode(n, buf, size);
+  for (int i = 0; len && i < 2; i++) {
+    buf[len++] = type;
+    buf[len++] = 1;
+    buf[len++] = 'x';
+  }
+  copy = len ? rd_record_decode(buf, len) : NULL;
+  free(buf);
+  if (copy) {
+    rd_data_store_mem_release(copy);
+    return false;
+  }
+  return true;
+}
+
+/*
+ * Every node in the RD must come back unchanged from its record. Runs in
+ * RAM only; also compares the footprint with the former per-object layout.
+ */
+void sl_test_rd_record_bench(void)
+{
+  uint32_t nodes = 0, failed = 0, rec_bytes = 0, old_bytes = 0, old_objects = 0;
+  uint64_t ticks = 0, start;
+  rd_node_database_entry_t *n, *copy;
+  uint32_t size, len;
+  uint8_t *buf;
+
+  for (nodeid_t i = 1; i <= ZW_MAX_NODES; i++) {
+    n = rd_node_get_raw(i);
+    if (!n) {
+      continue;
+    }
+    size = rd_record_size(n);
+    buf  = malloc(size);
+    if (!buf) {
+      ERR_PRINTF("rd record bench: out of memory\n");
+      return;
+    }
+    len   = rd_record_encode(n, buf, size);
+    start = sl_sleeptimer_get_tick_count64();
+    copy  = len ? rd_record_decode(buf, len) : NULL;
+    ticks += sl_sleeptimer_get_tick_count64() - start;
+    free(buf);
+
+    nodes++;
+    rec_bytes += len;
+    old_bytes += bench_legacy_size(n, &old_objects);
+    if (!copy || len != size || !bench_node_equal(n, copy)) {
+      ERR_PRINTF("rd record bench: node %d differs after round trip\n", i);
+      failed++;
+    }
+    if (!bench_duplicate_rejected(n, RD_TLV_NODE_NAME)
+        || !bench_duplicate_rejected(n, RD_TLV_EP_NAME)) {
+      ERR_PRINTF("rd record bench: node %d decoded with a repeated TLV\n", i);
+      failed++;
+    }
+    if (copy) {
+      rd_data_store_mem_release(copy);
+    }
+  }
+  if (nodes == 0) {
+    SL_LOG_PRINT("rd record bench: no nodes\n");
+    return;
+  }
+  SL_LOG_PRINT("rd record: %ld nodes, %ld failed, %ld bytes in %ld objects "
+               "-> %ld bytes in %ld records, decode %ld us per node\n",
+               nodes, failed, old_bytes, old_objects, rec_bytes, nodes,
+               (uint32_t) ((ticks * 1000000ULL)
+                           / sl_sleeptimer_get_timer_frequency() / nodes));
+}
+
+/*
+ * Unload every entry the cache may drop, then load each node once. Shows
+ * what a cold lookup costs and how much the cache keeps resident.
+ */
+void sl_test_rd_cache_bench(void)
+{
+  rd_node_cache_stats_t before, after;
+  uint64_t ticks = 0, start;
+  uint32_t nodes = 0;
+
+  rd_node_cache_trim(0);
+  rd_node_cache_get_stats(&before);
+  for (nodeid_t i = 1; i <= ZW_MAX_NODES; i++) {
+    if (!rd_node_exists(i) || rd_node_get_loaded(i)) {
+      continue;
+    }
+    start = sl_sleeptimer_get_tick_count64();
+    if (!rd_node_get_raw(i)) {
+      ERR_PRINTF("rd cache bench: node %d could not be loaded\n", i);
+    }
+    ticks += sl_sleeptimer_get_tick_count64() - start;
+    nodes++;
+  }
+  rd_node_cache_trim(RD_NODE_CACHE_SIZE);
+  rd_node_cache_get_stats(&after);
+
+  if (after.loads - before.loads != nodes) {
+    ERR_PRINTF("rd cache bench: %ld loads, expected %ld\n",
+               after.loads - before.loads, nodes);
+  }
+  SL_LOG_PRINT("rd cache: %d nodes, %d kept before, %d after, "
+               "load %ld us per node\n",
+               after.nodes, before.loaded, after.loaded,
+               nodes ? (uint32_t) ((ticks * 1000000ULL)
+                                   / sl_sleeptimer_get_timer_frequency()
+                                   / nodes) : 0);
+}
+
+/*
+ * Learn a device profile from the node with the most endpoints, fill in a
+ * copy of it without endpoints from the profile and compare. The profile is
+ * then invalidated by a firmware change, so none is left behind.
+ */
+void sl_test_rd_profile_bench(void)
+{
+  rd_node_database_entry_t *n = NULL, *copy, *e;
+  rd_ep_database_entry_t *ep0, *ep;
+  rd_profile_stats_t before, after;
+  rd_profile_id_t id;
+  uint64_t store_ticks, apply_ticks, start;
+  bool ok;
+
+  for (nodeid_t i = 1; i <= ZW_MAX_NODES; i++) {
+    e = rd_node_get_raw(i);
+    if (e && list_head(e->endpoints) && (!n || e->nEndpoints > n->nEndpoints)) {
+      n = e;
+    }
+  }
+  if (!n) {
+    SL_LOG_PRINT("rd profile bench: no nodes\n");
+    return;
+  }
+  rd_data_store_flush_node(n);
+  copy = rd_data_store_read(n->nodeid);
+  if (!copy) {
+    ERR_PRINTF("rd profile bench: node %d could not be read\n", n->nodeid);
+    return;
+  }
+  /* Leave only the root, as after the root probe of a new node. */
+  ep0 = list_head(copy->endpoints);
+  while (ep0->list) {
+    ep        = ep0->list;
+    ep0->list = ep->list;
+    rd_store_mem_free_ep(ep);
+  }
+  copy->nEndpoints = 1;
+
+  id.manufacturer = n->manufacturerID;
+  id.product_type = n->productType;
+  id.product_id   = n->productID;
+  id.fw_version   = 0xFFFF;
+  rd_profile_get_stats(&before);
+
+  start = sl_sleeptimer_get_tick_count64();
+  rd_profile_store(n, &id);
+  store_ticks = sl_sleeptimer_get_tick_count64() - start;
+  start       = sl_sleeptimer_get_tick_count64();
+  ok          = rd_profile_apply(copy, &id);
+  apply_ticks = sl_sleeptimer_get_tick_count64() - start;
+
+  if (!ok || copy->nEndpoints != n->nEndpoints) {
+    ERR_PRINTF("rd profile bench: node %d has %d endpoints from profile, "
+               "expected %d\n", n->nodeid, ok ? copy->nEndpoints : 0,
+               n->nEndpoints);
+  }
+  for (ep = list_head(copy->endpoints); ok && ep; ep = list_item_next(ep)) {
+    rd_ep_database_entry_t *x;
+    for (x = list_head(n->endpoints); x && x->endpoint_id != ep->endpoint_id;
+         x = list_item_next(x)) {
+    }
+    if (!x || x->endpoint_info_len != ep->endpoint_info_len
+        || !bench_bytes_equal(x->endpoint_info, ep->endpoint_info,
+                              x->endpoint_info_len)
+        || x->installer_iconID != ep->installer_iconID) {
+      ERR_PRINTF("rd profile bench: endpoint %d differs\n", ep->endpoint_id);
+    }
+  }
+
+  /* A root node info that is a prefix of the one of the profile is another
+     model. */
+  ep0 = list_head(copy->endpoints);
+  if (ep0->endpoint_info_len > 0) {
+    ep0->endpoint_info_len--;
+    if (rd_profile_apply(copy, &id)) {
+      ERR_PRINTF("rd profile bench: profile used for a shorter root\n");
+    }
+    ep0->endpoint_info_len++;
+  }
+
+  id.fw_version = 0xFFFE;
+  if (rd_profile_apply(copy, &id)) {
+    ERR_PRINTF("rd profile bench: profile used for other firmware\n");
+  }
+  rd_data_store_mem_release(copy);
+  rd_profile_get_stats(&after);
+
+  SL_LOG_PRINT("rd profile: node %d, %d endpoints, %ld invalidated, "
+               "store %ld us, apply %ld us\n",
+               n->nodeid, n->nEndpoints, after.invalidated - before.invalidated,
+               (uint32_t) ((store_ticks * 1000000ULL)
+                           / sl_sleeptimer_get_timer_frequency()),
+               (uint32_t) ((apply_ticks * 1000000ULL)
+                           / sl_sleeptimer_get_timer_frequency()));
+}
@@ -0,0 +1,148 @@
+#include <string.h>
+#include "sl_common_log.h"
+#include "test/sl_test.h"
+#include "ZW_classcmd.h"
+#include "modules/sl_rd_data_store.h"
+#include "apps/Z-Wave/CC/RD_internal.h"
+
+/* The classes of the shared version table, in its order. */
+static const uint16_t bench_versioned[RD_CC_VERSION_COUNT] = {
+  COMMAND_CLASS_ZWAVEPLUS_INFO,
+  COMMAND_CLASS_MULTI_CHANNEL_V4,
+  COMMAND_CLASS_MANUFACTURER_SPECIFIC,
+  COMMAND_CLASS_WAKE_UP,
+  COMMAND_CLASS_ASSOCIATION,
+  COMMAND_CLASS_VERSION,
+  COMMAND_CLASS_MULTI_CHANNEL_ASSOCIATION_V3,
+};
+
+/* Classes next to and between the table entries, and past both ends. */
+static const uint16_t bench_unversioned[] = {
+  0x0000,
+  COMMAND_CLASS_ZWAVEPLUS_INFO - 1,
+  COMMAND_CLASS_MULTI_CHANNEL_V4 + 1,
+  COMMAND_CLASS_MULTI_CHANNEL_ASSOCIATION_V3 - 1,
+  COMMAND_CLASS_MULTI_CHANNEL_ASSOCIATION_V3 + 1,
+  0x00FF,
+  0xF100,
+  0xFFFF,
+};
+
+static uint32_t bench_failed;
+
+static void bench_check(const char *name, uint16_t cc, bool ok)
+{
+  if (!ok) {
+    ERR_PRINTF("cc version bench: %s, class 0x%04x\n", name, cc);
+    bench_failed++;
+  }
+}
+
+/* Lookups of every table class, the first and last included, and misses. */
+static void bench_lookup(void)
+{
+  rd_node_database_entry_t n;
+  uint8_t v[RD_CC_VERSION_COUNT];
+  uint32_t i;
+
+  memset(&n, 0, sizeof(n));
+  n.node_cc_versions     = v;
+  n.node_cc_versions_len = RD_CC_VERSION_COUNT;
+  rd_node_cc_versions_set_default(&n);
+
+  for (i = 0; i < RD_CC_VERSION_COUNT; i++) {
+    rd_node_cc_version_set(&n, bench_versioned[i], (uint8_t) (i + 1));
+  }
+  for (i = 0; i < RD_CC_VERSION_COUNT; i++) {
+    bench_check("version not found", bench_versioned[i],
+                rd_node_cc_version_get(&n, bench_versioned[i]) == i + 1);
+    bench_check("version stored out of order", bench_versioned[i],
+                v[i] == i + 1);
+  }
+  for (i = 0; i < sizeof(bench_unversioned) / sizeof(bench_unversioned[0]);
+       i++) {
+    rd_node_cc_version_set(&n, bench_unversioned[i], 0x55);
+    bench_check("missing class found", bench_unversioned[i],
+                rd_node_cc_version_get(&n, bench_unversioned[i]) == 0);
+  }
+  for (i = 0; i < RD_CC_VERSION_COUNT; i++) {
+    bench_check("missing class overwrote a version", bench_versioned[i],
+                v[i] == i + 1);
+  }
+
+  /* A table shorter than the class list only holds its first classes. */
+  n.node_cc_versions_len = 2;
+  bench_check("version past the table", bench_versioned[2],
+              rd_node_cc_version_get(&n, bench_versioned[2]) == 0);
+  bench_check("version in short table", bench_versioned[1],
+              rd_node_cc_version_get(&n, bench_versioned[1]) == 2);
+}
+
+/*
+ * A node stored in the pair layout, its classes in another order, with a
+ * class not in the table and the end marker, must come out as the byte
+ * table with the versions it had and the defaults for the others.
+ */
+static void bench_upgrade(void)
+{
+  static const cc_version_pair_t pairs[] = {
+    { COMMAND_CLASS_VERSION, 3 },
+    { COMMAND_CLASS_ZWAVEPLUS_INFO, 2 },
+    { COMMAND_CLASS_BASIC, 9 },
+    { COMMAND_CLASS_MULTI_CHANNEL_ASSOCIATION_V3, 4 },
+    { 0xFFFF, 0 },
+  };
+  uint8_t def[RD_CC_VERSION_COUNT];
+  rd_node_database_entry_t n;
+  uint8_t expect;
+
+  memset(&n, 0, sizeof(n));
+  n.node_cc_versions = rd_data_mem_alloc(sizeof(pairs));
+  if (!n.node_cc_versions) {
+    ERR_PRINTF("cc version bench: out of memory\n");
+    bench_failed++;
+    return;
+  }
+  memcpy(n.node_cc_versions, pairs, sizeof(pairs));
+  n.node_cc_versions_len = sizeof(pairs);
+  rd_mem_cc_versions_set_default(RD_CC_VERSION_COUNT, def);
+
+  rd_node_cc_versions_upgrade(&n);
+  bench_check("pairs not upgraded", 0,
+              n.node_cc_versions_len == RD_CC_VERSION_COUNT);
+  for (uint32_t i = 0;
+       n.node_cc_versions_len == RD_CC_VERSION_COUNT
+       && i < RD_CC_VERSION_COUNT;
+       i++) {
+    expect = def[i];
+    for (uint32_t p = 0; p < sizeof(pairs) / sizeof(pairs[0]); p++) {
+      if (pairs[p].command_class == bench_versioned[i]) {
+        expect = pairs[p].version;
+      }
+    }
+    bench_check("upgraded version wrong", bench_versioned[i],
+                n.node_cc_versions[i] == expect);
+  }
+  bench_check("class outside the table kept", COMMAND_CLASS_BASIC,
+              rd_node_cc_version_get(&n, COMMAND_CLASS_BASIC) == 0);
+
+  /* The byte table is left as it is. */
+  n.node_cc_versions[0] = 7;
+  rd_node_cc_versions_upgrade(&n);
+  bench_check("byte table upgraded again", bench_versioned[0],
+              n.node_cc_versions_len == RD_CC_VERSION_COUNT
+              && n.node_cc_versions[0] == 7);
+  rd_data_mem_free(n.node_cc_versions);
+}
+
+/*
+ * Checks of the per-node CC version table on scratch nodes: lookups of the
+ * shared class list and the conversion of the pair layout of older stores.
+ */
+void sl_test_rd_versions_bench(void)
+{
+  bench_failed = 0;
+  bench_lookup();
+  bench_upgrade();
+  SL_LOG_PRINT("cc versions: %ld failed\n", bench_failed);
+}
@@ -0,0 +1,139 @@
+#include <string.h>
+#include "sl_common_log.h"
+#include "test/sl_test.h"
+#include "ZW_classcmd.h"
+#include "apps/transport/sl_ts_common.h"
+#include "apps/ip_bridge/sl_shared_get.h"
+
+/* The bench clears the pending Gets, never run it with client traffic. */
+#define BENCH_NODE    5
+#define BENCH_EP      1
+#define BENCH_VIRTUAL 200
+
+static const uint8_t bench_get[]     = { COMMAND_CLASS_SWITCH_BINARY, SWITCH_BINARY_GET };
+static const uint8_t bench_report[]  = { COMMAND_CLASS_SWITCH_BINARY, SWITCH_BINARY_REPORT, 0xFF };
+static const uint8_t bench_sensor[]  = { COMMAND_CLASS_SENSOR_MULTILEVEL, SENSOR_MULTILEVEL_GET, 0x01 };
+static const uint8_t bench_cfg_get[] = { COMMAND_CLASS_CONFIGURATION, CONFIGURATION_GET, 0x03 };
+static temp_association_t bench_clients[3];
+static uint32_t bench_failed;
+
+/* Session references only need to be distinct and non NULL. */
+#define BENCH_SESSION(i) ((void *) (uintptr_t) (0x100 + (i)))
+
+static void bench_check(const char *name, bool ok)
+{
+  if (!ok) {
+    ERR_PRINTF("shared get bench: %s\n", name);
+    bench_failed++;
+  }
+}
+
+static sl_shared_get_result_t bench_begin(int client,
+                                          uint8_t endpoint,
+                                          const uint8_t *get,
+                                          uint16_t len)
+{
+  return sl_shared_get_begin(BENCH_NODE, endpoint, NO_SCHEME,
+                             BENCH_VIRTUAL + client, &bench_clients[client],
+                             get, len, BENCH_SESSION(client));
+}
+
+/* Report from the node to virtual node virtual_id. */
+static int bench_report_to(nodeid_t virtual_id, temp_association_t *out)
+{
+  ts_param_t p;
+
+  ts_set_std(&p, virtual_id);
+  p.snode     = BENCH_NODE;
+  p.sendpoint = BENCH_EP;
+  return sl_shared_get_report(&p, bench_report, sizeof(bench_report),
+                              out, SL_SHARED_GET_FOLLOWERS);
+}
+
+/*
+ * Drive the shared Get table the way the classic Z/IP node path does: a
+ * Get from client 0 is sent, identical Gets from clients 1 and 2 follow it
+ * while it is on air and once it was delivered, and the report addressed
+ * to client 0 is copied to both. Failed sends, other endpoints and Gets
+ * with parameters are never shared.
+ */
+void sl_test_shared_get_bench(void)
+{
+  temp_association_t out[SL_SHARED_GET_FOLLOWERS];
+  void *followers[SL_SHARED_GET_FOLLOWERS];
+  sl_shared_get_stats_t st;
+  int n;
+
+  bench_failed = 0;
+  sl_shared_get_init();
+  memset(bench_clients, 0, sizeof(bench_clients));
+  for (int i = 0; i < 3; i++) {
+    bench_clients[i].virtual_id         = BENCH_VIRTUAL + i;
+    bench_clients[i].resource_port      = (uint16_t) (4123 + i);
+    bench_clients[i].resource_endpoint  = (uint8_t) i;
+    bench_clients[i].resource_ip.u8[15] = (uint8_t) (10 + i);
+  }
+
+  bench_check("first Get not sent",
+              bench_begin(0, BENCH_EP, bench_get, sizeof(bench_get))
+              == SL_SHARED_GET_SEND);
+  bench_check("Get on air not followed",
+              bench_begin(1, BENCH_EP, bench_get, sizeof(bench_get))
+              == SL_SHARED_GET_FOLLOW);
+  bench_check("other endpoint shared",
+              sl_shared_get_begin(BENCH_NODE, BENCH_EP + 1, NO_SCHEME,
+                                  BENCH_VIRTUAL + 2, &bench_clients[2],
+                                  bench_get, sizeof(bench_get),
+                                  BENCH_SESSION(9))
+              == SL_SHARED_GET_SEND);
+  sl_shared_get_sent(BENCH_SESSION(9), false, followers,
+                     SL_SHARED_GET_FOLLOWERS);
+  bench_check("Get with parameters shared",
+              bench_begin(2, BENCH_EP, bench_cfg_get, sizeof(bench_cfg_get))
+              == SL_SHARED_GET_SEND);
+
+  n = sl_shared_get_sent(BENCH_SESSION(0), true, followers,
+                         SL_SHARED_GET_FOLLOWERS);
+  bench_check("follower not given the result",
+              n == 1 && followers[0] == BENCH_SESSION(1));
+  bench_check("delivered Get not followed",
+              bench_begin(2, BENCH_EP, bench_get, sizeof(bench_get))
+              == SL_SHARED_GET_SENT);
+
+  bench_check("report to another client copied",
+              bench_report_to(BENCH_VIRTUAL + 1, out) == 0);
+  n = bench_report_to(BENCH_VIRTUAL, out);
+  bench_check("report not copied to both followers",
+              n == 2 && out[0].resource_port == 4124
+              && out[0].resource_endpoint == 1
+              && out[1].resource_port == 4125
+              && out[1].resource_endpoint == 2);
+  bench_check("answered Get still shared",
+              bench_begin(1, BENCH_EP, bench_get, sizeof(bench_get))
+              == SL_SHARED_GET_SEND);
+
+  /* A failed send takes its followers with it and is not shared again. */
+  bench_check("Get after failure followed",
+              bench_begin(2, BENCH_EP, bench_get, sizeof(bench_get))
+              == SL_SHARED_GET_FOLLOW);
+  n = sl_shared_get_sent(BENCH_SESSION(1), false, followers,
+                         SL_SHARED_GET_FOLLOWERS);
+  bench_check("failed send lost its follower",
+              n == 1 && followers[0] == BENCH_SESSION(2));
+  bench_check("failed Get still shared",
+              bench_begin(0, BENCH_EP, bench_get, sizeof(bench_get))
+              == SL_SHARED_GET_SEND);
+
+  /* A Get with parameters of the same class closes the pending one. */
+  bench_check("sensor Get not sent",
+              bench_begin(1, BENCH_EP, bench_sensor, 2) == SL_SHARED_GET_SEND);
+  bench_begin(2, BENCH_EP, bench_sensor, sizeof(bench_sensor));
+  bench_check("closed Get followed",
+              bench_begin(0, BENCH_EP, bench_sensor, 2) == SL_SHARED_GET_SEND);
+
+  sl_shared_get_get_stats(&st);
+  SL_LOG_PRINT("shared get: %ld sent, %ld shared, %ld report copies\n",
+               st.sent, st.shared, st.reports);
+  sl_shared_get_init();
+  SL_LOG_PRINT("shared get: %ld failed\n", bench_failed);
+}
@@ -0,0 +1,304 @@
+"""
+Build compressed (LZ4 block) and delta OTA images for the bridge.
+
+The bridge decodes these streams chunk by chunk straight into the PSRAM
+staging slot (apps/sl_ota/sl_ota_decode.c). Every encode is decoded again
+with the reference decoders below and compared byte for byte before the
+image is written out.
+
+Delta stream format, a sequence of operations:
+    0x00 <varint offset> <varint length>   copy from the base image
+    0x01 <varint length> <bytes...>        insert literal bytes
+Varints are unsigned LEB128.
+
+Header tail appended after the MD5 of the RPS header chunk:
+    encoding (1) [base_size (4, LE) base_md5 (16)]   (base only for delta)
+
+Usage:
+    python3 sl_ota_pack.py lz4 <image> <out>
+    python3 sl_ota_pack.py delta <base> <image> <out>
+    python3 sl_ota_pack.py selftest
+"""
+import hashlib
+import os
+import random
+import struct
+import sys
+
+ENCODING_RAW = 0
+ENCODING_LZ4 = 1
+ENCODING_DELTA = 2
+
+DELTA_OP_COPY = 0x00
+DELTA_OP_INSERT = 0x01
+
+LZ4_MIN_MATCH = 4
+LZ4_MAX_OFFSET = 0xFFFF
+LZ4_LAST_LITERALS = 5
+LZ4_MFLIMIT = 12
+
+DELTA_KEY_LEN = 8
+DELTA_MIN_COPY = 16
+
+
+def _lz4_len(out, n):
+    while n >= 255:
+        out.append(255)
+        n -= 255
+    out.append(n)
+
+
+def _lz4_sequence(out, literals, match_len, offset):
+    lit = len(literals)
+    token = (min(lit, 15) << 4)
+    if match_len is not None:
+        token |= min(match_len - LZ4_MIN_MATCH, 15)
+    out.append(token)
+    if lit >= 15:
+        _lz4_len(out, lit - 15)
+    out += literals
+    if match_len is None:
+        return
+    out += struct.pack("<H", offset)
+    if match_len - LZ4_MIN_MATCH >= 15:
+        _lz4_len(out, match_len - LZ4_MIN_MATCH - 15)
+
+
+def lz4_compress(data):
+    """Greedy single-block LZ4 compressor (hash of 4 bytes, last position)."""
+    out = bytearray()
+    table = {}
+    n = len(data)
+    anchor = 0
+    i = 0
+    limit = n - LZ4_MFLIMIT
+    while i < limit:
+        key = data[i:i + LZ4_MIN_MATCH]
+        cand = table.get(key)
+        table[key] = i
+        if cand is None or i - cand > LZ4_MAX_OFFSET:
+            i += 1
+            continue
+        m = LZ4_MIN_MATCH
+        while i + m < n - LZ4_LAST_LITERALS and data[cand + m] == data[i + m]:
+            m += 1
+        _lz4_sequence(out, data[anchor:i], m, i - cand)
+        i += m
+        anchor = i
+    _lz4_sequence(out, data[anchor:], None, 0)
+    return bytes(out)
+
+
+def lz4_decompress(stream, size):
+    out = bytearray()
+    i = 0
+    while True:
+        token = stream[i]
+        i += 1
+        lit = token >> 4
+        if lit == 15:
+            while True:
+                b = stream[i]
+                i += 1
+                lit += b
+                if b != 255:
+                    break
+        out += stream[i:i + lit]
+        i += lit
+        if i >= len(stream):
+            break
+        offset = stream[i] | (stream[i + 1] << 8)
+        i += 2
+        m = token & 15
+        if m == 15:
+            while True:
+                b = stream[i]
+                i += 1
+                m += b
+                if b != 255:
+                    break
+        m += LZ4_MIN_MATCH
+        if offset == 0 or offset > len(out):
+            raise ValueError("bad LZ4 offset")
+        for _ in range(m):
+            out.append(out[-offset])
+    if len(out) != size:
+        raise ValueError("LZ4 size mismatch")
+    return bytes(out)
+
+
+def _varint(out, v):
+    while True:
+        b = v & 0x7F
+        v >>= 7
+        if v:
+            out.append(b | 0x80)
+        else:
+            out.append(b)
+            return
+
+
+def _read_varint(stream, i):
+    v = 0
+    shift = 0
+    while True:
+        b = stream[i]
+        i += 1
+        v |= (b & 0x7F) << shift
+        shift += 7
+        if not b & 0x80:
+            return v, i
+
+
+def delta_encode(base, data):
+    """Greedy COPY/INSERT delta; prefers continuing the previous copy."""
+    index = {}
+    for p in range(len(base) - DELTA_KEY_LEN + 1):
+        index.setdefault(base[p:p + DELTA_KEY_LEN], p)
+
+    out = bytearray()
+    pending = bytearray()
+    i = 0
+    next_src = 0
+    n = len(data)
+
+    def flush():
+        if pending:
+            out.append(DELTA_OP_INSERT)
+            _varint(out, len(pending))
+            out.extend(pending)
+            pending.clear()
+
+    while i < n:
+        best_src, best_len = None, 0
+        for src in (next_src, index.get(data[i:i + DELTA_KEY_LEN])):
+            if src is None or src >= len(base):
+                continue
+            m = 0
+            while i + m < n and src + m < len(base) \
+                    and base[src + m] == data[i + m]:
+                m += 1
+            if m > best_len:
+                best_src, best_len = src, m
+        if best_len >= DELTA_MIN_COPY:
+            flush()
+            out.append(DELTA_OP_COPY)
+            _varint(out, best_src)
+            _varint(out, best_len)
+            i += best_len
+            next_src = best_src + best_len
+        else:
+            pending.append(data[i])
+            i += 1
+            next_src += 1
+    flush()
+    return bytes(out)
+
+
+def delta_decode(base, stream, size):
+    out = bytearray()
+    i = 0
+    while i < len(stream):
+        op = stream[i]
+        i += 1
+        if op == DELTA_OP_COPY:
+            off, i = _read_varint(stream, i)
+            ln, i = _read_varint(stream, i)
+            if off + ln > len(base):
+                raise ValueError("copy outside base image")
+            out += base[off:off + ln]
+        elif op == DELTA_OP_INSERT:
+            ln, i = _read_varint(stream, i)
+            out += stream[i:i + ln]
+            i += ln
+        else:
+            raise ValueError("unknown delta op")
+    if len(out) != size:
+        raise ValueError("delta size mismatch")
+    return bytes(out)
+
+
+def encode(data, encoding, base=None):
+    """
+    Encode an image and verify it decodes back byte for byte.
+    Returns (payload, header_tail).
+    """
+    if encoding == ENCODING_RAW:
+        return data, bytes([ENCODING_RAW])
+    if encoding == ENCODING_LZ4:
+        payload = lz4_compress(data)
+        decoded = lz4_decompress(payload, len(data))
+        tail = bytes([ENCODING_LZ4])
+    elif encoding == ENCODING_DELTA:
+        payload = delta_encode(base, data)
+        decoded = delta_decode(base, payload, len(data))
+        tail = bytes([ENCODING_DELTA]) + struct.pack("<I", len(base)) \
+            + hashlib.md5(base).digest()
+    else:
+        raise ValueError("unknown encoding")
+    if decoded != data:
+        raise ValueError("round trip mismatch")
+    return payload, tail
+
+
+def _report(name, data, payload):
+    ratio = 100.0 * len(payload) / max(len(data), 1)
+    print(f"{name}: {len(data)} -> {len(payload)} bytes ({ratio:.1f}%)")
+
+
+def selftest():
+    rnd = random.Random(0x917)
+    images = [
+        b"",
+        b"a",
+        bytes(range(256)) * 64,
+        bytes(rnd.getrandbits(8) for _ in range(5000)),
+        b"\x00" * 70000,
+    ]
+    for fname in ("switch_v2.gbl", "7-23-01.gbl"):
+        path = os.path.join(os.path.dirname(os.path.abspath(__file__)), fname)
+        if os.path.exists(path):
+            with open(path, "rb") as f:
+                images.append(f.read())
+    for idx, img in enumerate(images):
+        payload, _ = encode(img, ENCODING_LZ4)
+        _report(f"lz4 #{idx}", img, payload)
+        patched = bytearray(img)
+        for _ in range(min(8, len(patched))):
+            patched[rnd.randrange(len(patched))] ^= 0x5A
+        patched = bytes(patched[: len(patched) // 2]) + b"new section" \
+            + bytes(patched[len(patched) // 2:])
+        payload, _ = encode(patched, ENCODING_DELTA, img)
+        _report(f"delta #{idx}", patched, payload)
+    print("selftest passed")
+
+
+def main(argv):
+    if len(argv) == 2 and argv[1] == "selftest":
+        selftest()
+        return 0
+    if len(argv) == 4 and argv[1] == "lz4":
+        with open(argv[2], "rb") as f:
+            data = f.read()
+        payload, tail = encode(data, ENCODING_LZ4)
+        out = argv[3]
+    elif len(argv) == 5 and argv[1] == "delta":
+        with open(argv[2], "rb") as f:
+            base = f.read()
+        with open(argv[3], "rb") as f:
+            data = f.read()
+        payload, tail = encode(data, ENCODING_DELTA, base)
+        out = argv[4]
+    else:
+        print(__doc__)
+        return 1
+    with open(out, "wb") as f:
+        f.write(payload)
+    _report(argv[1], data, payload)
+    print(f"decoded size {len(data)}, md5 {hashlib.md5(data).hexdigest()}")
+    print(f"header tail {tail.hex()}")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv))
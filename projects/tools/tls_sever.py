@@ -4,8 +4,11 @@ import threading
 import struct
 import os
 import hashlib
+import io
 import sys
 
+import sl_ota_pack
+
 # Global variables to store connected clients
 clients = {}
 lock = threading.Lock()
@@ -285,18 +288,38 @@ def ota_bridge():
         except Exception as e:
             print(f"OTA Bridge error: {e}")
 
+def load_ota_image(fp):
+    """
+    Ask for the transfer encoding and return (image, payload file, header tail).
+    Size and MD5 in the header always describe the decoded image.
+    """
+    image = fp.read()
+    enc = input("Encoding [raw/lz4/delta] (default raw): ").strip().lower()
+    if enc == "lz4":
+        payload, tail = sl_ota_pack.encode(image, sl_ota_pack.ENCODING_LZ4)
+    elif enc == "delta":
+        base_path = input("Enter base firmware file path (image staged on the bridge): ")
+        with open(base_path, "rb") as bf:
+            base = bf.read()
+        payload, tail = sl_ota_pack.encode(image, sl_ota_pack.ENCODING_DELTA, base)
+    else:
+        return image, io.BytesIO(image), b""
+    print(f"encoded {len(image)} -> {len(payload)} bytes")
+    return image, io.BytesIO(payload), tail
+
 def process_ota_ncp(conn, fp):
     ctr = 0
-    # calculate the size of the file.
-    size = os.path.getsize(fp.name)
+    image, fp, tail = load_ota_image(fp)
+    size = len(image)
     print(f"size of file=={size}")
     # convert size to bytes array
     data = struct.pack("<I", size)
     # calculate the md5 of the file.
-    md5 = hashlib.md5(fp.read()).hexdigest()
+    md5 = hashlib.md5(image).hexdigest()
     print(f"md5 of file=={md5}, length=={len(md5)}")
     # convert md5 to bytes array
     data += bytes.fromhex(md5)
+    data += tail
 
     length = len(data)
     # RPS_HEADER packet: [OTA_NCP][RPS_HEADER][len_lo][len_hi][data...]
@@ -367,19 +390,27 @@ def ota_ncp():
             print(f"OTA NCP error: {e}")
 
 
-def process_ota_node(conn, fp, nodeid):
+def process_ota_node(conn, fp, nodeid, extra_nodes=()):
     ctr = 0
-    # calculate the size of the file.
-    size = os.path.getsize(fp.name)
+    image, fp, tail = load_ota_image(fp)
+    size = len(image)
     print(f"size of file=={size}")
     # convert size to bytes array
     data = struct.pack("<I", size)
     # calculate the md5 of the file.
-    md5 = hashlib.md5(fp.read()).hexdigest()
+    md5 = hashlib.md5(image).hexdigest()
     print(f"md5 of file=={md5}, length=={len(md5)}")
     # convert md5 to bytes array
     data += nodeid.to_bytes(2, 'big')
     data += bytes.fromhex(md5)
+    if extra_nodes:
+        # node list follows the encoding fields, so always send them.
+        data += tail or bytes([sl_ota_pack.ENCODING_RAW])
+        data += struct.pack("B", len(extra_nodes))
+        for n in extra_nodes:
+            data += n.to_bytes(2, 'big')
+    else:
+        data += tail
 
     length = len(data)
     # RPS_HEADER packet: [OTA_NCP][RPS_HEADER][len_lo][len_hi][data...]
@@ -448,8 +479,10 @@ def ota_node():
                 print("Invalid Node ID. It should be a number.")
                 return
             nodeid = int(nodeid)
+            extra = input("Additional node IDs updated in parallel (comma separated, empty for none): ")
+            extra_nodes = [int(n) for n in extra.split(",") if n.strip().isdigit()]
             conn = clients[client_address]
-            process_ota_node(conn, fp, nodeid)
+            process_ota_node(conn, fp, nodeid, extra_nodes)
             fp.close()
             print("Sending FW OTA Node completed. Please wait update to the node finished. It may take about 30 minutes.")
         except Exception as e:
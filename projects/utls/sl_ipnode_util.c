@@ -18,10 +18,20 @@
 #include "ipv6_utils.h"
 #include "sl_tcpip_def.h"
 #include "sl_ipnode_utils.h"
+#include "Net/sl_udp_utils.h"
 
-sl_tcpip_buf_t bkp_con;
-char bkp_zip[BKP_ZIP_SIZE];
-uint32_t bkp_zip_len = 0;
+/* Current packet before the first one arrives, so the macros never see NULL. */
+static sl_tcpip_buf_t bkp_idle = { .zip_data = bkp_idle.data };
+sl_tcpip_buf_t *bkp_pkt = &bkp_idle;
+
+void sl_backup_pkt_set(sl_tcpip_buf_t *buf)
+{
+  sl_tcpip_buf_t *prev = bkp_pkt;
+
+  sl_tcpip_buf_hold(buf);
+  bkp_pkt = buf;
+  sl_tcpip_buf_release(prev);
+}
 
 uint8_t
 is_local_address(uip_ipaddr_t *ip)
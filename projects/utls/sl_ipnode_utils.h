@@ -22,8 +22,6 @@
 #include "sl_tcpip_def.h"
 #include "ZW_udp_server.h"
 
-#define BKP_ZIP_SIZE  256
-
 //#define UIP_IP_BUF                          ((struct uip_ip_hdr *)&uip_buf[UIP_LLH_LEN])
 //#define UIP_ICMP_BUF                      ((struct uip_icmp_hdr *)&uip_buf[uip_l2_l3_hdr_len])
 //#define UIP_UDP_BUF                        ((struct uip_udp_hdr *)&uip_buf[uip_l2_l3_hdr_len])
@@ -59,28 +57,31 @@
 #define UIP_LLIPH_LEN (UIP_LLH_LEN + UIP_IPH_LEN)    /* size of L2
                                                       + IP header */
 
-extern sl_tcpip_buf_t bkp_con;
-extern char bkp_zip[BKP_ZIP_SIZE];
-extern uint32_t bkp_zip_len;
+/*
+ * Packet being handled by the tcpip thread. It stays valid until the next
+ * packet is set, so completion callbacks of the previous frame (ZIP ACK,
+ * send done) can still read it.
+ */
+extern sl_tcpip_buf_t *bkp_pkt;
+
+/**
+ * @brief Make buf the current packet; holds buf and releases the previous one.
+ */
+void sl_backup_pkt_set(sl_tcpip_buf_t *buf);
 
-#define sl_backup_uip_buf(buf)   do { bkp_con.zw_con = buf->zw_con; } while (0)
-#define sl_uip_buf_src_addr()    bkp_con.zw_con.ripaddr
-#define sl_uip_buf_src_port()    bkp_con.zw_con.rport
-#define sl_uip_buf_dst_addr()    bkp_con.zw_con.lipaddr
-#define sl_uip_buf_dst_port()    bkp_con.zw_con.lport
-#define sl_uip_buf_lendpoint()   bkp_con.zw_con.lendpoint
-#define sl_uip_buf_rendpoint()   bkp_con.zw_con.rendpoint
-#define sl_uip_buf_flags0()      bkp_con.zw_con.rx_flags
-#define sl_uip_buf_flags1()      bkp_con.zw_con.tx_flags
-#define sl_uip_buf_get_conn()    bkp_con.zw_con.conn
+#define sl_uip_buf_src_addr()    bkp_pkt->zw_con.ripaddr
+#define sl_uip_buf_src_port()    bkp_pkt->zw_con.rport
+#define sl_uip_buf_dst_addr()    bkp_pkt->zw_con.lipaddr
+#define sl_uip_buf_dst_port()    bkp_pkt->zw_con.lport
+#define sl_uip_buf_lendpoint()   bkp_pkt->zw_con.lendpoint
+#define sl_uip_buf_rendpoint()   bkp_pkt->zw_con.rendpoint
+#define sl_uip_buf_flags0()      bkp_pkt->zw_con.rx_flags
+#define sl_uip_buf_flags1()      bkp_pkt->zw_con.tx_flags
+#define sl_uip_buf_get_conn()    bkp_pkt->zw_con.conn
 
-#define ZIP_PKT_BUF              ((ZW_COMMAND_ZIP_PACKET*)&bkp_zip[0])
+#define ZIP_PKT_BUF              ((ZW_COMMAND_ZIP_PACKET*)bkp_pkt->zip_data)
 #define ZIP_PKT_BUF_SIZE                 400
-#define sl_backup_zip_buf(buf, len)   do { \
-    memcpy(bkp_zip, buf, len);             \
-    bkp_zip_len = len;                     \
-} while (0)
-#define sl_backup_zip_len()      bkp_zip_len
+#define sl_backup_zip_len()      bkp_pkt->zip_data_len
 
 uint8_t
 is_local_address(uip_ipaddr_t *ip);